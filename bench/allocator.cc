@@ -0,0 +1,43 @@
+#include <cycle_ptr.h>
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <vector>
+
+using namespace cycle_ptr;
+
+namespace {
+
+class node
+: public cycle_base
+{
+ public:
+  using vector_type = std::vector<
+      cycle_member_ptr<node>,
+      cycle_allocator<std::allocator<cycle_member_ptr<node>>>>;
+
+  node()
+  : edges(vector_type::allocator_type(*this))
+  {}
+
+  vector_type edges;
+};
+
+// Each thread grows its own adjacency list.
+// Every element construction looks up its owner.
+void vector_growth(benchmark::State& state) {
+  const cycle_gptr<node> target = make_cycle<node>();
+
+  for (auto _ : state) {
+    cycle_gptr<node> owner = make_cycle<node>();
+    for (int i = 0; i < 256; ++i) owner->edges.emplace_back(target);
+    benchmark::DoNotOptimize(owner);
+  }
+
+  state.SetItemsProcessed(state.iterations() * 256);
+}
+
+} /* namespace <unnamed> */
+
+BENCHMARK(vector_growth)->ThreadRange(1, 8)->UseRealTime();
+
+BENCHMARK_MAIN();
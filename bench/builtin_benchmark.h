@@ -0,0 +1,388 @@
+#pragma once
+
+// Minimal stand-in for Google Benchmark, used when it is not installed.
+// Implements the subset of its interface used by the benchmarks:
+// BENCHMARK(fn)->ThreadRange(lo, hi)->UseRealTime(), state iteration,
+// SetItemsProcessed, DoNotOptimize and BENCHMARK_MAIN.
+//
+// Recognized flags:
+//   --benchmark_filter=<regex>
+//   --benchmark_min_time=<seconds>
+//   --benchmark_format=<console|json>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace benchmark {
+
+
+class State;
+
+namespace internal {
+
+
+class Benchmark;
+
+///\brief All registered benchmarks.
+inline auto registry()
+-> std::vector<std::unique_ptr<Benchmark>>& {
+  static std::vector<std::unique_ptr<Benchmark>> impl;
+  return impl;
+}
+
+///\brief Barrier, used to start and stop the threads of a run together.
+class barrier {
+ public:
+  explicit barrier(int count) noexcept
+  : count_(count)
+  {}
+
+  ///\brief Wait for all threads.
+  ///\returns True for exactly one of the threads.
+  auto wait()
+  -> bool {
+    std::unique_lock<std::mutex> lck{ mtx_ };
+    const int phase = phase_;
+    if (++arrived_ == count_) {
+      arrived_ = 0;
+      ++phase_;
+      cv_.notify_all();
+      return true;
+    }
+    cv_.wait(lck, [this, phase]() { return phase_ != phase; });
+    return false;
+  }
+
+ private:
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  const int count_;
+  int arrived_ = 0;
+  int phase_ = 0;
+};
+
+///\brief Shared state of a single run.
+struct run {
+  run(std::int64_t iterations, int threads)
+  : iterations(iterations),
+    threads(threads),
+    start_barrier(threads),
+    stop_barrier(threads)
+  {}
+
+  const std::int64_t iterations;
+  const int threads;
+  barrier start_barrier, stop_barrier;
+  std::chrono::steady_clock::time_point start, stop;
+  std::clock_t cpu_start = 0, cpu_stop = 0;
+  std::atomic<std::int64_t> items{ 0 };
+};
+
+
+} /* namespace benchmark::internal */
+
+
+/**
+ * \brief Per thread state of a benchmark run.
+ * \details
+ * Iterating the state runs the timed loop.
+ */
+class State {
+  friend class internal::Benchmark;
+
+ public:
+  ///\brief Value of the iteration.
+  struct [[maybe_unused]] value {};
+
+  ///\brief Iterator counting down the iterations.
+  class iterator {
+   public:
+    explicit iterator(std::int64_t remaining) noexcept
+    : remaining_(remaining)
+    {}
+
+    auto operator*() const noexcept -> value { return {}; }
+
+    auto operator++()
+    noexcept
+    -> iterator& {
+      --remaining_;
+      return *this;
+    }
+
+    auto operator!=(const iterator& other) const
+    noexcept
+    -> bool {
+      return remaining_ != other.remaining_;
+    }
+
+   private:
+    std::int64_t remaining_;
+  };
+
+  ///\brief Start the timed loop, once all threads are ready.
+  auto begin()
+  -> iterator {
+    if (run_.start_barrier.wait()) {
+      run_.cpu_start = std::clock();
+      run_.start = std::chrono::steady_clock::now();
+    }
+    return iterator(run_.iterations);
+  }
+
+  ///\brief End of the timed loop.
+  auto end()
+  -> iterator {
+    return iterator(0);
+  }
+
+  auto iterations() const noexcept -> std::int64_t { return run_.iterations; }
+  auto thread_index() const noexcept -> int { return thread_index_; }
+  auto threads() const noexcept -> int { return run_.threads; }
+
+  auto SetItemsProcessed(std::int64_t items)
+  noexcept
+  -> void {
+    run_.items.fetch_add(items, std::memory_order_relaxed);
+  }
+
+ private:
+  State(internal::run& r, int thread_index) noexcept
+  : run_(r),
+    thread_index_(thread_index)
+  {}
+
+  ///\brief Stop the clock, once all threads completed their loop.
+  auto finish_()
+  -> void {
+    if (run_.stop_barrier.wait()) {
+      run_.stop = std::chrono::steady_clock::now();
+      run_.cpu_stop = std::clock();
+    }
+  }
+
+  internal::run& run_;
+  const int thread_index_;
+};
+
+
+///\brief Prevent the compiler from optimizing away \p v.
+template<typename T>
+inline auto DoNotOptimize(T&& v)
+-> void {
+  asm volatile("" : : "g"(&v) : "memory");
+}
+
+///\brief Prevent the compiler from optimizing away pending writes.
+inline auto ClobberMemory()
+-> void {
+  asm volatile("" : : : "memory");
+}
+
+
+namespace internal {
+
+
+///\brief Result of benchmarking a function at a thread count.
+struct result {
+  std::string name;
+  int threads;
+  std::int64_t iterations;
+  double real_ns, cpu_ns, items_per_second;
+};
+
+///\brief A registered benchmark.
+class Benchmark {
+ public:
+  Benchmark(const char* name, void (*fn)(State&))
+  : name_(name),
+    fn_(fn)
+  {}
+
+  ///\brief Run with powers of two threads from \p lo to \p hi, and \p hi itself.
+  auto ThreadRange(int lo, int hi)
+  -> Benchmark* {
+    threads_.clear();
+    for (int t = lo; t < hi; t *= 2) threads_.push_back(t);
+    threads_.push_back(hi);
+    return this;
+  }
+
+  ///\brief Run with \p t threads.
+  auto Threads(int t)
+  -> Benchmark* {
+    threads_.push_back(t);
+    return this;
+  }
+
+  ///\brief Wall clock time is always used.
+  auto UseRealTime()
+  noexcept
+  -> Benchmark* {
+    return this;
+  }
+
+  auto name() const noexcept -> const std::string& { return name_; }
+
+  ///\brief Run at each thread count, growing the iteration count until \p min_time is reached.
+  auto run_all(double min_time)
+  -> std::vector<result> {
+    std::vector<result> results;
+    for (int t : (threads_.empty() ? std::vector<int>{ 1 } : threads_)) {
+      std::int64_t iterations = 1;
+      for (;;) {
+        run r{ iterations, t };
+        run_once_(r);
+        const double elapsed = std::chrono::duration<double>(r.stop - r.start).count();
+        if (elapsed >= min_time || iterations >= 1'000'000'000) {
+          std::string full_name = name_;
+          if (!threads_.empty()) full_name += "/real_time/threads:" + std::to_string(t);
+          results.push_back({
+                  std::move(full_name), t, iterations,
+                  elapsed * 1e9 / static_cast<double>(iterations),
+                  static_cast<double>(r.cpu_stop - r.cpu_start) / CLOCKS_PER_SEC * 1e9 / static_cast<double>(iterations),
+                  static_cast<double>(r.items.load()) / elapsed });
+          break;
+        }
+
+        // Aim for 1.4 times the minimum time.
+        const double scale = (elapsed <= 0.0 ? 10.0 : std::min(10.0, 1.4 * min_time / elapsed));
+        iterations = std::max(iterations + 1, static_cast<std::int64_t>(static_cast<double>(iterations) * scale));
+      }
+    }
+    return results;
+  }
+
+ private:
+  auto run_once_(run& r)
+  -> void {
+    const auto body =
+        [this, &r](int index) {
+          State state{ r, index };
+          fn_(state);
+          state.finish_();
+        };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < r.threads; ++i) threads.emplace_back(body, i);
+    body(0);
+    for (auto& thr : threads) thr.join();
+  }
+
+  const std::string name_;
+  void (*const fn_)(State&);
+  std::vector<int> threads_;
+};
+
+inline auto register_benchmark(const char* name, void (*fn)(State&))
+-> Benchmark* {
+  registry().push_back(std::make_unique<Benchmark>(name, fn));
+  return registry().back().get();
+}
+
+///\brief Write \p s as a JSON string.
+inline auto json_string(std::ostream& out, const std::string& s)
+-> std::ostream& {
+  out << '"';
+  for (char c : s) {
+    if (c == '"' || c == '\\') out << '\\';
+    out << c;
+  }
+  return out << '"';
+}
+
+inline auto main(int argc, char** argv)
+-> int {
+  std::regex filter{ "." };
+  double min_time = 0.5;
+  bool json = false;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const auto value =
+        [&arg](const std::string& flag) -> const char* {
+          if (arg.compare(0, flag.size(), flag) != 0) return nullptr;
+          return arg.c_str() + flag.size();
+        };
+
+    if (const char* v = value("--benchmark_filter=")) {
+      filter = std::regex(v);
+    } else if (const char* v = value("--benchmark_min_time=")) {
+      min_time = std::stod(v); // Accepts a trailing 's'.
+    } else if (const char* v = value("--benchmark_format=")) {
+      json = (std::string(v) == "json");
+    } else {
+      std::cerr << "unrecognized flag: " << arg << "\n";
+      return 1;
+    }
+  }
+
+  std::vector<result> results;
+  for (const auto& b : registry()) {
+    if (!std::regex_search(b->name(), filter)) continue;
+    for (result& r : b->run_all(min_time)) {
+      if (!json) {
+        std::cout << std::left << std::setw(48) << r.name << std::right
+            << std::setw(14) << std::fixed << std::setprecision(1) << r.real_ns << " ns"
+            << std::setw(14) << r.cpu_ns << " ns"
+            << std::setw(12) << r.iterations
+            << "  items_per_second=" << std::setprecision(0) << r.items_per_second << "/s"
+            << std::endl;
+      }
+      results.push_back(std::move(r));
+    }
+  }
+
+  if (json) {
+    std::cout << "{\n"
+        << "  \"context\": {\n"
+        << "    \"library\": \"builtin\",\n"
+        << "    \"num_cpus\": " << std::thread::hardware_concurrency() << "\n"
+        << "  },\n"
+        << "  \"benchmarks\": [";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+      const result& r = results[i];
+      std::cout << (i == 0 ? "\n" : ",\n") << "    {\n      \"name\": ";
+      json_string(std::cout, r.name) << ",\n"
+          << "      \"run_type\": \"iteration\",\n"
+          << "      \"threads\": " << r.threads << ",\n"
+          << "      \"iterations\": " << r.iterations << ",\n"
+          << std::setprecision(17)
+          << "      \"real_time\": " << r.real_ns << ",\n"
+          << "      \"cpu_time\": " << r.cpu_ns << ",\n"
+          << "      \"time_unit\": \"ns\",\n"
+          << "      \"items_per_second\": " << r.items_per_second << "\n"
+          << "    }";
+    }
+    std::cout << "\n  ]\n}\n";
+  }
+  return 0;
+}
+
+
+} /* namespace benchmark::internal */
+} /* namespace benchmark */
+
+
+#define BENCHMARK_CONCAT_(a, b) a##b
+#define BENCHMARK_NAME_(line) BENCHMARK_CONCAT_(benchmark_registration_, line)
+
+#define BENCHMARK(fn) \
+    [[maybe_unused]] static ::benchmark::internal::Benchmark* BENCHMARK_NAME_(__LINE__) = \
+        ::benchmark::internal::register_benchmark(#fn, &fn)
+
+#define BENCHMARK_MAIN() \
+    int main(int argc, char** argv) { return ::benchmark::internal::main(argc, argv); }
@@ -0,0 +1,629 @@
+#include <cycle_ptr.h>
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#ifdef __GLIBC__
+# include <malloc.h>
+#endif
+
+// Runs the same workloads using cycle_ptr, std::shared_ptr with cycles
+// broken by hand using std::weak_ptr, and raw pointers into an arena.
+//
+// Each iteration builds the structure, traverses it, and destroys it.
+// Counters:
+// - bytes_per_object: heap memory held by the structure, per node.
+// - peak_heap_bytes: heap memory high water mark while building.
+// - peak_rss_kb: peak resident set size while running the benchmark.
+//   On Linux, the peak is reset at the start of each benchmark.
+//   Elsewhere, this is the peak of the process so far.
+
+namespace {
+
+std::atomic<std::size_t> heap_bytes{ 0 };
+std::atomic<std::size_t> heap_peak{ 0 };
+
+// Room in front of each allocation, to record its size.
+constexpr std::size_t header_size = alignof(std::max_align_t);
+
+// Recorded in front of each over-aligned allocation.
+struct aligned_header {
+  void* base;
+  std::size_t size;
+};
+
+auto count_allocation(std::size_t sz)
+noexcept
+-> void {
+  const std::size_t now = heap_bytes.fetch_add(sz, std::memory_order_relaxed) + sz;
+  std::size_t peak = heap_peak.load(std::memory_order_relaxed);
+  while (now > peak && !heap_peak.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {}
+}
+
+auto count_deallocation(std::size_t sz)
+noexcept
+-> void {
+  heap_bytes.fetch_sub(sz, std::memory_order_relaxed);
+}
+
+} /* namespace <unnamed> */
+
+auto operator new(std::size_t sz)
+-> void* {
+  void*const p = std::malloc(sz + header_size);
+  if (p == nullptr) throw std::bad_alloc();
+  *static_cast<std::size_t*>(p) = sz;
+
+  count_allocation(sz);
+  return static_cast<char*>(p) + header_size;
+}
+
+auto operator delete(void* p)
+noexcept
+-> void {
+  if (p == nullptr) return;
+  void*const base = static_cast<char*>(p) - header_size;
+  count_deallocation(*static_cast<std::size_t*>(base));
+  std::free(base);
+}
+
+auto operator delete(void* p, [[maybe_unused]] std::size_t sz)
+noexcept
+-> void {
+  ::operator delete(p);
+}
+
+auto operator new(std::size_t sz, std::align_val_t al)
+-> void* {
+  const std::size_t align = std::max(static_cast<std::size_t>(al), alignof(aligned_header));
+
+  // Over-allocate, so the result can be aligned with room for the header in front.
+  void*const base = std::malloc(sz + sizeof(aligned_header) + align - 1u);
+  if (base == nullptr) throw std::bad_alloc();
+  const std::uintptr_t addr =
+      (reinterpret_cast<std::uintptr_t>(base) + sizeof(aligned_header) + align - 1u) & ~std::uintptr_t(align - 1u);
+  void*const p = reinterpret_cast<void*>(addr);
+  new (static_cast<aligned_header*>(p) - 1) aligned_header{ base, sz };
+
+  count_allocation(sz);
+  return p;
+}
+
+auto operator delete(void* p, [[maybe_unused]] std::align_val_t al)
+noexcept
+-> void {
+  if (p == nullptr) return;
+  const aligned_header& h = *(static_cast<aligned_header*>(p) - 1);
+  count_deallocation(h.size);
+  std::free(h.base);
+}
+
+auto operator delete(void* p, [[maybe_unused]] std::size_t sz, std::align_val_t al)
+noexcept
+-> void {
+  ::operator delete(p, al);
+}
+
+namespace {
+
+using rng_type = std::minstd_rand;
+
+auto pick(rng_type& rng, std::size_t lo, std::size_t hi)
+-> std::size_t {
+  return std::uniform_int_distribution<std::size_t>(lo, hi - 1u)(rng);
+}
+
+
+// Workloads using cycle_ptr: every edge is a cycle_member_ptr.
+namespace with_cycle {
+
+using namespace cycle_ptr;
+
+// Binary tree, with edges back to the parent.
+struct tree {
+  struct node : cycle_base {
+    cycle_member_ptr<node> left, right, parent;
+    std::uint64_t value = 1;
+  };
+
+  tree(std::size_t n, [[maybe_unused]] rng_type& rng) {
+    std::vector<cycle_gptr<node>> nodes;
+    for (std::size_t i = 0; i < n; ++i) {
+      nodes.push_back(make_cycle<node>());
+      if (i != 0u) {
+        node& parent = *nodes[(i - 1u) / 2u];
+        (i % 2u == 1u ? parent.left : parent.right) = nodes.back();
+        nodes.back()->parent = nodes[(i - 1u) / 2u];
+      }
+    }
+    root = nodes.front();
+  }
+
+  static auto sum(const node& n)
+  -> std::uint64_t {
+    std::uint64_t s = n.value + (n.parent != nullptr ? n.parent->value : 0u);
+    if (n.left != nullptr) s += sum(*n.left);
+    if (n.right != nullptr) s += sum(*n.right);
+    return s;
+  }
+
+  auto sum() const -> std::uint64_t { return sum(*root); }
+
+  cycle_gptr<node> root;
+};
+
+// Chain, with edges to random later nodes.
+struct dag {
+  struct node : cycle_base {
+    cycle_member_ptr<node> next, a, b;
+    std::uint64_t value = 1;
+  };
+
+  dag(std::size_t n, rng_type& rng) {
+    std::vector<cycle_gptr<node>> nodes;
+    for (std::size_t i = 0; i < n; ++i) nodes.push_back(make_cycle<node>());
+    for (std::size_t i = 0; i + 1u < n; ++i) {
+      nodes[i]->next = nodes[i + 1u];
+      nodes[i]->a = nodes[pick(rng, i + 1u, n)];
+      nodes[i]->b = nodes[pick(rng, i + 1u, n)];
+    }
+    root = nodes.front();
+  }
+
+  auto sum() const
+  -> std::uint64_t {
+    std::uint64_t s = 0;
+    for (const node* i = root.get(); i != nullptr; i = i->next.get()) {
+      s += i->value;
+      if (i->a != nullptr) s += i->a->value + i->b->value;
+    }
+    return s;
+  }
+
+  cycle_gptr<node> root;
+};
+
+// Doubly linked list.
+struct list {
+  struct node : cycle_base {
+    cycle_member_ptr<node> next, prev;
+    std::uint64_t value = 1;
+  };
+
+  list(std::size_t n, [[maybe_unused]] rng_type& rng) {
+    head = make_cycle<node>();
+    cycle_gptr<node> tail = head;
+    for (std::size_t i = 1; i < n; ++i) {
+      cycle_gptr<node> elem = make_cycle<node>();
+      elem->prev = tail;
+      tail->next = elem;
+      tail = std::move(elem);
+    }
+  }
+
+  auto sum() const
+  -> std::uint64_t {
+    std::uint64_t s = 0;
+    for (const node* i = head.get(); i != nullptr; i = i->next.get())
+      s += i->value + (i->prev != nullptr ? i->prev->value : 0u);
+    return s;
+  }
+
+  cycle_gptr<node> head;
+};
+
+// Ring, with edges to random nodes.
+struct graph {
+  struct node : cycle_base {
+    cycle_member_ptr<node> next, a, b;
+    std::uint64_t value = 1;
+  };
+
+  graph(std::size_t n, rng_type& rng) {
+    std::vector<cycle_gptr<node>> nodes;
+    for (std::size_t i = 0; i < n; ++i) nodes.push_back(make_cycle<node>());
+    for (std::size_t i = 0; i < n; ++i) {
+      nodes[i]->next = nodes[(i + 1u) % n];
+      nodes[i]->a = nodes[pick(rng, 0, n)];
+      nodes[i]->b = nodes[pick(rng, 0, n)];
+    }
+    root = nodes.front();
+  }
+
+  auto sum() const
+  -> std::uint64_t {
+    std::uint64_t s = 0;
+    const node* i = root.get();
+    do {
+      s += i->value + i->a->value + i->b->value;
+      i = i->next.get();
+    } while (i != root.get());
+    return s;
+  }
+
+  cycle_gptr<node> root;
+};
+
+} /* namespace with_cycle */
+
+
+// Workloads using std::shared_ptr: edges that would close a cycle
+// are std::weak_ptr instead.
+namespace with_shared {
+
+// Binary tree, with weak edges back to the parent.
+struct tree {
+  struct node {
+    std::shared_ptr<node> left, right;
+    std::weak_ptr<node> parent;
+    std::uint64_t value = 1;
+  };
+
+  tree(std::size_t n, [[maybe_unused]] rng_type& rng) {
+    std::vector<std::shared_ptr<node>> nodes;
+    for (std::size_t i = 0; i < n; ++i) {
+      nodes.push_back(std::make_shared<node>());
+      if (i != 0u) {
+        node& parent = *nodes[(i - 1u) / 2u];
+        (i % 2u == 1u ? parent.left : parent.right) = nodes.back();
+        nodes.back()->parent = nodes[(i - 1u) / 2u];
+      }
+    }
+    root = nodes.front();
+  }
+
+  static auto sum(const node& n)
+  -> std::uint64_t {
+    const std::shared_ptr<node> parent = n.parent.lock();
+    std::uint64_t s = n.value + (parent != nullptr ? parent->value : 0u);
+    if (n.left != nullptr) s += sum(*n.left);
+    if (n.right != nullptr) s += sum(*n.right);
+    return s;
+  }
+
+  auto sum() const -> std::uint64_t { return sum(*root); }
+
+  std::shared_ptr<node> root;
+};
+
+// Chain, with edges to random later nodes.
+// Acyclic, so no weak pointers are needed.
+struct dag {
+  struct node {
+    std::shared_ptr<node> next, a, b;
+    std::uint64_t value = 1;
+  };
+
+  dag(std::size_t n, rng_type& rng) {
+    std::vector<std::shared_ptr<node>> nodes;
+    for (std::size_t i = 0; i < n; ++i) nodes.push_back(std::make_shared<node>());
+    for (std::size_t i = 0; i + 1u < n; ++i) {
+      nodes[i]->next = nodes[i + 1u];
+      nodes[i]->a = nodes[pick(rng, i + 1u, n)];
+      nodes[i]->b = nodes[pick(rng, i + 1u, n)];
+    }
+    root = nodes.front();
+  }
+
+  dag(const dag&) = delete;
+
+  // Unlink iteratively, so destruction does not recurse down the chain.
+  ~dag() noexcept {
+    for (std::shared_ptr<node> i = std::move(root); i != nullptr; ) {
+      i->a.reset();
+      i->b.reset();
+      i = std::move(i->next);
+    }
+  }
+
+  auto sum() const
+  -> std::uint64_t {
+    std::uint64_t s = 0;
+    for (const node* i = root.get(); i != nullptr; i = i->next.get()) {
+      s += i->value;
+      if (i->a != nullptr) s += i->a->value + i->b->value;
+    }
+    return s;
+  }
+
+  std::shared_ptr<node> root;
+};
+
+// Doubly linked list, with weak edges to the previous element.
+struct list {
+  struct node {
+    std::shared_ptr<node> next;
+    std::weak_ptr<node> prev;
+    std::uint64_t value = 1;
+  };
+
+  list(std::size_t n, [[maybe_unused]] rng_type& rng) {
+    head = std::make_shared<node>();
+    std::shared_ptr<node> tail = head;
+    for (std::size_t i = 1; i < n; ++i) {
+      std::shared_ptr<node> elem = std::make_shared<node>();
+      elem->prev = tail;
+      tail->next = elem;
+      tail = std::move(elem);
+    }
+  }
+
+  list(const list&) = delete;
+
+  // Unlink iteratively, so destruction does not recurse down the list.
+  ~list() noexcept {
+    for (std::shared_ptr<node> i = std::move(head); i != nullptr; )
+      i = std::move(i->next);
+  }
+
+  auto sum() const
+  -> std::uint64_t {
+    std::uint64_t s = 0;
+    for (const node* i = head.get(); i != nullptr; i = i->next.get()) {
+      const std::shared_ptr<node> prev = i->prev.lock();
+      s += i->value + (prev != nullptr ? prev->value : 0u);
+    }
+    return s;
+  }
+
+  std::shared_ptr<node> head;
+};
+
+// Ring, with edges to random nodes.
+// The graph owns all nodes, and all edges are weak.
+struct graph {
+  struct node {
+    std::weak_ptr<node> next, a, b;
+    std::uint64_t value = 1;
+  };
+
+  graph(std::size_t n, rng_type& rng) {
+    for (std::size_t i = 0; i < n; ++i) nodes.push_back(std::make_shared<node>());
+    for (std::size_t i = 0; i < n; ++i) {
+      nodes[i]->next = nodes[(i + 1u) % n];
+      nodes[i]->a = nodes[pick(rng, 0, n)];
+      nodes[i]->b = nodes[pick(rng, 0, n)];
+    }
+  }
+
+  auto sum() const
+  -> std::uint64_t {
+    std::uint64_t s = 0;
+    std::shared_ptr<node> i = nodes.front();
+    do {
+      s += i->value + i->a.lock()->value + i->b.lock()->value;
+      i = i->next.lock();
+    } while (i != nodes.front());
+    return s;
+  }
+
+  std::vector<std::shared_ptr<node>> nodes;
+};
+
+} /* namespace with_shared */
+
+
+// Workloads using raw pointers, with all nodes owned by an arena.
+namespace with_arena {
+
+// Binary tree, with edges back to the parent.
+struct tree {
+  struct node {
+    node* left = nullptr;
+    node* right = nullptr;
+    node* parent = nullptr;
+    std::uint64_t value = 1;
+  };
+
+  tree(std::size_t n, [[maybe_unused]] rng_type& rng) {
+    for (std::size_t i = 0; i < n; ++i) {
+      node& elem = nodes.emplace_back();
+      if (i != 0u) {
+        node& parent = nodes[(i - 1u) / 2u];
+        (i % 2u == 1u ? parent.left : parent.right) = &elem;
+        elem.parent = &parent;
+      }
+    }
+  }
+
+  static auto sum(const node& n)
+  -> std::uint64_t {
+    std::uint64_t s = n.value + (n.parent != nullptr ? n.parent->value : 0u);
+    if (n.left != nullptr) s += sum(*n.left);
+    if (n.right != nullptr) s += sum(*n.right);
+    return s;
+  }
+
+  auto sum() const -> std::uint64_t { return sum(nodes.front()); }
+
+  std::deque<node> nodes;
+};
+
+// Chain, with edges to random later nodes.
+struct dag {
+  struct node {
+    node* next = nullptr;
+    node* a = nullptr;
+    node* b = nullptr;
+    std::uint64_t value = 1;
+  };
+
+  dag(std::size_t n, rng_type& rng)
+  : nodes(n)
+  {
+    for (std::size_t i = 0; i + 1u < n; ++i) {
+      nodes[i].next = &nodes[i + 1u];
+      nodes[i].a = &nodes[pick(rng, i + 1u, n)];
+      nodes[i].b = &nodes[pick(rng, i + 1u, n)];
+    }
+  }
+
+  auto sum() const
+  -> std::uint64_t {
+    std::uint64_t s = 0;
+    for (const node* i = &nodes.front(); i != nullptr; i = i->next) {
+      s += i->value;
+      if (i->a != nullptr) s += i->a->value + i->b->value;
+    }
+    return s;
+  }
+
+  std::deque<node> nodes;
+};
+
+// Doubly linked list.
+struct list {
+  struct node {
+    node* next = nullptr;
+    node* prev = nullptr;
+    std::uint64_t value = 1;
+  };
+
+  list(std::size_t n, [[maybe_unused]] rng_type& rng) {
+    node* tail = nullptr;
+    for (std::size_t i = 0; i < n; ++i) {
+      node& elem = nodes.emplace_back();
+      elem.prev = tail;
+      if (tail != nullptr) tail->next = &elem;
+      tail = &elem;
+    }
+  }
+
+  auto sum() const
+  -> std::uint64_t {
+    std::uint64_t s = 0;
+    for (const node* i = &nodes.front(); i != nullptr; i = i->next)
+      s += i->value + (i->prev != nullptr ? i->prev->value : 0u);
+    return s;
+  }
+
+  std::deque<node> nodes;
+};
+
+// Ring, with edges to random nodes.
+struct graph {
+  struct node {
+    node* next = nullptr;
+    node* a = nullptr;
+    node* b = nullptr;
+    std::uint64_t value = 1;
+  };
+
+  graph(std::size_t n, rng_type& rng)
+  : nodes(n)
+  {
+    for (std::size_t i = 0; i < n; ++i) {
+      nodes[i].next = &nodes[(i + 1u) % n];
+      nodes[i].a = &nodes[pick(rng, 0, n)];
+      nodes[i].b = &nodes[pick(rng, 0, n)];
+    }
+  }
+
+  auto sum() const
+  -> std::uint64_t {
+    std::uint64_t s = 0;
+    const node* i = &nodes.front();
+    do {
+      s += i->value + i->a->value + i->b->value;
+      i = i->next;
+    } while (i != &nodes.front());
+    return s;
+  }
+
+  std::deque<node> nodes;
+};
+
+} /* namespace with_arena */
+
+
+// Reset the peak resident set size of the process to its current size.
+// Returns false if the system does not support this.
+auto reset_peak_rss()
+-> bool {
+#ifdef __GLIBC__
+  // Return memory freed by earlier benchmarks to the system,
+  // so it won't count towards this benchmark.
+  malloc_trim(0);
+#endif
+
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  clear_refs << "5";
+  clear_refs.close();
+  return !clear_refs.fail();
+}
+
+// Peak resident set size of the process in kB, since the last reset.
+auto peak_rss_kb()
+-> std::optional<long> {
+  std::ifstream status("/proc/self/status");
+  for (std::string line; std::getline(status, line); ) {
+    if (line.compare(0, 6, "VmHWM:") == 0)
+      return std::strtol(line.c_str() + 6, nullptr, 10);
+  }
+  return std::nullopt;
+}
+
+// Build, traverse and destroy a workload.
+template<typename Workload>
+void compare(benchmark::State& state) {
+  const auto n = static_cast<std::size_t>(state.range(0));
+  // ru_maxrss covers the whole process, including earlier benchmarks.
+  const bool rss_reset = reset_peak_rss();
+
+  for (auto _ : state) {
+    rng_type rng;
+    std::optional<Workload> w;
+    w.emplace(n, rng);
+    benchmark::DoNotOptimize(w->sum());
+    w.reset();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+
+  // Memory use, measured outside the timed loop.
+  {
+    rng_type rng;
+    const std::size_t before = heap_bytes.load(std::memory_order_relaxed);
+    heap_peak.store(before, std::memory_order_relaxed);
+    std::optional<Workload> w;
+    w.emplace(n, rng);
+    const std::size_t after = heap_bytes.load(std::memory_order_relaxed);
+
+    state.counters["bytes_per_object"] = static_cast<double>(after - before) / static_cast<double>(n);
+    state.counters["peak_heap_bytes"] = static_cast<double>(heap_peak.load(std::memory_order_relaxed) - before);
+  }
+
+  const std::optional<long> peak_rss = (rss_reset ? peak_rss_kb() : std::nullopt);
+  rusage usage;
+  if (peak_rss.has_value())
+    state.counters["peak_rss_kb"] = static_cast<double>(*peak_rss);
+  else if (getrusage(RUSAGE_SELF, &usage) == 0)
+    state.counters["peak_rss_kb"] = static_cast<double>(usage.ru_maxrss);
+}
+
+} /* namespace <unnamed> */
+
+#define COMPARE(Workload)                                                     \
+    BENCHMARK_TEMPLATE(compare, with_cycle::Workload)                         \
+        ->RangeMultiplier(4)->Range(1 << 8, 1 << 12);                         \
+    BENCHMARK_TEMPLATE(compare, with_shared::Workload)                        \
+        ->RangeMultiplier(4)->Range(1 << 8, 1 << 12);                         \
+    BENCHMARK_TEMPLATE(compare, with_arena::Workload)                         \
+        ->RangeMultiplier(4)->Range(1 << 8, 1 << 12)
+
+COMPARE(tree);
+COMPARE(dag);
+COMPARE(list);
+COMPARE(graph);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,62 @@
+#include <cycle_ptr.h>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <vector>
+
+using namespace cycle_ptr;
+
+namespace {
+
+struct node
+: public cycle_base
+{
+  cycle_member_ptr<node> next;
+};
+
+// Create a two element cycle and drop it, collecting it.
+void cycle_churn(benchmark::State& state) {
+  for (auto _ : state) {
+    cycle_gptr<node> first = make_cycle<node>();
+    cycle_gptr<node> second = make_cycle<node>();
+    first->next = second;
+    second->next = first;
+  }
+
+  state.SetItemsProcessed(state.iterations() * 2);
+  state.counters["generation_bytes"] = sizeof(detail::generation);
+}
+
+// Collect a small cycle, that is part of a large generation.
+void large_generation(benchmark::State& state) {
+  const auto size = state.range(0);
+
+  // Create a ring of size elements, all in a single generation.
+  const cycle_gptr<node> root = make_cycle<node>();
+  cycle_gptr<node> tail = root;
+  for (std::int64_t i = 1; i < size; ++i) {
+    cycle_gptr<node> n = make_cycle<node>();
+    tail->next = n;
+    tail = std::move(n);
+  }
+  tail->next = root;
+  tail = nullptr;
+
+  const cycle_gptr<node> second = root->next;
+  const cycle_gptr<node> third = second->next;
+  for (auto _ : state) {
+    // Merge garbage into the generation, then unlink and drop it.
+    cycle_gptr<node> garbage = make_cycle<node>();
+    garbage->next = third;
+    second->next = garbage;
+    second->next = third;
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+} /* namespace <unnamed> */
+
+BENCHMARK(cycle_churn);
+BENCHMARK(large_generation)->Range(8, 8 << 10);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,294 @@
+#include <cycle_ptr.h>
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cycle_ptr;
+
+// Measures GC pause latency, while mutator threads keep writing edges
+// and promoting weak pointers in the generation that is being collected.
+//
+// Each iteration merges a garbage graph into a live generation and
+// drops it, collecting the whole generation.
+// With CYCLE_PTR_STATS, the ``merges`` counter reports the merges per
+// iteration, which should be at least 1.
+// Reports percentiles of the time spent in each GC phase, and of the
+// latency of each mutator operation, in nanoseconds.
+// Edge writes hold the merge lock of their generation for share, so their
+// latencies include the time blocked on that lock.
+// Weak promotions of red objects grey what they make reachable, so their
+// latencies include that help, but they don't wait for the GC.
+//
+// Arguments: generation size, shape (0 = ring, 1 = tree, 2 = random),
+// number of mutator threads.
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+struct node
+: public cycle_base
+{
+  cycle_member_ptr<node> next, left, right;
+  cycle_member_ptr<node> extra; // Not touched by mutators.
+};
+
+enum class shape : int { ring, tree, random };
+
+// Log-linear histogram of durations, with 8 buckets per power of two.
+class histogram {
+ public:
+  auto record(clock_type::duration d)
+  noexcept
+  -> void {
+    const auto ns = static_cast<std::uint64_t>(std::max(clock_type::duration::rep(0), std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()));
+    ++buckets_[bucket_(ns)];
+    ++count_;
+  }
+
+  auto merge(const histogram& other)
+  noexcept
+  -> void {
+    for (std::size_t i = 0; i < buckets_.size(); ++i) buckets_[i] += other.buckets_[i];
+    count_ += other.count_;
+  }
+
+  // Upper bound of the bucket holding the \p q quantile.
+  auto quantile(double q) const
+  noexcept
+  -> double {
+    if (count_ == 0u) return 0.0;
+    const auto rank = static_cast<std::uint64_t>(q * static_cast<double>(count_ - 1u));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < buckets_.size(); ++i) {
+      seen += buckets_[i];
+      if (seen > rank) return static_cast<double>(upper_(i));
+    }
+    return static_cast<double>(upper_(buckets_.size() - 1u));
+  }
+
+ private:
+  static constexpr unsigned sub_bits = 3;
+
+  static auto bucket_(std::uint64_t ns)
+  noexcept
+  -> std::size_t {
+    if (ns < (1u << sub_bits)) return static_cast<std::size_t>(ns);
+    unsigned log2 = 0;
+    while ((ns >> log2) >= (2u << sub_bits)) ++log2;
+    return ((log2 + 1u) << sub_bits) + static_cast<std::size_t>((ns >> log2) - (1u << sub_bits));
+  }
+
+  static auto upper_(std::size_t bucket)
+  noexcept
+  -> std::uint64_t {
+    if (bucket < (1u << sub_bits)) return bucket;
+    const std::size_t log2 = (bucket >> sub_bits) - 1u;
+    const std::uint64_t mantissa = (bucket & ((1u << sub_bits) - 1u)) + (1u << sub_bits);
+    return ((mantissa + 1u) << log2) - 1u;
+  }
+
+  std::array<std::uint64_t, (64u - sub_bits + 1u) << sub_bits> buckets_{};
+  std::uint64_t count_ = 0;
+};
+
+// Pause histograms, indexed by the phase that started the interval.
+// The interval starting at gc_phase::start is the wait for the generation lock.
+struct pause_histograms {
+  std::array<histogram, static_cast<std::size_t>(gc_phase::done)> phase;
+  histogram total;
+};
+
+// Recorder of the collection running on this thread.
+thread_local pause_histograms* current_recorder = nullptr;
+thread_local std::array<clock_type::time_point, static_cast<std::size_t>(gc_phase::done) + 1u> phase_start;
+thread_local std::size_t last_phase = 0;
+
+void record_phase(gc_phase p) noexcept {
+  if (current_recorder == nullptr) return;
+
+  const auto now = clock_type::now();
+  const auto idx = static_cast<std::size_t>(p);
+  if (p != gc_phase::start)
+    current_recorder->phase[last_phase].record(now - phase_start[last_phase]);
+  if (p == gc_phase::done)
+    current_recorder->total.record(now - phase_start[static_cast<std::size_t>(gc_phase::start)]);
+
+  phase_start[idx] = now;
+  last_phase = idx;
+}
+
+// Build \p size nodes of shape \p s in a single generation.
+// If \p all is not null, it receives pointers to all nodes.
+//
+// Only the builder holds references until finish(), so that finish()
+// can drop them without running the GC for each.
+auto build(std::int64_t size, shape s, std::minstd_rand& rng, std::vector<cycle_gptr<node>>* all = nullptr)
+-> cycle_gptr<node> {
+  const auto n = static_cast<std::size_t>(size);
+  detail::graph_builder<node> b;
+  std::vector<node*> nodes;
+  nodes.reserve(n);
+  if (all != nullptr) {
+    all->clear();
+    all->reserve(n);
+  }
+  for (std::size_t i = 0; i < n; ++i) {
+    cycle_gptr<node> obj = b.make();
+    nodes.push_back(obj.get());
+    if (all != nullptr) all->push_back(obj);
+    b.add(std::move(obj));
+  }
+
+  for (std::size_t i = 0; i < n; ++i) {
+    node& obj = *nodes[i];
+    switch (s) {
+      case shape::ring:
+        b.link(obj.next, (i + 1u) % n);
+        break;
+      case shape::tree:
+        if (2u * i + 1u < n) b.link(obj.left, 2u * i + 1u);
+        if (2u * i + 2u < n) b.link(obj.right, 2u * i + 2u);
+        break;
+      case shape::random:
+        // The chain keeps everything reachable.
+        if (i + 1u < n) b.link(obj.next, i + 1u);
+        b.link(obj.left, std::uniform_int_distribution<std::size_t>(0, n - 1u)(rng));
+        b.link(obj.right, std::uniform_int_distribution<std::size_t>(0, n - 1u)(rng));
+        break;
+    }
+  }
+  return b.finish();
+}
+
+// Mutator: write edges between its own share of the live nodes,
+// and promote weak pointers to them.
+void mutate(
+    const std::vector<cycle_gptr<node>>& live,
+    std::size_t index, std::size_t mutators,
+    const std::atomic<bool>& stop,
+    histogram& edge_write,
+    [[maybe_unused]] histogram& weak_lock) {
+  std::minstd_rand rng(static_cast<std::minstd_rand::result_type>(index + 1u));
+  std::uniform_int_distribution<std::size_t> pick(0, live.size() - 1u);
+
+#ifndef CYCLE_PTR_NO_WEAK
+  std::vector<cycle_weak_ptr<node>> weak(live.begin(), live.end());
+#endif
+
+  while (!stop.load(std::memory_order_relaxed)) {
+    std::size_t i = pick(rng);
+    i -= i % mutators;
+    i += index;
+    if (i >= live.size()) continue;
+    node& src = *live[i];
+
+    auto t0 = clock_type::now();
+    src.left = live[pick(rng)];
+    auto t1 = clock_type::now();
+    src.left.reset();
+    auto t2 = clock_type::now();
+    edge_write.record(t1 - t0);
+    edge_write.record(t2 - t1);
+
+#ifndef CYCLE_PTR_NO_WEAK
+    t0 = clock_type::now();
+    benchmark::DoNotOptimize(weak[pick(rng)].lock());
+    t1 = clock_type::now();
+    weak_lock.record(t1 - t0);
+#endif
+  }
+}
+
+void report(benchmark::State& state, const std::string& name, const histogram& h) {
+  state.counters[name + "_p50_ns"] = h.quantile(0.5);
+  state.counters[name + "_p99_ns"] = h.quantile(0.99);
+  state.counters[name + "_p999_ns"] = h.quantile(0.999);
+}
+
+void gc_pause(benchmark::State& state) {
+  const std::int64_t size = state.range(0);
+  const shape s = static_cast<shape>(state.range(1));
+  const auto mutators = static_cast<std::size_t>(state.range(2));
+
+  std::minstd_rand rng;
+  std::vector<cycle_gptr<node>> live;
+  const cycle_gptr<node> live_root = build(size, shape::ring, rng, &live);
+
+  std::atomic<bool> stop{ false };
+  std::vector<histogram> edge_writes(mutators), weak_locks(mutators);
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < mutators; ++i) {
+    threads.emplace_back(
+        mutate, std::cref(live), i, mutators, std::cref(stop),
+        std::ref(edge_writes[i]), std::ref(weak_locks[i]));
+  }
+
+  pause_histograms pauses;
+#ifdef CYCLE_PTR_STATS
+  std::uint64_t merges = 0;
+#endif
+  const gc_phase_hook old_hook = set_gc_phase_hook(&record_phase);
+  for (auto _ : state) {
+    state.PauseTiming();
+    cycle_gptr<node> garbage = build(size, s, rng);
+#ifdef CYCLE_PTR_STATS
+    const std::uint64_t merges_before = get_statistics().merges;
+#endif
+    // The edge into the garbage makes its generation non-moveable,
+    // so that the edge back into the live graph, which breaks the
+    // generation order, merges the two generations.
+    live_root->extra = garbage;
+    garbage->extra = live_root;
+    live_root->extra.reset();
+#ifdef CYCLE_PTR_STATS
+    merges += get_statistics().merges - merges_before;
+#endif
+    state.ResumeTiming();
+
+    current_recorder = &pauses;
+    garbage.reset(); // Collects the generation.
+    current_recorder = nullptr;
+  }
+  set_gc_phase_hook(old_hook);
+
+  stop.store(true, std::memory_order_relaxed);
+  for (auto& thr : threads) thr.join();
+
+  histogram edge_write, weak_lock;
+  for (const histogram& h : edge_writes) edge_write.merge(h);
+  for (const histogram& h : weak_locks) weak_lock.merge(h);
+
+  static const char*const phase_names[] = { "lock", "phase1", "phase2", "phase3", "destroy" };
+  for (std::size_t i = 0; i < pauses.phase.size(); ++i)
+    report(state, phase_names[i], pauses.phase[i]);
+  report(state, "pause", pauses.total);
+#ifdef CYCLE_PTR_STATS
+  state.counters["merges"] = benchmark::Counter(static_cast<double>(merges), benchmark::Counter::kAvgIterations);
+#endif
+  if (mutators != 0u) {
+    report(state, "edge_write", edge_write);
+#ifndef CYCLE_PTR_NO_WEAK
+    report(state, "weak_lock", weak_lock);
+#endif
+  }
+
+  state.SetItemsProcessed(state.iterations() * size);
+}
+
+} /* namespace <unnamed> */
+
+BENCHMARK(gc_pause)
+    ->ArgNames({ "size", "shape", "mutators" })
+    ->ArgsProduct({ { 1 << 10, 16 << 10 }, { 0, 1, 2 }, { 0, 1, 4 } })
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
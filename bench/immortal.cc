@@ -0,0 +1,44 @@
+#include <cycle_ptr.h>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+
+using namespace cycle_ptr;
+
+namespace {
+
+struct registry {
+  std::uint64_t value = 42;
+};
+
+// Shared by all threads of all runs, so threads don't race on its creation.
+const cycle_gptr<registry>& mortal_object() {
+  static const cycle_gptr<registry> impl = make_cycle<registry>();
+  return impl;
+}
+
+const cycle_gptr<registry>& immortal_object() {
+  static const cycle_gptr<registry> impl = make_cycle_immortal<registry>();
+  return impl;
+}
+
+// Every thread copies and drops pointers to the same object.
+template<const cycle_gptr<registry>& (*Hot)()>
+void copy_drop(benchmark::State& state) {
+  const cycle_gptr<registry>& ptr = Hot();
+
+  for (auto _ : state) {
+    for (int i = 0; i < 64; ++i) {
+      cycle_gptr<registry> copy = ptr;
+      benchmark::DoNotOptimize(copy);
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * 64);
+}
+
+} /* namespace <unnamed> */
+
+BENCHMARK_TEMPLATE(copy_drop, &mortal_object)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(copy_drop, &immortal_object)->ThreadRange(1, 8)->UseRealTime();
+
+BENCHMARK_MAIN();
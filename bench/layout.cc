@@ -0,0 +1,65 @@
+#include <cycle_ptr.h>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+
+using namespace cycle_ptr;
+
+namespace {
+
+// Object with the default control block layout.
+struct shared_payload {
+  std::uint64_t value[4] = { 1, 2, 3, 4 };
+};
+
+// Same object, with the cache isolated control block layout.
+struct isolated_payload {
+  std::uint64_t value[4] = { 1, 2, 3, 4 };
+};
+
+} /* namespace <unnamed> */
+
+template<>
+struct cycle_ptr::cache_isolated<isolated_payload>
+: std::true_type
+{};
+
+namespace {
+
+// Shared by all threads of all runs, so threads don't race on its creation.
+template<typename Payload>
+const cycle_gptr<Payload>& hot_object() {
+  static const cycle_gptr<Payload> impl = make_cycle<Payload>();
+  return impl;
+}
+
+// Even threads copy and drop pointers to the object (refcount traffic),
+// odd threads only read the object.
+// The reader throughput is what the layout is meant to improve.
+template<typename Payload>
+void contention(benchmark::State& state) {
+  const cycle_gptr<Payload> ptr = hot_object<Payload>();
+  const bool is_reader = (state.thread_index() % 2 == 1 || state.threads() == 1);
+
+  for (auto _ : state) {
+    if (is_reader) {
+      for (int i = 0; i < 64; ++i) {
+        std::uint64_t v = ptr->value[0];
+        benchmark::DoNotOptimize(v);
+      }
+    } else {
+      for (int i = 0; i < 64; ++i) {
+        cycle_gptr<Payload> copy = ptr;
+        benchmark::DoNotOptimize(copy);
+      }
+    }
+  }
+
+  if (is_reader) state.SetItemsProcessed(state.iterations() * 64);
+}
+
+} /* namespace <unnamed> */
+
+BENCHMARK_TEMPLATE(contention, shared_payload)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(contention, isolated_payload)->ThreadRange(1, 8)->UseRealTime();
+
+BENCHMARK_MAIN();
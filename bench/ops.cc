@@ -0,0 +1,213 @@
+#include <cycle_ptr.h>
+#ifdef CYCLE_PTR_BUILTIN_BENCHMARK
+# include "builtin_benchmark.h"
+#else
+# include <benchmark/benchmark.h>
+#endif
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace cycle_ptr;
+
+// Micro benchmarks of the individual pointer operations.
+// Each runs on 1 thread and on 2 up to the number of CPUs, all threads
+// operating on shared objects, unless noted otherwise.
+
+namespace {
+
+struct payload {
+  std::uint64_t value = 42;
+};
+
+class node
+: public cycle_base
+{
+ public:
+  using vector_type = std::vector<
+      cycle_member_ptr<payload>,
+      cycle_allocator<std::allocator<cycle_member_ptr<payload>>>>;
+
+  node()
+  : edges(vector_type::allocator_type(*this))
+  {}
+
+  auto self()
+  -> cycle_gptr<node> {
+    return shared_from_this(this);
+  }
+
+  cycle_member_ptr<payload> next;
+  vector_type edges;
+};
+
+// Intrusively reference counted type, for the hazard pointer benchmarks.
+class counted {
+ public:
+  friend auto intrusive_ptr_add_ref(counted* c)
+  noexcept
+  -> void {
+    c->refs_.fetch_add(1u, std::memory_order_relaxed);
+  }
+
+  friend auto intrusive_ptr_release(counted* c)
+  noexcept
+  -> void {
+    if (c->refs_.fetch_sub(1u, std::memory_order_acq_rel) == 1u) delete c;
+  }
+
+ private:
+  std::atomic<std::uintptr_t> refs_{ 0u };
+};
+
+auto max_threads()
+-> int {
+  return static_cast<int>(std::max(2u, std::thread::hardware_concurrency()));
+}
+
+auto shared_payload()
+-> const cycle_gptr<payload>& {
+  static const cycle_gptr<payload> impl = make_cycle<payload>();
+  return impl;
+}
+
+auto shared_node()
+-> const cycle_gptr<node>& {
+  static const cycle_gptr<node> impl = make_cycle<node>();
+  return impl;
+}
+
+// Allocate and drop an object, which collects it.
+void make_cycle_drop(benchmark::State& state) {
+  for (auto _ : state)
+    benchmark::DoNotOptimize(make_cycle<payload>());
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Copy and drop a pointer to a shared object.
+void gptr_copy_destroy(benchmark::State& state) {
+  const cycle_gptr<payload>& shared = shared_payload();
+  for (auto _ : state) {
+    cycle_gptr<payload> copy = shared;
+    benchmark::DoNotOptimize(copy);
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Move a pointer back and forth.
+void gptr_move(benchmark::State& state) {
+  cycle_gptr<payload> x = shared_payload(), y;
+  for (auto _ : state) {
+    y = std::move(x);
+    benchmark::DoNotOptimize(y);
+    x = std::move(y);
+    benchmark::DoNotOptimize(x);
+  }
+
+  state.SetItemsProcessed(state.iterations() * 2);
+}
+
+// Assign and reset a member pointer, each thread using its own owner.
+void member_ptr_assign_reset(benchmark::State& state) {
+  const cycle_gptr<node> owner = make_cycle<node>();
+  const cycle_gptr<payload>& target = shared_payload();
+  for (auto _ : state) {
+    owner->next = target;
+    owner->next.reset();
+  }
+
+  state.SetItemsProcessed(state.iterations() * 2);
+}
+
+#ifndef CYCLE_PTR_NO_WEAK
+// Promote a weak pointer to a shared object.
+void weak_lock(benchmark::State& state) {
+  const cycle_weak_ptr<payload> weak = shared_payload();
+  for (auto _ : state)
+    benchmark::DoNotOptimize(weak.lock());
+
+  state.SetItemsProcessed(state.iterations());
+}
+#endif
+
+// Create a pointer from a shared object.
+void shared_from_this(benchmark::State& state) {
+  node& n = *shared_node();
+  for (auto _ : state)
+    benchmark::DoNotOptimize(n.self());
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Grow an adjacency list, each thread using its own owner.
+// Every element construction looks up its owner.
+void allocator_growth(benchmark::State& state) {
+  const cycle_gptr<payload>& target = shared_payload();
+  for (auto _ : state) {
+    cycle_gptr<node> owner = make_cycle<node>();
+    for (int i = 0; i < 64; ++i) owner->edges.emplace_back(target);
+    benchmark::DoNotOptimize(owner);
+  }
+
+  state.SetItemsProcessed(state.iterations() * 64);
+}
+
+// Load from a shared hazard pointer.
+void hazard_load(benchmark::State& state) {
+  static detail::hazard_ptr<counted> ptr{ detail::intrusive_ptr<counted>(new counted(), true) };
+  for (auto _ : state)
+    benchmark::DoNotOptimize(ptr.load());
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Store into a shared hazard pointer, contending with the other threads.
+void hazard_store(benchmark::State& state) {
+  static detail::hazard_ptr<counted> ptr;
+  const auto value = detail::intrusive_ptr<counted>(new counted(), true);
+  for (auto _ : state)
+    ptr.store(value);
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Object whose constructor runs the benchmark loop,
+// while its address range is published.
+class lookup_probe {
+ public:
+  explicit lookup_probe(benchmark::State& state) {
+    for (auto _ : state)
+      benchmark::DoNotOptimize(detail::base_control::publisher_lookup(this, sizeof(*this)));
+  }
+
+ private:
+  std::uint64_t data_[4] = {};
+};
+
+// Look up the control block of an object under construction.
+void publisher_lookup(benchmark::State& state) {
+  benchmark::DoNotOptimize(make_cycle<lookup_probe>(state));
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+} /* namespace <unnamed> */
+
+BENCHMARK(make_cycle_drop)->ThreadRange(1, max_threads())->UseRealTime();
+BENCHMARK(gptr_copy_destroy)->ThreadRange(1, max_threads())->UseRealTime();
+BENCHMARK(gptr_move)->ThreadRange(1, max_threads())->UseRealTime();
+BENCHMARK(member_ptr_assign_reset)->ThreadRange(1, max_threads())->UseRealTime();
+#ifndef CYCLE_PTR_NO_WEAK
+BENCHMARK(weak_lock)->ThreadRange(1, max_threads())->UseRealTime();
+#endif
+BENCHMARK(shared_from_this)->ThreadRange(1, max_threads())->UseRealTime();
+BENCHMARK(allocator_growth)->ThreadRange(1, max_threads())->UseRealTime();
+BENCHMARK(hazard_load)->ThreadRange(1, max_threads())->UseRealTime();
+BENCHMARK(hazard_store)->ThreadRange(1, max_threads())->UseRealTime();
+BENCHMARK(publisher_lookup)->ThreadRange(1, max_threads())->UseRealTime();
+
+BENCHMARK_MAIN();
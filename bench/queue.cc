@@ -0,0 +1,95 @@
+#include <cycle_ptr/concurrent_queue.h>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+using namespace cycle_ptr;
+
+namespace {
+
+struct task {
+  std::uint64_t value = 42;
+};
+
+// Mutex guarded queue, as used before concurrent_queue existed.
+class mutex_queue {
+ public:
+  auto push(cycle_gptr<task> value)
+  -> void {
+    std::lock_guard<std::mutex> lck{ mtx_ };
+    data_.push_back(std::move(value));
+  }
+
+  auto try_pop(cycle_gptr<task>& value)
+  -> bool {
+    std::lock_guard<std::mutex> lck{ mtx_ };
+    if (data_.empty()) return false;
+    value = std::move(data_.front());
+    data_.pop_front();
+    return true;
+  }
+
+ private:
+  std::mutex mtx_;
+  std::deque<cycle_gptr<task>> data_;
+};
+
+// Mutex guarded stack.
+class mutex_stack {
+ public:
+  auto push(cycle_gptr<task> value)
+  -> void {
+    std::lock_guard<std::mutex> lck{ mtx_ };
+    data_.push_back(std::move(value));
+  }
+
+  auto try_pop(cycle_gptr<task>& value)
+  -> bool {
+    std::lock_guard<std::mutex> lck{ mtx_ };
+    if (data_.empty()) return false;
+    value = std::move(data_.back());
+    data_.pop_back();
+    return true;
+  }
+
+ private:
+  std::mutex mtx_;
+  std::vector<cycle_gptr<task>> data_;
+};
+
+// Shared by all threads of a run.
+template<typename Container>
+Container& container() {
+  static Container impl;
+  return impl;
+}
+
+// Every thread pushes and pops the same task.
+// The task is shared, so that allocation of tasks doesn't dominate.
+template<typename Container>
+void push_pop(benchmark::State& state) {
+  Container& c = container<Container>();
+  static const cycle_gptr<task> item = make_cycle<task>();
+
+  cycle_gptr<task> out;
+  for (auto _ : state) {
+    for (int i = 0; i < 64; ++i) {
+      c.push(item);
+      c.try_pop(out);
+    }
+  }
+  out.reset();
+
+  state.SetItemsProcessed(state.iterations() * 64);
+}
+
+} /* namespace <unnamed> */
+
+BENCHMARK_TEMPLATE(push_pop, concurrent_queue<task>)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(push_pop, mutex_queue)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(push_pop, concurrent_stack<task>)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(push_pop, mutex_stack)->ThreadRange(1, 8)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,32 @@
+#include "workload.h"
+#include <exception>
+#include <iostream>
+
+// Records a trace of synthetic workloads, for the replay benchmark.
+//
+// Usage: cycle_ptr_bench_record <file> <spec>...
+// See workload.h for the format of a spec.
+
+#ifndef CYCLE_PTR_TRACE
+# error "record.cc requires CYCLE_PTR_TRACE to be defined"
+#endif
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    std::cerr << "usage: " << argv[0] << " <file> <spec>...\n";
+    return 1;
+  }
+
+  try {
+    std::vector<workload::spec> specs;
+    for (int i = 2; i < argc; ++i) specs.push_back(workload::parse_spec(argv[i]));
+
+    cycle_ptr::trace_start(argv[1]);
+    for (const workload::spec& s : specs) workload::run(s);
+    cycle_ptr::trace_stop();
+  } catch (const std::exception& ex) {
+    std::cerr << argv[0] << ": " << ex.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
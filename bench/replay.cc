@@ -0,0 +1,219 @@
+#include <cycle_ptr.h>
+#include <cycle_ptr/trace.h>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Replays traces recorded with CYCLE_PTR_TRACE, reporting the time taken
+// and the merges and collections performed.
+//
+// Traces are given using ``--trace=<file>``.
+// Comparing the output of two builds of this benchmark, using
+// ``--benchmark_format=json``, shows how a change to the library affects
+// the recorded application.
+//
+// Operations are replayed on a single thread, in the order in which they
+// were recorded.
+// Each traced object is replaced by a node holding an edge for each edge
+// that the trace used; the node has no payload.
+
+#ifndef CYCLE_PTR_STATS
+# error "replay.cc requires CYCLE_PTR_STATS to be defined"
+#endif
+
+namespace {
+
+using namespace cycle_ptr;
+using benchmark::Counter;
+
+class node
+: public cycle_base
+{
+ public:
+  using vector_type = std::vector<
+      cycle_member_ptr<node>,
+      cycle_allocator<std::allocator<cycle_member_ptr<node>>>>;
+
+  explicit node(std::size_t slots)
+  : edges(slots, vector_type::allocator_type(*this))
+  {}
+
+  vector_type edges;
+};
+
+// Operation of a trace, with objects and edges numbered densely.
+struct step {
+  static constexpr std::uint32_t none = UINT32_MAX;
+
+  trace_op op;
+  std::uint32_t obj;
+  std::uint32_t slot = none;
+  std::uint32_t dst = none;
+};
+
+struct program {
+  // Number of edges of each object.
+  std::vector<std::size_t> slots;
+  std::vector<step> steps;
+  std::size_t threads = 0;
+};
+
+// Number the objects and edges in a trace.
+// Operations on objects created before the trace started are skipped.
+auto compile(const std::vector<trace_event>& events)
+-> program {
+  program p;
+  std::unordered_map<std::uint64_t, std::uint32_t> objects;
+  std::vector<std::unordered_map<std::ptrdiff_t, std::uint32_t>> slots;
+  std::unordered_set<std::uint64_t> threads;
+
+  for (const trace_event& e : events) {
+    threads.insert(e.thread);
+
+    if (e.op == trace_op::make) {
+      const auto idx = static_cast<std::uint32_t>(slots.size());
+      objects[e.obj] = idx;
+      slots.emplace_back();
+      p.steps.push_back({ trace_op::make, idx });
+      continue;
+    }
+
+    const auto obj = objects.find(e.obj);
+    if (obj == objects.end()) continue;
+    step s{ e.op, obj->second };
+
+    if (e.op == trace_op::edge_set || e.op == trace_op::edge_reset) {
+      auto& obj_slots = slots[s.obj];
+      s.slot = obj_slots.emplace(e.slot, static_cast<std::uint32_t>(obj_slots.size())).first->second;
+    }
+    if (e.op == trace_op::edge_set) {
+      const auto dst = objects.find(e.dst);
+      if (dst == objects.end())
+        s.op = trace_op::edge_reset;
+      else
+        s.dst = dst->second;
+    }
+    p.steps.push_back(s);
+  }
+
+  for (const auto& obj_slots : slots) p.slots.push_back(obj_slots.size());
+  p.threads = threads.size();
+  return p;
+}
+
+// Replay state of a traced object.
+struct object {
+  cycle_weak_ptr<node> weak;
+  node* ptr = nullptr;
+  // The cycle_gptr instances the traced program holds.
+  std::vector<cycle_gptr<node>> held;
+
+  auto lock() const
+  -> cycle_gptr<node> {
+    return held.empty() ? weak.lock() : held.back();
+  }
+};
+
+void execute(const program& p, std::vector<object>& objects) {
+  for (const step& s : p.steps) {
+    object& obj = objects[s.obj];
+
+    switch (s.op) {
+      case trace_op::make:
+        obj.held.push_back(make_cycle<node>(p.slots[s.obj]));
+        obj.weak = obj.held.back();
+        obj.ptr = obj.held.back().get();
+        break;
+      case trace_op::acquire:
+        if (cycle_gptr<node> g = obj.lock()) obj.held.push_back(std::move(g));
+        break;
+      case trace_op::drop:
+        if (!obj.held.empty()) obj.held.pop_back();
+        break;
+      case trace_op::weak_lock:
+        if (cycle_gptr<node> g = obj.weak.lock()) obj.held.push_back(std::move(g));
+        break;
+      case trace_op::weak_lock_failed:
+        benchmark::DoNotOptimize(obj.weak.lock());
+        break;
+      case trace_op::edge_set:
+        if (!obj.weak.expired()) obj.ptr->edges[s.slot] = objects[s.dst].lock();
+        break;
+      case trace_op::edge_reset:
+        if (!obj.weak.expired()) obj.ptr->edges[s.slot].reset();
+        break;
+    }
+  }
+}
+
+void replay(benchmark::State& state, const std::shared_ptr<const program>& p) {
+  std::uint64_t merges = 0, collections = 0, collected_objects = 0;
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::vector<object> objects(p->slots.size());
+    const statistics before = get_statistics();
+    state.ResumeTiming();
+
+    execute(*p, objects);
+
+    state.PauseTiming();
+    const statistics after = get_statistics();
+    merges += after.merges - before.merges;
+    collections += after.collections - before.collections;
+    collected_objects += after.collected_objects - before.collected_objects;
+    objects.clear(); // Drop whatever the trace left alive.
+    state.ResumeTiming();
+  }
+
+  state.counters["objects"] = static_cast<double>(p->slots.size());
+  state.counters["threads"] = static_cast<double>(p->threads);
+  state.counters["merges"] = Counter(static_cast<double>(merges), Counter::kAvgIterations);
+  state.counters["collections"] = Counter(static_cast<double>(collections), Counter::kAvgIterations);
+  state.counters["collected_objects"] = Counter(static_cast<double>(collected_objects), Counter::kAvgIterations);
+  state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(p->steps.size()));
+}
+
+} /* namespace <unnamed> */
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " [benchmark options] --trace=<file>...\n";
+    return 1;
+  }
+
+  for (int i = 1; i < argc; ++i) {
+    static const char flag[] = "--trace=";
+    if (std::strncmp(argv[i], flag, sizeof(flag) - 1u) != 0) {
+      std::cerr << argv[0] << ": unrecognized argument: " << argv[i] << "\n";
+      return 1;
+    }
+
+    const std::string path = argv[i] + sizeof(flag) - 1u;
+    std::shared_ptr<const program> p;
+    try {
+      std::ifstream in(path, std::ios_base::in | std::ios_base::binary);
+      if (!in) throw std::runtime_error("unable to open " + path);
+      p = std::make_shared<const program>(compile(read_trace(in)));
+    } catch (const std::exception& ex) {
+      std::cerr << argv[0] << ": " << path << ": " << ex.what() << "\n";
+      return 1;
+    }
+
+    benchmark::RegisterBenchmark(("replay/" + path).c_str(), &replay, p)
+        ->Unit(benchmark::kMillisecond);
+  }
+
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,106 @@
+#include <cycle_ptr/serialize.h>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace cycle_ptr;
+
+namespace {
+
+struct node {
+  explicit node(std::int64_t value) noexcept
+  : value(value)
+  {}
+
+  std::int64_t value;
+  cycle_member_ptr<node> next, skip;
+};
+
+struct node_codec {
+  void write(const node& n, graph_writer<node>& w) const {
+    w.write(n.value);
+    w.edge(n.next);
+    w.edge(n.skip);
+  }
+
+  cycle_gptr<node> read(graph_reader<node>& r) const {
+    cycle_gptr<node> n = r.make(r.read<std::int64_t>());
+    r.edge(n->next);
+    r.edge(n->skip);
+    return n;
+  }
+};
+
+// Edges of a ring of size nodes, with a pseudo random skip edge on each node.
+struct record {
+  std::size_t next, skip;
+};
+
+auto make_records(std::int64_t size)
+-> std::vector<record> {
+  std::vector<record> records;
+  std::uint32_t rnd = 0x9e3779b9u;
+  for (std::int64_t i = 0; i < size; ++i) {
+    rnd = rnd * 1664525u + 1013904223u;
+    records.push_back({ static_cast<std::size_t>((i + 1) % size), static_cast<std::size_t>(rnd % size) });
+  }
+  return records;
+}
+
+// Build the graph the way a hand written loader does:
+// one make_cycle per object, then assign the edges.
+auto build(const std::vector<record>& records)
+-> cycle_gptr<node> {
+  std::vector<cycle_gptr<node>> objects;
+  objects.reserve(records.size());
+  for (std::size_t i = 0; i < records.size(); ++i)
+    objects.push_back(make_cycle<node>(static_cast<std::int64_t>(i)));
+  for (std::size_t i = 0; i < records.size(); ++i) {
+    objects[i]->next = objects[records[i].next];
+    objects[i]->skip = objects[records[i].skip];
+  }
+  return objects.front();
+}
+
+void naive_load(benchmark::State& state) {
+  const std::vector<record> records = make_records(state.range(0));
+  for (auto _ : state)
+    benchmark::DoNotOptimize(build(records));
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void serialize(benchmark::State& state) {
+  const cycle_gptr<node> root = build(make_records(state.range(0)));
+  for (auto _ : state) {
+    std::ostringstream out;
+    serialize_graph(out, root, node_codec());
+    benchmark::DoNotOptimize(out.tellp());
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void deserialize(benchmark::State& state) {
+  std::ostringstream out;
+  serialize_graph(out, build(make_records(state.range(0))), node_codec());
+  const std::string data = out.str();
+
+  for (auto _ : state) {
+    std::istringstream in(data);
+    benchmark::DoNotOptimize(deserialize_graph<node>(in, node_codec()));
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.counters["bytes_per_object"] = static_cast<double>(data.size()) / static_cast<double>(state.range(0));
+}
+
+} /* namespace <unnamed> */
+
+BENCHMARK(naive_load)->Range(64, 4 << 10);
+BENCHMARK(serialize)->Range(64, 4 << 10);
+BENCHMARK(deserialize)->Range(64, 4 << 10);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,107 @@
+#include <cycle_ptr/skiplist_map.h>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+
+using namespace cycle_ptr;
+
+namespace {
+
+struct item {
+  std::uint64_t value = 42;
+};
+
+constexpr int key_count = 4096;
+
+// std::map guarded by a reader-writer lock, as used before skiplist_map existed.
+class locked_map {
+ public:
+  auto find(int key) const
+  -> cycle_gptr<item> {
+    std::shared_lock<std::shared_mutex> lck{ mtx_ };
+    auto pos = data_.find(key);
+    if (pos == data_.end()) return nullptr;
+    return pos->second;
+  }
+
+  auto insert(int key, cycle_gptr<item> value)
+  -> bool {
+    std::lock_guard<std::shared_mutex> lck{ mtx_ };
+    return data_.emplace(key, std::move(value)).second;
+  }
+
+  auto erase(int key)
+  -> bool {
+    std::lock_guard<std::shared_mutex> lck{ mtx_ };
+    return data_.erase(key) != 0u;
+  }
+
+ private:
+  mutable std::shared_mutex mtx_;
+  std::map<int, cycle_gptr<item>> data_;
+};
+
+template<typename Map>
+Map& create_map();
+
+template<>
+skiplist_map<int, item>& create_map<skiplist_map<int, item>>() {
+  static skiplist_map<int, item> impl{ unowned_cycle };
+  return impl;
+}
+
+template<>
+locked_map& create_map<locked_map>() {
+  static locked_map impl;
+  return impl;
+}
+
+// Shared by all threads of a run, filled with the even keys.
+template<typename Map>
+Map& container() {
+  static Map& impl = []() -> Map& {
+    Map& m = create_map<Map>();
+    const cycle_gptr<item> value = make_cycle<item>();
+    for (int i = 0; i < key_count; i += 2) m.insert(i, value);
+    return m;
+  }();
+  return impl;
+}
+
+// Each thread performs lookups, with one in every 16 operations
+// inserting or erasing an odd key.
+// Odd keys are partitioned between threads, so the size stays stable.
+template<typename Map>
+void lookup_mostly(benchmark::State& state) {
+  Map& m = container<Map>();
+  static const cycle_gptr<item> value = make_cycle<item>();
+
+  std::uint32_t rnd = 0x9e3779b9u * static_cast<std::uint32_t>(state.thread_index() + 1);
+  const int own_key = 2 * state.thread_index() + 1;
+  bool own_present = false;
+
+  for (auto _ : state) {
+    for (int i = 0; i < 15; ++i) {
+      rnd = rnd * 1664525u + 1013904223u;
+      benchmark::DoNotOptimize(m.find(static_cast<int>(rnd >> 8) % key_count));
+    }
+
+    if (own_present)
+      m.erase(own_key);
+    else
+      m.insert(own_key, value);
+    own_present = !own_present;
+  }
+  if (own_present) m.erase(own_key);
+
+  state.SetItemsProcessed(state.iterations() * 16);
+}
+
+} /* namespace <unnamed> */
+
+BENCHMARK_TEMPLATE(lookup_mostly, skiplist_map<int, item>)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(lookup_mostly, locked_map)->ThreadRange(1, 8)->UseRealTime();
+
+BENCHMARK_MAIN();
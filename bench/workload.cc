@@ -0,0 +1,92 @@
+#include "workload.h"
+#include <benchmark/benchmark.h>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+// Runs synthetic workloads, reporting the merges, collections and
+// generations that each causes.
+//
+// Besides the default workloads, additional ones can be given using
+// ``--workload=<spec>``, see workload.h for the format.
+
+namespace {
+
+using benchmark::Counter;
+
+void run_workload(benchmark::State& state, const workload::spec& s) {
+  workload::result total;
+  for (auto _ : state) {
+    const workload::result r = workload::run(s);
+    total.edges = r.edges;
+    for (auto [dst, src] : { std::make_pair(&total.build, &r.build), std::make_pair(&total.churn, &r.churn), std::make_pair(&total.drop, &r.drop) }) {
+      dst->duration += src->duration;
+      dst->stats.generations += src->stats.generations;
+      dst->stats.merges += src->stats.merges;
+      dst->stats.merged_objects += src->stats.merged_objects;
+      dst->stats.collections += src->stats.collections;
+      dst->stats.collected_objects += src->stats.collected_objects;
+    }
+  }
+
+  for (auto [name, st] : { std::make_pair("build", &total.build), std::make_pair("churn", &total.churn), std::make_pair("drop", &total.drop) }) {
+    const std::string prefix = name;
+    state.counters[prefix + "_s"] = Counter(st->duration.count(), Counter::kAvgIterations);
+    state.counters[prefix + "_generations"] = Counter(static_cast<double>(st->stats.generations), Counter::kAvgIterations);
+    state.counters[prefix + "_merges"] = Counter(static_cast<double>(st->stats.merges), Counter::kAvgIterations);
+    state.counters[prefix + "_merged_objects"] = Counter(static_cast<double>(st->stats.merged_objects), Counter::kAvgIterations);
+    state.counters[prefix + "_collections"] = Counter(static_cast<double>(st->stats.collections), Counter::kAvgIterations);
+    state.counters[prefix + "_collected_objects"] = Counter(static_cast<double>(st->stats.collected_objects), Counter::kAvgIterations);
+  }
+  state.counters["edges"] = static_cast<double>(total.edges);
+  state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(s.nodes));
+}
+
+auto register_workload(const workload::spec& s)
+-> void {
+  benchmark::RegisterBenchmark(("workload/" + workload::to_string(s)).c_str(), &run_workload, s)
+      ->Unit(benchmark::kMillisecond);
+}
+
+const char*const default_workloads[] = {
+  "chain_forward:nodes=4096",
+  "chain_backward:nodes=4096",
+  "star_out:nodes=4096",
+  "star_in:nodes=4096",
+  "clique:nodes=128",
+  "random:nodes=1024,degree=2",
+  "random:nodes=1024,degree=2,churn=4",
+  "cycle:nodes=1024"
+};
+
+} /* namespace <unnamed> */
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+
+  bool custom = false;
+  for (int i = 1; i < argc; ++i) {
+    static const char flag[] = "--workload=";
+    if (std::strncmp(argv[i], flag, sizeof(flag) - 1u) != 0) {
+      std::cerr << argv[0] << ": unrecognized argument: " << argv[i] << "\n";
+      return 1;
+    }
+
+    try {
+      register_workload(workload::parse_spec(argv[i] + sizeof(flag) - 1u));
+    } catch (const std::invalid_argument& ex) {
+      std::cerr << argv[0] << ": " << ex.what() << "\n";
+      return 1;
+    }
+    custom = true;
+  }
+
+  if (!custom) {
+    for (const char* s : default_workloads)
+      register_workload(workload::parse_spec(s));
+  }
+
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,261 @@
+#pragma once
+
+// Synthetic workloads, wiring objects into graphs of a given shape.
+//
+// A workload is described by a spec, which can be written as a string:
+//   <shape>[:key=value[,key=value...]]
+// for example ``random:nodes=4096,degree=4,churn=2,seed=7``.
+//
+// Shapes:
+// - chain_forward: each node points at the node created after it.
+// - chain_backward: each node points at the node created before it.
+// - star_out: a hub points at every other node.
+// - star_in: every other node points at a hub.
+// - clique: every node points at every other node.
+// - random: every node points at ``degree`` random nodes.
+// - cycle: chain_forward, with the last node pointing at the first.
+//
+// Running a workload builds the graph, performs ``churn * nodes`` edge
+// writes to random nodes, and drops the graph.
+// The statistics of the library are recorded for each step,
+// so this requires CYCLE_PTR_STATS to be defined.
+
+#ifndef CYCLE_PTR_STATS
+# error "workload.h requires CYCLE_PTR_STATS to be defined"
+#endif
+
+#include <cycle_ptr.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace workload {
+
+
+enum class shape {
+  chain_forward,
+  chain_backward,
+  star_out,
+  star_in,
+  clique,
+  random,
+  cycle
+};
+
+inline constexpr const char* shape_names[] = {
+  "chain_forward",
+  "chain_backward",
+  "star_out",
+  "star_in",
+  "clique",
+  "random",
+  "cycle"
+};
+
+///\brief Description of a workload.
+struct spec {
+  shape s = shape::random;
+  ///\brief Number of nodes.
+  std::size_t nodes = 1024;
+  ///\brief Number of edges per node, for random graphs.
+  std::size_t degree = 2;
+  ///\brief Number of edge writes during churn, per node.
+  double churn = 0.0;
+  ///\brief Seed for random choices.
+  std::uint32_t seed = 1;
+};
+
+/**
+ * \brief Parse a spec from its string form.
+ * \throws std::invalid_argument if \p str is not a valid spec.
+ */
+inline auto parse_spec(const std::string& str)
+-> spec {
+  spec result;
+
+  const std::string::size_type colon = str.find(':');
+  const std::string name = str.substr(0, colon);
+  std::size_t idx = 0;
+  while (idx < std::size(shape_names) && name != shape_names[idx]) ++idx;
+  if (idx == std::size(shape_names))
+    throw std::invalid_argument("workload: unknown shape: " + name);
+  result.s = static_cast<shape>(idx);
+
+  std::string::size_type pos = (colon == std::string::npos ? str.size() : colon + 1u);
+  while (pos < str.size()) {
+    std::string::size_type end = str.find(',', pos);
+    if (end == std::string::npos) end = str.size();
+    const std::string kv = str.substr(pos, end - pos);
+    pos = end + 1u;
+
+    const std::string::size_type eq = kv.find('=');
+    if (eq == std::string::npos)
+      throw std::invalid_argument("workload: expected key=value: " + kv);
+    const std::string key = kv.substr(0, eq);
+    const std::string value = kv.substr(eq + 1u);
+
+    if (key == "nodes")
+      result.nodes = std::stoul(value);
+    else if (key == "degree")
+      result.degree = std::stoul(value);
+    else if (key == "churn")
+      result.churn = std::stod(value);
+    else if (key == "seed")
+      result.seed = static_cast<std::uint32_t>(std::stoul(value));
+    else
+      throw std::invalid_argument("workload: unknown key: " + key);
+  }
+
+  if (result.nodes == 0u)
+    throw std::invalid_argument("workload: nodes must be positive");
+  return result;
+}
+
+///\brief Write the string form of \p s.
+inline auto to_string(const spec& s)
+-> std::string {
+  return std::string(shape_names[static_cast<std::size_t>(s.s)])
+      + ":nodes=" + std::to_string(s.nodes)
+      + ",degree=" + std::to_string(s.degree)
+      + ",churn=" + std::to_string(s.churn)
+      + ",seed=" + std::to_string(s.seed);
+}
+
+
+///\brief Node of a workload graph.
+class node
+: public cycle_ptr::cycle_base
+{
+ public:
+  using vector_type = std::vector<
+      cycle_ptr::cycle_member_ptr<node>,
+      cycle_ptr::cycle_allocator<std::allocator<cycle_ptr::cycle_member_ptr<node>>>>;
+
+  node()
+  : edges(vector_type::allocator_type(*this))
+  {}
+
+  vector_type edges;
+};
+
+
+///\brief Difference between two statistics snapshots.
+inline auto operator-(const cycle_ptr::statistics& x, const cycle_ptr::statistics& y)
+noexcept
+-> cycle_ptr::statistics {
+  cycle_ptr::statistics result;
+  result.generations = x.generations - y.generations;
+  result.merges = x.merges - y.merges;
+  result.merged_objects = x.merged_objects - y.merged_objects;
+  result.collections = x.collections - y.collections;
+  result.collected_objects = x.collected_objects - y.collected_objects;
+  return result;
+}
+
+///\brief Measurements of a single step of a workload.
+struct step {
+  std::chrono::duration<double> duration{ 0 };
+  cycle_ptr::statistics stats;
+};
+
+///\brief Measurements of a workload.
+struct result {
+  step build, churn, drop;
+  ///\brief Number of edges created during build.
+  std::size_t edges = 0;
+};
+
+/**
+ * \brief Build, churn and drop the graph described by \p s.
+ * \details
+ * Statistics are process wide, so other threads operating
+ * on cycle pointers skew the result.
+ */
+inline auto run(const spec& s)
+-> result {
+  using clock_type = std::chrono::steady_clock;
+  using cycle_ptr::cycle_gptr;
+  using cycle_ptr::make_cycle;
+
+  result r;
+  std::mt19937 rng{ s.seed };
+  std::uniform_int_distribution<std::size_t> pick(0, s.nodes - 1u);
+  std::vector<cycle_gptr<node>> nodes;
+  nodes.reserve(s.nodes);
+
+  const auto measure =
+      [](step& out, auto&& fn) {
+        const cycle_ptr::statistics before = cycle_ptr::get_statistics();
+        const auto t0 = clock_type::now();
+        fn();
+        out.duration = clock_type::now() - t0;
+        out.stats = cycle_ptr::get_statistics() - before;
+      };
+
+  measure(r.build,
+      [&]() {
+        for (std::size_t i = 0; i < s.nodes; ++i) {
+          nodes.push_back(make_cycle<node>());
+          node& elem = *nodes.back();
+
+          switch (s.s) {
+            case shape::chain_forward:
+            case shape::cycle:
+              if (i != 0u) nodes[i - 1u]->edges.emplace_back(nodes.back());
+              break;
+            case shape::chain_backward:
+              if (i != 0u) elem.edges.emplace_back(nodes[i - 1u]);
+              break;
+            case shape::star_out:
+              if (i != 0u) nodes.front()->edges.emplace_back(nodes.back());
+              break;
+            case shape::star_in:
+              if (i != 0u) elem.edges.emplace_back(nodes.front());
+              break;
+            case shape::clique:
+              for (std::size_t j = 0; j < i; ++j) {
+                nodes[j]->edges.emplace_back(nodes.back());
+                elem.edges.emplace_back(nodes[j]);
+              }
+              break;
+            case shape::random:
+              break;
+          }
+        }
+
+        if (s.s == shape::cycle)
+          nodes.back()->edges.emplace_back(nodes.front());
+        if (s.s == shape::random) {
+          for (const cycle_gptr<node>& elem : nodes) {
+            for (std::size_t j = 0; j < s.degree; ++j)
+              elem->edges.emplace_back(nodes[pick(rng)]);
+          }
+        }
+      });
+  for (const cycle_gptr<node>& elem : nodes) r.edges += elem->edges.size();
+
+  measure(r.churn,
+      [&]() {
+        const auto writes = static_cast<std::size_t>(s.churn * static_cast<double>(s.nodes));
+        for (std::size_t i = 0; i < writes; ++i) {
+          node& src = *nodes[pick(rng)];
+          if (src.edges.empty()) continue;
+          src.edges[std::uniform_int_distribution<std::size_t>(0, src.edges.size() - 1u)(rng)] = nodes[pick(rng)];
+        }
+      });
+
+  measure(r.drop,
+      [&]() {
+        nodes.clear();
+      });
+  return r;
+}
+
+
+} /* namespace workload */
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <cassert>
@@ -9,18 +10,140 @@
 #include <initializer_list>
 #include <iosfwd>
 #include <iterator>
+#include <limits>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <new>
 #include <shared_mutex>
+#include <stdexcept>
+#include <thread>
 #include <tuple>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
+#include <vector>
+
+#ifdef CYCLE_PTR_TRACE
+# include <chrono>
+# include <condition_variable>
+# include <fstream>
+# include <string>
+#endif
 
 namespace cycle_ptr {
 template<typename> class cycle_allocator;
+template<typename> class cycle_edge_ptr;
+template<typename> class cycle_edge_set;
 class gc_operation;
+class cycle_intrusive_base;
+class collect_hook;
+
+
+/**
+ * \brief Trait selecting the cache isolated control block layout for \p T.
+ * \details
+ * By default, the reference counters of a control block and the first bytes
+ * of the object it manages share a cache line.
+ * Threads that copy pointers to an object then cause false sharing with
+ * threads that only read the object.
+ *
+ * Specialize this trait as ``std::true_type``, to have \ref make_cycle and
+ * \ref allocate_cycle place the object on its own cache line(s),
+ * away from the reference counters:
+ * \code
+ * template<>
+ * struct cycle_ptr::cache_isolated<MyHotType>
+ * : std::true_type
+ * {};
+ * \endcode
+ *
+ * The isolated layout uses more memory per object, due to the padding
+ * required to cache line align the object.
+ * \tparam T The type of object managed by a control block.
+ */
+template<typename T>
+struct cache_isolated
+: std::false_type
+{};
+
+///\brief Shorthand for cache_isolated<T>::value.
+///\relates cache_isolated
+template<typename T>
+inline constexpr bool cache_isolated_v = cache_isolated<T>::value;
+
+
+/**
+ * \brief Trait declaring the statically known edges of \p T.
+ * \details
+ * By default, a type has no statically declared edges.
+ * Its edges are \ref cycle_member_ptr "member pointers", which register
+ * themselves with their owner when they are constructed.
+ *
+ * A specialization declares a static ``members()`` function, returning a
+ * tuple of pointers to the \ref cycle_edge_ptr members of \p T.
+ * The \ref CYCLE_PTR_EDGES macro writes this specialization:
+ * \code
+ * struct Node {
+ *   cycle_edge_ptr<Node> left, right;
+ * };
+ * CYCLE_PTR_EDGES(Node, &Node::left, &Node::right)
+ * \endcode
+ *
+ * When an object of such a type is created by \ref make_cycle or
+ * \ref allocate_cycle, the listed members are adopted by its control block.
+ * The GC then enumerates them using a table of offsets, instead of a list
+ * of registered vertices.
+ *
+ * A type that doesn't declare its edges uses the declaration of its most
+ * derived base class declared using \ref CYCLE_PTR_EDGES.
+ * A type that declares its edges must also list those of its bases.
+ * \tparam T The type of object managed by a control block.
+ */
+template<typename T>
+struct cycle_edges {};
+
+/**
+ * \brief Tag for looking up the edges declared by \ref CYCLE_PTR_EDGES.
+ * \details
+ * For each type, \ref CYCLE_PTR_EDGES declares an overload of
+ * ``cycle_edges_lookup`` taking this tag and a pointer to that type.
+ * Overload resolution on a pointer to a derived type then selects
+ * the declaration of its most derived base.
+ */
+struct cycle_edges_lookup_tag {};
+
+///\brief Lookup result for types without declared edges.
+///\relates cycle_edges_lookup_tag
+constexpr auto cycle_edges_lookup(cycle_edges_lookup_tag tag [[maybe_unused]], const void* ptr [[maybe_unused]])
+noexcept
+-> void* {
+  return nullptr;
+}
+
+/**
+ * \brief Declare the \ref cycle_edge_ptr members of \p Type.
+ * \relates cycle_edges
+ * \details
+ * Specializes \ref cycle_edges for \p Type,
+ * and makes the declaration available to types derived from \p Type.
+ * Must be used at global scope.
+ */
+#define CYCLE_PTR_EDGES(Type, ...)                                            \
+namespace cycle_ptr {                                                         \
+template<>                                                                    \
+struct cycle_edges<Type> {                                                    \
+  static constexpr auto members() noexcept {                                  \
+    return std::make_tuple(__VA_ARGS__);                                      \
+  }                                                                           \
+};                                                                            \
+                                                                              \
+constexpr auto cycle_edges_lookup(cycle_edges_lookup_tag, const Type*)        \
+noexcept                                                                      \
+-> cycle_edges<Type>* {                                                       \
+  return nullptr;                                                             \
+}                                                                             \
+}
 
 
 /**
@@ -90,6 +213,134 @@ auto get_delay_gc() -> delay_gc;
  */
 auto set_delay_gc(delay_gc f) -> delay_gc;
 
+/**
+ * \brief Phases of a GC operation, reported to the \ref gc_phase_hook.
+ * \details
+ * Each collection reports \ref gc_phase::start and \ref gc_phase::done,
+ * and the phases in between that it reaches.
+ * A collection that finds everything reachable skips from the phase in
+ * which it found that out, to \ref gc_phase::done.
+ */
+enum class gc_phase {
+  ///\brief GC started, about to acquire the generation lock.
+  start,
+  ///\brief Generation lock acquired, mark-sweep without blocking any mutators.
+  phase1,
+  ///\brief About to seal weak pointer promotion, then mark-sweep what was promoted.
+  phase2,
+  ///\brief Colouring unreachable objects black.
+  phase3,
+  ///\brief Generation locks released, destroying unreachable objects.
+  destroy,
+  ///\brief GC completed.
+  done
+};
+
+/**
+ * \brief Function observing the phases of each GC operation.
+ * \relates gc_phase
+ * \details
+ * The function is invoked on the thread running the GC,
+ * at the start of each phase.
+ * Intended for instrumentation, such as measuring GC pauses.
+ *
+ * The function is invoked with GC locks held,
+ * so it must not use cycle pointers.
+ * \sa \ref set_gc_phase_hook
+ */
+using gc_phase_hook = void (*)(gc_phase) noexcept;
+
+/**
+ * \brief Install a gc_phase_hook.
+ * \relates gc_phase
+ * \details
+ * Collections that already started may invoke the previous hook.
+ * \param[in] f The hook, or ``nullptr`` to install none.
+ * \returns The previous hook.
+ */
+auto set_gc_phase_hook(gc_phase_hook f) noexcept -> gc_phase_hook;
+
+#ifdef CYCLE_PTR_STATS
+/**
+ * \brief Counters of internal operations, for diagnosing performance.
+ * \details
+ * Only available if ``CYCLE_PTR_STATS`` is defined.
+ * All counters are process wide, and only ever increase.
+ * \sa \ref get_statistics
+ */
+struct statistics {
+  ///\brief Number of generations created.
+  std::uint64_t generations = 0;
+  ///\brief Number of generations merged into another generation.
+  std::uint64_t merges = 0;
+  ///\brief Number of objects moved by merges.
+  std::uint64_t merged_objects = 0;
+  ///\brief Number of GC operations started.
+  std::uint64_t collections = 0;
+  ///\brief Number of objects destroyed by GC operations.
+  std::uint64_t collected_objects = 0;
+};
+
+/**
+ * \brief Read the current statistics.
+ * \relates statistics
+ * \details
+ * Counters are read individually, so a snapshot taken while other threads
+ * operate on cycle pointers may be inconsistent.
+ */
+auto get_statistics() noexcept -> statistics;
+#endif
+
+/**
+ * \brief Operations recorded in a trace.
+ * \details
+ * Objects are identified by a number, assigned when they are created.
+ * \sa \ref trace_start
+ */
+enum class trace_op : std::uint8_t {
+  ///\brief An object was created, and a cycle_gptr to it returned.
+  make,
+  ///\brief A cycle_gptr to an object was created from another pointer.
+  acquire,
+  ///\brief A cycle_gptr to an object was released.
+  drop,
+  ///\brief An edge from an object was assigned to point at another object.
+  edge_set,
+  ///\brief An edge from an object was cleared.
+  edge_reset,
+  ///\brief A weak pointer was promoted to a cycle_gptr.
+  weak_lock,
+  ///\brief A weak pointer promotion failed, because its target was expired.
+  weak_lock_failed
+};
+
+#ifdef CYCLE_PTR_TRACE
+/**
+ * \brief Start recording operations to the file at \p path.
+ * \details
+ * Only available if ``CYCLE_PTR_TRACE`` is defined.
+ *
+ * Each thread records its operations in a lock free ring buffer,
+ * which a background thread writes to the file.
+ * If a ring buffer fills up, its thread writes it out itself.
+ *
+ * Operations on objects created before the trace started are not recorded.
+ * \throws std::runtime_error if a trace is already active,
+ * or the file can't be opened.
+ * \sa \ref trace_op
+ */
+auto trace_start(const std::string& path) -> void;
+
+/**
+ * \brief Stop recording, and write out all recorded operations.
+ * \details
+ * Only available if ``CYCLE_PTR_TRACE`` is defined.
+ * Does nothing if no trace is active.
+ * \throws std::runtime_error if writing the file failed.
+ */
+auto trace_stop() -> void;
+#endif
+
 
 } /* namespace cycle_ptr */
 
@@ -99,6 +350,74 @@ namespace cycle_ptr::detail {
 
 class base_control;
 class generation;
+template<typename> class graph_builder;
+
+
+#ifdef CYCLE_PTR_STATS
+///\brief Counters backing \ref cycle_ptr::statistics.
+struct statistics_counters {
+  std::atomic<std::uint64_t> generations{ 0u };
+  std::atomic<std::uint64_t> merges{ 0u };
+  std::atomic<std::uint64_t> merged_objects{ 0u };
+  std::atomic<std::uint64_t> collections{ 0u };
+  std::atomic<std::uint64_t> collected_objects{ 0u };
+
+  static auto singleton()
+  noexcept
+  -> statistics_counters& {
+    static statistics_counters impl;
+    return impl;
+  }
+
+  ///\brief Add \p n to counter \p c.
+  static auto add(std::atomic<std::uint64_t> statistics_counters::* c, std::uint64_t n = 1u)
+  noexcept
+  -> void {
+    (singleton().*c).fetch_add(n, std::memory_order_relaxed);
+  }
+};
+#endif
+
+#ifdef CYCLE_PTR_TRACE
+///\brief Allocate an object number for traces.
+///\details Numbers start at 1, so that 0 can represent a null pointer.
+inline auto trace_new_id_()
+noexcept
+-> std::uint64_t {
+  static std::atomic<std::uint64_t> impl{ 1u };
+  return impl.fetch_add(1u, std::memory_order_relaxed);
+}
+
+/**
+ * \brief Record \p op on the object of \p obj, if a trace is active.
+ * \details Does nothing if \p obj is null.
+ */
+inline auto trace_(trace_op op, const base_control* obj) noexcept -> void;
+
+/**
+ * \brief Record the assignment of the edge at \p slot, from \p src,
+ * if a trace is active.
+ * \details
+ * Edges from unowned pointers are recorded as acquiring \p new_dst
+ * and dropping \p old_dst, since they behave as a cycle_gptr.
+ */
+inline auto trace_edge_(
+    const base_control& src, const void* slot,
+    const base_control* old_dst, const base_control* new_dst) noexcept
+-> void;
+#else
+inline auto trace_(
+    trace_op op [[maybe_unused]],
+    const base_control* obj [[maybe_unused]]) noexcept
+-> void {}
+
+inline auto trace_edge_(
+    const base_control& src [[maybe_unused]],
+    const void* slot [[maybe_unused]],
+    const base_control* old_dst [[maybe_unused]],
+    const base_control* new_dst [[maybe_unused]]) noexcept
+-> void {}
+#endif
 
 
 /**
@@ -1888,6 +2207,20 @@ class hazard_ptr {
     return hazard_t()(ptr_);
   }
 
+  /**
+   * \brief Read the value of this, without acquiring a reference.
+   * \details
+   * The returned pointer is only valid for as long as the caller can
+   * otherwise guarantee the life time of the pointee.
+   * \returns Raw pointer in this.
+   */
+  [[nodiscard]]
+  auto peek() const
+  noexcept
+  -> T* {
+    return ptr_.load(std::memory_order_acquire);
+  }
+
   /**
    * \brief Assignment.
    * \post
@@ -1948,14 +2281,14 @@ class hazard_ptr {
   auto compare_exchange_weak(pointer& expected, pointer desired)
   noexcept
   -> bool {
-    return hazard_t::compare_exchange_weak(expected, std::move(desired));
+    return hazard_t::compare_exchange_weak(ptr_, expected, std::move(desired));
   }
 
   ///\brief Strong compare-exchange operation.
   auto compare_exchange_strong(pointer& expected, pointer desired)
   noexcept
   -> bool {
-    return hazard_t::compare_exchange_strong(expected, std::move(desired));
+    return hazard_t::compare_exchange_strong(ptr_, expected, std::move(desired));
   }
 
   ///\brief Equality comparison.
@@ -2124,6 +2457,27 @@ noexcept
   return (nrefs << color_shift) | static_cast<std::uintptr_t>(c);
 }
 
+/**
+ * \brief Flag marking a reference counter as immortal.
+ * \details
+ * Uses the topmost bit of the reference count, which is never reached
+ * by actual references.
+ *
+ * Once set, the flag is never cleared.
+ * Reference counting operations on immortal objects are skipped.
+ */
+constexpr std::uintptr_t immortal_flag =
+    std::uintptr_t(1) << (std::numeric_limits<std::uintptr_t>::digits - 1);
+
+/**
+ * \brief Test if the reference counter is marked immortal.
+ */
+constexpr auto is_immortal(std::uintptr_t refcounter)
+noexcept
+-> bool {
+  return (refcounter & immortal_flag) != 0u;
+}
+
 /**
  * \brief Color invariant for reference counter.
  */
@@ -2140,11 +2494,52 @@ noexcept
 }
 
 
+/**
+ * \brief Find the declaration of the edges of \p T.
+ * \details
+ * Uses the specialization of \ref cycle_ptr::cycle_edges for \p T,
+ * if there is one.
+ * Otherwise, uses the declaration of the most derived base of \p T.
+ * If \p T has no declared edges, the type is void.
+ */
+template<typename T, typename = void>
+struct static_edges_source {
+  using type = std::remove_pointer_t<decltype(
+      cycle_edges_lookup(cycle_ptr::cycle_edges_lookup_tag(), static_cast<const T*>(nullptr)))>;
+};
+
+template<typename T>
+struct static_edges_source<T, std::void_t<decltype(cycle_ptr::cycle_edges<T>::members())>> {
+  using type = cycle_ptr::cycle_edges<T>;
+};
+
+///\brief Shorthand for static_edges_source<T>::type.
+template<typename T>
+using static_edges_source_t = typename static_edges_source<T>::type;
+
+///\brief Test if \p T or one of its bases declares edges.
+template<typename T, typename = void>
+struct has_static_edges
+: std::false_type
+{};
+
+template<typename T>
+struct has_static_edges<T, std::void_t<decltype(static_edges_source_t<T>::members())>>
+: std::true_type
+{};
+
+///\brief Shorthand for has_static_edges<T>::value.
+template<typename T>
+inline constexpr bool has_static_edges_v = has_static_edges<T>::value;
+
+
 class vertex
 : public link<vertex>
 {
   friend class generation;
   friend class base_control;
+  friend class edge_base;
+  friend class edge_set_base;
 
  protected:
   vertex();
@@ -2179,6 +2574,35 @@ class vertex
   ///\brief Test if origin is expired.
   auto owner_is_expired() const noexcept -> bool;
 
+  /**
+   * \brief Clear the edge from \p src to \p dst.
+   * \details Implements reset(), for any edge originating from \p src.
+   */
+  static auto clear_edge_(base_control& src, hazard_ptr<base_control>& dst) noexcept
+  -> void;
+
+  /**
+   * \brief Assign \p new_dst to the edge from \p src.
+   * \details
+   * Implements reset(new_dst, has_reference, no_red_promotion),
+   * for any edge originating from \p src.
+   */
+  static auto reset_edge_(
+      base_control& src,
+      hazard_ptr<base_control>& dst,
+      intrusive_ptr<base_control> new_dst,
+      bool has_reference,
+      bool no_red_promotion) noexcept
+  -> void;
+
+  ///\brief Read the target control block, without acquiring a reference.
+  ///\details Only valid while the caller can guarantee the edge isn't changed.
+  auto peek_control() const
+  noexcept
+  -> base_control* {
+    return dst_.peek();
+  }
+
  public:
   ///\brief Read the target control block.
   ///\returns The target control block of this vertex.
@@ -2190,6 +2614,135 @@ class vertex
 };
 
 
+/**
+ * \brief Edge that is declared statically, using \ref cycle_ptr::cycle_edges.
+ * \details
+ * Unlike vertex, an edge_base does not register with its owner.
+ * Instead, the owner adopts it after construction of the object completes.
+ * Until adopted, the edge holds a strong reference to its destination,
+ * like a \ref cycle_ptr::cycle_gptr "cycle_gptr".
+ */
+class edge_base {
+  friend class generation;
+  friend class base_control;
+
+ protected:
+  edge_base() noexcept = default;
+
+  edge_base(const edge_base& other [[maybe_unused]]) noexcept
+  : edge_base()
+  {}
+
+  ~edge_base() noexcept;
+
+  ///\brief Clear the edge.
+  auto reset() noexcept -> void;
+
+  ///\brief Assign a new \p new_dst.
+  ///\details Arguments are the same as for vertex::reset.
+  auto reset(
+      intrusive_ptr<base_control> new_dst,
+      bool has_reference,
+      bool no_red_promotion) noexcept
+  -> void;
+
+  ///\brief Test if origin is expired.
+  auto owner_is_expired() const noexcept -> bool;
+
+ public:
+  ///\brief Read the target control block.
+  ///\returns The target control block of this edge.
+  auto get_control() const noexcept -> intrusive_ptr<base_control>;
+
+ private:
+  ///\brief Control block that adopted this edge, or nullptr if not adopted.
+  base_control* owner_ = nullptr;
+  hazard_ptr<base_control> dst_;
+};
+
+
+/**
+ * \brief Densely stored set of edges, sharing a single registration.
+ * \details
+ * Registers with its owner once, like vertex, but holds any number of
+ * destinations.
+ * The destinations are stored contiguously, so the GC scans the set
+ * as a single block.
+ *
+ * Changes to the number of edges are made while holding the mutex of
+ * the owner, as that is what protects GC iteration.
+ * Assigning or clearing an individual edge follows the same logic as vertex.
+ */
+class edge_set_base
+: public link<edge_set_base>
+{
+  friend class base_control;
+
+ protected:
+  edge_set_base();
+  explicit edge_set_base(intrusive_ptr<base_control> bc) noexcept;
+  ~edge_set_base() noexcept;
+
+  edge_set_base(const edge_set_base&) = delete;
+  auto operator=(const edge_set_base&) -> edge_set_base& = delete;
+
+  ///\brief Number of edges.
+  auto size_() const
+  noexcept
+  -> std::size_t {
+    return dst_.size();
+  }
+
+  ///\brief Test if origin is expired.
+  auto owner_is_expired() const noexcept -> bool;
+
+  ///\brief Reserve space for \p n edges.
+  ///	hrows std::bad_alloc If there is not enough memory.
+  auto reserve_(std::size_t n) -> void;
+
+  /**
+   * \brief Append \p n null edges.
+   * \throws std::bad_alloc If there is not enough memory.
+   */
+  auto grow_(std::size_t n) -> void;
+
+  ///\brief Clear the edge at index \p i.
+  auto reset_(std::size_t i) noexcept -> void;
+
+  ///\brief Assign a new \p new_dst to the edge at index \p i.
+  ///\details Arguments are the same as for vertex::reset.
+  auto reset_(
+      std::size_t i,
+      intrusive_ptr<base_control> new_dst,
+      bool has_reference,
+      bool no_red_promotion) noexcept
+  -> void;
+
+  /**
+   * \brief Remove edges from the set.
+   * \details
+   * Keeps the edges for which \p keep returns true, preserving their order.
+   * For each kept edge that changes position, \p move is invoked with
+   * the old and new index.
+   *
+   * \pre Each removed edge is null.
+   * \note Invoked with the mutex of the owner held.
+   * \returns The new number of edges.
+   */
+  template<typename Keep, typename Move>
+  auto compact_(Keep&& keep, Move&& move) noexcept -> std::size_t;
+
+  ///\brief Read the target control block of the edge at index \p i.
+  auto get_control_(std::size_t i) const noexcept -> intrusive_ptr<base_control>;
+
+ private:
+  const intrusive_ptr<base_control> bc_; // Non-null.
+  ///\brief Destinations of the edges.
+  ///\details The vector itself is only modified while holding the mutex of bc_.
+  std::vector<hazard_ptr<base_control>> dst_;
+};
+
+
 /**
  * \brief Base class for all control blocks.
  * \details
@@ -2200,6 +2753,8 @@ class base_control
 {
   friend class generation;
   friend class vertex;
+  friend class edge_base;
+  friend class edge_set_base;
   template<typename> friend class cycle_ptr::cycle_allocator;
 
   ///\brief Increment reference counter.
@@ -2208,6 +2763,7 @@ class base_control
   noexcept
   -> void {
     assert(bc != nullptr);
+    if (bc->immortal()) return;
 
     [[maybe_unused]]
     std::uintptr_t old = bc->control_refs_.fetch_add(1u, std::memory_order_acquire);
@@ -2221,8 +2777,10 @@ class base_control
   noexcept
   -> void {
     assert(bc != nullptr);
+    if (bc->immortal()) return;
 
-    std::uintptr_t old = bc->control_refs_.fetch_sub(1u, std::memory_order_release);
+    // Acquire, so the deleter sees the writes of other threads that released.
+    std::uintptr_t old = bc->control_refs_.fetch_sub(1u, std::memory_order_acq_rel);
     assert(old > 0u);
 
     if (old == 1u) std::invoke(bc->get_deleter_(), bc);
@@ -2251,13 +2809,73 @@ class base_control
     return get_color(store_refs_.load(std::memory_order_relaxed)) == color::black;
   }
 
+  ///\brief Test if the object managed by this control is immortal.
+  auto immortal() const
+  noexcept
+  -> bool {
+    return is_immortal(store_refs_.load(std::memory_order_relaxed));
+  }
+
+  /**
+   * \brief Test if the caller holds the only reference to the managed object.
+   * \details
+   * The test is conservative: it may report false for an object that
+   * no-one else can reach, but never reports true for a shared object.
+   *
+   * The reference counter must be 1, and no other object in the same
+   * generation may have an edge to the managed object
+   * (those edges don't hold a reference).
+   * Edges from the managed object to itself are ignored.
+   * Weak pointers are not considered.
+   * Edge writes in the generation wait for the test to complete.
+   *
+   * \pre The caller holds a reference to the managed object.
+   * \note Linear in the number of edges in the generation,
+   * unless the reference counter rules out uniqueness.
+   */
+  auto is_unique() noexcept -> bool;
+
+  /**
+   * \brief Mark the object managed by this control as immortal.
+   * \details
+   * Immortal objects are never collected.
+   * Neither their reference counter, nor the reference counter of this
+   * control block, will be modified after this call.
+   *
+   * \pre The caller holds a reference to the managed object.
+   */
+  auto make_immortal()
+  noexcept
+  -> void {
+    [[maybe_unused]]
+    const std::uintptr_t old = store_refs_.fetch_or(immortal_flag, std::memory_order_relaxed);
+    assert(get_refs(old) > 0u);
+  }
+
   ///\brief Implements publisher lookup based on address range.
   static auto publisher_lookup(void* addr, std::size_t len) -> intrusive_ptr<base_control>;
 
+#ifndef CYCLE_PTR_NO_WEAK
   ///\brief Used by weak to strong reference promotion.
   ///\return True if promotion succeeded, false otherwise.
   auto weak_acquire() noexcept -> bool;
 
+  /**
+   * \brief Used by batch weak to strong reference promotion.
+   * \details
+   * Promotes each control block in \p ctrls, like weak_acquire().
+   * Red promotions are grouped by generation, so that each generation
+   * is announced to at most once.
+   *
+   * \param[in] ctrls Control blocks to promote. Null entries are skipped.
+   * \param[in] n Number of elements in \p ctrls.
+   * \param[out] acquired For each control block, true if promotion succeeded.
+   * \throws std::bad_alloc if temporary storage can't be allocated.
+   * If an exception is thrown, no references will have been acquired.
+   */
+  static auto weak_acquire_all(base_control*const* ctrls, std::size_t n, bool* acquired) -> void;
+#endif
+
   /**
    * \brief Acquire reference.
    * \details
@@ -2270,6 +2888,8 @@ class base_control
   auto acquire_no_red()
   noexcept
   -> void {
+    if (immortal()) return;
+
     [[maybe_unused]]
     std::uintptr_t old = store_refs_.fetch_add(1u << color_shift, std::memory_order_relaxed);
     assert(get_color(old) != color::black && get_color(old) != color::red);
@@ -2297,6 +2917,8 @@ class base_control
   auto release(bool skip_gc = false)
   noexcept
   -> void {
+    if (immortal()) return;
+
     const std::uintptr_t old = store_refs_.fetch_sub(
         1u << color_shift,
         std::memory_order_release);
@@ -2323,16 +2945,71 @@ class base_control
   noexcept
   -> void {
     std::lock_guard<std::mutex> lck{ mtx_ };
+    // Linkage may only be inspected with the lock held,
+    // as erasing a neighbour modifies it.
+    assert(v.linked());
     edges_.erase(edges_.iterator_to(v));
   }
 
-  ///\brief Test if this control block represents an unowned object.
-  virtual auto is_unowned() const noexcept -> bool;
+  ///\brief Register an edge set.
+  auto push_back(edge_set_base& s)
+  noexcept
+  -> void {
+    std::lock_guard<std::mutex> lck{ mtx_ };
+    edge_sets_.push_back(s);
+  }
 
- private:
-  ///\brief Destroy object managed by this control block.
-  virtual auto clear_data_() noexcept -> void = 0;
-  /**
+  ///\brief Deregister an edge set.
+  auto erase(edge_set_base& s)
+  noexcept
+  -> void {
+    std::lock_guard<std::mutex> lck{ mtx_ };
+    assert(s.linked());
+    edge_sets_.erase(edge_sets_.iterator_to(s));
+  }
+
+  /**
+   * \brief Attach \p hook to the object managed by this control block.
+   * \pre The caller holds a reference to the managed object.
+   * \pre \p hook is not attached to any object.
+   */
+  auto add_collect_hook(cycle_ptr::collect_hook& hook) noexcept -> void;
+
+  ///\brief Detach \p hook, if it has not been invoked yet.
+  auto remove_collect_hook(cycle_ptr::collect_hook& hook) noexcept -> void;
+
+  ///\brief Test if this control block represents an unowned object.
+  virtual auto is_unowned() const noexcept -> bool;
+
+  /**
+   * \brief Adopt the statically declared edges of \p obj.
+   * \details
+   * Does nothing, unless \p T or one of its bases declares edges
+   * (see \ref cycle_ptr::cycle_edges).
+   * Otherwise, the strong references held by the edges are converted
+   * into edges originating from this.
+   *
+   * \pre \p obj is the object managed by this control block.
+   * \pre \p obj is fully constructed and not yet published.
+   */
+  template<typename T>
+  auto adopt_static_edges(T& obj) noexcept -> void;
+
+  /**
+   * \brief Retrieve the managed object, if it derives from cycle_intrusive_base.
+   * \details
+   * Used by the intrusive pointers, to find the object from its control block.
+   * \returns The intrusive base of the managed object, or nullptr if the
+   * managed object does not derive from cycle_intrusive_base.
+   * The returned pointer may only be dereferenced while the managed object
+   * is alive.
+   */
+  virtual auto intrusive_base() const noexcept -> cycle_ptr::cycle_intrusive_base*;
+
+ private:
+  ///\brief Destroy object managed by this control block.
+  virtual auto clear_data_() noexcept -> void = 0;
+  /**
    * \brief Retrieve the deleter function.
    * \details
    * Deleter is a free function, because control blocks need to use their
@@ -2340,6 +3017,62 @@ class base_control
    */
   virtual auto get_deleter_() const noexcept -> void (*)(base_control*) noexcept = 0;
 
+  ///\brief Invoke and detach all collect hooks.
+  ///\pre The caller holds mtx_.
+  auto fire_collect_hooks_() noexcept -> void;
+
+#ifndef CYCLE_PTR_NO_WEAK
+  /**
+   * \brief Promote a red control.
+   * \details
+   * Implements the red-promotion protocol described at
+   * generation::promotion_state_.
+   * \param strong If set, the caller guarantees this is reachable.
+   * \return True if promotion succeeded, false if this is unreachable.
+   */
+  auto red_acquire_(bool strong) noexcept -> bool;
+
+  /**
+   * \brief Grey the red controls in \p gen reachable from this.
+   * \details
+   * Called after greying this during a red-promotion,
+   * so that the GC doesn't have to sweep again before sealing promotion.
+   * \pre The caller announced a promotion on \p gen.
+   */
+  auto help_promote_(generation& gen) noexcept -> void;
+#endif
+
+  /**
+   * \brief Invoke \p fn on each edge originating from this.
+   * \details
+   * Visits the registered vertices, the edge sets,
+   * and then the statically declared edges.
+   * \pre The caller holds mtx_.
+   * \param fn Functor accepting the destination of each edge,
+   * as ``hazard_ptr<base_control>&``.
+   */
+  template<typename Fn>
+  auto for_each_edge_(Fn&& fn)
+  -> void {
+    for (vertex& v : edges_) fn(v.dst_);
+    for (edge_set_base& s : edge_sets_)
+      for (hazard_ptr<base_control>& dst : s.dst_) fn(dst);
+
+    char*const object = static_cast<char*>(static_edges_.object);
+    for (std::size_t i = 0; i < static_edges_.size; ++i)
+      fn(reinterpret_cast<edge_base*>(object + static_edges_.offsets[i])->dst_);
+  }
+
+  ///\brief Table of statically declared edges in the managed object.
+  struct static_edges {
+    ///\brief Address of the managed object.
+    void* object = nullptr;
+    ///\brief Offset of each edge, relative to object.
+    const std::ptrdiff_t* offsets = nullptr;
+    ///\brief Number of edges.
+    std::size_t size = 0;
+  };
+
   ///\brief Reference counter on managed object.
   ///\details Initially has a value of 1.
   std::atomic<std::uintptr_t> store_refs_{ make_refcounter(1u, color::white) };
@@ -2352,6 +3085,14 @@ class base_control
   std::mutex mtx_;
   ///\brief List of edges originating from object managed by this control block.
   llist<vertex, vertex> edges_;
+  ///\brief List of edge sets originating from object managed by this control block.
+  llist<edge_set_base, edge_set_base> edge_sets_;
+  ///\brief Statically declared edges originating from object managed by this control block.
+  ///\details Protected by mtx_.
+  static_edges static_edges_;
+  ///\brief Hooks to invoke when the managed object is collected.
+  ///\details Protected by mtx_.
+  cycle_ptr::collect_hook* collect_hooks_ = nullptr;
 
  public:
   /**
@@ -2370,6 +3111,11 @@ class base_control
    * publishing an uninitialized pointer.
    */
   bool under_construction = true;
+
+#ifdef CYCLE_PTR_TRACE
+  ///\brief Number identifying this in traces.
+  const std::uint64_t trace_id = trace_new_id_();
+#endif
 };
 
 
@@ -2382,45 +3128,33 @@ class base_control
  */
 class base_control::publisher {
  private:
-  ///\brief Address range.
+  ///\brief Published address range.
   struct address_range {
     ///\brief Base memory address.
     void* addr;
     ///\brief Size of memory in bytes.
     std::size_t len;
+    ///\brief Control block managing the range.
+    base_control* bc;
 
-    ///\brief Equality comparison.
-    auto operator==(const address_range& other) const
-    noexcept
-    -> bool {
-      return std::tie(addr, len) == std::tie(other.addr, other.len);
-    }
-
-    ///\brief Inequality comparison.
-    auto operator!=(const address_range& other) const
+    ///\brief Test if this range covers [\p addr, \p addr + \p len).
+    auto contains(void* addr, std::size_t len) const
     noexcept
     -> bool {
-      return !(*this == other);
-    }
-
-    ///\brief Less operator for use in map.
-    auto operator<(const address_range& other) const
-    noexcept
-    -> bool {
-      return addr < other.addr;
+      return reinterpret_cast<std::uintptr_t>(this->addr) <= reinterpret_cast<std::uintptr_t>(addr)
+          && (reinterpret_cast<std::uintptr_t>(this->addr) + this->len
+              >= reinterpret_cast<std::uintptr_t>(addr) + len);
     }
   };
 
   /**
-   * \brief Map of address ranges.
+   * \brief Per thread set of published ranges.
    * \details
-   * This is an ordered map, sorted by address (ascending).
-   *
-   * It must be an ordered map, since the lookup queries will likely contain
-   * sub-ranges.
+   * Each thread publishes into its own shard, so publishing and the common
+   * lookup never contend on a global lock.
    *
    * \note
-   * We use a global map for published memory ranges, rather than a TLS variable.
+   * We can't use a plain TLS variable for published memory ranges.
    * \par
    * This is because a TLS variable would break, if the called constructor,
    * during our publishing stage, would jump threads.
@@ -2428,8 +3162,28 @@ class base_control::publisher {
    * co-routine additions in C++20.
    * For example, if a co-routine creates an object, which during its
    * construction invokes an awaitable function.
+   * \par
+   * So shards are linked into a global list, which a lookup searches
+   * if the shard of the current thread does not cover the range.
+   * Shards are never deallocated: when a thread exits, its shard is
+   * reused by a later thread.
+   * This way, a publisher may outlive the thread that created it.
    */
-  using map_type = std::map<address_range, base_control*>;
+  struct alignas(hardware_destructive_interference_size) shard {
+    ///\brief Protects ranges.
+    ///\details Only contended if a constructor jumps threads.
+    std::mutex mtx;
+    ///\brief Published ranges, in order of publication.
+    std::vector<address_range> ranges;
+    ///\brief Set while a thread owns this shard.
+    std::atomic<bool> in_use{ true };
+    ///\brief Next shard in the global list.
+    shard* next = nullptr;
+  };
+
+  ///\brief Thread local handle on a shard.
+  ///\details Releases the shard for reuse when the thread exits.
+  class shard_owner;
 
   publisher() = delete;
   publisher(const publisher&) = delete;
@@ -2450,22 +3204,20 @@ class base_control::publisher {
   static auto lookup(void* addr, std::size_t len) -> intrusive_ptr<base_control>;
 
  private:
-  /**
-   * \brief Global map of ranges.
-   * \details The singleton map maintains all published ranges.
-   *
-   * It is a map, instead of a TLS pointer, as the latter might be wrong, when
-   * an object constructor calls a method implemented as a co-routine.
-   * In the case of (boost) asio, this could cause the constructor to switch
-   * threads and thus make the pointer invisible.
-   *
-   * \returns Map for range publication, with its associated mutex.
-   */
-  static auto singleton_map_() noexcept
-  -> std::tuple<std::shared_mutex&, map_type&>;
+  ///\brief Head of the global list of shards.
+  static auto shards_() noexcept -> std::atomic<shard*>&;
 
-  ///\brief Iterator into published data.
-  map_type::const_iterator iter_;
+  ///\brief Shard of the current thread.
+  static auto local_shard_() -> shard&;
+
+  ///\brief Find the most recently published range in \p s covering [\p addr, \p addr + \p len).
+  ///\returns Control block of that range, or nullptr if there is none.
+  static auto lookup_in_(shard& s, void* addr, std::size_t len) -> base_control*;
+
+  ///\brief Shard into which the range was published.
+  shard& shard_;
+  ///\brief Published base address, used to find our entry during unpublishing.
+  void*const addr_;
 };
 
 
@@ -2502,11 +3254,23 @@ class generation {
  private:
   using controls_list = llist<base_control, base_control>;
 
+#ifdef CYCLE_PTR_STATS
+  generation() noexcept {
+    statistics_counters::add(&statistics_counters::generations);
+  }
+
+  generation(std::uintmax_t seq) noexcept
+  : seq_(seq)
+  {
+    statistics_counters::add(&statistics_counters::generations);
+  }
+#else
   generation() = default;
 
   generation(std::uintmax_t seq)
   : seq_(seq)
   {}
+#endif
 
   generation(const generation&) = delete;
 
@@ -2530,10 +3294,22 @@ class generation {
     return intrusive_ptr<generation>(new generation(seq), true);
   }
 
+  /**
+   * \brief Test if an edge from \p origin to \p dest is allowed.
+   * \details
+   * Generations are ordered by sequence number.
+   * Moving sequence numbers down can make them collide, in which case
+   * the address of the generation breaks the tie.
+   * This keeps the order total, so that a merge never has to move a
+   * generation into one with the same sequence number and a lower address,
+   * which would violate the lock order.
+   */
   static auto order_invariant(const generation& origin, const generation& dest)
   noexcept
   -> bool {
-    return origin.seq() < (dest.seq() & ~moveable_seq);
+    const std::uintmax_t origin_seq = origin.seq();
+    const std::uintmax_t dest_seq = dest.seq() & ~moveable_seq;
+    return origin_seq < dest_seq || (origin_seq == dest_seq && &origin < &dest);
   }
 
   auto link(base_control& bc) noexcept
@@ -2575,6 +3351,22 @@ class generation {
   static auto fix_ordering(base_control& src, base_control& dst) noexcept
   -> std::shared_lock<std::shared_mutex>;
 
+  /**
+   * \brief Test if anything other than the caller's reference points at \p dst.
+   * \details
+   * Scans the generation of \p dst for edges to \p dst,
+   * since edges within a generation don't hold a reference.
+   * Edges from \p dst to itself are not counted.
+   *
+   * Edge writes in the generation are blocked during the scan,
+   * and the reference counter is tested again once the scan completes.
+   * So an edge can't be copied past the scan, unless a reference to
+   * \p dst remains in use.
+   *
+   * \pre The caller holds a reference to \p dst.
+   */
+  static auto is_shared(base_control& dst) noexcept -> bool;
+
  private:
   /**
    * \brief Single run of the GC.
@@ -2582,7 +3374,8 @@ class generation {
    *
    * The GC runs in two mark-sweep algorithms, in distinct phases.
    * - Phase 1: operates mark-sweep, but does not lock out other threads.
-   * - Phase 2: operates mark-sweep on the remainder, locking out other threads attempting weak-pointer acquisition.
+   * - Phase 2: seals weak red-promotion and operates mark-sweep on the promoted remainder.
+   *   Weak red-promotions fail fast while sealed, instead of waiting for the GC.
    * - Phase 3: colour everything still not reachable black.
    * - Destruction phase: this phase runs after phase 3, with all GC locks unlocked.
    *   It is responsible for destroying the pointees.
@@ -2592,6 +3385,19 @@ class generation {
    */
   auto gc_() noexcept -> void;
 
+#ifndef CYCLE_PTR_NO_WEAK
+  /**
+   * \brief Close and seal weak red-promotion.
+   * \details
+   * Waits for in-flight red-promotions to drain,
+   * sweeping again if a promotion couldn't complete its help.
+   * \param[in,out] sweep_end End of the processed range.
+   * \returns False if everything turned out to be reachable,
+   * in which case promotion is not closed.
+   */
+  auto seal_promotions_(controls_list::iterator& sweep_end) noexcept -> bool;
+#endif
+
   /**
    * \brief Mark phase of the GC algorithm.
    * \details Marks all white nodes red or grey, depending on their reference
@@ -2608,32 +3414,42 @@ class generation {
   /**
    * \brief Phase 2 mark
    * \details
-   * Extends the wavefront in ``[controls_.begin(), b)`` with anything
-   * non-red after \p b.
+   * Creates a wavefront from anything non-red at or after \p wavefront_begin.
+   * \param[in,out] wavefront_begin Start of the unprocessed range.
+   * Updated to the first element of the wavefront.
+   * \returns End of the wavefront.
    */
-  auto gc_phase2_mark_(controls_list::iterator b) noexcept
+  auto gc_phase2_mark_(controls_list::iterator& wavefront_begin) noexcept
   -> controls_list::iterator;
 
   /**
    * \brief Sweep phase of the GC algorithm.
-   * \details Takes the wavefront and for each element,
-   * adds all outgoing links to the wavefront.
+   * \details Takes the wavefront ``[wavefront_begin, wavefront_end)`` and
+   * for each element, adds all outgoing links to the wavefront.
+   *
+   * Elements before \p wavefront_begin must already have been processed.
    *
    * Processed grey elements are marked white.
    * \returns Partition end iterator.
    * Elements before the iterator are known reachable.
    * Elements after are not reachable (but note that red-promotion may make them reachable).
    */
-  auto gc_sweep_(controls_list::iterator wavefront_end) noexcept
+  auto gc_sweep_(
+      controls_list::iterator wavefront_begin,
+      controls_list::iterator wavefront_end) noexcept
   -> controls_list::iterator;
 
   /**
    * \brief Perform phase 2 mark-sweep.
    * \details
-   * In phase 2, weak red promotion is no longer allowed.
+   * In phase 2, weak red promotion is sealed.
+   *
+   * Elements before \p wavefront_begin must already have been processed.
    * \returns End partition iterator of reachable set.
    */
-  auto gc_phase2_sweep_(controls_list::iterator wavefront_end) noexcept
+  auto gc_phase2_sweep_(
+      controls_list::iterator wavefront_begin,
+      controls_list::iterator wavefront_end) noexcept
   -> controls_list::iterator;
 
   /**
@@ -2693,15 +3509,52 @@ class generation {
   controls_list controls_;
 
  public:
-  ///\brief Lock to control weak red-promotions.
-  ///\details
-  ///When performing a weak red promotion, this lock must be held for share.
-  ///The GC will hold this lock exclusively, to prevent red promotions.
-  ///
-  ///Note that this lock is not needed when performing a strong red-promotion,
-  ///as the promoted element is known reachable, thus the GC would already have
-  ///processed it during phase 1.
-  std::shared_mutex red_promotion_mtx_;
+#ifndef CYCLE_PTR_NO_WEAK
+  ///\brief No new weak red-promotions may start.
+  static constexpr std::uint64_t promotion_closed = 0x1u;
+  ///\brief All red-promotions have drained: red controls are unreachable.
+  static constexpr std::uint64_t promotion_sealed = 0x2u;
+  ///\brief A promotion did not complete its help, the GC must sweep again.
+  static constexpr std::uint64_t promotion_rescan = 0x4u;
+  ///\brief Increment for the number of in-flight red-promotions.
+  static constexpr std::uint64_t promotion_inflight_one = 0x8u;
+  ///\brief Mask for the number of in-flight red-promotions.
+  static constexpr std::uint64_t promotion_inflight_mask = 0xfffffff8u;
+  ///\brief Increment of the epoch, counting the number of times promotion was sealed.
+  static constexpr std::uint64_t promotion_epoch_one = std::uint64_t(1) << 32;
+
+  /**
+   * \brief State of weak red-promotions.
+   * \details
+   * Red-promotions don't block and aren't blocked by the GC.
+   * Instead, a thread promoting a red control:
+   * - announces itself by incrementing the in-flight counter,
+   *   which is only allowed while promotion is not closed,
+   * - greys the control and helps the GC by greying the red controls
+   *   reachable from it within this generation,
+   * - and then withdraws its announcement.
+   *
+   * The GC closes promotion at the start of phase 2, waits for in-flight
+   * promotions to drain and then seals it.
+   * While sealed, every red control in this generation is unreachable,
+   * so a weak red-promotion fails fast, without waiting for the GC.
+   * The epoch changes each time promotion is reopened, so that a promoter
+   * can tell it observed a red control during a single sealed interval.
+   *
+   * Strong red-promotions are on reachable controls, so they may announce
+   * until promotion is sealed.
+   */
+  std::atomic<std::uint64_t> promotion_state_{ 0u };
+
+  ///\brief Withdraw the announcement of a red-promotion.
+  auto end_promotion_()
+  noexcept
+  -> void {
+    [[maybe_unused]]
+    const std::uint64_t old = promotion_state_.fetch_sub(promotion_inflight_one, std::memory_order_seq_cst);
+    assert((old & promotion_inflight_mask) != 0u);
+  }
+#endif
 
  private:
   ///\brief Sequence number of this generation.
@@ -2709,7 +3562,7 @@ class generation {
   ///\brief Reference counter for intrusive_ptr.
   std::atomic<std::uintptr_t> refs_{ 0u };
   ///\brief Flag indicating a pending GC.
-  std::atomic_flag gc_flag_;
+  std::atomic_flag gc_flag_ = ATOMIC_FLAG_INIT;
 };
 
 
@@ -2742,6 +3595,14 @@ class control final
   : Alloc(std::move(alloc))
   {}
 
+  ///\brief Create control block in generation \p g.
+  ///\param alloc The allocator used to allocate space for this control block.
+  ///\param g The generation of this control block.
+  control(Alloc alloc, intrusive_ptr<generation> g)
+  : base_control(std::move(g)),
+    Alloc(std::move(alloc))
+  {}
+
   ///\brief Instantiate the object managed by this control block.
   ///\details
   ///Uses placement new to instantiate the object that is being managed.
@@ -2756,6 +3617,7 @@ class control final
 
     publisher pub{ reinterpret_cast<void*>(&store_), sizeof(store_), *this };
     new (reinterpret_cast<void*>(&store_)) T(std::forward<Args>(args)...); // May throw.
+    this->adopt_static_edges(*reinterpret_cast<T*>(&store_));
 
     // Clear construction flag after construction completes successfully.
     this->under_construction = false;
@@ -2763,6 +3625,15 @@ class control final
     return reinterpret_cast<T*>(&store_);
   }
 
+  auto intrusive_base() const
+  noexcept
+  -> cycle_ptr::cycle_intrusive_base* override {
+    if constexpr(std::is_base_of_v<cycle_ptr::cycle_intrusive_base, T>)
+      return const_cast<T*>(reinterpret_cast<const T*>(&store_));
+    else
+      return nullptr;
+  }
+
  private:
   ///\brief Destroy object.
   ///\pre this has a constructed object (i.e. a successful call to \ref instantiate).
@@ -2800,8 +3671,147 @@ class control final
     control_alloc_traits_t::deallocate(alloc, ptr, 1);
   }
 
+  ///\brief Alignment of the managed object.
+  ///\details
+  ///If the type is \ref cycle_ptr::cache_isolated "cache isolated",
+  ///the object starts on a cache line boundary.
+  ///This keeps the reference counters in base_control out of the cache lines
+  ///that hold the object.
+  static constexpr std::size_t store_align_ =
+      (cycle_ptr::cache_isolated_v<T> && alignof(T) < hardware_destructive_interference_size
+       ? hardware_destructive_interference_size
+       : alignof(T));
+
   ///\brief Storage for managed object.
-  std::aligned_storage_t<sizeof(T), alignof(T)> store_;
+  std::aligned_storage_t<sizeof(T), store_align_> store_;
+};
+
+
+/**
+ * \brief Control block implementation that keeps its object in a separate allocation.
+ * \details
+ * Like \ref control, except that the managed object is allocated separately
+ * from the control block.
+ * The storage of the managed object is released as soon as the object is
+ * destroyed, while the (small) control block stays around until the last
+ * weak pointer to it goes away.
+ *
+ * This is the cycle_ptr equivalent of ``std::shared_ptr<T>(new T)``,
+ * where \ref control is the equivalent of ``std::make_shared<T>()``.
+ *
+ * \tparam T The type of object managed by this control block.
+ * \tparam Alloc The allocator used to allocate storage for this control block
+ * and its managed object.
+ */
+template<typename T, typename Alloc>
+class split_control final
+: public base_control,
+  private Alloc
+{
+  using alloc_traits = std::allocator_traits<Alloc>;
+  using control_alloc_t = typename alloc_traits::template rebind_alloc<split_control>;
+  using control_alloc_traits_t = typename alloc_traits::template rebind_traits<split_control>;
+
+  static_assert(std::is_same_v<typename alloc_traits::value_type, T>,
+      "Alloc must be allocator of T.");
+
+  split_control(const split_control&) = delete;
+
+ public:
+  ///\brief Create control block.
+  ///\param alloc The allocator used to allocate space for this control block.
+  split_control(Alloc alloc)
+  : Alloc(std::move(alloc))
+  {}
+
+  ///\brief Instantiate the object managed by this control block.
+  ///\details
+  ///Allocates storage for the object and uses placement new to
+  ///instantiate the object that is being managed.
+  ///\pre !this->under_construction
+  ///\post this->under_construction
+  ///\param args Arguments to pass to constructor of \p T.
+  ///\throws std::bad_alloc if storage for \p T can not be allocated.
+  ///\throws ... if constructor of \p T throws.
+  template<typename... Args>
+  auto instantiate(Args&&... args)
+  -> T* {
+    assert(this->under_construction);
+    assert(store_ == nullptr);
+
+    Alloc& alloc = *this;
+    T*const store = alloc_traits::allocate(alloc, 1); // May throw.
+    try {
+      publisher pub{ reinterpret_cast<void*>(store), sizeof(T), *this };
+      new (reinterpret_cast<void*>(store)) T(std::forward<Args>(args)...); // May throw.
+    } catch (...) {
+      alloc_traits::deallocate(alloc, store, 1);
+      throw;
+    }
+
+    this->adopt_static_edges(*store);
+
+    // Clear construction flag after construction completes successfully.
+    store_ = store;
+    this->under_construction = false;
+
+    return store_;
+  }
+
+  auto intrusive_base() const
+  noexcept
+  -> cycle_ptr::cycle_intrusive_base* override {
+    if constexpr(std::is_base_of_v<cycle_ptr::cycle_intrusive_base, T>)
+      return store_;
+    else
+      return nullptr;
+  }
+
+ private:
+  ///\brief Destroy object and release its storage.
+  ///\pre this has a constructed object (i.e. a successful call to \ref instantiate).
+  ///\note May not clear this->under_construction, due to assertions in base_control destructor.
+  auto clear_data_()
+  noexcept
+  -> void override {
+    assert(!this->under_construction);
+    assert(store_ != nullptr);
+
+    Alloc& alloc = *this;
+    T*const store = std::exchange(store_, nullptr);
+    store->~T();
+    alloc_traits::deallocate(alloc, store, 1);
+  }
+
+  ///\brief Get function that performs deletion of this.
+  ///\returns A function that, when passed this, will destroy this.
+  auto get_deleter_() const
+  noexcept
+  -> void (*)(base_control* bc) noexcept override {
+    return &deleter_impl_;
+  }
+
+  ///\brief Implementation of delete function.
+  ///\details Uses allocator supplied at construction to destroy and deallocate this.
+  static auto deleter_impl_(base_control* bc)
+  noexcept
+  -> void {
+    assert(bc != nullptr);
+#ifdef NDEBUG
+    split_control* ptr = static_cast<split_control*>(bc);
+#else
+    split_control* ptr = dynamic_cast<split_control*>(bc);
+    assert(ptr != nullptr);
+#endif
+
+    control_alloc_t alloc = std::move(*ptr);
+    control_alloc_traits_t::destroy(alloc, ptr);
+    control_alloc_traits_t::deallocate(alloc, ptr, 1);
+  }
+
+  ///\brief Separately allocated storage for managed object.
+  ///\details Null, unless the managed object is alive.
+  T* store_ = nullptr;
 };
 
 
@@ -2889,6 +3899,7 @@ inline base_control::~base_control() noexcept {
 #ifndef NDEBUG
   std::lock_guard<std::mutex> edge_lck{ mtx_ };
   assert(edges_.empty());
+  assert(edge_sets_.empty());
 #endif
 }
 
@@ -2897,31 +3908,20 @@ inline auto base_control::unowned_control()
   return intrusive_ptr<base_control>(new unowned_control_impl(), false);
 }
 
+#ifndef CYCLE_PTR_NO_WEAK
 inline auto base_control::weak_acquire()
 noexcept
 -> bool {
-  intrusive_ptr<generation> gen_ptr;
-  std::shared_lock<std::shared_mutex> lck;
+  if (immortal()) return true;
 
   std::uintptr_t expect = make_refcounter(1, color::white);
   while (get_color(expect) != color::black) {
-    if (get_color(expect) == color::red && !lck.owns_lock()) [[unlikely]] {
-      // Acquire weak red-promotion lock.
-      gen_ptr = generation_.get();
-      for (;;) {
-        lck = std::shared_lock<std::shared_mutex>(gen_ptr->red_promotion_mtx_);
-        if (gen_ptr == generation_) break;
-        lck.unlock();
-        gen_ptr = generation_;
-      }
-    }
+    if (get_color(expect) == color::red) [[unlikely]]
+      return red_acquire_(false);
 
-    const color target_color = (get_color(expect) == color::red
-        ? color::grey
-        : get_color(expect));
     if (store_refs_.compare_exchange_weak(
             expect,
-            make_refcounter(get_refs(expect) + 1u, target_color),
+            make_refcounter(get_refs(expect) + 1u, get_color(expect)),
             std::memory_order_relaxed,
             std::memory_order_relaxed)) [[likely]] {
       return true;
@@ -2931,96 +3931,448 @@ noexcept
   return false;
 }
 
-inline auto base_control::acquire()
+inline auto base_control::red_acquire_(bool strong)
 noexcept
--> void {
-  std::uintptr_t expect = make_refcounter(1, color::white);
+-> bool {
+  intrusive_ptr<generation> gen_ptr = generation_.get();
   for (;;) {
-    assert(get_color(expect) != color::black);
+    std::uint64_t state = gen_ptr->promotion_state_.load(std::memory_order_seq_cst);
+
+    if (!(state & generation::promotion_sealed)
+        && (strong || !(state & generation::promotion_closed))) {
+      // Announce the promotion, so the GC won't seal promotion until we're done.
+      if (!gen_ptr->promotion_state_.compare_exchange_weak(
+              state,
+              state + generation::promotion_inflight_one,
+              std::memory_order_seq_cst,
+              std::memory_order_seq_cst))
+        continue;
+      if (gen_ptr != generation_) [[unlikely]] {
+        gen_ptr->end_promotion_();
+        gen_ptr = generation_.get();
+        continue;
+      }
 
-    const color target_color = (get_color(expect) == color::red
-        ? color::grey
-        : get_color(expect));
+      std::uintptr_t expect = store_refs_.load(std::memory_order_relaxed);
+      while (get_color(expect) != color::black) {
+        const color target_color = (get_color(expect) == color::red
+            ? color::grey
+            : get_color(expect));
+        if (store_refs_.compare_exchange_weak(
+                expect,
+                make_refcounter(get_refs(expect) + 1u, target_color),
+                std::memory_order_relaxed,
+                std::memory_order_relaxed)) [[likely]] {
+          if (get_color(expect) == color::red) help_promote_(*gen_ptr);
+          gen_ptr->end_promotion_();
+          return true;
+        }
+      }
+
+      gen_ptr->end_promotion_();
+      assert(!strong);
+      return false;
+    }
+
+    // Promotion is closed.
+    // Controls that aren't red don't need the protocol.
+    std::uintptr_t expect = store_refs_.load(std::memory_order_acquire);
+    if (get_color(expect) == color::black) {
+      assert(!strong);
+      return false;
+    }
+    if (get_color(expect) != color::red) {
+      if (store_refs_.compare_exchange_weak(
+              expect,
+              make_refcounter(get_refs(expect) + 1u, get_color(expect)),
+              std::memory_order_relaxed,
+              std::memory_order_relaxed)) [[likely]] {
+        return true;
+      }
+      continue;
+    }
+
+    // The GC is waiting for in-flight promotions to drain.
+    if (!(state & generation::promotion_sealed)) [[unlikely]] {
+      std::this_thread::yield();
+      continue;
+    }
+
+    // Validate that this was red, in this generation, while sealed.
+    if (gen_ptr != generation_) [[unlikely]] {
+      gen_ptr = generation_.get();
+      continue;
+    }
+    if (gen_ptr->promotion_state_.load(std::memory_order_seq_cst) != state)
+      continue;
+
+    // Unreachable: fail fast.
+    if (!strong) return false;
+
+    // The caller guarantees we're reachable, so this is merely a race
+    // with an edge write that the GC will pick up.
     if (store_refs_.compare_exchange_weak(
             expect,
-            make_refcounter(get_refs(expect) + 1u, target_color),
+            make_refcounter(get_refs(expect) + 1u, color::grey),
             std::memory_order_relaxed,
             std::memory_order_relaxed)) [[likely]] {
-      return;
+      return true;
     }
   }
 }
 
-inline auto base_control::gc()
+inline auto base_control::help_promote_(generation& gen)
 noexcept
 -> void {
-  intrusive_ptr<generation> gen_ptr;
-  do {
-    gen_ptr = generation_.get();
-    gen_ptr->gc();
-  } while (gen_ptr != generation_);
+  std::vector<intrusive_ptr<base_control>> wavefront;
+  try {
+    wavefront.emplace_back(this, true);
+    while (!wavefront.empty()) {
+      const intrusive_ptr<base_control> bc = std::move(wavefront.back());
+      wavefront.pop_back();
+
+      std::lock_guard<std::mutex> edges_lck{ bc->mtx_ };
+      bc->for_each_edge_(
+          [&gen, &wavefront](hazard_ptr<base_control>& edge_dst) {
+            intrusive_ptr<base_control> dst = edge_dst.load();
+            if (dst == nullptr || dst->generation_ != &gen)
+              return; // Edges outside this generation hold a reference.
+
+            std::uintptr_t expect = make_refcounter(0u, color::red);
+            while (get_color(expect) == color::red) {
+              if (dst->store_refs_.compare_exchange_weak(
+                      expect,
+                      make_refcounter(get_refs(expect), color::grey),
+                      std::memory_order_acq_rel,
+                      std::memory_order_acquire)) {
+                wavefront.push_back(std::move(dst));
+                break;
+              }
+            }
+          });
+    }
+  } catch (const std::bad_alloc&) {
+    // A greyed control may not have had its edges processed.
+    gen.promotion_state_.fetch_or(generation::promotion_rescan, std::memory_order_seq_cst);
+  }
 }
 
-inline auto base_control::is_unowned() const
-noexcept
--> bool {
-  return false;
-}
+inline auto base_control::weak_acquire_all(base_control*const* ctrls, std::size_t n, bool* acquired)
+-> void {
+  // Red controls, with the generation on which to announce the promotion.
+  // Reserved up front, so we won't throw after acquiring references.
+  std::vector<std::tuple<intrusive_ptr<generation>, std::size_t>> red;
+  red.reserve(n);
+
+  // First pass: promote everything that does not require the protocol.
+  for (std::size_t i = 0; i < n; ++i) {
+    acquired[i] = false;
+    base_control*const bc = ctrls[i];
+    if (bc == nullptr) continue;
+    if (bc->immortal()) {
+      acquired[i] = true;
+      continue;
+    }
 
+    std::uintptr_t expect = bc->store_refs_.load(std::memory_order_relaxed);
+    while (get_color(expect) != color::black) {
+      if (get_color(expect) == color::red) {
+        red.emplace_back(bc->generation_.get(), i);
+        break;
+      }
 
-inline base_control::publisher::publisher(void* addr, std::size_t len, base_control& bc) {
-  const auto mtx_and_map = singleton_map_();
-  std::lock_guard<std::shared_mutex> lck{ std::get<std::shared_mutex&>(mtx_and_map) };
+      if (bc->store_refs_.compare_exchange_weak(
+              expect,
+              make_refcounter(get_refs(expect) + 1u, get_color(expect)),
+              std::memory_order_relaxed,
+              std::memory_order_relaxed)) [[likely]] {
+        acquired[i] = true;
+        break;
+      }
+    }
+  }
+  if (red.empty()) [[likely]] return;
 
-  [[maybe_unused]]
-  bool success;
-  std::tie(iter_, success) =
-      std::get<map_type&>(mtx_and_map).emplace(address_range{ addr, len }, &bc);
+  // Group red controls by generation.
+  std::sort(
+      red.begin(), red.end(),
+      [](const auto& x, const auto& y) {
+        return std::less<const generation*>()(std::get<0>(x).get(), std::get<0>(y).get());
+      });
 
-  assert(success);
+  // Second pass: promote red controls, announcing on each generation once.
+  // Controls that moved to a different generation, or whose generation
+  // closed promotion, keep their entry,
+  // and are handled by the regular algorithm afterwards.
+  auto group_begin = red.begin();
+  while (group_begin != red.end()) {
+    const intrusive_ptr<generation> gen_ptr = std::get<0>(*group_begin);
+    const auto group_end = std::find_if(
+        group_begin, red.end(),
+        [&gen_ptr](const auto& r) { return std::get<0>(r) != gen_ptr; });
+
+    std::uint64_t state = gen_ptr->promotion_state_.load(std::memory_order_seq_cst);
+    while (!(state & generation::promotion_closed)
+        && !gen_ptr->promotion_state_.compare_exchange_weak(
+            state,
+            state + generation::promotion_inflight_one,
+            std::memory_order_seq_cst,
+            std::memory_order_seq_cst));
+    if (state & generation::promotion_closed) {
+      group_begin = group_end;
+      continue;
+    }
+
+    for (auto r = group_begin; r != group_end; ++r) {
+      const std::size_t i = std::get<1>(*r);
+      base_control*const bc = ctrls[i];
+      if (gen_ptr != bc->generation_) [[unlikely]] continue;
+      std::get<0>(*r).reset();
+
+      std::uintptr_t expect = bc->store_refs_.load(std::memory_order_relaxed);
+      while (get_color(expect) != color::black) {
+        const color target_color = (get_color(expect) == color::red
+            ? color::grey
+            : get_color(expect));
+        if (bc->store_refs_.compare_exchange_weak(
+                expect,
+                make_refcounter(get_refs(expect) + 1u, target_color),
+                std::memory_order_relaxed,
+                std::memory_order_relaxed)) [[likely]] {
+          if (get_color(expect) == color::red) bc->help_promote_(*gen_ptr);
+          acquired[i] = true;
+          break;
+        }
+      }
+    }
+    gen_ptr->end_promotion_();
+
+    group_begin = group_end;
+  }
+
+  for (const auto& r : red) {
+    if (std::get<0>(r) != nullptr) [[unlikely]]
+      acquired[std::get<1>(r)] = ctrls[std::get<1>(r)]->weak_acquire();
+  }
 }
+#endif
 
-inline base_control::publisher::~publisher() noexcept {
-  const auto mtx_and_map = singleton_map_();
-  std::lock_guard<std::shared_mutex> lck{ std::get<std::shared_mutex&>(mtx_and_map) };
+inline auto base_control::acquire()
+noexcept
+-> void {
+  if (immortal()) return;
+
+  std::uintptr_t expect = make_refcounter(1, color::white);
+  for (;;) {
+    assert(get_color(expect) != color::black);
+
+#ifndef CYCLE_PTR_NO_WEAK
+    // Red promotion has to help the GC, so weak promotions can fail fast.
+    if (get_color(expect) == color::red) [[unlikely]] {
+      [[maybe_unused]]
+      const bool acquired = red_acquire_(true);
+      assert(acquired);
+      return;
+    }
+
+    const color target_color = get_color(expect);
+#else
+    const color target_color = (get_color(expect) == color::red
+        ? color::grey
+        : get_color(expect));
+#endif
+    if (store_refs_.compare_exchange_weak(
+            expect,
+            make_refcounter(get_refs(expect) + 1u, target_color),
+            std::memory_order_relaxed,
+            std::memory_order_relaxed)) [[likely]] {
+      return;
+    }
+  }
+}
+
+inline auto base_control::gc()
+noexcept
+-> void {
+  intrusive_ptr<generation> gen_ptr;
+  do {
+    gen_ptr = generation_.get();
+    gen_ptr->gc();
+  } while (gen_ptr != generation_);
+}
+
+inline auto base_control::is_unique()
+noexcept
+-> bool {
+  // Acquire, so the caller sees the writes of owners that released.
+  const std::uintptr_t refs = store_refs_.load(std::memory_order_acquire);
+  if (is_immortal(refs) || get_refs(refs) != 1u) return false;
 
-  std::get<map_type&>(mtx_and_map).erase(iter_);
+  // Edges within a generation don't hold a reference.
+  return !generation::is_shared(*this);
 }
 
-inline auto base_control::publisher::lookup(void* addr, std::size_t len)
--> intrusive_ptr<base_control> {
-  const auto mtx_and_map = singleton_map_();
-  std::shared_lock<std::shared_mutex> lck{ std::get<std::shared_mutex&>(mtx_and_map) };
+inline auto base_control::is_unowned() const
+noexcept
+-> bool {
+  return false;
+}
 
-  // Find address range after argument range.
-  const map_type& map = std::get<map_type&>(mtx_and_map);
-  auto pos = map.upper_bound(address_range{ addr, len });
-  assert(pos == map.end() || pos->first.addr > addr);
+inline auto base_control::intrusive_base() const
+noexcept
+-> cycle_ptr::cycle_intrusive_base* {
+  return nullptr;
+}
 
-  // Skip back one position, to find highest address range containing addr.
-  if (pos == map.begin()) [[unlikely]] {
-    throw std::runtime_error("cycle_ptr: no published control block for given address range.");
-  } else {
-    --pos;
+template<typename T>
+auto base_control::adopt_static_edges(T& obj)
+noexcept
+-> void {
+  if constexpr(has_static_edges_v<T>) {
+    constexpr auto members = static_edges_source_t<T>::members();
+    constexpr std::size_t n = std::tuple_size_v<decltype(members)>;
+    char*const object = reinterpret_cast<char*>(std::addressof(obj));
+
+    // Offsets are the same for each instance of T,
+    // so we only compute them once.
+    static const std::array<std::ptrdiff_t, n> offsets = std::apply(
+        [&obj, object](auto... member) {
+          return std::array<std::ptrdiff_t, n>{{
+              (reinterpret_cast<char*>(static_cast<edge_base*>(&(obj.*member))) - object)...
+          }};
+        },
+        members);
+
+    const auto edge_at = [object](std::ptrdiff_t off) -> edge_base& {
+      return *reinterpret_cast<edge_base*>(object + off);
+    };
+
+    // Take the references held by the edges, so that GC and merges
+    // won't see edges with a reference counter during adoption.
+    std::array<intrusive_ptr<base_control>, n> held;
+    for (std::size_t i = 0; i < n; ++i) {
+      assert(edge_at(offsets[i]).owner_ == nullptr);
+      held[i] = edge_at(offsets[i]).dst_.exchange(nullptr);
+    }
+
+    {
+      std::lock_guard<std::mutex> lck{ mtx_ };
+      static_edges_ = static_edges{ object, offsets.data(), n };
+    }
+
+    // Install the edges, consuming the held references.
+    for (std::size_t i = 0; i < n; ++i) {
+      edge_base& e = edge_at(offsets[i]);
+      e.owner_ = this;
+      vertex::reset_edge_(*this, e.dst_, std::move(held[i]), true, true);
+    }
+  }
+}
+
+
+class base_control::publisher::shard_owner {
+ public:
+  shard_owner()
+  : s_(acquire_())
+  {}
+
+  shard_owner(const shard_owner&) = delete;
+
+  ~shard_owner() noexcept {
+    s_.in_use.store(false, std::memory_order_release);
   }
-  assert(pos != map.end() && pos->first.addr <= addr);
-  assert(pos->second != nullptr);
 
-  // Verify if range fits.
-  if (reinterpret_cast<std::uintptr_t>(pos->first.addr) + pos->first.len
-      >= reinterpret_cast<std::uintptr_t>(addr) + len) [[likely]] {
-    return intrusive_ptr<base_control>(pos->second, true);
+  auto get() const
+  noexcept
+  -> shard& {
+    return s_;
+  }
+
+ private:
+  ///\brief Reuse an unused shard, or create a new one.
+  static auto acquire_()
+  -> shard& {
+    std::atomic<shard*>& head = shards_();
+
+    for (shard* s = head.load(std::memory_order_acquire); s != nullptr; s = s->next) {
+      bool expect = false;
+      if (!s->in_use.load(std::memory_order_relaxed)
+          && s->in_use.compare_exchange_strong(expect, true, std::memory_order_acquire, std::memory_order_relaxed))
+        return *s;
+    }
+
+    shard*const s = new shard(); // May throw.
+    s->next = head.load(std::memory_order_relaxed);
+    while (!head.compare_exchange_weak(s->next, s, std::memory_order_release, std::memory_order_relaxed)) {
+      // Retry.
+    }
+    return *s;
+  }
+
+  shard& s_;
+};
+
+inline base_control::publisher::publisher(void* addr, std::size_t len, base_control& bc)
+: shard_(local_shard_()),
+  addr_(addr)
+{
+  std::lock_guard<std::mutex> lck{ shard_.mtx };
+  assert(std::none_of(shard_.ranges.begin(), shard_.ranges.end(),
+          [addr](const address_range& r) { return r.addr == addr; }));
+  shard_.ranges.push_back(address_range{ addr, len, &bc }); // May throw.
+}
+
+inline base_control::publisher::~publisher() noexcept {
+  std::lock_guard<std::mutex> lck{ shard_.mtx };
+
+  // Publishers are usually destroyed in reverse order of construction,
+  // so our range is most likely the last one.
+  const auto pos = std::find_if(shard_.ranges.rbegin(), shard_.ranges.rend(),
+      [this](const address_range& r) { return r.addr == addr_; });
+  assert(pos != shard_.ranges.rend());
+  shard_.ranges.erase(std::next(pos).base());
+}
+
+inline auto base_control::publisher::lookup(void* addr, std::size_t len)
+-> intrusive_ptr<base_control> {
+  // Fast path: the range was published by this thread.
+  shard& local = local_shard_();
+  if (base_control*const bc = lookup_in_(local, addr, len); bc != nullptr) [[likely]]
+    return intrusive_ptr<base_control>(bc, true);
+
+  // Slow path: constructor may have jumped threads, search other shards.
+  for (shard* s = shards_().load(std::memory_order_acquire); s != nullptr; s = s->next) {
+    if (s == &local) continue;
+    if (base_control*const bc = lookup_in_(*s, addr, len); bc != nullptr)
+      return intrusive_ptr<base_control>(bc, true);
   }
 
   throw std::runtime_error("cycle_ptr: no published control block for given address range.");
 }
 
-inline auto base_control::publisher::singleton_map_()
+inline auto base_control::publisher::lookup_in_(shard& s, void* addr, std::size_t len)
+-> base_control* {
+  std::lock_guard<std::mutex> lck{ s.mtx };
+
+  const auto pos = std::find_if(s.ranges.rbegin(), s.ranges.rend(),
+      [addr, len](const address_range& r) { return r.contains(addr, len); });
+  if (pos == s.ranges.rend()) return nullptr;
+
+  assert(pos->bc != nullptr);
+  return pos->bc;
+}
+
+inline auto base_control::publisher::shards_()
 noexcept
--> std::tuple<std::shared_mutex&, map_type&> {
-  static std::shared_mutex mtx;
-  static map_type map;
-  return std::tie(mtx, map);
+-> std::atomic<shard*>& {
+  static std::atomic<shard*> head{ nullptr };
+  return head;
+}
+
+inline auto base_control::publisher::local_shard_()
+-> shard& {
+  static thread_local const shard_owner owner;
+  return owner.get();
 }
 
 
@@ -3097,12 +4449,384 @@ inline auto maybe_delay_gc_(detail::generation& g)
 }
 
 
+///\brief The installed gc_phase_hook.
+inline auto gc_phase_hook_impl_()
+noexcept
+-> std::atomic<gc_phase_hook>& {
+  static std::atomic<gc_phase_hook> impl{ nullptr };
+  return impl;
+}
+
+/**
+ * \brief Reports the phases of a single GC operation to the gc_phase_hook.
+ * \details
+ * Reports \ref gc_phase::done on destruction,
+ * so that returning early from a GC still completes the report.
+ */
+class gc_phase_reporter {
+ public:
+  gc_phase_reporter() noexcept
+  : hook_(gc_phase_hook_impl_().load(std::memory_order_acquire))
+  {
+    (*this)(gc_phase::start);
+  }
+
+  gc_phase_reporter(const gc_phase_reporter&) = delete;
+  auto operator=(const gc_phase_reporter&) -> gc_phase_reporter& = delete;
+
+  ~gc_phase_reporter() noexcept {
+    (*this)(gc_phase::done);
+  }
+
+  ///\brief Report the start of phase \p p.
+  auto operator()(gc_phase p) const
+  noexcept
+  -> void {
+    if (hook_ != nullptr) (*hook_)(p);
+  }
+
+ private:
+  const gc_phase_hook hook_;
+};
+
+
+/**
+ * \brief Magic bytes at the start of a trace file.
+ * \details
+ * The magic is followed by the \ref trace_version byte,
+ * and a sequence of chunks.
+ * Each chunk holds operations of a single thread:
+ * - thread number, as a varint;
+ * - number of operations, as a varint;
+ * - each operation, as its \ref cycle_ptr::trace_op byte, followed by
+ *   the sequence number delta from the previous operation in the chunk,
+ *   and the object number, as varints.
+ *   Edge operations add the zigzag encoded offset of the edge
+ *   from the control block of its object, and \ref trace_op::edge_set
+ *   the object number of the destination.
+ *
+ * Varints are little endian, with 7 bits per byte and the high bit set
+ * on all bytes but the last.
+ */
+inline constexpr char trace_magic[4] = { 'C', 'Y', 'P', 'T' };
+///\brief Version of the trace file format.
+inline constexpr std::uint8_t trace_version = 1;
+
+#ifdef CYCLE_PTR_TRACE
+/**
+ * \brief Records operations to a trace file.
+ * \details
+ * Each thread owns a single producer, single consumer ring buffer.
+ * The consumer is whichever thread holds the mutex: the background writer,
+ * trace_stop(), or the producer itself, when its ring buffer is full.
+ * So records are never lost, but a full ring buffer stalls its thread
+ * until it is written out.
+ */
+class trace_recorder {
+ private:
+  struct entry {
+    std::uint64_t seq;
+    std::uint64_t obj;
+    std::uint64_t dst;
+    std::ptrdiff_t slot;
+    trace_op op;
+  };
+
+  struct buffer {
+    static constexpr std::size_t size = 4096;
+
+    explicit buffer(std::uint64_t thread) noexcept
+    : thread(thread)
+    {}
+
+    const std::uint64_t thread;
+    ///\brief Index of the next write, only modified by the producer.
+    std::atomic<std::size_t> head{ 0u };
+    ///\brief Index of the next read, only modified by the consumer.
+    std::atomic<std::size_t> tail{ 0u };
+    std::array<entry, size> ring;
+  };
+
+  ///\brief Registers the buffer of a thread, for the lifetime of the thread.
+  class thread_buffer {
+   public:
+    thread_buffer() noexcept
+    : buf(singleton().register_())
+    {}
+
+    thread_buffer(const thread_buffer&) = delete;
+    auto operator=(const thread_buffer&) -> thread_buffer& = delete;
+
+    ~thread_buffer() noexcept {
+      if (buf != nullptr) singleton().unregister_(buf);
+    }
+
+    buffer*const buf;
+  };
+
+  trace_recorder() = default;
+
+ public:
+  trace_recorder(const trace_recorder&) = delete;
+  auto operator=(const trace_recorder&) -> trace_recorder& = delete;
+
+  ~trace_recorder() noexcept {
+    try {
+      stop();
+    } catch (...) {
+      // Destructor can't report the failure.
+    }
+  }
+
+  static auto singleton()
+  noexcept
+  -> trace_recorder& {
+    static trace_recorder impl;
+    return impl;
+  }
+
+  auto active() const
+  noexcept
+  -> bool {
+    return active_.load(std::memory_order_relaxed);
+  }
+
+  ///\brief Record an operation in the ring buffer of this thread.
+  auto record(trace_op op, std::uint64_t obj, std::ptrdiff_t slot = 0, std::uint64_t dst = 0)
+  noexcept
+  -> void {
+    thread_local thread_buffer tb;
+    buffer*const b = tb.buf;
+    if (b == nullptr) [[unlikely]] return;
+
+    const std::size_t head = b->head.load(std::memory_order_relaxed);
+    if (head - b->tail.load(std::memory_order_acquire) == buffer::size) [[unlikely]] {
+      std::lock_guard<std::mutex> lck{ mtx_ };
+      drain_(*b);
+    }
+
+    b->ring[head % buffer::size] = entry{ seq_.fetch_add(1u, std::memory_order_relaxed), obj, dst, slot, op };
+    b->head.store(head + 1u, std::memory_order_release);
+  }
+
+  auto start(const std::string& path)
+  -> void {
+    std::lock_guard<std::mutex> lck{ mtx_ };
+    if (out_.is_open()) throw std::runtime_error("cycle_ptr: trace already active");
+
+    // Discard records made after the previous trace stopped.
+    for (buffer* b : buffers_)
+      b->tail.store(b->head.load(std::memory_order_acquire), std::memory_order_release);
+
+    out_.open(path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    if (!out_.is_open()) {
+      out_.clear();
+      throw std::runtime_error("cycle_ptr: unable to open trace file: " + path);
+    }
+    out_.write(trace_magic, sizeof(trace_magic));
+    out_.put(static_cast<char>(trace_version));
+
+    stop_writer_ = false;
+    try {
+      writer_ = std::thread(&trace_recorder::write_loop_, this);
+    } catch (...) {
+      out_.close();
+      out_.clear();
+      throw;
+    }
+    active_.store(true, std::memory_order_relaxed);
+  }
+
+  auto stop()
+  -> void {
+    std::unique_lock<std::mutex> lck{ mtx_ };
+    if (!out_.is_open() || !writer_.joinable()) return;
+
+    active_.store(false, std::memory_order_relaxed);
+    stop_writer_ = true;
+    cv_.notify_all();
+    std::thread writer = std::move(writer_);
+    lck.unlock();
+    writer.join();
+    lck.lock();
+
+    for (buffer* b : buffers_) drain_(*b);
+    out_.close();
+    const bool failed = out_.fail();
+    out_.clear();
+    if (failed) throw std::runtime_error("cycle_ptr: failed to write trace file");
+  }
+
+ private:
+  auto register_()
+  noexcept
+  -> buffer* {
+    std::lock_guard<std::mutex> lck{ mtx_ };
+    buffer*const b = new (std::nothrow) buffer(next_thread_++);
+    if (b == nullptr) return nullptr;
+    try {
+      buffers_.push_back(b);
+    } catch (...) {
+      delete b;
+      return nullptr;
+    }
+    return b;
+  }
+
+  auto unregister_(buffer* b)
+  noexcept
+  -> void {
+    std::lock_guard<std::mutex> lck{ mtx_ };
+    drain_(*b);
+    buffers_.erase(std::find(buffers_.begin(), buffers_.end(), b));
+    delete b;
+  }
+
+  ///\brief Background writer, draining all buffers periodically.
+  auto write_loop_()
+  noexcept
+  -> void {
+    std::unique_lock<std::mutex> lck{ mtx_ };
+    while (!stop_writer_) {
+      for (buffer* b : buffers_) drain_(*b);
+      cv_.wait_for(lck, std::chrono::milliseconds(10));
+    }
+  }
+
+  static auto put_varint_(std::string& out, std::uint64_t v)
+  -> void {
+    while (v >= 0x80u) {
+      out.push_back(static_cast<char>(v | 0x80u));
+      v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+  }
+
+  /**
+   * \brief Write the records in \p b to the file, as a single chunk.
+   * \details
+   * Discards the records if no trace is active.
+   * \pre mtx_ is held by the caller.
+   */
+  auto drain_(buffer& b)
+  noexcept
+  -> void {
+    const std::size_t tail = b.tail.load(std::memory_order_relaxed);
+    const std::size_t head = b.head.load(std::memory_order_acquire);
+    if (head == tail) return;
+
+    if (out_.is_open()) {
+      try {
+        chunk_.clear();
+        put_varint_(chunk_, b.thread);
+        put_varint_(chunk_, head - tail);
+        std::uint64_t seq = 0;
+        for (std::size_t i = tail; i != head; ++i) {
+          const entry& e = b.ring[i % buffer::size];
+          chunk_.push_back(static_cast<char>(e.op));
+          put_varint_(chunk_, e.seq - seq);
+          put_varint_(chunk_, e.obj);
+          seq = e.seq;
+
+          if (e.op == trace_op::edge_set || e.op == trace_op::edge_reset) {
+            const auto slot = static_cast<std::uint64_t>(e.slot);
+            put_varint_(chunk_, e.slot < 0 ? ~(slot << 1) : slot << 1);
+          }
+          if (e.op == trace_op::edge_set)
+            put_varint_(chunk_, e.dst);
+        }
+        out_.write(chunk_.data(), static_cast<std::streamsize>(chunk_.size()));
+      } catch (...) {
+        out_.setstate(std::ios_base::failbit);
+      }
+    }
+
+    b.tail.store(head, std::memory_order_release);
+  }
+
+  std::atomic<bool> active_{ false };
+  ///\brief Sequence number of the next record, ordering records across threads.
+  std::atomic<std::uint64_t> seq_{ 0u };
+  ///\brief Protects all members below, and consumption of the ring buffers.
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  std::vector<buffer*> buffers_;
+  std::uint64_t next_thread_ = 0;
+  std::ofstream out_;
+  std::string chunk_;
+  std::thread writer_;
+  bool stop_writer_ = false;
+};
+
+inline auto trace_(trace_op op, const base_control* obj)
+noexcept
+-> void {
+  trace_recorder& r = trace_recorder::singleton();
+  if (obj != nullptr && r.active()) r.record(op, obj->trace_id);
+}
+
+inline auto trace_edge_(
+    const base_control& src, const void* slot,
+    const base_control* old_dst, const base_control* new_dst)
+noexcept
+-> void {
+  trace_recorder& r = trace_recorder::singleton();
+  if (!r.active()) return;
+
+  if (src.is_unowned()) {
+    if (new_dst != nullptr) r.record(trace_op::acquire, new_dst->trace_id);
+    if (old_dst != nullptr) r.record(trace_op::drop, old_dst->trace_id);
+    return;
+  }
+
+  const std::ptrdiff_t offset = reinterpret_cast<const char*>(slot) - reinterpret_cast<const char*>(&src);
+  if (new_dst == nullptr)
+    r.record(trace_op::edge_reset, src.trace_id, offset);
+  else
+    r.record(trace_op::edge_set, src.trace_id, offset, new_dst->trace_id);
+}
+#endif
+
+
 } /* namespace cycle_ptr::detail */
 
 
 namespace cycle_ptr {
 
 
+inline auto set_gc_phase_hook(gc_phase_hook f)
+noexcept
+-> gc_phase_hook {
+  return detail::gc_phase_hook_impl_().exchange(f, std::memory_order_acq_rel);
+}
+
+#ifdef CYCLE_PTR_STATS
+inline auto get_statistics()
+noexcept
+-> statistics {
+  const detail::statistics_counters& impl = detail::statistics_counters::singleton();
+  statistics s;
+  s.generations = impl.generations.load(std::memory_order_relaxed);
+  s.merges = impl.merges.load(std::memory_order_relaxed);
+  s.merged_objects = impl.merged_objects.load(std::memory_order_relaxed);
+  s.collections = impl.collections.load(std::memory_order_relaxed);
+  s.collected_objects = impl.collected_objects.load(std::memory_order_relaxed);
+  return s;
+}
+#endif
+
+#ifdef CYCLE_PTR_TRACE
+inline auto trace_start(const std::string& path)
+-> void {
+  detail::trace_recorder::singleton().start(path);
+}
+
+inline auto trace_stop()
+-> void {
+  detail::trace_recorder::singleton().stop();
+}
+#endif
+
 inline auto get_delay_gc()
 -> delay_gc {
   detail::delay_gc_impl_& impl = detail::delay_gc_impl_::singleton();
@@ -3177,6 +4901,38 @@ noexcept
   }
 }
 
+inline auto generation::is_shared(base_control& dst)
+noexcept
+-> bool {
+  // Lock generation against edge writes and merges,
+  // and against GC.
+  intrusive_ptr<generation> gen = dst.generation_.load();
+  std::unique_lock<std::shared_mutex> merge_lck{ gen->merge_mtx_ };
+  while (gen != dst.generation_) {
+    merge_lck.unlock();
+    gen = dst.generation_.load();
+    merge_lck = std::unique_lock<std::shared_mutex>{ gen->merge_mtx_ };
+  }
+  const std::shared_lock<std::shared_mutex> lck{ gen->mtx_ };
+
+  for (base_control& bc : gen->controls_) {
+    if (&bc == &dst) continue;
+
+    bool found = false;
+    std::lock_guard<std::mutex> edges_lck{ bc.mtx_ };
+    bc.for_each_edge_(
+        [&dst, &found](hazard_ptr<base_control>& edge_dst) {
+          if (edge_dst.peek() == &dst) found = true;
+        });
+    if (found) return true;
+  }
+
+  // A reference acquired during the scan may have been obtained through
+  // an edge that the scan already passed.
+  // Edge writes are blocked, so such a reference must still be in use.
+  return get_refs(dst.store_refs_.load(std::memory_order_acquire)) != 1u;
+}
+
 inline auto generation::fix_ordering(base_control& src, base_control& dst)
 noexcept
 -> std::shared_lock<std::shared_mutex> {
@@ -3242,14 +4998,12 @@ noexcept
     }
 
     // Update src_gen, in case another merge moved src away from under us.
+    // Always relock: if src_gen and dst_gen were swapped above,
+    // src_merge_lck refers to the mutex of the merged-away generation.
     assert(!src_gc_requested);
     assert(!src_merge_lck.owns_lock());
-    if (src_gen != src.generation_) [[unlikely]] {
-      src_gen = src.generation_.load();
-      src_merge_lck = std::shared_lock<std::shared_mutex>{ src_gen->merge_mtx_ };
-    } else {
-      src_merge_lck.lock();
-    }
+    src_gen = src.generation_.load();
+    src_merge_lck = std::shared_lock<std::shared_mutex>{ src_gen->merge_mtx_ };
   }
 
   // Validate post condition.
@@ -3265,7 +5019,11 @@ noexcept
 inline auto generation::gc_()
 noexcept
 -> void {
+  const gc_phase_reporter report;
   controls_list unreachable;
+#ifdef CYCLE_PTR_STATS
+  statistics_counters::add(&statistics_counters::collections);
+#endif
 
   // Lock scope.
   {
@@ -3280,6 +5038,7 @@ noexcept
     // ran and thus as if they happened before the last reference to their
     // data went away.
     std::lock_guard<std::shared_mutex> lck{ mtx_ };
+    report(gc_phase::phase1);
 
     // Clear GC request flag, signalling that GC has started.
     // (We do this after acquiring initial locks, so that multiple threads can
@@ -3291,26 +5050,55 @@ noexcept
     if (wavefront_end == controls_.end()) return; // Everything is reachable.
 
     // Sweep phase.
-    controls_list::iterator sweep_end = gc_sweep_(std::move(wavefront_end));
+    controls_list::iterator sweep_end = gc_sweep_(controls_.begin(), std::move(wavefront_end));
     if (sweep_end == controls_.end()) return; // Everything is reachable.
 
+#ifndef CYCLE_PTR_NO_WEAK
+    // ----------------------------------------
+    // Phase 2 starts by closing weak red-promotion.
+    // Promotions that are in flight grey everything they make reachable,
+    // so once they drain, the red controls are unreachable and
+    // promotion is sealed: weak red-promotions fail fast from here on.
+    report(gc_phase::phase2);
+    if (!seal_promotions_(sweep_end)) return; // Everything is reachable.
+
+    // Reopen promotion when the lock scope ends,
+    // by which time the unreachable controls are black.
+    struct promotion_opener {
+      ~promotion_opener() noexcept {
+        [[maybe_unused]]
+        const std::uint64_t old = self.promotion_state_.exchange(
+            ((self.promotion_state_.load(std::memory_order_relaxed) + promotion_epoch_one)
+             & ~(promotion_epoch_one - 1u)),
+            std::memory_order_seq_cst);
+        assert((old & promotion_inflight_mask) == 0u);
+      }
+
+      generation& self;
+    };
+    const promotion_opener open_promotions{ *this };
+#else
     // ----------------------------------------
-    // Locks for phase 2:
-    // exclusive lock on red_promotion_mtx_, prevents weak red-promotions.
-    std::lock_guard<std::shared_mutex> red_promotion_lck{ red_promotion_mtx_ };
+    // Without weak pointers, the only promotions are strong red-promotions.
+    // Phase 2 still picks up the ones that occurred during phase 1,
+    // but no lock is required.
+    report(gc_phase::phase2);
+#endif
 
     // Process marks for phase 2.
     // Ensures that all grey elements in sweep_end, controls_.end() are moved into the wave front.
-    wavefront_end = gc_phase2_mark_(std::move(sweep_end));
+    wavefront_end = gc_phase2_mark_(sweep_end);
     if (wavefront_end == controls_.end()) return; // Everything is reachable.
 
     // Perform phase 2 sweep.
-    controls_list::iterator reachable_end = gc_phase2_sweep_(std::move(wavefront_end));
+    // Everything before the wavefront was processed in phase 1.
+    controls_list::iterator reachable_end = gc_phase2_sweep_(std::move(sweep_end), std::move(wavefront_end));
     if (reachable_end == controls_.end()) return; // Everything is reachable.
 
     // ----------------------------------------
     // Phase 3: mark unreachables black and add a reference to their controls.
     // The range reachable_end, controls_.end(), contains all unreachable elements.
+    report(gc_phase::phase3);
     std::for_each(
         reachable_end, controls_.end(),
         [](base_control& bc) {
@@ -3330,15 +5118,19 @@ noexcept
   // ----------------------------------------
   // Destruction phase: destroy data in each control block.
   // Clear edges in unreachable pointers.
+  report(gc_phase::destroy);
   std::for_each(
       unreachable.begin(), unreachable.end(),
       [this](base_control& bc) {
         std::lock_guard<std::mutex> lck{ bc.mtx_ }; // Lock edges_
-        for (vertex& v : bc.edges_) {
-          intrusive_ptr<base_control> dst = v.dst_.exchange(nullptr);
-          if (dst != nullptr && dst->generation_ != this)
-            dst->release(); // Reference count decrement.
-        }
+        bc.fire_collect_hooks_();
+        bc.for_each_edge_(
+            [this](hazard_ptr<base_control>& edge_dst) {
+              intrusive_ptr<base_control> dst = edge_dst.exchange(nullptr);
+              if (dst != nullptr && dst->generation_ != this)
+                dst->release(); // Reference count decrement.
+            });
+        bc.static_edges_ = base_control::static_edges();
       });
 
   // Destroy unreachables.
@@ -3349,11 +5141,54 @@ noexcept
         false);
 
     bc_ptr->clear_data_(); // Object destruction.
+#ifdef CYCLE_PTR_STATS
+    statistics_counters::add(&statistics_counters::collected_objects);
+#endif
   }
 
   // And we're done. :)
 }
 
+#ifndef CYCLE_PTR_NO_WEAK
+inline auto generation::seal_promotions_(controls_list::iterator& sweep_end)
+noexcept
+-> bool {
+  std::uint64_t state = promotion_state_.fetch_or(promotion_closed, std::memory_order_seq_cst)
+      | promotion_closed;
+  for (;;) {
+    if (state & promotion_rescan) [[unlikely]] {
+      // A promotion couldn't complete its help, so sweep from its grey controls.
+      state = promotion_state_.fetch_and(~promotion_rescan, std::memory_order_seq_cst)
+          & ~promotion_rescan;
+
+      controls_list::iterator wavefront_begin = sweep_end;
+      const controls_list::iterator wavefront_end = gc_phase2_mark_(wavefront_begin);
+      sweep_end = gc_sweep_(std::move(wavefront_begin), std::move(wavefront_end));
+      if (sweep_end == controls_.end()) {
+        // Everything is reachable.
+        promotion_state_.fetch_and(~promotion_closed, std::memory_order_seq_cst);
+        return false;
+      }
+      continue;
+    }
+
+    if ((state & promotion_inflight_mask) != 0u) {
+      // Wait for in-flight promotions to complete their help.
+      std::this_thread::yield();
+      state = promotion_state_.load(std::memory_order_seq_cst);
+      continue;
+    }
+
+    if (promotion_state_.compare_exchange_weak(
+            state,
+            state | promotion_sealed,
+            std::memory_order_seq_cst,
+            std::memory_order_seq_cst))
+      return true;
+  }
+}
+#endif
+
 inline auto generation::gc_mark_()
 noexcept
 -> controls_list::iterator {
@@ -3395,9 +5230,10 @@ noexcept
   return wavefront_end;
 }
 
-inline auto generation::gc_phase2_mark_(controls_list::iterator b)
+inline auto generation::gc_phase2_mark_(controls_list::iterator& wavefront_begin)
 noexcept
 -> controls_list::iterator {
+  controls_list::iterator b = wavefront_begin;
   controls_list::iterator wavefront_end = b;
 
   while (b != controls_.end()) {
@@ -3411,18 +5247,20 @@ noexcept
       ++wavefront_end;
       ++b;
     } else {
-      controls_.splice(wavefront_end, controls_, b++);
+      const controls_list::iterator moved = b++;
+      controls_.splice(wavefront_end, controls_, moved);
+      if (wavefront_begin == wavefront_end) wavefront_begin = moved;
     }
   }
 
   return wavefront_end;
 }
 
-inline auto generation::gc_sweep_(controls_list::iterator wavefront_end)
+inline auto generation::gc_sweep_(
+    controls_list::iterator wavefront_begin,
+    controls_list::iterator wavefront_end)
 noexcept
 -> controls_list::iterator {
-  controls_list::iterator wavefront_begin = controls_.begin();
-
   while (wavefront_begin != wavefront_end) {
     {
       // Promote grey to white.
@@ -3443,56 +5281,57 @@ noexcept
     // Lock wavefront_begin->edges_, for processing.
     std::lock_guard<std::mutex> edges_lck{ wavefront_begin->mtx_ };
 
-    for (const vertex& edge : wavefront_begin->edges_) {
-      // Note that if dst has this generation, we short circuit the release
-      // manually, to prevent recursion.
-      //
-      // Note that this does not trip a GC, as only edge changes can do that.
-      // And release of this pointer simply releases a control, not its
-      // associated edge.
-      const intrusive_ptr<base_control> dst = edge.dst_.load();
-
-      // We don't need to lock dst->generation_, since it's this generation
-      // which is already protected.
-      // (When it isn't this generation, we don't process the edge.)
-      if (dst == nullptr || dst->generation_ != this)
-        continue;
-
-      // dst color meaning:
-      // 1. white -- already processed, skip reprocessing.
-      // 2. grey -- either in the wavefront, or marked grey due to red-promotion
-      //    (must be moved into wavefront).
-      // 3. red -- zero reference count, outside wavefront, requires processing.
-      //
-      // Only red requires promotion to grey, the other colours remain as is.
-      //
-      // Note that the current node (*wavefront_begin) is already marked white,
-      // thus the handling of that won't mess up anything.
-      std::uintptr_t expect = make_refcounter(0, color::red);
-      do {
-        assert(get_color(expect) != color::black);
-      } while (get_color(expect) != color::white
-          && dst->store_refs_.compare_exchange_weak(
-              expect,
-              make_refcounter(get_refs(expect), color::grey),
-              std::memory_order_acq_rel,
-              std::memory_order_acquire));
-      if (get_color(expect) == color::white)
-        continue; // Skip already processed element.
-
-      // Ensure grey node is in wavefront.
-      // Yes, we may be moving a node already in the wavefront to a different
-      // position.
-      // Can't be helped, since we're operating outside red-promotion exclusion.
-      assert(get_color(expect) != color::black && get_color(expect) != color::white);
-      assert(wavefront_begin != controls_.iterator_to(*dst));
-
-      if (wavefront_end == controls_.iterator_to(*dst)) [[unlikely]] {
-        ++wavefront_end;
-      } else {
-        controls_.splice(wavefront_end, controls_, controls_.iterator_to(*dst));
-      }
-    }
+    wavefront_begin->for_each_edge_(
+        [this, &wavefront_begin, &wavefront_end](hazard_ptr<base_control>& edge_dst) {
+          // Note that if dst has this generation, we short circuit the release
+          // manually, to prevent recursion.
+          //
+          // Note that this does not trip a GC, as only edge changes can do that.
+          // And release of this pointer simply releases a control, not its
+          // associated edge.
+          const intrusive_ptr<base_control> dst = edge_dst.load();
+
+          // We don't need to lock dst->generation_, since it's this generation
+          // which is already protected.
+          // (When it isn't this generation, we don't process the edge.)
+          if (dst == nullptr || dst->generation_ != this)
+            return;
+
+          // dst color meaning:
+          // 1. white -- already processed, skip reprocessing.
+          // 2. grey -- either in the wavefront, or marked grey due to red-promotion
+          //    (must be moved into wavefront).
+          // 3. red -- zero reference count, outside wavefront, requires processing.
+          //
+          // Only red requires promotion to grey, the other colours remain as is.
+          //
+          // Note that the current node (*wavefront_begin) is already marked white,
+          // thus the handling of that won't mess up anything.
+          std::uintptr_t expect = make_refcounter(0, color::red);
+          do {
+            assert(get_color(expect) != color::black);
+          } while (get_color(expect) != color::white
+              && dst->store_refs_.compare_exchange_weak(
+                  expect,
+                  make_refcounter(get_refs(expect), color::grey),
+                  std::memory_order_acq_rel,
+                  std::memory_order_acquire));
+          if (get_color(expect) == color::white)
+            return; // Skip already processed element.
+
+          // Ensure grey node is in wavefront.
+          // Yes, we may be moving a node already in the wavefront to a different
+          // position.
+          // Can't be helped, since we're operating outside red-promotion exclusion.
+          assert(get_color(expect) != color::black && get_color(expect) != color::white);
+          assert(wavefront_begin != controls_.iterator_to(*dst));
+
+          if (wavefront_end == controls_.iterator_to(*dst)) [[unlikely]] {
+            ++wavefront_end;
+          } else {
+            controls_.splice(wavefront_end, controls_, controls_.iterator_to(*dst));
+          }
+        });
 
     ++wavefront_begin;
   }
@@ -3500,12 +5339,12 @@ noexcept
   return wavefront_begin;
 }
 
-inline auto generation::gc_phase2_sweep_(controls_list::iterator wavefront_end)
+inline auto generation::gc_phase2_sweep_(
+    controls_list::iterator wavefront_begin,
+    controls_list::iterator wavefront_end)
 noexcept
 -> controls_list::iterator {
-  for (controls_list::iterator wavefront_begin = controls_.begin();
-      wavefront_begin != wavefront_end;
-      ++wavefront_begin) {
+  for (; wavefront_begin != wavefront_end; ++wavefront_begin) {
     base_control& bc = *wavefront_begin;
 
     // Change bc colour to white.
@@ -3525,34 +5364,35 @@ noexcept
 
     // Process edges.
     std::lock_guard<std::mutex> bc_lck{ bc.mtx_ };
-    for (const vertex& v : bc.edges_) {
-      intrusive_ptr<base_control> dst = v.dst_.get();
-      if (dst == nullptr || dst->generation_ != this)
-        continue; // Skip edges outside this generation.
-
-      expect = make_refcounter(0, color::red);
-      while (get_color(expect) == color::red) {
-        if (dst->store_refs_.compare_exchange_weak(
-                expect,
-                make_refcounter(get_refs(expect), color::grey),
-                std::memory_order_relaxed,
-                std::memory_order_relaxed))
-          break;
-      }
-      if (get_color(expect) != color::red) [[likely]] {
-        continue; // Already processed or already in wavefront.
-      }
+    bc.for_each_edge_(
+        [&](hazard_ptr<base_control>& edge_dst) {
+          intrusive_ptr<base_control> dst = edge_dst.get();
+          if (dst == nullptr || dst->generation_ != this)
+            return; // Skip edges outside this generation.
+
+          expect = make_refcounter(0, color::red);
+          while (get_color(expect) == color::red) {
+            if (dst->store_refs_.compare_exchange_weak(
+                    expect,
+                    make_refcounter(get_refs(expect), color::grey),
+                    std::memory_order_relaxed,
+                    std::memory_order_relaxed))
+              break;
+          }
+          if (get_color(expect) != color::red) [[likely]] {
+            return; // Already processed or already in wavefront.
+          }
 
-      assert(dst != &bc);
-      assert(wavefront_end != controls_.end());
-      assert(wavefront_begin != controls_.iterator_to(*dst));
+          assert(dst != &bc);
+          assert(wavefront_end != controls_.end());
+          assert(wavefront_begin != controls_.iterator_to(*dst));
 
-      if (wavefront_end == controls_.iterator_to(*dst)) [[unlikely]] {
-        ++wavefront_end;
-      } else {
-        controls_.splice(wavefront_end, controls_, controls_.iterator_to(*dst));
-      }
-    }
+          if (wavefront_end == controls_.iterator_to(*dst)) [[unlikely]] {
+            ++wavefront_end;
+          } else {
+            controls_.splice(wavefront_end, controls_, controls_.iterator_to(*dst));
+          }
+        });
   }
 
   return wavefront_end;
@@ -3585,26 +5425,30 @@ noexcept
   // Cascade merge operation into edges.
   for (base_control& bc : src->controls_) {
     std::lock_guard<std::mutex> edge_lck{ bc.mtx_ };
-    for (const vertex& edge : bc.edges_) {
-      // Move edge.
-      // We have to restart this, as other threads may change pointers
-      // from under us.
-      for (auto edge_dst = edge.dst_.load();
-          (edge_dst != nullptr
-           && edge_dst->generation_ != src
-           && edge_dst->generation_ != dst);
-          edge_dst = edge.dst_.load()) {
-        // Generation check: we only merge if invariant would
-        // break after move of ``bc`` into ``dst``.
-        const auto edge_dst_gen = edge_dst->generation_.load();
-        if (order_invariant(*dst, *edge_dst_gen)) break;
-
-        // Recursion.
-        dst_tpl = merge_(
-            std::make_tuple(edge_dst_gen, false),
-            std::move(dst_tpl));
-      }
-    }
+    bc.for_each_edge_(
+        [&](hazard_ptr<base_control>& edge) {
+          // Move edge.
+          // We have to restart this, as other threads may change pointers
+          // from under us.
+          for (auto edge_dst = edge.load();
+              (edge_dst != nullptr
+               && edge_dst->generation_ != src
+               && edge_dst->generation_ != dst);
+              edge_dst = edge.load()) {
+            // Generation check: we only merge if invariant would
+            // break after move of ``bc`` into ``dst``.
+            // Edges to immortal objects don't participate in ordering.
+            if (edge_dst->immortal()) break;
+
+            const auto edge_dst_gen = edge_dst->generation_.load();
+            if (order_invariant(*dst, *edge_dst_gen)) break;
+
+            // Recursion.
+            dst_tpl = merge_(
+                std::make_tuple(edge_dst_gen, false),
+                std::move(dst_tpl));
+          }
+        });
   }
 
   // All edges have been moved into or past dst,
@@ -3670,21 +5514,30 @@ noexcept
   assert(x_mtx_lck.owns_lock() && x_mtx_lck.mutex() == &src->mtx_);
   std::lock_guard<std::shared_mutex> dst_lck{ dst->mtx_ };
 
+#ifdef CYCLE_PTR_STATS
+  statistics_counters::add(&statistics_counters::merges);
+  statistics_counters::add(
+      &statistics_counters::merged_objects,
+      static_cast<std::uint64_t>(std::distance(src->controls_.begin(), src->controls_.end())));
+#endif
+
   // Stage 1: Update edge reference counters.
   for (base_control& bc : src->controls_) {
     std::lock_guard<std::mutex> edge_lck{ bc.mtx_ };
-    for (const vertex& edge : bc.edges_) {
-      const auto edge_dst = edge.dst_.get();
-      assert(edge_dst == nullptr
-          || edge_dst->generation_ == src
-          || edge_dst->generation_ == dst
-          || order_invariant(*dst, *edge_dst->generation_.load()));
-
-      // Update reference counters.
-      // (This predicate is why stage 2 must happen after stage 1.)
-      if (edge_dst != nullptr && edge_dst->generation_ == dst)
-        edge_dst->release(true);
-    }
+    bc.for_each_edge_(
+        [&](hazard_ptr<base_control>& edge) {
+          const auto edge_dst = edge.get();
+          assert(edge_dst == nullptr
+              || edge_dst->generation_ == src
+              || edge_dst->generation_ == dst
+              || edge_dst->immortal()
+              || order_invariant(*dst, *edge_dst->generation_.load()));
+
+          // Update reference counters.
+          // (This predicate is why stage 2 must happen after stage 1.)
+          if (edge_dst != nullptr && edge_dst->generation_ == dst)
+            edge_dst->release(true);
+        });
   }
   // Stage 2: switch generation pointers.
   // Note that we can't combine stage 1 and stage 2,
@@ -3742,28 +5595,43 @@ inline vertex::~vertex() noexcept {
     reset();
   }
 
-  assert(this->link<vertex>::linked());
   bc_->erase(*this);
 }
 
 inline auto vertex::reset()
 noexcept
 -> void {
-  if (owner_is_expired()) return; // Reset is a noop when expired.
-  if (dst_ == nullptr) return;
+  clear_edge_(*bc_, dst_);
+}
+
+inline auto vertex::reset(
+    intrusive_ptr<base_control> new_dst,
+    bool has_reference,
+    bool no_red_promotion)
+noexcept
+-> void {
+  reset_edge_(*bc_, dst_, std::move(new_dst), has_reference, no_red_promotion);
+}
+
+inline auto vertex::clear_edge_(base_control& src, hazard_ptr<base_control>& dst)
+noexcept
+-> void {
+  if (src.expired()) return; // Reset is a noop when expired.
+  if (dst == nullptr) return;
 
-  intrusive_ptr<generation> src_gen = bc_->generation_.load();
+  intrusive_ptr<generation> src_gen = src.generation_.load();
 
   // Lock src generation against merges.
   std::shared_lock<std::shared_mutex> src_merge_lck{ src_gen->merge_mtx_ };
-  while (src_gen != bc_->generation_) {
+  while (src_gen != src.generation_) {
     src_merge_lck.unlock();
-    src_gen = bc_->generation_.load();
+    src_gen = src.generation_.load();
     src_merge_lck = std::shared_lock<std::shared_mutex>{ src_gen->merge_mtx_ };
   }
 
   // Clear old dst and replace with nullptr.
-  const intrusive_ptr<base_control> old_dst = dst_.exchange(nullptr);
+  const intrusive_ptr<base_control> old_dst = dst.exchange(nullptr);
+  trace_edge_(src, &dst, old_dst.get(), nullptr);
   if (old_dst != nullptr) {
     if (old_dst->generation_ != src_gen) {
       old_dst->release();
@@ -3777,7 +5645,9 @@ noexcept
   }
 }
 
-inline auto vertex::reset(
+inline auto vertex::reset_edge_(
+    base_control& src,
+    hazard_ptr<base_control>& dst,
     intrusive_ptr<base_control> new_dst,
     bool has_reference,
     bool no_red_promotion)
@@ -3785,14 +5655,14 @@ noexcept
 -> void {
   assert(!has_reference || no_red_promotion);
 
-  if (owner_is_expired()) [[unlikely]] { // Reset is a noop when expired.
+  if (src.expired()) [[unlikely]] { // Reset is a noop when expired.
     // Clear reference if we hold one.
     if (new_dst != nullptr && has_reference) new_dst->release();
     return;
   }
 
-  // Need to special case this, because below we release ```dst_```.
-  if (dst_ == new_dst) {
+  // Need to special case this, because below we release ```dst```.
+  if (dst == new_dst) {
     if (new_dst != nullptr && has_reference) new_dst->release();
     return;
   }
@@ -3804,27 +5674,32 @@ noexcept
 
   // Source generation.
   // (May be updated below, but must have a lifetime that exceeds either lock.)
-  intrusive_ptr<generation> src_gen = bc_->generation_.load();
+  intrusive_ptr<generation> src_gen = src.generation_.load();
 
   // Lock src generation against merges.
   std::shared_lock<std::shared_mutex> src_merge_lck;
-  if (new_dst == nullptr) {
+  if (new_dst == nullptr || new_dst->immortal()) {
+    // Immortal objects are never collected, so edges pointing at them
+    // don't need to maintain the order invariant.
     src_merge_lck = std::shared_lock<std::shared_mutex>{ src_gen->merge_mtx_ };
-    while (src_gen != bc_->generation_) {
+    while (src_gen != src.generation_) {
       src_merge_lck.unlock();
-      src_gen = bc_->generation_.load();
+      src_gen = src.generation_.load();
       src_merge_lck = std::shared_lock<std::shared_mutex>{ src_gen->merge_mtx_ };
     }
   } else {
     // Maybe merge generations, if required to maintain order invariant.
-    src_merge_lck = generation::fix_ordering(*bc_, *new_dst);
-    src_gen = bc_->generation_.load(); // Update, since it may have changed.
+    src_merge_lck = generation::fix_ordering(src, *new_dst);
+    src_gen = src.generation_.load(); // Update, since it may have changed.
     assert(src_merge_lck.owns_lock());
     assert(src_merge_lck.mutex() == &src_gen->merge_mtx_);
+  }
 
+  if (new_dst != nullptr) {
     if (new_dst->generation_ != src_gen) {
       // Guaranteed by generation::fix_ordering call.
-      assert(generation::order_invariant(*src_gen, *new_dst->generation_.load()));
+      assert(new_dst->immortal()
+          || generation::order_invariant(*src_gen, *new_dst->generation_.load()));
 
       // Acquire reference counter.
       if (!has_reference) {
@@ -3843,10 +5718,11 @@ noexcept
   // If these fail, code above may have corrupted state already.
   assert(src_merge_lck.owns_lock()
       && src_merge_lck.mutex() == &src_gen->merge_mtx_);
-  assert(src_gen == bc_->generation_);
+  assert(src_gen == src.generation_);
 
   // Clear old dst and replace with new dst.
-  const intrusive_ptr<base_control> old_dst = dst_.exchange(new_dst);
+  const intrusive_ptr<base_control> old_dst = dst.exchange(new_dst);
+  trace_edge_(src, &dst, old_dst.get(), new_dst.get());
   bool drop_old_reference = false;
   bool gc_old_reference = false;
   if (old_dst != nullptr) {
@@ -3884,6 +5760,159 @@ noexcept
 }
 
 
+inline edge_base::~edge_base() noexcept {
+  if (owner_is_expired()) {
+    assert(dst_ == nullptr);
+  } else {
+    reset();
+  }
+}
+
+inline auto edge_base::reset()
+noexcept
+-> void {
+  if (owner_ != nullptr) {
+    vertex::clear_edge_(*owner_, dst_);
+    return;
+  }
+
+  const intrusive_ptr<base_control> old_dst = dst_.exchange(nullptr);
+  if (old_dst != nullptr) old_dst->release();
+}
+
+inline auto edge_base::reset(
+    intrusive_ptr<base_control> new_dst,
+    bool has_reference,
+    bool no_red_promotion)
+noexcept
+-> void {
+  assert(!has_reference || no_red_promotion);
+
+  if (owner_ != nullptr) {
+    vertex::reset_edge_(*owner_, dst_, std::move(new_dst), has_reference, no_red_promotion);
+    return;
+  }
+
+  // Not adopted: behave as a strong reference.
+  if (new_dst != nullptr && !has_reference) {
+    if (no_red_promotion)
+      new_dst->acquire_no_red();
+    else
+      new_dst->acquire();
+  }
+
+  const intrusive_ptr<base_control> old_dst = dst_.exchange(std::move(new_dst));
+  if (old_dst != nullptr) old_dst->release();
+}
+
+inline auto edge_base::owner_is_expired() const
+noexcept
+-> bool {
+  return owner_ != nullptr && owner_->expired();
+}
+
+inline auto edge_base::get_control() const
+noexcept
+-> intrusive_ptr<base_control> {
+  return dst_.load();
+}
+
+
+inline edge_set_base::edge_set_base()
+: edge_set_base(base_control::publisher_lookup(this, sizeof(*this)))
+{}
+
+inline edge_set_base::edge_set_base(intrusive_ptr<base_control> bc) noexcept
+: bc_(std::move(bc))
+{
+  assert(bc_ != nullptr);
+  bc_->push_back(*this);
+}
+
+inline edge_set_base::~edge_set_base() noexcept {
+  if (bc_->expired()) {
+    assert(std::all_of(dst_.begin(), dst_.end(),
+            [](const hazard_ptr<base_control>& dst) { return dst == nullptr; }));
+  } else {
+    for (hazard_ptr<base_control>& dst : dst_)
+      vertex::clear_edge_(*bc_, dst);
+  }
+
+  bc_->erase(*this);
+}
+
+inline auto edge_set_base::owner_is_expired() const
+noexcept
+-> bool {
+  return bc_->expired();
+}
+
+inline auto edge_set_base::reserve_(std::size_t n)
+-> void {
+  if (n <= dst_.capacity()) return;
+
+  std::lock_guard<std::mutex> lck{ bc_->mtx_ };
+  dst_.reserve(n); // May throw.
+}
+
+inline auto edge_set_base::grow_(std::size_t n)
+-> void {
+  std::lock_guard<std::mutex> lck{ bc_->mtx_ };
+  dst_.resize(dst_.size() + n); // May throw.
+}
+
+inline auto edge_set_base::reset_(std::size_t i)
+noexcept
+-> void {
+  assert(i < dst_.size());
+  vertex::clear_edge_(*bc_, dst_[i]);
+}
+
+inline auto edge_set_base::reset_(
+    std::size_t i,
+    intrusive_ptr<base_control> new_dst,
+    bool has_reference,
+    bool no_red_promotion)
+noexcept
+-> void {
+  assert(i < dst_.size());
+  vertex::reset_edge_(*bc_, dst_[i], std::move(new_dst), has_reference, no_red_promotion);
+}
+
+template<typename Keep, typename Move>
+auto edge_set_base::compact_(Keep&& keep, Move&& move)
+noexcept
+-> std::size_t {
+  std::lock_guard<std::mutex> lck{ bc_->mtx_ };
+
+  std::size_t out = 0;
+  for (std::size_t i = 0; i < dst_.size(); ++i) {
+    if (!keep(i)) {
+      assert(dst_[i] == nullptr);
+      continue;
+    }
+
+    // Moving the hazard pointer does not change the reference counter
+    // of the destination, so the edge remains accounted for.
+    if (out != i) {
+      dst_[out] = std::move(dst_[i]);
+      move(i, out);
+    }
+    ++out;
+  }
+
+  dst_.erase(dst_.begin() + out, dst_.end());
+  return out;
+}
+
+inline auto edge_set_base::get_control_(std::size_t i) const
+noexcept
+-> intrusive_ptr<base_control> {
+  assert(i < dst_.size());
+  return dst_[i].load();
+}
+
+
 } /* namespace cycle_ptr::detail */
 
 
@@ -3908,9 +5937,132 @@ template<typename> class cycle_member_ptr;
 template<typename> class cycle_gptr;
 template<typename> class cycle_weak_ptr;
 template<typename> class cycle_allocator;
+template<typename> class cycle_intrusive_gptr;
+template<typename> class cycle_intrusive_member_ptr;
+template<typename> class cycle_intrusive_weak_ptr;
 
 template<typename T, typename Alloc, typename... Args>
 auto allocate_cycle(Alloc alloc, Args&&... args) -> cycle_gptr<T>;
+template<typename T, typename Alloc, typename... Args>
+auto allocate_cycle_split(Alloc alloc, Args&&... args) -> cycle_gptr<T>;
+template<typename T>
+auto make_immortal(const cycle_gptr<T>& ptr) noexcept -> void;
+template<typename T>
+auto add_collect_hook(const cycle_gptr<T>& ptr, collect_hook& hook) noexcept -> void;
+#ifndef CYCLE_PTR_NO_WEAK
+template<typename ForwardIt, typename OutputIt>
+auto lock_all(ForwardIt b, ForwardIt e, OutputIt out) -> OutputIt;
+#endif
+
+/**
+ * \brief Hook that is invoked when an object is collected.
+ * \details
+ * Attach a hook to an object using \ref add_collect_hook.
+ * Once the GC finds the object unreachable, it invokes on_collect(),
+ * before destroying the object.
+ * At that point, weak pointers to the object are already expired.
+ *
+ * Each hook is invoked at most once, and is detached when invoked.
+ * Objects that are never collected (for example immortal objects)
+ * never invoke their hooks.
+ *
+ * This allows containers of weak pointers to find out which of their
+ * entries expired, without scanning all entries.
+ */
+class collect_hook {
+  friend class detail::base_control;
+
+  template<typename T>
+  friend auto add_collect_hook(const cycle_gptr<T>& ptr, collect_hook& hook) noexcept -> void;
+
+ public:
+  collect_hook() noexcept = default;
+  collect_hook(const collect_hook&) = delete;
+  auto operator=(const collect_hook&) -> collect_hook& = delete;
+
+  /**
+   * \brief Destructor.
+   * \details
+   * Detaches the hook.
+   * Derived classes should call remove() from their destructor,
+   * as on_collect() may be invoked until remove() returns.
+   */
+  virtual ~collect_hook() noexcept {
+    remove();
+  }
+
+  /**
+   * \brief Detach this hook from its object.
+   * \details
+   * If on_collect() is being invoked concurrently, waits for it to complete.
+   * Does nothing if the hook is not attached.
+   * \attention Must not be called from on_collect().
+   */
+  auto remove() noexcept -> void;
+
+ protected:
+  /**
+   * \brief Invoked by the GC, when the object is found unreachable.
+   * \details
+   * Invoked while the GC holds locks on the object.
+   * The function must not block, and must not access cycle pointers.
+   */
+  virtual auto on_collect() noexcept -> void = 0;
+
+ private:
+  ///\brief Control block of the object this hook is attached to.
+  detail::intrusive_ptr<detail::base_control> ctrl_;
+  ///\brief Next hook of the same object.
+  collect_hook* next_ = nullptr;
+};
+
+inline auto collect_hook::remove()
+noexcept
+-> void {
+  if (ctrl_ == nullptr) return;
+  ctrl_->remove_collect_hook(*this);
+  ctrl_.reset();
+}
+
+namespace detail {
+
+inline auto base_control::add_collect_hook(cycle_ptr::collect_hook& hook)
+noexcept
+-> void {
+  assert(hook.ctrl_ == nullptr);
+  hook.ctrl_ = intrusive_ptr<base_control>(this, true);
+
+  std::lock_guard<std::mutex> lck{ mtx_ };
+  assert(!expired());
+  hook.next_ = std::exchange(collect_hooks_, &hook);
+}
+
+inline auto base_control::remove_collect_hook(cycle_ptr::collect_hook& hook)
+noexcept
+-> void {
+  std::lock_guard<std::mutex> lck{ mtx_ };
+  for (cycle_ptr::collect_hook** i = &collect_hooks_; *i != nullptr; i = &(*i)->next_) {
+    if (*i == &hook) {
+      *i = std::exchange(hook.next_, nullptr);
+      return;
+    }
+  }
+}
+
+inline auto base_control::fire_collect_hooks_()
+noexcept
+-> void {
+  cycle_ptr::collect_hook* hook = std::exchange(collect_hooks_, nullptr);
+  while (hook != nullptr) {
+    // Hooks are detached before they are invoked,
+    // so remove() won't find them in the list.
+    cycle_ptr::collect_hook*const next = std::exchange(hook->next_, nullptr);
+    hook->on_collect();
+    hook = next;
+  }
+}
+
+} /* namespace cycle_ptr::detail */
 
 /**
  * \brief An optional base for classes which need to supply ownership to cycle_member_ptr.
@@ -3924,6 +6076,9 @@ auto allocate_cycle(Alloc alloc, Args&&... args) -> cycle_gptr<T>;
 class cycle_base {
   template<typename> friend class cycle_member_ptr;
   template<typename> friend class cycle_allocator;
+  template<typename> friend class cycle_intrusive_gptr;
+  template<typename> friend class cycle_intrusive_member_ptr;
+  template<typename> friend class cycle_intrusive_weak_ptr;
 
  protected:
   /**
@@ -4027,7 +6182,15 @@ class cycle_base {
       throw std::bad_weak_ptr();
 
     cycle_gptr<T> result;
+#ifndef CYCLE_PTR_NO_WEAK
     if (!control_->weak_acquire()) throw std::bad_weak_ptr();
+    detail::trace_(trace_op::weak_lock, control_.get());
+#else
+    // Invoking a member function implies this is reachable.
+    if (control_->expired()) throw std::bad_weak_ptr();
+    control_->acquire();
+    detail::trace_(trace_op::acquire, control_.get());
+#endif
     result.emplace_(this_ptr, control_);
     return result;
   }
@@ -4057,8 +6220,10 @@ class cycle_member_ptr
  public:
   ///\brief Element type of this pointer.
   using element_type = std::remove_extent_t<T>;
+#ifndef CYCLE_PTR_NO_WEAK
   ///\brief Weak pointer equivalent.
   using weak_type = cycle_weak_ptr<T>;
+#endif
 
   /**
    * \brief Create an unowned member pointer, representing a nullptr.
@@ -4372,6 +6537,7 @@ class cycle_member_ptr
     this->detail::vertex::reset(ptr.target_ctrl_, false, true);
   }
 
+#ifndef CYCLE_PTR_NO_WEAK
   /**
    * \brief Create an unowned member pointer, pointing at \p ptr.
    * \details
@@ -4412,6 +6578,7 @@ class cycle_member_ptr
   cycle_member_ptr(unowned_cycle_t unowned_tag, const cycle_weak_ptr<U>& ptr)
   : cycle_member_ptr(unowned_tag, cycle_gptr<U>(ptr))
   {}
+#endif
 
   /**
    * \brief Constructor with explicitly specified ownership.
@@ -4589,6 +6756,7 @@ class cycle_member_ptr
     this->detail::vertex::reset(ptr.target_ctrl_, false, true);
   }
 
+#ifndef CYCLE_PTR_NO_WEAK
   /**
    * \brief Constructor with explicitly specified ownership.
    *
@@ -4603,6 +6771,7 @@ class cycle_member_ptr
   cycle_member_ptr(cycle_base& owner, const cycle_weak_ptr<U>& ptr)
   : cycle_member_ptr(owner, cycle_gptr<U>(ptr))
   {}
+#endif
 
   /**
    * \brief Constructor with automatic ownership detection.
@@ -4871,6 +7040,7 @@ class cycle_member_ptr
     this->detail::vertex::reset(ptr.target_ctrl_, false, true);
   }
 
+#ifndef CYCLE_PTR_NO_WEAK
   /**
    * \brief Constructor with automatic ownership detection.
    * \details
@@ -4893,6 +7063,7 @@ class cycle_member_ptr
   explicit cycle_member_ptr(const cycle_weak_ptr<U>& ptr)
   : cycle_member_ptr(cycle_gptr<U>(ptr))
   {}
+#endif
 
   /**
    * \brief Assignment operator.
@@ -5125,6 +7296,7 @@ class cycle_member_ptr
     return get() != nullptr;
   }
 
+#ifndef CYCLE_PTR_NO_WEAK
   ///\brief Ownership ordering.
   template<typename U>
   auto owner_before(const cycle_weak_ptr<U>& other) const
@@ -5132,6 +7304,7 @@ class cycle_member_ptr
   -> bool {
     return get_control() < other.target_ctrl_;
   }
+#endif
 
   ///\brief Ownership ordering.
   template<typename U>
@@ -5168,18 +7341,34 @@ class cycle_member_ptr
 template<typename T>
 class cycle_gptr {
   template<typename> friend class cycle_member_ptr;
+  template<typename> friend class cycle_edge_ptr;
+  template<typename> friend class cycle_edge_set;
   template<typename> friend class cycle_gptr;
   template<typename> friend class cycle_weak_ptr;
+  template<typename> friend class cycle_intrusive_gptr;
+  template<typename> friend class detail::graph_builder;
   friend class cycle_base;
 
   template<typename Type, typename Alloc, typename... Args>
   friend auto cycle_ptr::allocate_cycle(Alloc alloc, Args&&... args) -> cycle_gptr<Type>;
+  template<typename Type, typename Alloc, typename... Args>
+  friend auto cycle_ptr::allocate_cycle_split(Alloc alloc, Args&&... args) -> cycle_gptr<Type>;
+  template<typename Type>
+  friend auto cycle_ptr::make_immortal(const cycle_gptr<Type>& ptr) noexcept -> void;
+  template<typename Type>
+  friend auto cycle_ptr::add_collect_hook(const cycle_gptr<Type>& ptr, collect_hook& hook) noexcept -> void;
+#ifndef CYCLE_PTR_NO_WEAK
+  template<typename ForwardIt, typename OutputIt>
+  friend auto cycle_ptr::lock_all(ForwardIt b, ForwardIt e, OutputIt out) -> OutputIt;
+#endif
 
  public:
   ///\copydoc cycle_member_ptr::element_type
   using element_type = std::remove_extent_t<T>;
+#ifndef CYCLE_PTR_NO_WEAK
   ///\copydoc cycle_member_ptr::weak_type
   using weak_type = cycle_weak_ptr<T>;
+#endif
 
   ///\brief Default constructor.
   ///\post *this == nullptr
@@ -5201,6 +7390,7 @@ class cycle_gptr {
     target_ctrl_(other.target_ctrl_)
   {
     if (target_ctrl_ != nullptr) target_ctrl_->acquire_no_red();
+    detail::trace_(trace_op::acquire, target_ctrl_.get());
   }
 
   /**
@@ -5227,6 +7417,7 @@ class cycle_gptr {
     target_ctrl_(other.target_ctrl_)
   {
     if (target_ctrl_ != nullptr) target_ctrl_->acquire_no_red();
+    detail::trace_(trace_op::acquire, target_ctrl_.get());
   }
 
   /**
@@ -5260,6 +7451,7 @@ class cycle_gptr {
       target_ctrl_.reset();
     } else if (target_ctrl_ != nullptr) {
       target_ctrl_->acquire();
+      detail::trace_(trace_op::acquire, target_ctrl_.get());
     }
   }
 
@@ -5280,6 +7472,25 @@ class cycle_gptr {
     other.reset();
   }
 
+  /**
+   * \brief Copy constructor.
+   * \post
+   * *this == other
+   */
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  cycle_gptr(const cycle_edge_ptr<U>& other)
+  : target_(other.target_),
+    target_ctrl_(other.get_control())
+  {
+    if (other.owner_is_expired()) {
+      target_ = nullptr;
+      target_ctrl_.reset();
+    } else if (target_ctrl_ != nullptr) {
+      target_ctrl_->acquire();
+      detail::trace_(trace_op::acquire, target_ctrl_.get());
+    }
+  }
+
   /**
    * \brief Aliasing constructor.
    * \post
@@ -5294,6 +7505,7 @@ class cycle_gptr {
     target_ctrl_(other.target_ctrl_)
   {
     if (target_ctrl_ != nullptr) target_ctrl_->acquire_no_red();
+    detail::trace_(trace_op::acquire, target_ctrl_.get());
   }
 
   /**
@@ -5314,11 +7526,13 @@ class cycle_gptr {
     if (other.owner_is_expired()) {
       target_ = nullptr;
       target_ctrl_.reset();
-    } else {
-      if (target_ctrl_ != nullptr) target_ctrl_->acquire();
+    } else if (target_ctrl_ != nullptr) {
+      target_ctrl_->acquire();
+      detail::trace_(trace_op::acquire, target_ctrl_.get());
     }
   }
 
+#ifndef CYCLE_PTR_NO_WEAK
   /**
    * \brief Construct from cycle_weak_ptr.
    * \post
@@ -5331,9 +7545,14 @@ class cycle_gptr {
   : target_(other.target_),
     target_ctrl_(other.target_ctrl_)
   {
-    if (target_ctrl_ == nullptr || !target_ctrl_->weak_acquire())
+    if (target_ctrl_ == nullptr) throw std::bad_weak_ptr();
+    if (!target_ctrl_->weak_acquire()) {
+      detail::trace_(trace_op::weak_lock_failed, target_ctrl_.get());
       throw std::bad_weak_ptr();
+    }
+    detail::trace_(trace_op::weak_lock, target_ctrl_.get());
   }
+#endif
 
   /**
    * \brief Copy assignment.
@@ -5345,9 +7564,11 @@ class cycle_gptr {
   -> cycle_gptr& {
     detail::intrusive_ptr<detail::base_control> bc = other.target_ctrl_;
     if (bc != nullptr) bc->acquire_no_red();
+    detail::trace_(trace_op::acquire, bc.get());
 
     target_ = other.target_;
     bc.swap(target_ctrl_);
+    detail::trace_(trace_op::drop, bc.get());
     if (bc != nullptr) bc->release(bc == target_ctrl_);
 
     return *this;
@@ -5368,6 +7589,7 @@ class cycle_gptr {
 
     target_ = std::exchange(other.target_, nullptr);
     bc.swap(target_ctrl_);
+    detail::trace_(trace_op::drop, bc.get());
     if (bc != nullptr) bc->release(bc == target_ctrl_);
 
     return *this;
@@ -5384,9 +7606,11 @@ class cycle_gptr {
   -> cycle_gptr& {
     detail::intrusive_ptr<detail::base_control> bc = other.target_ctrl_;
     if (bc != nullptr) bc->acquire_no_red();
+    detail::trace_(trace_op::acquire, bc.get());
 
     target_ = other.target_;
     bc.swap(target_ctrl_);
+    detail::trace_(trace_op::drop, bc.get());
     if (bc != nullptr) bc->release(bc == target_ctrl_);
 
     return *this;
@@ -5408,6 +7632,7 @@ class cycle_gptr {
 
     target_ = std::exchange(other.target_, nullptr);
     bc.swap(target_ctrl_);
+    detail::trace_(trace_op::drop, bc.get());
     if (bc != nullptr) bc->release(bc == target_ctrl_);
 
     return *this;
@@ -5428,9 +7653,11 @@ class cycle_gptr {
     } else {
       detail::intrusive_ptr<detail::base_control> bc = other.get_control();
       if (bc != nullptr) bc->acquire();
+      detail::trace_(trace_op::acquire, bc.get());
 
       target_ = other.target_;
       bc.swap(target_ctrl_);
+      detail::trace_(trace_op::drop, bc.get());
       if (bc != nullptr) bc->release(bc == target_ctrl_);
     }
 
@@ -5456,8 +7683,10 @@ class cycle_gptr {
   }
 
   ~cycle_gptr() noexcept {
-    if (target_ctrl_ != nullptr)
+    if (target_ctrl_ != nullptr) {
+      detail::trace_(trace_op::drop, target_ctrl_.get());
       target_ctrl_->release();
+    }
   }
 
   /**
@@ -5470,6 +7699,7 @@ class cycle_gptr {
   -> void {
     if (target_ctrl_ != nullptr) {
       target_ = nullptr;
+      detail::trace_(trace_op::drop, target_ctrl_.get());
       target_ctrl_->release();
       target_ctrl_.reset();
     }
@@ -5544,13 +7774,37 @@ class cycle_gptr {
     return get() != nullptr;
   }
 
-  ///\copydoc cycle_member_ptr::owner_before
-  template<typename U>
-  auto owner_before(const cycle_weak_ptr<U>& other) const
-  noexcept
+  /**
+   * \brief Test if this is the only pointer keeping its object alive.
+   * \details
+   * Unlike ``std::shared_ptr::use_count``, reference counters alone
+   * can't answer this, since pointers in objects of the same generation
+   * don't hold a reference.
+   * Those are found by scanning the generation, so this is linear in the
+   * size of the generation, unless another reference exists.
+   *
+   * The test is conservative: it may report false for an object that is
+   * not shared, but never reports true for a shared one.
+   * Weak pointers are not considered and may still be promoted.
+   *
+   * \returns True if no other cycle_gptr or cycle_member_ptr points at the object.
+   * False if ``*this == nullptr``.
+   */
+  auto is_unique() const
+  noexcept
+  -> bool {
+    return target_ctrl_ != nullptr && target_ctrl_->is_unique();
+  }
+
+#ifndef CYCLE_PTR_NO_WEAK
+  ///\copydoc cycle_member_ptr::owner_before
+  template<typename U>
+  auto owner_before(const cycle_weak_ptr<U>& other) const
+  noexcept
   -> bool {
     return target_ctrl_ < other.target_ctrl_;
   }
+#endif
 
   ///\copydoc cycle_member_ptr::owner_before
   template<typename U>
@@ -5606,6 +7860,7 @@ class cycle_gptr {
 };
 
 
+#ifndef CYCLE_PTR_NO_WEAK
 /**
  * \brief Weak cycle pointer.
  * \details
@@ -5619,6 +7874,9 @@ class cycle_weak_ptr {
   template<typename> friend class cycle_gptr;
   template<typename> friend class cycle_weak_ptr;
 
+  template<typename ForwardIt, typename OutputIt>
+  friend auto cycle_ptr::lock_all(ForwardIt b, ForwardIt e, OutputIt out) -> OutputIt;
+
  public:
   ///\copydoc cycle_member_ptr::element_type
   using element_type = std::remove_extent_t<T>;
@@ -5770,8 +8028,13 @@ class cycle_weak_ptr {
   noexcept
   -> cycle_gptr<T> {
     cycle_gptr<T> result;
-    if (target_ctrl_ != nullptr && target_ctrl_->weak_acquire())
+    if (target_ctrl_ == nullptr) return result;
+    if (target_ctrl_->weak_acquire()) {
+      detail::trace_(trace_op::weak_lock, target_ctrl_.get());
       result.emplace_(target_, target_ctrl_);
+    } else {
+      detail::trace_(trace_op::weak_lock_failed, target_ctrl_.get());
+    }
     return result;
   }
 
@@ -5805,6 +8068,7 @@ class cycle_weak_ptr {
   ///\brief Control block of this weak pointer.
   detail::intrusive_ptr<detail::base_control> target_ctrl_ = nullptr;
 };
+#endif
 
 
 ///\brief Equality comparison.
@@ -6171,6 +8435,7 @@ noexcept
 }
 
 
+#ifndef CYCLE_PTR_NO_WEAK
 ///\brief Swap two pointers.
 ///\relates cycle_weak_ptr
 template<typename T>
@@ -6180,6 +8445,43 @@ noexcept
   x.swap(y);
 }
 
+/**
+ * \brief Lock multiple weak pointers at once.
+ * \relates cycle_weak_ptr
+ * \details
+ * Equivalent to invoking \ref cycle_weak_ptr::lock on each weak pointer
+ * in the range, but cheaper when locking many pointers that require
+ * red promotion: such pointers are grouped by generation,
+ * and the promotion is announced to each generation only once.
+ *
+ * \param b,e Range of \ref cycle_weak_ptr to lock.
+ * \param out Output iterator receiving a \ref cycle_gptr for each element
+ * in the range, in order. Expired elements yield a nullptr.
+ * \returns Output iterator past the last written element.
+ * \throws std::bad_alloc if temporary storage can't be allocated.
+ */
+template<typename ForwardIt, typename OutputIt>
+inline auto lock_all(ForwardIt b, ForwardIt e, OutputIt out)
+-> OutputIt {
+  using weak_type = typename std::iterator_traits<ForwardIt>::value_type;
+  using gptr_type = decltype(std::declval<const weak_type&>().lock());
+
+  std::vector<detail::base_control*> ctrls;
+  for (ForwardIt i = b; i != e; ++i) ctrls.push_back(i->target_ctrl_.get());
+
+  std::vector<gptr_type> result(ctrls.size());
+  const auto acquired = std::make_unique<bool[]>(ctrls.size());
+  detail::base_control::weak_acquire_all(ctrls.data(), ctrls.size(), acquired.get());
+
+  std::size_t idx = 0;
+  for (ForwardIt i = b; i != e; ++i, ++idx) {
+    detail::trace_(acquired[idx] ? trace_op::weak_lock : trace_op::weak_lock_failed, ctrls[idx]);
+    if (acquired[idx]) result[idx].emplace_(i->target_, i->target_ctrl_);
+  }
+  return std::move(result.begin(), result.end(), out);
+}
+#endif
+
 
 ///\brief Equality comparison.
 ///\relates cycle_gptr
@@ -6302,6 +8604,50 @@ noexcept
 }
 
 
+namespace detail {
+
+
+/**
+ * \brief Allocate a control block and instantiate \p T in it.
+ * \tparam T The type of object to instantiate.
+ * \param alloc The allocator to use for allocating the control block.
+ * \param gen The generation of the control block,
+ * or nullptr to create a new generation.
+ * \param args The arguments passed to the constructor of type \p T.
+ * \returns The new instance of \p T, and a reference to its control block.
+ * The reference counter of the instance is 1.
+ * \throws std::bad_alloc if allocating a generation fails.
+ */
+template<typename T, typename Alloc, typename... Args>
+auto allocate_control(Alloc alloc, intrusive_ptr<generation> gen, Args&&... args)
+-> std::tuple<T*, intrusive_ptr<base_control>> {
+  using alloc_t = typename std::allocator_traits<Alloc>::template rebind_alloc<T>;
+  using control_t = control<T, alloc_t>;
+  using alloc_traits = typename std::allocator_traits<Alloc>::template rebind_traits<control_t>;
+  using ctrl_alloc_t = typename std::allocator_traits<Alloc>::template rebind_alloc<control_t>;
+
+  ctrl_alloc_t ctrl_alloc = alloc;
+
+  control_t* raw_ctrl_ptr = alloc_traits::allocate(ctrl_alloc, 1);
+  try {
+    if (gen == nullptr)
+      alloc_traits::construct(ctrl_alloc, raw_ctrl_ptr, ctrl_alloc);
+    else
+      alloc_traits::construct(ctrl_alloc, raw_ctrl_ptr, ctrl_alloc, std::move(gen));
+  } catch (...) {
+    alloc_traits::deallocate(ctrl_alloc, raw_ctrl_ptr, 1);
+    throw;
+  }
+  auto ctrl_ptr = intrusive_ptr<base_control>(raw_ctrl_ptr, false);
+  trace_(trace_op::make, raw_ctrl_ptr);
+  T* elem_ptr = raw_ctrl_ptr->instantiate(std::forward<Args>(args)...);
+  return { elem_ptr, std::move(ctrl_ptr) };
+}
+
+
+} /* namespace cycle_ptr::detail */
+
+
 /**
  * \brief Allocate a new instance of \p T, using the specificied allocator.
  * \relates cycle_base
@@ -6315,9 +8661,55 @@ noexcept
  */
 template<typename T, typename Alloc, typename... Args>
 inline auto allocate_cycle(Alloc alloc, Args&&... args)
+-> cycle_gptr<T> {
+  auto [elem_ptr, ctrl_ptr] = detail::allocate_control<T>(std::move(alloc), nullptr, std::forward<Args>(args)...);
+
+  cycle_gptr<T> result;
+  result.emplace_(elem_ptr, std::move(ctrl_ptr));
+  return result;
+}
+
+/**
+ * \brief Allocate a new instance of \p T, using the default allocator.
+ * \relates cycle_base
+ * \details
+ * Ensures the type \p T is instantiated correctly, with its control block.
+ *
+ * Equivalent to calling ``allocate_cycle<T>(std::allocator<T>(), args...)``.
+ * \tparam T The type of object to instantiate.
+ * \param args The arguments passed to the constructor of type \p T.
+ * \returns A cycle_gptr to the new instance of \p T.
+ * \throws std::bad_alloc if allocating a generation fails.
+ */
+template<typename T, typename... Args>
+inline auto make_cycle(Args&&... args)
+-> cycle_gptr<T> {
+  return allocate_cycle<T>(std::allocator<T>(), std::forward<Args>(args)...);
+}
+
+/**
+ * \brief Allocate a new instance of \p T, using the specificied allocator.
+ * \relates cycle_base
+ * \details
+ * Like \ref allocate_cycle, except that \p T is allocated separately from
+ * its control block.
+ *
+ * Memory used by \p T is released as soon as the instance is collected,
+ * whereas with \ref allocate_cycle it is held until the last
+ * \ref cycle_weak_ptr referencing it goes away.
+ * Use this for large objects that are referenced by long-lived weak pointers.
+ * \tparam T The type of object to instantiate.
+ * \param alloc The allocator to use for allocating the control block
+ * and the instance of \p T.
+ * \param args The arguments passed to the constructor of type \p T.
+ * \returns A cycle_gptr to the new instance of \p T.
+ * \throws std::bad_alloc if allocating a generation fails.
+ */
+template<typename T, typename Alloc, typename... Args>
+inline auto allocate_cycle_split(Alloc alloc, Args&&... args)
 -> cycle_gptr<T> {
   using alloc_t = typename std::allocator_traits<Alloc>::template rebind_alloc<T>;
-  using control_t = detail::control<T, alloc_t>;
+  using control_t = detail::split_control<T, alloc_t>;
   using alloc_traits = typename std::allocator_traits<Alloc>::template rebind_traits<control_t>;
   using ctrl_alloc_t = typename std::allocator_traits<Alloc>::template rebind_alloc<control_t>;
 
@@ -6331,6 +8723,7 @@ inline auto allocate_cycle(Alloc alloc, Args&&... args)
     throw;
   }
   auto ctrl_ptr = detail::intrusive_ptr<detail::base_control>(raw_ctrl_ptr, false);
+  detail::trace_(trace_op::make, raw_ctrl_ptr);
   T* elem_ptr = raw_ctrl_ptr->instantiate(std::forward<Args>(args)...);
 
   cycle_gptr<T> result;
@@ -6342,157 +8735,2043 @@ inline auto allocate_cycle(Alloc alloc, Args&&... args)
  * \brief Allocate a new instance of \p T, using the default allocator.
  * \relates cycle_base
  * \details
- * Ensures the type \p T is instantiated correctly, with its control block.
+ * Like \ref make_cycle, except that \p T is allocated separately from
+ * its control block.
  *
- * Equivalent to calling ``allocate_cycle<T>(std::allocator<T>(), args...)``.
+ * Equivalent to calling ``allocate_cycle_split<T>(std::allocator<T>(), args...)``.
  * \tparam T The type of object to instantiate.
  * \param args The arguments passed to the constructor of type \p T.
  * \returns A cycle_gptr to the new instance of \p T.
  * \throws std::bad_alloc if allocating a generation fails.
+ * \sa allocate_cycle_split
  */
 template<typename T, typename... Args>
-inline auto make_cycle(Args&&... args)
+inline auto make_cycle_split(Args&&... args)
 -> cycle_gptr<T> {
-  return allocate_cycle<T>(std::allocator<T>(), std::forward<Args>(args)...);
+  return allocate_cycle_split<T>(std::allocator<T>(), std::forward<Args>(args)...);
 }
 
-
-///\brief Write pointer to output stream.
-///\relates cycle_member_ptr
-template<typename Char, typename Traits, typename T>
-inline auto operator<<(std::basic_ostream<Char, Traits>& out, const cycle_member_ptr<T>& ptr)
--> std::basic_ostream<Char, Traits>& {
-  return out << ptr.get();
+/**
+ * \brief Mark the object pointed at by \p ptr as immortal.
+ * \relates cycle_gptr
+ * \details
+ * An immortal object is never collected.
+ * Copying and dropping pointers to it does not modify its reference counters,
+ * so hot shared objects (registries, interned singletons, configuration roots)
+ * don't suffer contention on their reference counter.
+ *
+ * Edges pointing at immortal objects don't cause generations to be merged.
+ * Objects reachable from the immortal object are kept alive indefinitely,
+ * unless the edges pointing at them are cleared.
+ *
+ * The object and its control block are leaked at program termination.
+ * \param ptr Pointer to the object. If ptr is nullptr, this function is a no-op.
+ * \attention Aliased pointers mark the object owning the aliased member as immortal.
+ */
+template<typename T>
+inline auto make_immortal(const cycle_gptr<T>& ptr)
+noexcept
+-> void {
+  if (ptr.target_ctrl_ != nullptr) ptr.target_ctrl_->make_immortal();
 }
 
-///\brief Write pointer to output stream.
-///\relates cycle_gptr
-template<typename Char, typename Traits, typename T>
-inline auto operator<<(std::basic_ostream<Char, Traits>& out, const cycle_gptr<T>& ptr)
--> std::basic_ostream<Char, Traits>& {
-  return out << ptr.get();
+/**
+ * \brief Attach \p hook to the object pointed at by \p ptr.
+ * \relates collect_hook
+ * \details
+ * The hook is invoked once the GC finds the object unreachable.
+ * \param ptr Pointer to the object. If ptr is nullptr, this function is a no-op.
+ * \param hook The hook to attach.
+ * \pre \p hook is not attached to any object.
+ * \attention Aliased pointers attach the hook to the object owning the aliased member.
+ */
+template<typename T>
+inline auto add_collect_hook(const cycle_gptr<T>& ptr, collect_hook& hook)
+noexcept
+-> void {
+  if (ptr.target_ctrl_ != nullptr) ptr.target_ctrl_->add_collect_hook(hook);
 }
 
-
 /**
- * \brief Adaptor for collections with member types.
- * \details Member types are owned by the owner supplied at allocator construction.
- * \tparam Nested Underlying allocator.
+ * \brief Allocate a new, immortal instance of \p T.
+ * \relates cycle_base
+ * \details
+ * Equivalent to calling \ref make_cycle, followed by \ref make_immortal.
+ * \tparam T The type of object to instantiate.
+ * \param args The arguments passed to the constructor of type \p T.
+ * \returns A cycle_gptr to the new instance of \p T.
+ * \throws std::bad_alloc if allocating a generation fails.
  */
-template<typename Nested>
-class cycle_allocator
-: public Nested
-{
-  template<typename> friend class cycle_allocator;
+template<typename T, typename... Args>
+inline auto make_cycle_immortal(Args&&... args)
+-> cycle_gptr<T> {
+  cycle_gptr<T> result = make_cycle<T>(std::forward<Args>(args)...);
+  make_immortal(result);
+  return result;
+}
 
- public:
-  ///\brief When copy-assigning, allocator is not copied over.
-  using propagate_on_container_copy_assignment = std::false_type;
-  ///\brief When move-assigning, allocator is not copied over.
-  using propagate_on_container_move_assignment = std::false_type;
-  ///\brief When performing swap, allocator is not swapped.
-  using propagate_on_container_swap = std::false_type;
-  ///\brief Must check for equality.
-  using is_always_equal = std::false_type;
 
-  ///\brief Template for changing controlled type of allocator.
-  template<typename T>
-  struct rebind {
-    ///\brief The type of this allocator, rebound to type \p T.
-    using other = cycle_allocator<typename std::allocator_traits<Nested>::template rebind_alloc<T>>;
-  };
+namespace detail {
 
-  ///\brief Copy constructor for distinct type.
-  template<typename Other>
-  cycle_allocator(const cycle_allocator<Other>& other)
-  noexcept(std::is_nothrow_constructible_v<Nested, const Other&>)
-  : Nested(other),
-    control_(other.control_)
-  {}
 
-  ///\brief Create allocator, with declared ownership.
-  ///\param base The owner of elements created using this allocator.
-  ///\param args Arguments to pass to underlying allocator constructor.
-  template<typename... Args, typename = std::enable_if_t<std::is_constructible_v<Nested, Args...>>>
-  explicit cycle_allocator(const cycle_base& base, Args&&... args)
-  : Nested(std::forward<Args>(args)...),
-    control_(base.control_)
+/**
+ * \brief Builds a graph of new objects in a single generation.
+ * \details
+ * Objects are numbered in order of creation.
+ * Edges between them are recorded, and assigned once all objects exist.
+ * Since all objects share the generation, assigning the edges never
+ * merges generations, nor maintains reference counters.
+ *
+ * Used by \ref cycle_ptr::clone_graph and the graph deserializer.
+ * \tparam T The type of object in the graph.
+ */
+template<typename T>
+class graph_builder {
+ public:
+  graph_builder()
+  : gen_(generation::new_generation())
   {}
 
-  ///\brief Create allocator, with elements having no ownership.
-  ///\param unowned_tag Tag indicating that elements created by this allocator do not have an owning object.
-  ///\param args Arguments to pass to underlying allocator constructor.
-  template<typename... Args, typename = std::enable_if_t<std::is_constructible_v<Nested, Args...>>>
-  explicit cycle_allocator(unowned_cycle_t unowned_tag [[maybe_unused]], Args&&... args)
-  : Nested(std::forward<Args>(args)...),
-    control_(detail::base_control::unowned_control())
-  {}
+  graph_builder(const graph_builder&) = delete;
+  auto operator=(const graph_builder&) -> graph_builder& = delete;
 
   /**
-   * \brief Constructor.
+   * \brief Allocate a new object in the generation of the graph.
    * \details
-   * Publishes the owner control block prior to construction,
-   * to allow for members to pick it up automatically.
-   * (After construction, the control block is unpublished.)
-   *
-   * Forwards to construct as implemented by \p Nested.
+   * The object is not numbered; use add() for that.
+   * \param args The arguments passed to the constructor of type \p T.
+   * \returns A cycle_gptr to the new instance of \p T.
    */
-  template<typename T, typename... Args>
-  auto construct(T* ptr, Args&&... args)
+  template<typename... Args>
+  auto make(Args&&... args)
+  -> cycle_gptr<T> {
+    auto [elem_ptr, ctrl_ptr] = allocate_control<T>(std::allocator<T>(), gen_, std::forward<Args>(args)...);
+
+    cycle_gptr<T> result;
+    result.emplace_(elem_ptr, std::move(ctrl_ptr));
+    return result;
+  }
+
+  ///\brief Number of objects in the graph.
+  auto size() const
+  noexcept
+  -> std::size_t {
+    return objects_.size();
+  }
+
+  ///\brief Add \p obj to the graph, as object number size().
+  auto add(cycle_gptr<T> obj)
   -> void {
-    detail::base_control::publisher pub{ ptr, sizeof(T), *control_ };
-    std::allocator_traits<Nested>::construct(*this, ptr, std::forward<Args>(args)...);
+    objects_.push_back(std::move(obj));
   }
 
-  /**
-   * \brief Fail to create copy of this allocator.
-   * \details
-   * Fails a static assert with a message asking you to please explicitly
-   * specify what ownership relation to use for copied container.
-   *
-   * \note
-   * Ideally, this would also be possible for move construction of a
-   * container, but there's no support for that in the C++ Standard Library.
-   */
-  template<typename Dummy = void>
-  auto select_on_container_copy_construction()
-  -> cycle_allocator {
-    static_assert(std::is_void_v<Dummy> && false,
-        "You must explicitly specify an allocator with owner during copy.");
-    return *this;
+  ///\brief Point \p dst at object number \p index, once all objects exist.
+  auto link(cycle_member_ptr<T>& dst, std::size_t index)
+  -> void {
+    links_.emplace_back(&dst, index);
   }
 
   /**
-   * \brief Compare allocators for equality.
+   * \brief Assign the recorded edges, and return object number 0.
    * \details
-   * Two allocators are equal if they use the same owner.
-   *
-   * (Distinct owners are treated as equal if they represent the unowned
-   * control block.)
+   * Drops the references to the other objects.
+   * Those are expected to be reachable from object 0,
+   * so their reference counters are dropped without running the GC
+   * for each; a single GC run then picks up any that aren't.
+   * \pre Each recorded edge refers to an existing object.
    */
-  auto operator==(const cycle_allocator& other) const
-  noexcept(
-      std::allocator_traits<Nested>::is_always_equal::value
-      || noexcept(std::declval<const Nested&>() == std::declval<const Nested&>()))
-  -> bool {
-    if constexpr(!std::allocator_traits<Nested>::is_always_equal::value) {
-      if (!std::equal_to<Nested>()(*this, other)) return false;
+  auto finish()
+  noexcept
+  -> cycle_gptr<T> {
+    for (const auto& [dst, index] : links_) {
+      assert(index < objects_.size());
+      *dst = objects_[index];
     }
-
-    return control_ == other.control_
-        || (control_->is_unowned() && other.control_->is_unowned());
-  }
-
-  ///\brief Inequality comparison.
-  auto operator!=(const cycle_allocator& other) const
-  noexcept(noexcept(std::declval<const cycle_allocator&>() == std::declval<const cycle_allocator&>()))
-  -> bool {
-    return !(*this == other);
+    links_.clear();
+
+    if (objects_.empty()) return nullptr;
+    cycle_gptr<T> root = objects_.front();
+    for (cycle_gptr<T>& obj : objects_) {
+      if (obj.target_ctrl_ == nullptr) continue;
+      obj.target_ = nullptr;
+      trace_(trace_op::drop, obj.target_ctrl_.get());
+      obj.target_ctrl_->release(true);
+      obj.target_ctrl_.reset();
+    }
+    objects_.clear();
+    root.target_ctrl_->gc();
+    return root;
   }
 
  private:
-  ///\brief Control block for ownership.
-  detail::intrusive_ptr<detail::base_control> control_;
+  ///\brief Generation holding the objects.
+  intrusive_ptr<generation> gen_;
+  ///\brief Objects, by number.
+  std::vector<cycle_gptr<T>> objects_;
+  ///\brief Edges to assign, once all objects exist.
+  std::vector<std::pair<cycle_member_ptr<T>*, std::size_t>> links_;
+};
+
+
+} /* namespace cycle_ptr::detail */
+
+
+/**
+ * \brief Context passed to the cloner of \ref clone_graph.
+ * \details
+ * The cloner creates the copy of an object using make(),
+ * and uses link() to point the edges of the copy at the copies of
+ * the originals.
+ * \tparam T The type of object in the graph.
+ */
+template<typename T>
+class clone_context {
+  template<typename U, typename Cloner>
+  friend auto clone_graph(const cycle_gptr<U>& root, Cloner&& cloner) -> cycle_gptr<U>;
+
+ public:
+  clone_context(const clone_context&) = delete;
+  auto operator=(const clone_context&) -> clone_context& = delete;
+
+  /**
+   * \brief Allocate a new object in the generation of the copied graph.
+   * \param args The arguments passed to the constructor of type \p T.
+   * \returns A cycle_gptr to the new instance of \p T.
+   */
+  template<typename... Args>
+  auto make(Args&&... args)
+  -> cycle_gptr<T> {
+    return builder_.make(std::forward<Args>(args)...);
+  }
+
+  /**
+   * \brief Point \p dst at the copy of the object \p original points at.
+   * \details
+   * If that object has not been copied yet, it is queued for copying.
+   * The assignment is performed once all objects have been copied.
+   * \param dst Edge in a copy.
+   * \param original Edge in the original object.
+   */
+  template<typename Ptr>
+  auto link(cycle_member_ptr<T>& dst, const Ptr& original)
+  -> void {
+    if (original == nullptr) {
+      dst = nullptr;
+      return;
+    }
+
+    builder_.link(dst, index_(original.get()));
+  }
+
+ private:
+  clone_context() = default;
+
+  ///\brief Number of \p original, queueing it for copying if it is new.
+  auto index_(const T* original)
+  -> std::size_t {
+    const auto [pos, added] = index_map_.emplace(original, pending_.size());
+    if (added) pending_.push_back(original);
+    return pos->second;
+  }
+
+  ///\brief Builder for the copies.
+  detail::graph_builder<T> builder_;
+  ///\brief Number of each original.
+  std::unordered_map<const T*, std::size_t> index_map_;
+  ///\brief Originals, by number.
+  ///\details Those at or after builder_.size() still have to be copied.
+  std::vector<const T*> pending_;
+};
+
+/**
+ * \brief Copy the graph of objects reachable from \p root.
+ * \relates clone_context
+ * \details
+ * The cloner is invoked once for each object reached, as
+ * ``cloner(const T& original, clone_context<T>& ctx)``,
+ * and returns a copy created with ``ctx.make(...)``.
+ * Edges of the copy that are passed to ``ctx.link()`` are followed,
+ * and end up pointing at the copies of their originals.
+ * Edges that aren't linked are not followed;
+ * the cloner may share or clear those.
+ *
+ * \code
+ * cycle_gptr<Node> copy = clone_graph(
+ *     root,
+ *     [](const Node& original, clone_context<Node>& ctx) {
+ *       cycle_gptr<Node> c = ctx.make(original.value);
+ *       ctx.link(c->next, original.next);
+ *       return c;
+ *     });
+ * \endcode
+ *
+ * All copies are allocated in a single new generation, instead of one
+ * generation per object.
+ * Edges are assigned after all copies exist, so linking them never
+ * has to merge generations, nor maintain reference counters.
+ *
+ * \pre No other thread modifies the original graph while it is copied.
+ * \param root The root of the graph to copy.
+ * \param cloner Functor creating the copy of a single object.
+ * \returns The copy of \p root, or nullptr if \p root is nullptr.
+ */
+template<typename T, typename Cloner>
+auto clone_graph(const cycle_gptr<T>& root, Cloner&& cloner)
+-> cycle_gptr<T> {
+  if (root == nullptr) return nullptr;
+
+  clone_context<T> ctx;
+  ctx.index_(root.get());
+  // Objects are copied in order of their number.
+  while (ctx.builder_.size() < ctx.pending_.size()) {
+    cycle_gptr<T> copy = std::invoke(cloner, *ctx.pending_[ctx.builder_.size()], ctx);
+    assert(copy != nullptr);
+    ctx.builder_.add(std::move(copy));
+  }
+  return ctx.builder_.finish();
+}
+
+
+///\brief Write pointer to output stream.
+///\relates cycle_member_ptr
+template<typename Char, typename Traits, typename T>
+inline auto operator<<(std::basic_ostream<Char, Traits>& out, const cycle_member_ptr<T>& ptr)
+-> std::basic_ostream<Char, Traits>& {
+  return out << ptr.get();
+}
+
+///\brief Write pointer to output stream.
+///\relates cycle_gptr
+template<typename Char, typename Traits, typename T>
+inline auto operator<<(std::basic_ostream<Char, Traits>& out, const cycle_gptr<T>& ptr)
+-> std::basic_ostream<Char, Traits>& {
+  return out << ptr.get();
+}
+
+
+/**
+ * \brief Statically declared edge between two objects.
+ * \details
+ * Like \ref cycle_member_ptr, this pointer models an edge from the object
+ * containing it, to the object it points at.
+ * However, it does not register itself with its owner during construction,
+ * making it cheaper to construct and destroy.
+ *
+ * Instead, its owner (or a base class of its owner) must declare it,
+ * by specializing \ref cycle_edges (for instance using \ref CYCLE_PTR_EDGES).
+ * After construction of the owning object completes, \ref make_cycle and
+ * \ref allocate_cycle hand the declared edges to the control block.
+ * The GC enumerates these edges using a table of offsets.
+ *
+ * A cycle_edge_ptr that is not declared by its owner, or whose owner is not
+ * managed by a cycle pointer, behaves like a \ref cycle_gptr:
+ * it holds a strong reference, and cycles through it will not be collected.
+ * \tparam T The type of object this pointer points at.
+ */
+template<typename T>
+class cycle_edge_ptr
+: private detail::edge_base
+{
+  template<typename> friend class cycle_edge_ptr;
+  template<typename> friend class cycle_gptr;
+  friend class detail::base_control;
+
+ public:
+  ///\brief Element type of this pointer.
+  using element_type = std::remove_extent_t<T>;
+
+  ///\brief Default constructor.
+  ///\post *this == nullptr
+  cycle_edge_ptr() noexcept = default;
+
+  ///\brief Nullptr constructor.
+  ///\post *this == nullptr
+  cycle_edge_ptr(std::nullptr_t nil [[maybe_unused]]) noexcept
+  : cycle_edge_ptr()
+  {}
+
+  /**
+   * \brief Copy constructor.
+   * \details
+   * The new pointer is not adopted, regardless of whether \p other is.
+   * \post
+   * *this == other
+   */
+  cycle_edge_ptr(const cycle_edge_ptr& other) noexcept
+  : cycle_edge_ptr()
+  {
+    *this = other;
+  }
+
+  /**
+   * \brief Copy constructor.
+   * \post
+   * *this == ptr
+   */
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  cycle_edge_ptr(const cycle_gptr<U>& ptr) noexcept
+  : cycle_edge_ptr()
+  {
+    *this = ptr;
+  }
+
+  /**
+   * \brief Move constructor.
+   * \post
+   * *this == original value of ptr
+   *
+   * \post
+   * ptr == nullptr
+   */
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  cycle_edge_ptr(cycle_gptr<U>&& ptr) noexcept
+  : cycle_edge_ptr()
+  {
+    *this = std::move(ptr);
+  }
+
+  /**
+   * \brief Assignment operator.
+   * \post
+   * *this == nullptr
+   */
+  auto operator=(std::nullptr_t nil [[maybe_unused]])
+  noexcept
+  -> cycle_edge_ptr& {
+    reset();
+    return *this;
+  }
+
+  /**
+   * \brief Copy assignment operator.
+   * \post
+   * *this == other
+   */
+  auto operator=(const cycle_edge_ptr& other)
+  noexcept
+  -> cycle_edge_ptr& {
+    return *this = cycle_gptr<T>(other);
+  }
+
+  /**
+   * \brief Copy assignment operator.
+   * \post
+   * *this == other
+   */
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  auto operator=(const cycle_edge_ptr<U>& other)
+  noexcept
+  -> cycle_edge_ptr& {
+    return *this = cycle_gptr<U>(other);
+  }
+
+  /**
+   * \brief Copy assignment operator.
+   * \post
+   * *this == other
+   */
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  auto operator=(const cycle_gptr<U>& other)
+  noexcept
+  -> cycle_edge_ptr& {
+    this->detail::edge_base::reset(other.target_ctrl_, false, true);
+    target_ = other.target_;
+    return *this;
+  }
+
+  /**
+   * \brief Move assignment operator.
+   * \post
+   * *this == original value of other
+   *
+   * \post
+   * other == nullptr
+   */
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  auto operator=(cycle_gptr<U>&& other)
+  noexcept
+  -> cycle_edge_ptr& {
+    this->detail::edge_base::reset(
+        std::move(other.target_ctrl_),
+        true, true);
+    target_ = std::exchange(other.target_, nullptr);
+    return *this;
+  }
+
+  /**
+   * \brief Clear this pointer.
+   * \post
+   * *this == nullptr
+   */
+  auto reset()
+  noexcept
+  -> void {
+    this->detail::edge_base::reset();
+    target_ = nullptr;
+  }
+
+  /**
+   * \brief Returns the raw pointer of this.
+   * \details Returns nullptr if the owner of this is expired.
+   */
+  auto get() const
+  noexcept
+  -> T* {
+    if (owner_is_expired()) [[unlikely]]
+      return nullptr;
+    return target_;
+  }
+
+  /**
+   * \brief Dereference operation.
+   * \details
+   * Only declared if \p T is not ``void``.
+   */
+  template<bool Enable = !std::is_void_v<T>>
+  auto operator*() const
+  noexcept
+  -> std::enable_if_t<Enable, T>& {
+    assert(get() != nullptr);
+    return *get();
+  }
+
+  /**
+   * \brief Indirection operation.
+   * \details
+   * Only declared if \p T is not ``void``.
+   */
+  template<bool Enable = !std::is_void_v<T>>
+  auto operator->() const
+  noexcept
+  -> std::enable_if_t<Enable, T>* {
+    assert(get() != nullptr);
+    return get();
+  }
+
+  /**
+   * \brief Test if this pointer points holds a non-nullptr value.
+   * \returns get() != nullptr
+   */
+  explicit operator bool() const
+  noexcept {
+    return get() != nullptr;
+  }
+
+  ///\brief Ownership ordering.
+  template<typename U>
+  auto owner_before(const cycle_gptr<U>& other) const
+  noexcept
+  -> bool {
+    return get_control() < other.target_ctrl_;
+  }
+
+  ///\brief Ownership ordering.
+  template<typename U>
+  auto owner_before(const cycle_edge_ptr<U>& other) const
+  noexcept
+  -> bool {
+    return get_control() < other.get_control();
+  }
+
+ private:
+  ///\brief Target object that this points at.
+  T* target_ = nullptr;
+};
+
+///\brief Equality comparison.
+///\relates cycle_edge_ptr
+template<typename T, typename U>
+inline auto operator==(const cycle_edge_ptr<T>& x, const cycle_edge_ptr<U>& y)
+noexcept
+-> bool {
+  return x.get() == y.get();
+}
+
+///\brief Inequality comparison.
+///\relates cycle_edge_ptr
+template<typename T, typename U>
+inline auto operator!=(const cycle_edge_ptr<T>& x, const cycle_edge_ptr<U>& y)
+noexcept
+-> bool {
+  return !(x == y);
+}
+
+///\brief Equality comparison.
+///\relates cycle_edge_ptr
+template<typename T, typename U>
+inline auto operator==(const cycle_edge_ptr<T>& x, const cycle_gptr<U>& y)
+noexcept
+-> bool {
+  return x.get() == y.get();
+}
+
+///\brief Equality comparison.
+///\relates cycle_edge_ptr
+template<typename T, typename U>
+inline auto operator==(const cycle_gptr<T>& x, const cycle_edge_ptr<U>& y)
+noexcept
+-> bool {
+  return x.get() == y.get();
+}
+
+///\brief Inequality comparison.
+///\relates cycle_edge_ptr
+template<typename T, typename U>
+inline auto operator!=(const cycle_edge_ptr<T>& x, const cycle_gptr<U>& y)
+noexcept
+-> bool {
+  return !(x == y);
+}
+
+///\brief Inequality comparison.
+///\relates cycle_edge_ptr
+template<typename T, typename U>
+inline auto operator!=(const cycle_gptr<T>& x, const cycle_edge_ptr<U>& y)
+noexcept
+-> bool {
+  return !(x == y);
+}
+
+///\brief Equality comparison.
+///\relates cycle_edge_ptr
+template<typename T>
+inline auto operator==(const cycle_edge_ptr<T>& x, std::nullptr_t y [[maybe_unused]])
+noexcept
+-> bool {
+  return x.get() == nullptr;
+}
+
+///\brief Equality comparison.
+///\relates cycle_edge_ptr
+template<typename T>
+inline auto operator==(std::nullptr_t x [[maybe_unused]], const cycle_edge_ptr<T>& y)
+noexcept
+-> bool {
+  return y.get() == nullptr;
+}
+
+///\brief Inequality comparison.
+///\relates cycle_edge_ptr
+template<typename T>
+inline auto operator!=(const cycle_edge_ptr<T>& x, std::nullptr_t y)
+noexcept
+-> bool {
+  return !(x == y);
+}
+
+///\brief Inequality comparison.
+///\relates cycle_edge_ptr
+template<typename T>
+inline auto operator!=(std::nullptr_t x, const cycle_edge_ptr<T>& y)
+noexcept
+-> bool {
+  return !(x == y);
+}
+
+///\brief Write pointer to output stream.
+///\relates cycle_edge_ptr
+template<typename Char, typename Traits, typename T>
+inline auto operator<<(std::basic_ostream<Char, Traits>& out, const cycle_edge_ptr<T>& ptr)
+-> std::basic_ostream<Char, Traits>& {
+  return out << ptr.get();
+}
+
+
+/**
+ * \brief Set of edges from a single owner, stored densely.
+ * \details
+ * Equivalent to a collection of \ref cycle_member_ptr sharing the same owner,
+ * but the set registers with its owner only once and stores its
+ * destinations contiguously.
+ * This makes it suitable for adjacency lists with many entries:
+ * \code
+ * class Node {
+ *  public:
+ *   cycle_edge_set<Node> neighbours;
+ * };
+ * \endcode
+ *
+ * The GC scans all edges in the set as a single block.
+ *
+ * Like std::vector, the set itself is not safe for concurrent modification.
+ * \tparam T The type of object the edges point at.
+ */
+template<typename T>
+class cycle_edge_set
+: private detail::edge_set_base
+{
+ public:
+  ///\brief Element type of the edges in this set.
+  using element_type = std::remove_extent_t<T>;
+  ///\brief Size type of this set.
+  using size_type = std::size_t;
+  ///\brief Iterator over the targets of this set.
+  using const_iterator = typename std::vector<T*>::const_iterator;
+
+  /**
+   * \brief Default constructor acquires its owner from context.
+   * \details
+   * Uses the same publisher logic as \ref cycle_member_ptr.
+   * \throws std::runtime_error if no range was published.
+   */
+  cycle_edge_set() = default;
+
+  /**
+   * \brief Create an unowned edge set.
+   * \details
+   * Makes the edges in this set behave like cycle_gptr.
+   * \param unowned_tag Tag to select ownerless construction.
+   */
+  explicit cycle_edge_set(unowned_cycle_t unowned_tag [[maybe_unused]])
+  : detail::edge_set_base(detail::base_control::unowned_control())
+  {}
+
+  /**
+   * \brief Copy constructor.
+   * \details
+   * The owner is acquired from context, like for the default constructor.
+   * \post
+   * *this holds the same targets as \p other.
+   * \throws std::runtime_error if no range was published.
+   */
+  cycle_edge_set(const cycle_edge_set& other)
+  : cycle_edge_set()
+  {
+    *this = other;
+  }
+
+  /**
+   * \brief Copy assignment operator.
+   * \post
+   * *this holds the same targets as \p other.
+   */
+  auto operator=(const cycle_edge_set& other)
+  -> cycle_edge_set& {
+    if (this == &other) return *this;
+
+    clear();
+    reserve(other.size());
+    for (size_type i = 0; i < other.size(); ++i) push_back(other.at(i));
+    return *this;
+  }
+
+  ///\brief Number of edges in this set.
+  auto size() const
+  noexcept
+  -> size_type {
+    return targets_.size();
+  }
+
+  ///\brief Test if this set is empty.
+  auto empty() const
+  noexcept
+  -> bool {
+    return targets_.empty();
+  }
+
+  ///\brief Iterator to the first target.
+  ///\note Targets are not valid once the owner of this is expired.
+  auto begin() const
+  noexcept
+  -> const_iterator {
+    return targets_.begin();
+  }
+
+  ///\brief Iterator past the last target.
+  auto end() const
+  noexcept
+  -> const_iterator {
+    return targets_.end();
+  }
+
+  /**
+   * \brief Returns the raw pointer of the edge at index \p i.
+   * \details Returns nullptr if the owner of this is expired.
+   */
+  auto get(size_type i) const
+  noexcept
+  -> T* {
+    assert(i < size());
+    if (owner_is_expired()) [[unlikely]]
+      return nullptr;
+    return targets_[i];
+  }
+
+  /**
+   * \brief Returns a pointer to the target of the edge at index \p i.
+   * \throws std::out_of_range if \p i is not less than size().
+   */
+  auto at(size_type i) const
+  -> cycle_gptr<T> {
+    if (i >= size()) throw std::out_of_range("cycle_edge_set::at");
+
+    cycle_gptr<T> result;
+    if (owner_is_expired()) [[unlikely]]
+      return result;
+
+    detail::intrusive_ptr<detail::base_control> ctrl = get_control_(i);
+    if (ctrl != nullptr) {
+      ctrl->acquire();
+      detail::trace_(trace_op::acquire, ctrl.get());
+      result.emplace_(targets_[i], std::move(ctrl));
+    }
+    return result;
+  }
+
+  /**
+   * \brief Reserve space for \p n edges.
+   * \throws std::bad_alloc If there is not enough memory.
+   */
+  auto reserve(size_type n)
+  -> void {
+    targets_.reserve(n);
+    this->detail::edge_set_base::reserve_(n);
+  }
+
+  /**
+   * \brief Append an edge to \p ptr.
+   * \throws std::bad_alloc If there is not enough memory.
+   */
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  auto push_back(const cycle_gptr<U>& ptr)
+  -> void {
+    push_back(cycle_gptr<U>(ptr));
+  }
+
+  /**
+   * \brief Append an edge to \p ptr.
+   * \post
+   * ptr == nullptr
+   * \throws std::bad_alloc If there is not enough memory.
+   */
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  auto push_back(cycle_gptr<U>&& ptr)
+  -> void {
+    const size_type i = append_(1);
+    assign_(i, std::move(ptr));
+  }
+
+  /**
+   * \brief Append an edge for each pointer in the range [\p b, \p e).
+   * \details
+   * Grows the set once, instead of for each pointer.
+   * \throws std::bad_alloc If there is not enough memory.
+   */
+  template<typename ForwardIt>
+  auto insert(ForwardIt b, ForwardIt e)
+  -> void {
+    size_type i = append_(std::distance(b, e));
+    while (b != e) assign_(i++, cycle_gptr<T>(*b++));
+  }
+
+  ///\brief Replace the target of the edge at index \p i with \p ptr.
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  auto assign(size_type i, const cycle_gptr<U>& ptr)
+  noexcept
+  -> void {
+    assign_(i, cycle_gptr<U>(ptr));
+  }
+
+  ///\brief Replace the target of the edge at index \p i with \p ptr.
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  auto assign(size_type i, cycle_gptr<U>&& ptr)
+  noexcept
+  -> void {
+    assign_(i, std::move(ptr));
+  }
+
+  ///\brief Remove the edge at index \p i.
+  auto erase(size_type i)
+  noexcept
+  -> void {
+    erase(i, i + 1u);
+  }
+
+  ///\brief Remove the edges at indices [\p b, \p e).
+  auto erase(size_type b, size_type e)
+  noexcept
+  -> void {
+    assert(b <= e && e <= size());
+    if (b == e) return;
+
+    for (size_type i = b; i < e; ++i) this->detail::edge_set_base::reset_(i);
+    compact_([b, e](size_type i) { return i < b || i >= e; });
+  }
+
+  /**
+   * \brief Remove all edges for which \p pred returns true.
+   * \details
+   * \p pred is invoked with the raw pointer of each edge.
+   * \returns The number of removed edges.
+   * \throws std::bad_alloc If there is not enough memory.
+   */
+  template<typename Pred>
+  auto erase_if(Pred pred)
+  -> size_type {
+    std::vector<bool> keep(size(), true); // May throw.
+    size_type removed = 0;
+    for (size_type i = 0; i < size(); ++i) {
+      if (std::invoke(pred, get(i))) {
+        this->detail::edge_set_base::reset_(i);
+        keep[i] = false;
+        ++removed;
+      }
+    }
+
+    if (removed != 0) compact_([&keep](size_type i) -> bool { return keep[i]; });
+    return removed;
+  }
+
+  ///\brief Remove all edges.
+  auto clear()
+  noexcept
+  -> void {
+    erase(0, size());
+  }
+
+ private:
+  /**
+   * \brief Append \p n null edges.
+   * \returns The index of the first new edge.
+   */
+  auto append_(size_type n)
+  -> size_type {
+    const size_type old_size = size();
+    if (old_size + n > targets_.capacity())
+      reserve(std::max(old_size + n, 2u * targets_.capacity()));
+
+    // Neither call reallocates, so they won't throw.
+    this->detail::edge_set_base::grow_(n);
+    targets_.resize(old_size + n, nullptr);
+    return old_size;
+  }
+
+  ///\brief Assign \p ptr to the edge at index \p i.
+  template<typename U>
+  auto assign_(size_type i, cycle_gptr<U>&& ptr)
+  noexcept
+  -> void {
+    assert(i < size());
+    this->detail::edge_set_base::reset_(i, std::move(ptr.target_ctrl_), true, true);
+    targets_[i] = std::exchange(ptr.target_, nullptr);
+  }
+
+  ///\brief Remove the edges for which \p keep returns false.
+  template<typename Keep>
+  auto compact_(Keep&& keep)
+  noexcept
+  -> void {
+    const size_type new_size = this->detail::edge_set_base::compact_(
+        std::forward<Keep>(keep),
+        [this](size_type from, size_type to) { targets_[to] = targets_[from]; });
+    targets_.resize(new_size);
+  }
+
+  ///\brief Targets of the edges, in the same order as the edges.
+  std::vector<T*> targets_;
+};
+
+
+namespace detail {
+
+
+///\brief Trait to select intrusive gptr and member pointers.
+template<typename T>
+struct is_intrusive_ptr
+: std::false_type
+{};
+
+template<typename T>
+struct is_intrusive_ptr<cycle_intrusive_gptr<T>>
+: std::true_type
+{};
+
+template<typename T>
+struct is_intrusive_ptr<cycle_intrusive_member_ptr<T>>
+: std::true_type
+{};
+
+///\brief Shorthand for is_intrusive_ptr<T>::value.
+template<typename T>
+inline constexpr bool is_intrusive_ptr_v = is_intrusive_ptr<T>::value;
+
+
+} /* namespace cycle_ptr::detail */
+
+
+/**
+ * \brief Base class for objects managed by intrusive cycle pointers.
+ * \details
+ * Objects deriving from cycle_intrusive_base can be pointed at by
+ * \ref cycle_intrusive_gptr, \ref cycle_intrusive_member_ptr and
+ * \ref cycle_intrusive_weak_ptr.
+ * Those pointers find the control block through the object,
+ * instead of storing it alongside the object pointer.
+ *
+ * Objects deriving from cycle_intrusive_base must be created using
+ * \ref make_cycle, \ref allocate_cycle or their split variants,
+ * and may not derive from cycle_intrusive_base more than once.
+ */
+class cycle_intrusive_base
+: public cycle_base
+{
+ protected:
+  /**
+   * \brief Default constructor acquires its control block from context.
+   * \throws std::runtime_error if no range was published.
+   */
+  cycle_intrusive_base() = default;
+
+  ///\brief Copy constructor.
+  ///\note A copy has a different, automatically deduced, control block.
+  cycle_intrusive_base(const cycle_intrusive_base&) = default;
+
+  ///\brief Move constructor.
+  ///\note A copy has a different, automatically deduced, control block.
+  cycle_intrusive_base(cycle_intrusive_base&&) = default;
+
+  ///\brief Copy assignment (noop).
+  auto operator=(const cycle_intrusive_base&) -> cycle_intrusive_base& = default;
+  ///\brief Move assignment (noop).
+  auto operator=(cycle_intrusive_base&&) -> cycle_intrusive_base& = default;
+
+  ///\brief Default destructor.
+  ~cycle_intrusive_base() noexcept = default;
+};
+
+
+/**
+ * \brief Global (or automatic) scope intrusive smart pointer.
+ * \details
+ * Equivalent of \ref cycle_gptr, for types deriving from
+ * \ref cycle_intrusive_base.
+ *
+ * The pointer is a single word: the control block is found through
+ * the object.
+ * As a consequence, aliasing is not supported: an intrusive pointer always
+ * points at the object managed by its control block.
+ *
+ * \tparam T The pointee type, must derive from \ref cycle_intrusive_base.
+ */
+template<typename T>
+class cycle_intrusive_gptr {
+  template<typename> friend class cycle_intrusive_gptr;
+  template<typename> friend class cycle_intrusive_member_ptr;
+  template<typename> friend class cycle_intrusive_weak_ptr;
+
+ public:
+  ///\copydoc cycle_member_ptr::element_type
+  using element_type = T;
+#ifndef CYCLE_PTR_NO_WEAK
+  ///\copydoc cycle_member_ptr::weak_type
+  using weak_type = cycle_intrusive_weak_ptr<T>;
+#endif
+
+  ///\brief Default constructor.
+  ///\post *this == nullptr
+  constexpr cycle_intrusive_gptr() noexcept {}
+
+  ///\brief Nullptr constructor.
+  ///\post *this == nullptr
+  constexpr cycle_intrusive_gptr(std::nullptr_t nil [[maybe_unused]]) noexcept
+  : cycle_intrusive_gptr()
+  {}
+
+  /**
+   * \brief Create a pointer from a raw pointer.
+   * \details
+   * Since the control block is reachable from the object,
+   * a pointer can be recreated from a raw pointer.
+   * \attention The caller must guarantee \p ptr is reachable,
+   * for instance because it is pointed at by another pointer.
+   * \post this->get() == ptr
+   */
+  explicit cycle_intrusive_gptr(T* ptr) noexcept
+  : target_(ptr)
+  {
+    if (target_ != nullptr) control_of_(target_)->acquire();
+  }
+
+  ///\brief Copy constructor.
+  ///\post *this == other
+  cycle_intrusive_gptr(const cycle_intrusive_gptr& other) noexcept
+  : target_(other.target_)
+  {
+    if (target_ != nullptr) control_of_(target_)->acquire_no_red();
+  }
+
+  ///\brief Move constructor.
+  ///\post *this == original value of other
+  ///\post other == nullptr
+  cycle_intrusive_gptr(cycle_intrusive_gptr&& other) noexcept
+  : target_(std::exchange(other.target_, nullptr))
+  {}
+
+  ///\brief Copy constructor.
+  ///\post *this == other
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  cycle_intrusive_gptr(const cycle_intrusive_gptr<U>& other) noexcept
+  : target_(other.target_)
+  {
+    if (target_ != nullptr) control_of_(target_)->acquire_no_red();
+  }
+
+  ///\brief Move constructor.
+  ///\post *this == original value of other
+  ///\post other == nullptr
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  cycle_intrusive_gptr(cycle_intrusive_gptr<U>&& other) noexcept
+  : target_(std::exchange(other.target_, nullptr))
+  {}
+
+  /**
+   * \brief Create from a cycle_gptr.
+   * \pre \p other does not alias: it points at the object managed by its
+   * control block.
+   * \post *this == other
+   */
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  cycle_intrusive_gptr(const cycle_gptr<U>& other) noexcept
+  : target_(other.target_)
+  {
+    if (target_ != nullptr) {
+      assert(control_of_(target_) == other.target_ctrl_.get());
+      control_of_(target_)->acquire_no_red();
+    }
+  }
+
+  /**
+   * \brief Create from a cycle_gptr.
+   * \details Takes over the reference held by \p other.
+   * \pre \p other does not alias: it points at the object managed by its
+   * control block.
+   * \post *this == original value of other
+   * \post other == nullptr
+   */
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  cycle_intrusive_gptr(cycle_gptr<U>&& other) noexcept
+  : target_(std::exchange(other.target_, nullptr))
+  {
+    assert(target_ == nullptr || control_of_(target_) == other.target_ctrl_.get());
+    other.target_ctrl_.reset();
+  }
+
+  ///\brief Create from a member pointer.
+  ///\post *this == other
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  cycle_intrusive_gptr(const cycle_intrusive_member_ptr<U>& other) noexcept {
+    if (other.owner_is_expired()) return;
+
+    const auto bc = other.get_control();
+    if (bc != nullptr) {
+      bc->acquire();
+      target_ = static_cast<U*>(bc->intrusive_base());
+    }
+  }
+
+#ifndef CYCLE_PTR_NO_WEAK
+  ///\brief Create from a weak pointer.
+  ///\throws std::bad_weak_ptr If \p other is expired.
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  explicit cycle_intrusive_gptr(const cycle_intrusive_weak_ptr<U>& other)
+  : cycle_intrusive_gptr(other.lock())
+  {
+    if (target_ == nullptr) throw std::bad_weak_ptr();
+  }
+#endif
+
+  ///\brief Destructor.
+  ~cycle_intrusive_gptr() noexcept {
+    if (target_ != nullptr) release_(target_);
+  }
+
+  ///\brief Copy assignment.
+  auto operator=(const cycle_intrusive_gptr& other)
+  noexcept
+  -> cycle_intrusive_gptr& {
+    if (other.target_ != nullptr) control_of_(other.target_)->acquire_no_red();
+    T*const old = std::exchange(target_, other.target_);
+    if (old != nullptr) release_(old);
+    return *this;
+  }
+
+  ///\brief Move assignment.
+  auto operator=(cycle_intrusive_gptr&& other)
+  noexcept
+  -> cycle_intrusive_gptr& {
+    T*const old = std::exchange(target_, std::exchange(other.target_, nullptr));
+    if (old != nullptr) release_(old);
+    return *this;
+  }
+
+  ///\brief Copy assignment.
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  auto operator=(const cycle_intrusive_gptr<U>& other)
+  noexcept
+  -> cycle_intrusive_gptr& {
+    return *this = cycle_intrusive_gptr(other);
+  }
+
+  ///\brief Move assignment.
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  auto operator=(cycle_intrusive_gptr<U>&& other)
+  noexcept
+  -> cycle_intrusive_gptr& {
+    return *this = cycle_intrusive_gptr(std::move(other));
+  }
+
+  ///\brief Assign from a member pointer.
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  auto operator=(const cycle_intrusive_member_ptr<U>& other)
+  noexcept
+  -> cycle_intrusive_gptr& {
+    return *this = cycle_intrusive_gptr(other);
+  }
+
+  ///\brief Nullptr assignment.
+  ///\post *this == nullptr
+  auto operator=(std::nullptr_t nil [[maybe_unused]])
+  noexcept
+  -> cycle_intrusive_gptr& {
+    reset();
+    return *this;
+  }
+
+  ///\brief Convert to a non-intrusive pointer.
+  operator cycle_gptr<T>() const
+  noexcept {
+    cycle_gptr<T> result;
+    if (target_ != nullptr) {
+      detail::base_control*const bc = control_of_(target_);
+      bc->acquire_no_red();
+      detail::trace_(trace_op::acquire, bc);
+      result.emplace_(target_, detail::intrusive_ptr<detail::base_control>(bc, true));
+    }
+    return result;
+  }
+
+  ///\brief Clear this pointer.
+  ///\post *this == nullptr
+  auto reset()
+  noexcept
+  -> void {
+    if (target_ != nullptr) release_(std::exchange(target_, nullptr));
+  }
+
+  ///\brief Swap with another pointer.
+  auto swap(cycle_intrusive_gptr& other)
+  noexcept
+  -> void {
+    std::swap(target_, other.target_);
+  }
+
+  ///\brief Retrieve the object pointed at.
+  auto get() const
+  noexcept
+  -> T* {
+    return target_;
+  }
+
+  ///\brief Dereference operation.
+  auto operator*() const
+  noexcept
+  -> T& {
+    assert(get() != nullptr);
+    return *get();
+  }
+
+  ///\brief Indirection operation.
+  auto operator->() const
+  noexcept
+  -> T* {
+    assert(get() != nullptr);
+    return get();
+  }
+
+  ///\brief Test if this pointer points at an object.
+  explicit operator bool() const
+  noexcept {
+    return get() != nullptr;
+  }
+
+  ///\brief Ownership ordering.
+  template<typename Ptr>
+  auto owner_before(const Ptr& other) const
+  noexcept
+  -> bool {
+    return get() < other.get();
+  }
+
+ private:
+  ///\brief Find the control block of \p ptr.
+  static auto control_of_(const T* ptr)
+  noexcept
+  -> detail::base_control* {
+    static_assert(std::is_base_of_v<cycle_intrusive_base, T>,
+        "Intrusive pointers require T to derive from cycle_intrusive_base.");
+
+    assert(ptr != nullptr);
+    return static_cast<const cycle_base*>(ptr)->control_.get();
+  }
+
+  /**
+   * \brief Release the reference on \p ptr.
+   * \details
+   * Since the object holds on to its own control block,
+   * we must hold a reference to the control block while the release runs:
+   * the object (and its reference) may be destroyed by the GC in the process.
+   */
+  static auto release_(T* ptr)
+  noexcept
+  -> void {
+    const auto bc = detail::intrusive_ptr<detail::base_control>(control_of_(ptr), true);
+    bc->release();
+  }
+
+  ///\brief Target object.
+  T* target_ = nullptr;
+};
+
+
+/**
+ * \brief Intrusive pointer between objects participating in the cycle_ptr graph.
+ * \details
+ * Equivalent of \ref cycle_member_ptr, for types deriving from
+ * \ref cycle_intrusive_base.
+ *
+ * The pointer does not store the object pointer, since it is found through
+ * the control block of the edge.
+ * It still requires the registration data of the edge, which the GC uses
+ * to traverse the graph.
+ *
+ * \tparam T The pointee type, must derive from \ref cycle_intrusive_base.
+ */
+template<typename T>
+class cycle_intrusive_member_ptr
+: private detail::vertex
+{
+  template<typename> friend class cycle_intrusive_gptr;
+  template<typename> friend class cycle_intrusive_member_ptr;
+  template<typename> friend class cycle_intrusive_weak_ptr;
+
+ public:
+  ///\copydoc cycle_member_ptr::element_type
+  using element_type = T;
+#ifndef CYCLE_PTR_NO_WEAK
+  ///\copydoc cycle_member_ptr::weak_type
+  using weak_type = cycle_intrusive_weak_ptr<T>;
+#endif
+
+  /**
+   * \brief Default constructor.
+   * \details
+   * Automatically deduces its owner, like cycle_member_ptr does.
+   * \post *this == nullptr
+   * \throws std::runtime_error If no published control block covers
+   * the address range of *this.
+   */
+  cycle_intrusive_member_ptr() {}
+
+  ///\brief Nullptr constructor.
+  ///\copydetails cycle_intrusive_member_ptr()
+  cycle_intrusive_member_ptr(std::nullptr_t nil [[maybe_unused]]) {}
+
+  ///\brief Create a null pointer, owned by \p owner.
+  ///\post *this == nullptr
+  explicit cycle_intrusive_member_ptr(cycle_base& owner) noexcept
+  : vertex(owner.control_)
+  {}
+
+  ///\brief Create a null pointer, owned by \p owner.
+  ///\post *this == nullptr
+  cycle_intrusive_member_ptr(cycle_base& owner, std::nullptr_t nil [[maybe_unused]]) noexcept
+  : cycle_intrusive_member_ptr(owner)
+  {}
+
+  ///\brief Create a pointer to \p ptr, owned by \p owner.
+  ///\post *this == ptr
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  cycle_intrusive_member_ptr(cycle_base& owner, const cycle_intrusive_gptr<U>& ptr) noexcept
+  : vertex(owner.control_)
+  {
+    *this = ptr;
+  }
+
+  ///\brief Create a pointer to \p ptr, owned by \p owner.
+  ///\post *this == original value of ptr
+  ///\post ptr == nullptr
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  cycle_intrusive_member_ptr(cycle_base& owner, cycle_intrusive_gptr<U>&& ptr) noexcept
+  : vertex(owner.control_)
+  {
+    *this = std::move(ptr);
+  }
+
+  ///\brief Copy constructor.
+  ///\details Owner is deduced automatically.
+  cycle_intrusive_member_ptr(const cycle_intrusive_member_ptr& ptr)
+  : vertex()
+  {
+    *this = ptr;
+  }
+
+  ///\brief Move constructor.
+  ///\details Owner is deduced automatically.
+  cycle_intrusive_member_ptr(cycle_intrusive_member_ptr&& ptr)
+  : cycle_intrusive_member_ptr(ptr)
+  {
+    ptr.reset();
+  }
+
+  ///\brief Create pointer to \p ptr.
+  ///\details Owner is deduced automatically.
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  cycle_intrusive_member_ptr(const cycle_intrusive_gptr<U>& ptr)
+  : vertex()
+  {
+    *this = ptr;
+  }
+
+  ///\brief Create pointer to \p ptr.
+  ///\details Owner is deduced automatically.
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  cycle_intrusive_member_ptr(cycle_intrusive_gptr<U>&& ptr)
+  : vertex()
+  {
+    *this = std::move(ptr);
+  }
+
+  ///\brief Nullptr assignment.
+  auto operator=(std::nullptr_t nil [[maybe_unused]])
+  noexcept
+  -> cycle_intrusive_member_ptr& {
+    reset();
+    return *this;
+  }
+
+  ///\brief Copy assignment.
+  auto operator=(const cycle_intrusive_member_ptr& other)
+  noexcept
+  -> cycle_intrusive_member_ptr& {
+    if (other.owner_is_expired())
+      reset();
+    else
+      this->detail::vertex::reset(other.get_control(), false, false);
+    return *this;
+  }
+
+  ///\brief Move assignment.
+  auto operator=(cycle_intrusive_member_ptr&& other)
+  noexcept
+  -> cycle_intrusive_member_ptr& {
+    if (this != &other) [[likely]] {
+      *this = other;
+      other.reset();
+    }
+    return *this;
+  }
+
+  ///\brief Assignment.
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  auto operator=(const cycle_intrusive_member_ptr<U>& other)
+  noexcept
+  -> cycle_intrusive_member_ptr& {
+    if (other.owner_is_expired())
+      reset();
+    else
+      this->detail::vertex::reset(other.get_control(), false, false);
+    return *this;
+  }
+
+  ///\brief Assignment.
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  auto operator=(const cycle_intrusive_gptr<U>& other)
+  noexcept
+  -> cycle_intrusive_member_ptr& {
+    this->detail::vertex::reset(
+        (other.target_ == nullptr
+         ? nullptr
+         : detail::intrusive_ptr<detail::base_control>(cycle_intrusive_gptr<U>::control_of_(other.target_), true)),
+        false, true);
+    return *this;
+  }
+
+  ///\brief Move assignment.
+  ///\details Takes over the reference held by \p other.
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  auto operator=(cycle_intrusive_gptr<U>&& other)
+  noexcept
+  -> cycle_intrusive_member_ptr& {
+    U*const target = std::exchange(other.target_, nullptr);
+    if (target == nullptr) {
+      reset();
+    } else {
+      this->detail::vertex::reset(
+          detail::intrusive_ptr<detail::base_control>(cycle_intrusive_gptr<U>::control_of_(target), true),
+          true, true);
+    }
+    return *this;
+  }
+
+  ///\brief Clear this pointer.
+  auto reset()
+  noexcept
+  -> void {
+    this->detail::vertex::reset();
+  }
+
+  ///\brief Retrieve the object pointed at.
+  ///\details Like cycle_member_ptr, returns nullptr if the owner is expired.
+  auto get() const
+  noexcept
+  -> T* {
+    if (owner_is_expired()) [[unlikely]]
+      return nullptr;
+
+    detail::base_control*const bc = peek_control();
+    if (bc == nullptr) return nullptr;
+    return static_cast<T*>(bc->intrusive_base());
+  }
+
+  ///\brief Dereference operation.
+  auto operator*() const
+  noexcept
+  -> T& {
+    assert(get() != nullptr);
+    return *get();
+  }
+
+  ///\brief Indirection operation.
+  auto operator->() const
+  noexcept
+  -> T* {
+    assert(get() != nullptr);
+    return get();
+  }
+
+  ///\brief Test if this pointer points at an object.
+  explicit operator bool() const
+  noexcept {
+    return get() != nullptr;
+  }
+
+  ///\brief Ownership ordering.
+  template<typename Ptr>
+  auto owner_before(const Ptr& other) const
+  noexcept
+  -> bool {
+    return get() < other.get();
+  }
+};
+
+
+#ifndef CYCLE_PTR_NO_WEAK
+/**
+ * \brief Intrusive weak cycle pointer.
+ * \details
+ * Equivalent of \ref cycle_weak_ptr, for types deriving from
+ * \ref cycle_intrusive_base.
+ *
+ * The pointer is a single word: it holds the control block,
+ * from which the object is found when locking.
+ *
+ * \tparam T The pointee type, must derive from \ref cycle_intrusive_base.
+ */
+template<typename T>
+class cycle_intrusive_weak_ptr {
+  template<typename> friend class cycle_intrusive_weak_ptr;
+
+ public:
+  ///\copydoc cycle_member_ptr::element_type
+  using element_type = T;
+
+  ///\brief Default constructor.
+  constexpr cycle_intrusive_weak_ptr() noexcept {}
+
+  ///\brief Copy constructor.
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  cycle_intrusive_weak_ptr(const cycle_intrusive_weak_ptr<U>& other) noexcept
+  : target_ctrl_(other.target_ctrl_)
+  {}
+
+  ///\brief Move constructor.
+  ///\post other.lock() == nullptr
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  cycle_intrusive_weak_ptr(cycle_intrusive_weak_ptr<U>&& other) noexcept
+  : target_ctrl_(std::move(other.target_ctrl_))
+  {}
+
+  ///\brief Create weak pointer from \p other.
+  ///\post this->lock() == other
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  cycle_intrusive_weak_ptr(const cycle_intrusive_gptr<U>& other) noexcept
+  : target_ctrl_(
+      other == nullptr
+      ? nullptr
+      : detail::intrusive_ptr<detail::base_control>(cycle_intrusive_gptr<U>::control_of_(other.get()), true))
+  {}
+
+  ///\brief Create weak pointer from \p other.
+  ///\post this->lock() == other
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  cycle_intrusive_weak_ptr(const cycle_intrusive_member_ptr<U>& other) noexcept
+  : target_ctrl_(other.owner_is_expired() ? nullptr : other.get_control())
+  {}
+
+  ///\brief Reset this pointer.
+  ///\post this->lock() == nullptr
+  auto reset()
+  noexcept
+  -> void {
+    target_ctrl_.reset();
+  }
+
+  ///\brief Swap with another weak pointer.
+  auto swap(cycle_intrusive_weak_ptr& other)
+  noexcept
+  -> void {
+    target_ctrl_.swap(other.target_ctrl_);
+  }
+
+  ///\brief Test if this weak pointer is expired.
+  ///\returns True if this weak pointer is expired, meaning that its pointee has been collected.
+  auto expired() const
+  noexcept
+  -> bool {
+    return target_ctrl_ == nullptr || target_ctrl_->expired();
+  }
+
+  ///\brief Create a pointer to the pointee.
+  ///\returns A pointer to the pointee, or nullptr if this is expired.
+  auto lock() const
+  noexcept
+  -> cycle_intrusive_gptr<T> {
+    cycle_intrusive_gptr<T> result;
+    if (target_ctrl_ != nullptr && target_ctrl_->weak_acquire())
+      result.target_ = static_cast<T*>(target_ctrl_->intrusive_base());
+    return result;
+  }
+
+  ///\brief Ownership ordering.
+  template<typename U>
+  auto owner_before(const cycle_intrusive_weak_ptr<U>& other) const
+  noexcept
+  -> bool {
+    return target_ctrl_ < other.target_ctrl_;
+  }
+
+ private:
+  ///\brief Control block of the pointee.
+  detail::intrusive_ptr<detail::base_control> target_ctrl_ = nullptr;
+};
+#endif
+
+
+///\brief Equality comparison.
+///\relates cycle_intrusive_gptr
+template<typename T, typename U>
+inline auto operator==(const cycle_intrusive_gptr<T>& x, const cycle_intrusive_gptr<U>& y)
+noexcept
+-> bool {
+  return x.get() == y.get();
+}
+
+///\brief Equality comparison.
+///\relates cycle_intrusive_gptr
+///\relates cycle_intrusive_member_ptr
+template<typename T, typename U>
+inline auto operator==(const cycle_intrusive_gptr<T>& x, const cycle_intrusive_member_ptr<U>& y)
+noexcept
+-> bool {
+  return x.get() == y.get();
+}
+
+///\brief Equality comparison.
+///\relates cycle_intrusive_gptr
+///\relates cycle_intrusive_member_ptr
+template<typename T, typename U>
+inline auto operator==(const cycle_intrusive_member_ptr<T>& x, const cycle_intrusive_gptr<U>& y)
+noexcept
+-> bool {
+  return x.get() == y.get();
+}
+
+///\brief Equality comparison.
+///\relates cycle_intrusive_member_ptr
+template<typename T, typename U>
+inline auto operator==(const cycle_intrusive_member_ptr<T>& x, const cycle_intrusive_member_ptr<U>& y)
+noexcept
+-> bool {
+  return x.get() == y.get();
+}
+
+///\brief Equality comparison.
+///\relates cycle_intrusive_gptr
+template<typename T>
+inline auto operator==(const cycle_intrusive_gptr<T>& x, std::nullptr_t y [[maybe_unused]])
+noexcept
+-> bool {
+  return !x;
+}
+
+///\brief Equality comparison.
+///\relates cycle_intrusive_gptr
+template<typename T>
+inline auto operator==(std::nullptr_t x [[maybe_unused]], const cycle_intrusive_gptr<T>& y)
+noexcept
+-> bool {
+  return !y;
+}
+
+///\brief Equality comparison.
+///\relates cycle_intrusive_member_ptr
+template<typename T>
+inline auto operator==(const cycle_intrusive_member_ptr<T>& x, std::nullptr_t y [[maybe_unused]])
+noexcept
+-> bool {
+  return !x;
+}
+
+///\brief Equality comparison.
+///\relates cycle_intrusive_member_ptr
+template<typename T>
+inline auto operator==(std::nullptr_t x [[maybe_unused]], const cycle_intrusive_member_ptr<T>& y)
+noexcept
+-> bool {
+  return !y;
+}
+
+///\brief Inequality comparison.
+///\relates cycle_intrusive_gptr
+///\relates cycle_intrusive_member_ptr
+template<typename X, typename Y>
+inline auto operator!=(const X& x, const Y& y)
+noexcept
+-> std::enable_if_t<
+    (detail::is_intrusive_ptr_v<X> || detail::is_intrusive_ptr_v<Y>),
+    decltype(x == y)> {
+  return !(x == y);
+}
+
+///\brief Less comparison.
+///\relates cycle_intrusive_gptr
+template<typename T, typename U>
+inline auto operator<(const cycle_intrusive_gptr<T>& x, const cycle_intrusive_gptr<U>& y)
+noexcept
+-> bool {
+  return std::less<const void*>()(x.get(), y.get());
+}
+
+///\brief Swap two pointers.
+///\relates cycle_intrusive_gptr
+template<typename T>
+inline auto swap(cycle_intrusive_gptr<T>& x, cycle_intrusive_gptr<T>& y)
+noexcept
+-> void {
+  x.swap(y);
+}
+
+#ifndef CYCLE_PTR_NO_WEAK
+///\brief Swap two pointers.
+///\relates cycle_intrusive_weak_ptr
+template<typename T>
+inline auto swap(cycle_intrusive_weak_ptr<T>& x, cycle_intrusive_weak_ptr<T>& y)
+noexcept
+-> void {
+  x.swap(y);
+}
+#endif
+
+
+/**
+ * \brief Adaptor for collections with member types.
+ * \details Member types are owned by the owner supplied at allocator construction.
+ * \tparam Nested Underlying allocator.
+ */
+template<typename Nested>
+class cycle_allocator
+: public Nested
+{
+  template<typename> friend class cycle_allocator;
+
+ public:
+  ///\brief When copy-assigning, allocator is not copied over.
+  using propagate_on_container_copy_assignment = std::false_type;
+  ///\brief When move-assigning, allocator is not copied over.
+  using propagate_on_container_move_assignment = std::false_type;
+  ///\brief When performing swap, allocator is not swapped.
+  using propagate_on_container_swap = std::false_type;
+  ///\brief Must check for equality.
+  using is_always_equal = std::false_type;
+
+  ///\brief Template for changing controlled type of allocator.
+  template<typename T>
+  struct rebind {
+    ///\brief The type of this allocator, rebound to type \p T.
+    using other = cycle_allocator<typename std::allocator_traits<Nested>::template rebind_alloc<T>>;
+  };
+
+  ///\brief Copy constructor for distinct type.
+  template<typename Other>
+  cycle_allocator(const cycle_allocator<Other>& other)
+  noexcept(std::is_nothrow_constructible_v<Nested, const Other&>)
+  : Nested(other),
+    control_(other.control_)
+  {}
+
+  ///\brief Create allocator, with declared ownership.
+  ///\param base The owner of elements created using this allocator.
+  ///\param args Arguments to pass to underlying allocator constructor.
+  template<typename... Args, typename = std::enable_if_t<std::is_constructible_v<Nested, Args...>>>
+  explicit cycle_allocator(const cycle_base& base, Args&&... args)
+  : Nested(std::forward<Args>(args)...),
+    control_(base.control_)
+  {}
+
+  ///\brief Create allocator, with elements having no ownership.
+  ///\param unowned_tag Tag indicating that elements created by this allocator do not have an owning object.
+  ///\param args Arguments to pass to underlying allocator constructor.
+  template<typename... Args, typename = std::enable_if_t<std::is_constructible_v<Nested, Args...>>>
+  explicit cycle_allocator(unowned_cycle_t unowned_tag [[maybe_unused]], Args&&... args)
+  : Nested(std::forward<Args>(args)...),
+    control_(detail::base_control::unowned_control())
+  {}
+
+  ///\brief Constructor for internal use.
+  ///\param control The control block of the owner of elements created using this allocator.
+  ///\param args Arguments to pass to underlying allocator constructor.
+  template<typename... Args, typename = std::enable_if_t<std::is_constructible_v<Nested, Args...>>>
+  explicit cycle_allocator(detail::intrusive_ptr<detail::base_control> control, Args&&... args)
+  : Nested(std::forward<Args>(args)...),
+    control_(std::move(control))
+  {
+    assert(control_ != nullptr);
+  }
+
+  /**
+   * \brief Constructor.
+   * \details
+   * Publishes the owner control block prior to construction,
+   * to allow for members to pick it up automatically.
+   * (After construction, the control block is unpublished.)
+   *
+   * Forwards to construct as implemented by \p Nested.
+   *
+   * Elements may not declare edges (see \ref cycle_edges),
+   * as only control blocks adopt those.
+   */
+  template<typename T, typename... Args>
+  auto construct(T* ptr, Args&&... args)
+  -> void {
+    static_assert(!detail::has_static_edges_v<T>,
+        "Elements with statically declared edges are not adopted by the owner. Use cycle_member_ptr members instead.");
+
+    detail::base_control::publisher pub{ ptr, sizeof(T), *control_ };
+    std::allocator_traits<Nested>::construct(*this, ptr, std::forward<Args>(args)...);
+  }
+
+  /**
+   * \brief Fail to create copy of this allocator.
+   * \details
+   * Fails a static assert with a message asking you to please explicitly
+   * specify what ownership relation to use for copied container.
+   *
+   * \note
+   * Ideally, this would also be possible for move construction of a
+   * container, but there's no support for that in the C++ Standard Library.
+   */
+  template<typename Dummy = void>
+  auto select_on_container_copy_construction()
+  -> cycle_allocator {
+    static_assert(std::is_void_v<Dummy> && false,
+        "You must explicitly specify an allocator with owner during copy.");
+    return *this;
+  }
+
+  /**
+   * \brief Compare allocators for equality.
+   * \details
+   * Two allocators are equal if they use the same owner.
+   *
+   * (Distinct owners are treated as equal if they represent the unowned
+   * control block.)
+   */
+  auto operator==(const cycle_allocator& other) const
+  noexcept(
+      std::allocator_traits<Nested>::is_always_equal::value
+      || noexcept(std::declval<const Nested&>() == std::declval<const Nested&>()))
+  -> bool {
+    if constexpr(!std::allocator_traits<Nested>::is_always_equal::value) {
+      if (!std::equal_to<Nested>()(*this, other)) return false;
+    }
+
+    return control_ == other.control_
+        || (control_->is_unowned() && other.control_->is_unowned());
+  }
+
+  ///\brief Inequality comparison.
+  auto operator!=(const cycle_allocator& other) const
+  noexcept(noexcept(std::declval<const cycle_allocator&>() == std::declval<const cycle_allocator&>()))
+  -> bool {
+    return !(*this == other);
+  }
+
+ private:
+  ///\brief Control block for ownership.
+  detail::intrusive_ptr<detail::base_control> control_;
+};
+
+
+namespace detail {
+
+
+///\brief Pointer type used by transparent comparators.
+///\details Uses ``const void*`` if \p T is void.
+template<typename T>
+using transparent_pointer_t = std::conditional_t<std::is_void_v<T>, const void*, const T*>;
+
+///\brief Retrieve the pointer for transparent comparison.
+template<typename T, typename U>
+constexpr auto transparent_pointer(U* p)
+noexcept
+-> transparent_pointer_t<T> {
+  return p;
+}
+
+///\brief Retrieve the pointer for transparent comparison.
+template<typename T>
+constexpr auto transparent_pointer(std::nullptr_t p [[maybe_unused]])
+noexcept
+-> transparent_pointer_t<T> {
+  return nullptr;
+}
+
+///\brief Retrieve the pointer for transparent comparison.
+///\details Accepts any of the cycle pointer types.
+template<typename T, typename Ptr>
+constexpr auto transparent_pointer(const Ptr& p)
+noexcept
+-> decltype(transparent_pointer_t<T>(p.get())) {
+  return p.get();
+}
+
+
+} /* namespace cycle_ptr::detail */
+
+
+/**
+ * \brief Transparent less comparison of pointers.
+ * \details
+ * Compares \ref cycle_member_ptr, \ref cycle_gptr, their intrusive
+ * equivalents and raw pointers, by the address they point at.
+ *
+ * Since the comparator is transparent, a map keyed by member pointers
+ * can be searched for a \ref cycle_gptr or raw pointer, without
+ * constructing a member pointer:
+ * \code
+ * std::map<
+ *     cycle_member_ptr<Key>, Value,
+ *     ptr_less<>,
+ *     cycle_allocator<std::allocator<std::pair<const cycle_member_ptr<Key>, Value>>>>
+ *     someMap;
+ * cycle_gptr<Key> soughtKey;
+ *
+ * someMap.find(soughtKey); // No allocation, no locking.
+ * \endcode
+ *
+ * \tparam T If void, pointers are compared as ``const void*``.
+ * Otherwise, pointers are converted to ``const T*`` first.
+ * Specify \p T when comparing pointers to derived types, whose address may
+ * differ from the address of their base.
+ */
+template<typename T = void>
+struct ptr_less {
+  ///\brief Mark comparator as transparent.
+  using is_transparent = void;
+
+  ///\brief Compare \p x and \p y.
+  ///\returns True if \p x points at an address before \p y.
+  template<typename X, typename Y>
+  constexpr auto operator()(const X& x, const Y& y) const
+  noexcept
+  -> bool {
+    return std::less<detail::transparent_pointer_t<T>>()(
+        detail::transparent_pointer<T>(x),
+        detail::transparent_pointer<T>(y));
+  }
+};
+
+/**
+ * \brief Transparent equality comparison of pointers.
+ * \details
+ * Equality comparison equivalent of \ref ptr_less.
+ * \tparam T \copydoc ptr_less
+ */
+template<typename T = void>
+struct ptr_equal {
+  ///\brief Mark comparator as transparent.
+  using is_transparent = void;
+
+  ///\brief Compare \p x and \p y.
+  ///\returns True if \p x and \p y point at the same address.
+  template<typename X, typename Y>
+  constexpr auto operator()(const X& x, const Y& y) const
+  noexcept
+  -> bool {
+    return detail::transparent_pointer<T>(x) == detail::transparent_pointer<T>(y);
+  }
+};
+
+/**
+ * \brief Transparent hash of pointers.
+ * \details
+ * Hashes \ref cycle_member_ptr, \ref cycle_gptr, their intrusive
+ * equivalents and raw pointers, by the address they point at.
+ * Pointers to the same address have the same hash code.
+ *
+ * Use with \ref ptr_equal.
+ * \note Heterogeneous lookup in unordered containers requires C++20.
+ * \tparam T \copydoc ptr_less
+ */
+template<typename T = void>
+struct ptr_hash {
+  ///\brief Mark hash function as transparent.
+  using is_transparent = void;
+
+  ///\brief Compute hash code of \p x.
+  template<typename X>
+  auto operator()(const X& x) const
+  noexcept
+  -> std::size_t {
+    return std::hash<detail::transparent_pointer_t<T>>()(detail::transparent_pointer<T>(x));
+  }
+};
+
+/**
+ * \brief Transparent ownership ordering.
+ * \details
+ * Orders \ref cycle_member_ptr, \ref cycle_gptr and \ref cycle_weak_ptr
+ * by the control block they share ownership of,
+ * using their ``owner_before`` member function.
+ * Aliasing pointers compare equivalent to the pointer they alias.
+ *
+ * Raw pointers can't be used with this comparator, as they carry no
+ * ownership information.
+ * \tparam T Unused, present for symmetry with ``std::owner_less``.
+ */
+template<typename T = void>
+struct owner_less {
+  ///\brief Mark comparator as transparent.
+  using is_transparent = void;
+
+  ///\brief Compare \p x and \p y.
+  ///\returns ``x.owner_before(y)``
+  template<typename X, typename Y>
+  auto operator()(const X& x, const Y& y) const
+  noexcept
+  -> bool {
+    return x.owner_before(y);
+  }
 };
 
 
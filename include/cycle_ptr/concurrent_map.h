@@ -0,0 +1,513 @@
+#pragma once
+
+#include <cycle_ptr.h>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace cycle_ptr {
+
+
+/**
+ * \brief Concurrent hash map, whose values are edges from the owner of the map.
+ * \details
+ * Each value in the map is a \ref cycle_member_ptr, owned by the object
+ * containing the map.
+ * Thus the GC sees the map contents, exactly as it would see a
+ * ``std::unordered_map`` with a \ref cycle_allocator.
+ *
+ * Lookups are lock free.
+ * Each bucket holds an immutable array of entries, which is read
+ * using a hazard pointer.
+ *
+ * Modifications lock the affected bucket, and replace its array.
+ * Growing the map blocks modifications, but not lookups.
+ * A lookup may drop the last reference to a replaced array;
+ * the array is then destroyed by the next modification,
+ * so lookups never release entries (which may run the GC).
+ *
+ * \code
+ * class Registry
+ * : public cycle_base
+ * {
+ *  public:
+ *   concurrent_map<int, Item> items;
+ * };
+ * \endcode
+ *
+ * \tparam Key Key type of the map.
+ * \tparam T Type of object the values in the map point at.
+ * \tparam Hash Hash function for keys.
+ * \tparam KeyEqual Equality comparison for keys.
+ */
+template<typename Key, typename T, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
+class concurrent_map {
+ public:
+  ///\brief Key type of the map.
+  using key_type = Key;
+  ///\brief Type of object the values point at.
+  using element_type = T;
+  ///\brief Size type of the map.
+  using size_type = std::size_t;
+  ///\brief Hash function.
+  using hasher = Hash;
+  ///\brief Key equality comparison.
+  using key_equal = KeyEqual;
+
+ private:
+  ///\brief A single key-value pair.
+  ///\details Immutable, so that lookups can read it without synchronization.
+  class entry {
+   public:
+    entry(std::size_t hash, const key_type& key, cycle_gptr<T>&& value)
+    : hash(hash),
+      key(key),
+      value(std::move(value))
+    {}
+
+    entry(const entry&) = delete;
+
+    ///\brief Cached hash code of key.
+    const std::size_t hash;
+    ///\brief Key of this entry.
+    const key_type key;
+    ///\brief Value of this entry.
+    ///\details Edge from the owner of the map.
+    const cycle_member_ptr<T> value;
+
+   private:
+    friend auto intrusive_ptr_add_ref(entry* e)
+    noexcept
+    -> void {
+      e->refs_.fetch_add(1u, std::memory_order_relaxed);
+    }
+
+    friend auto intrusive_ptr_release(entry* e)
+    noexcept
+    -> void {
+      if (e->refs_.fetch_sub(1u, std::memory_order_acq_rel) == 1u) {
+        using traits = std::allocator_traits<std::allocator<entry>>;
+        std::allocator<entry> alloc;
+        traits::destroy(alloc, e);
+        traits::deallocate(alloc, e, 1);
+      }
+    }
+
+    ///\brief Reference counter.
+    std::atomic<std::uintptr_t> refs_{ 1u };
+  };
+
+  ///\brief Immutable contents of a bucket.
+  ///\details
+  ///When the last reference goes away, the bucket data is pushed on the
+  ///retired list of its map, instead of being destroyed.
+  class bucket_data {
+   public:
+    explicit bucket_data(std::atomic<bucket_data*>& retired) noexcept
+    : retired_(retired)
+    {}
+
+    bucket_data(const bucket_data&) = delete;
+
+    ///\brief Destroy each bucket data in the retired list starting at \p b.
+    static auto destroy_list(bucket_data* b)
+    noexcept
+    -> void {
+      while (b != nullptr) delete std::exchange(b, b->next_retired_);
+    }
+
+    ///\brief Entries in the bucket.
+    std::vector<detail::intrusive_ptr<entry>> entries;
+
+   private:
+    friend auto intrusive_ptr_add_ref(bucket_data* b)
+    noexcept
+    -> void {
+      b->refs_.fetch_add(1u, std::memory_order_relaxed);
+    }
+
+    friend auto intrusive_ptr_release(bucket_data* b)
+    noexcept
+    -> void {
+      if (b->refs_.fetch_sub(1u, std::memory_order_acq_rel) != 1u) return;
+
+      bucket_data* head = b->retired_.load(std::memory_order_relaxed);
+      do {
+        b->next_retired_ = head;
+      } while (!b->retired_.compare_exchange_weak(
+              head, b,
+              std::memory_order_release,
+              std::memory_order_relaxed));
+    }
+
+    ///\brief Retired list of the map.
+    std::atomic<bucket_data*>& retired_;
+    ///\brief Next element in the retired list.
+    bucket_data* next_retired_ = nullptr;
+    ///\brief Reference counter.
+    std::atomic<std::uintptr_t> refs_{ 1u };
+  };
+
+  ///\brief Bucket in the hash table.
+  struct bucket {
+    ///\brief Serializes modifications of the bucket.
+    std::mutex mtx;
+    ///\brief Contents of the bucket.
+    detail::hazard_ptr<bucket_data> data;
+  };
+
+  ///\brief Hash table.
+  struct table {
+    explicit table(size_type n)
+    : size(n),
+      buckets(std::make_unique<bucket[]>(n))
+    {}
+
+    ///\brief Retrieve the bucket for hash code \p hash.
+    auto operator[](std::size_t hash) const
+    noexcept
+    -> bucket& {
+      return buckets[hash % size];
+    }
+
+    ///\brief Number of buckets.
+    const size_type size;
+    ///\brief Buckets.
+    const std::unique_ptr<bucket[]> buckets;
+    ///\brief Previous table.
+    ///\details Tables are retained until the map is destroyed, as lookups may still be reading them.
+    std::unique_ptr<table> prev;
+  };
+
+  ///\brief Allocator for entries.
+  ///\details Publishes the owner of this map, when constructing an entry.
+  using entry_allocator = cycle_allocator<std::allocator<entry>>;
+
+ public:
+  /**
+   * \brief Default constructor acquires its owner from context.
+   * \details
+   * Uses the same publisher logic as \ref cycle_member_ptr.
+   * \throws std::runtime_error if no range was published.
+   */
+  explicit concurrent_map(size_type bucket_count = 16u)
+  : concurrent_map(detail::base_control::publisher_lookup(this, sizeof(*this)), bucket_count)
+  {}
+
+  /**
+   * \brief Create an unowned map.
+   * \details
+   * Makes the values in this map behave like cycle_gptr.
+   * \param unowned_tag Tag to select ownerless construction.
+   * \param bucket_count Initial number of buckets.
+   */
+  explicit concurrent_map(unowned_cycle_t unowned_tag [[maybe_unused]], size_type bucket_count = 16u)
+  : concurrent_map(detail::base_control::unowned_control(), bucket_count)
+  {}
+
+  concurrent_map(const concurrent_map&) = delete;
+  auto operator=(const concurrent_map&) -> concurrent_map& = delete;
+
+  ///\brief Destructor.
+  ///\pre No other thread is accessing this map.
+  ~concurrent_map() noexcept {
+    delete table_.load(std::memory_order_relaxed);
+    reclaim_();
+  }
+
+  ///\brief Number of entries in the map.
+  ///\note Other threads may change the size concurrently.
+  auto size() const
+  noexcept
+  -> size_type {
+    return size_.load(std::memory_order_relaxed);
+  }
+
+  ///\brief Test if the map is empty.
+  ///\note Other threads may change the size concurrently.
+  auto empty() const
+  noexcept
+  -> bool {
+    return size() == 0u;
+  }
+
+  ///\brief Number of buckets in the map.
+  auto bucket_count() const
+  noexcept
+  -> size_type {
+    return table_.load(std::memory_order_acquire)->size;
+  }
+
+  /**
+   * \brief Look up the value for \p key.
+   * \details Lock free.
+   * \returns Pointer to the value of \p key, or nullptr if \p key is not present.
+   */
+  auto find(const key_type& key) const
+  -> cycle_gptr<T> {
+    const std::size_t hash = hash_(key);
+
+    for (;;) {
+      const table*const t = table_.load(std::memory_order_acquire);
+      const detail::intrusive_ptr<bucket_data> data = (*t)[hash].data.load();
+
+      if (data != nullptr) {
+        for (const auto& e : data->entries) {
+          if (e->hash == hash && eq_(e->key, key))
+            return cycle_gptr<T>(e->value);
+        }
+      }
+
+      // A resize may have moved the entry to the new table,
+      // in which case we must look again.
+      if (t == table_.load(std::memory_order_acquire)) return nullptr;
+    }
+  }
+
+  /**
+   * \brief Test if \p key is present.
+   * \details Lock free.
+   */
+  auto contains(const key_type& key) const
+  -> bool {
+    return find(key) != nullptr;
+  }
+
+  /**
+   * \brief Insert \p value for \p key, if \p key is not present.
+   * \returns True if the value was inserted.
+   */
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  auto insert(const key_type& key, cycle_gptr<U> value)
+  -> bool {
+    return modify_(
+        key,
+        [&](std::size_t hash, detail::intrusive_ptr<bucket_data>& data, std::ptrdiff_t idx) -> bool {
+          if (idx >= 0) return false;
+          data->entries.push_back(make_entry_(hash, key, std::move(value)));
+          return true;
+        });
+  }
+
+  /**
+   * \brief Assign \p value to \p key.
+   * \returns True if \p key was not present.
+   */
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  auto insert_or_assign(const key_type& key, cycle_gptr<U> value)
+  -> bool {
+    bool inserted = false;
+    modify_(
+        key,
+        [&](std::size_t hash, detail::intrusive_ptr<bucket_data>& data, std::ptrdiff_t idx) -> bool {
+          if (idx >= 0) {
+            data->entries[idx] = make_entry_(hash, key, std::move(value));
+          } else {
+            data->entries.push_back(make_entry_(hash, key, std::move(value)));
+            inserted = true;
+          }
+          return true;
+        });
+    return inserted;
+  }
+
+  /**
+   * \brief Remove \p key.
+   * \returns True if \p key was present.
+   */
+  auto erase(const key_type& key)
+  -> bool {
+    return modify_(
+        key,
+        [](std::size_t hash [[maybe_unused]], detail::intrusive_ptr<bucket_data>& data, std::ptrdiff_t idx) -> bool {
+          if (idx < 0) return false;
+          data->entries.erase(data->entries.begin() + idx);
+          return true;
+        });
+  }
+
+  ///\brief Remove all entries.
+  auto clear()
+  -> void {
+    std::shared_lock<std::shared_mutex> resize_lck{ resize_mtx_ };
+    const table*const t = table_.load(std::memory_order_relaxed);
+
+    for (size_type i = 0; i < t->size; ++i) {
+      detail::intrusive_ptr<bucket_data> old;
+      {
+        std::lock_guard<std::mutex> lck{ t->buckets[i].mtx };
+        old = t->buckets[i].data.exchange(nullptr);
+        if (old != nullptr)
+          size_.fetch_sub(old->entries.size(), std::memory_order_relaxed);
+      }
+      // Old entries are released outside the lock,
+      // as their release may run the GC.
+    }
+    reclaim_();
+  }
+
+ private:
+  concurrent_map(detail::intrusive_ptr<detail::base_control> owner, size_type bucket_count)
+  : alloc_(std::move(owner)),
+    table_(new table(std::max(bucket_count, size_type(1))))
+  {}
+
+  ///\brief Compute hash code of \p key.
+  auto hash_(const key_type& key) const
+  -> std::size_t {
+    return std::invoke(hash_fn_, key);
+  }
+
+  ///\brief Compare keys.
+  auto eq_(const key_type& x, const key_type& y) const
+  -> bool {
+    return std::invoke(eq_fn_, x, y);
+  }
+
+  ///\brief Create a new entry.
+  ///\details The entry is created with a member pointer owned by the owner of this map.
+  template<typename U>
+  auto make_entry_(std::size_t hash, const key_type& key, cycle_gptr<U>&& value)
+  -> detail::intrusive_ptr<entry> {
+    using traits = std::allocator_traits<entry_allocator>;
+
+    entry_allocator alloc = alloc_;
+    entry*const e = traits::allocate(alloc, 1);
+    try {
+      traits::construct(alloc, e, hash, key, cycle_gptr<T>(std::move(value)));
+    } catch (...) {
+      traits::deallocate(alloc, e, 1);
+      throw;
+    }
+    return detail::intrusive_ptr<entry>(e, false);
+  }
+
+  ///\brief Destroy bucket data whose last reference went away.
+  ///\details Destroying bucket data may release entries, and run the GC.
+  auto reclaim_()
+  noexcept
+  -> void {
+    if (retired_.load(std::memory_order_relaxed) == nullptr) [[likely]] return;
+    bucket_data::destroy_list(retired_.exchange(nullptr, std::memory_order_acquire));
+  }
+
+  /**
+   * \brief Modify the bucket of \p key.
+   * \details
+   * Invokes \p fn with the hash code of \p key, a copy of the bucket data,
+   * and the index of \p key in the bucket data (or -1 if absent).
+   * If \p fn returns true, the copy replaces the bucket data.
+   * \returns The result of \p fn.
+   */
+  template<typename Fn>
+  auto modify_(const key_type& key, Fn&& fn)
+  -> bool {
+    const std::size_t hash = hash_(key);
+    detail::intrusive_ptr<bucket_data> old;
+    bool changed;
+
+    {
+      std::shared_lock<std::shared_mutex> resize_lck{ resize_mtx_ };
+      bucket& b = (*table_.load(std::memory_order_relaxed))[hash];
+      std::lock_guard<std::mutex> lck{ b.mtx };
+
+      old = b.data.load();
+      auto data = detail::intrusive_ptr<bucket_data>(new bucket_data(retired_), false);
+      std::ptrdiff_t idx = -1;
+      if (old != nullptr) {
+        data->entries = old->entries;
+        for (std::size_t i = 0; i < data->entries.size(); ++i) {
+          const entry& e = *data->entries[i];
+          if (e.hash == hash && eq_(e.key, key)) {
+            idx = static_cast<std::ptrdiff_t>(i);
+            break;
+          }
+        }
+      }
+
+      changed = std::invoke(fn, hash, data, idx);
+      if (!changed) {
+        // The copy was never published, and its entries are shared with old.
+        delete data.detach();
+        return false;
+      }
+
+      const size_type new_size = data->entries.size();
+      const size_type old_size = (old == nullptr ? 0u : old->entries.size());
+      b.data = std::move(data);
+      if (new_size > old_size)
+        size_.fetch_add(new_size - old_size, std::memory_order_relaxed);
+      else
+        size_.fetch_sub(old_size - new_size, std::memory_order_relaxed);
+    }
+    // Replaced entries are released after unlocking,
+    // as their release may run the GC.
+    old.reset();
+
+    maybe_grow_();
+    reclaim_();
+    return changed;
+  }
+
+  ///\brief Double the number of buckets, if the map is too full.
+  auto maybe_grow_()
+  -> void {
+    if (size() <= 2u * table_.load(std::memory_order_acquire)->size) [[likely]]
+      return;
+
+    std::unique_lock<std::shared_mutex> resize_lck{ resize_mtx_ };
+    table*const old_table = table_.load(std::memory_order_relaxed);
+    if (size() <= 2u * old_table->size) return; // Another thread grew the table.
+
+    auto new_table = std::make_unique<table>(2u * old_table->size);
+    std::vector<std::vector<detail::intrusive_ptr<entry>>> new_data(new_table->size);
+    for (size_type i = 0; i < old_table->size; ++i) {
+      const detail::intrusive_ptr<bucket_data> data = old_table->buckets[i].data.load();
+      if (data == nullptr) continue;
+      for (const auto& e : data->entries)
+        new_data[e->hash % new_table->size].push_back(e);
+    }
+    for (size_type i = 0; i < new_table->size; ++i) {
+      if (new_data[i].empty()) continue;
+      auto data = detail::intrusive_ptr<bucket_data>(new bucket_data(retired_), false);
+      data->entries = std::move(new_data[i]);
+      new_table->buckets[i].data = std::move(data);
+    }
+
+    new_table->prev.reset(old_table);
+    table_.store(new_table.release(), std::memory_order_release);
+
+    // Lookups that miss in the old table retry with the new table.
+    // So we can drop the old contents, which no longer holds references
+    // to removed entries this way.
+    for (size_type i = 0; i < old_table->size; ++i)
+      old_table->buckets[i].data.reset();
+  }
+
+  ///\brief Allocator for entries, which knows the owner of this map.
+  const entry_allocator alloc_;
+  ///\brief Hash function.
+  hasher hash_fn_;
+  ///\brief Key equality comparison.
+  key_equal eq_fn_;
+  ///\brief Serializes growing of the table with modifications.
+  std::shared_mutex resize_mtx_;
+  ///\brief Current table.
+  std::atomic<table*> table_;
+  ///\brief Number of entries.
+  std::atomic<size_type> size_{ 0u };
+  ///\brief Bucket data whose last reference went away, awaiting destruction.
+  ///\details Drained by modifications, as lookups must not release entries.
+  std::atomic<bucket_data*> retired_{ nullptr };
+};
+
+
+} /* namespace cycle_ptr */
@@ -0,0 +1,358 @@
+#pragma once
+
+#include <cycle_ptr.h>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace cycle_ptr {
+namespace detail {
+
+
+/**
+ * \brief Pool of node memory, for lock free containers.
+ * \details
+ * Released nodes are pushed on a lock free free-list.
+ * Only one thread at a time pops from the free-list, which makes the pop
+ * immune to the ABA problem.
+ * A thread that finds another thread popping, allocates new memory instead,
+ * so allocation never blocks.
+ *
+ * Memory in the pool is only returned when the pool is destroyed.
+ * \tparam Node The type of node to allocate memory for.
+ */
+template<typename Node>
+class node_pool {
+ private:
+  ///\brief Overlay for memory in the free-list.
+  struct free_node {
+    free_node* next;
+  };
+
+  static_assert(sizeof(Node) >= sizeof(free_node));
+
+ public:
+  node_pool() noexcept = default;
+  node_pool(const node_pool&) = delete;
+
+  ~node_pool() noexcept {
+    free_node* n = free_.load(std::memory_order_acquire);
+    while (n != nullptr) {
+      free_node*const next = n->next;
+      n->~free_node();
+      ::operator delete(static_cast<void*>(n), std::align_val_t(alignof(Node)));
+      n = next;
+    }
+  }
+
+  /**
+   * \brief Retrieve memory for a node.
+   * \throws std::bad_alloc If the pool is empty and there is not enough memory.
+   */
+  auto allocate()
+  -> void* {
+    if (!pop_busy_.test_and_set(std::memory_order_acquire)) {
+      free_node* n = free_.load(std::memory_order_acquire);
+      while (n != nullptr
+          && !free_.compare_exchange_weak(n, n->next, std::memory_order_acquire, std::memory_order_acquire)) {
+        // Retry.
+      }
+      pop_busy_.clear(std::memory_order_release);
+
+      if (n != nullptr) {
+        n->~free_node();
+        return static_cast<void*>(n);
+      }
+    }
+
+    return ::operator new(sizeof(Node), std::align_val_t(alignof(Node))); // May throw.
+  }
+
+  ///\brief Return memory of a node to the pool.
+  auto deallocate(void* p)
+  noexcept
+  -> void {
+    free_node*const n = new (p) free_node{ free_.load(std::memory_order_relaxed) };
+    while (!free_.compare_exchange_weak(n->next, n, std::memory_order_release, std::memory_order_relaxed)) {
+      // Retry.
+    }
+  }
+
+ private:
+  ///\brief Free-list.
+  std::atomic<free_node*> free_{ nullptr };
+  ///\brief Set while a thread pops from the free-list.
+  std::atomic_flag pop_busy_ = ATOMIC_FLAG_INIT;
+};
+
+
+/**
+ * \brief Node of a lock free container.
+ * \details
+ * Nodes are reference counted, so that hazard pointers can protect them.
+ * Once the last reference goes away, the memory is returned to the pool.
+ */
+template<typename T>
+class lockfree_node {
+ public:
+  ///\brief Pool type for nodes.
+  using pool_type = node_pool<lockfree_node>;
+
+  lockfree_node(pool_type& pool, cycle_gptr<T>&& value) noexcept
+  : value(std::move(value)),
+    pool_(pool)
+  {}
+
+  lockfree_node(const lockfree_node&) = delete;
+
+  ///\brief Create a node.
+  ///\throws std::bad_alloc If there is not enough memory.
+  static auto create(pool_type& pool, cycle_gptr<T>&& value)
+  -> intrusive_ptr<lockfree_node> {
+    return intrusive_ptr<lockfree_node>(
+        new (pool.allocate()) lockfree_node(pool, std::move(value)),
+        false);
+  }
+
+  ///\brief Next node in the container.
+  hazard_ptr<lockfree_node> next;
+  ///\brief Value of the node.
+  ///\details Only accessed by the thread that unlinks the node.
+  cycle_gptr<T> value;
+
+ private:
+  friend auto intrusive_ptr_add_ref(lockfree_node* n)
+  noexcept
+  -> void {
+    n->refs_.fetch_add(1u, std::memory_order_relaxed);
+  }
+
+  friend auto intrusive_ptr_release(lockfree_node* n)
+  noexcept
+  -> void {
+    // Unlinked nodes keep their next link, so a stale reference to a node
+    // can keep a long chain of unlinked nodes alive.
+    // Release the chain iteratively, instead of recursing into next.
+    while (n != nullptr && n->refs_.fetch_sub(1u, std::memory_order_acq_rel) == 1u) {
+      lockfree_node*const next = n->next.exchange(nullptr).detach();
+      pool_type& pool = n->pool_;
+      n->~lockfree_node();
+      pool.deallocate(static_cast<void*>(n));
+      n = next;
+    }
+  }
+
+  ///\brief Reference counter.
+  std::atomic<std::uintptr_t> refs_{ 1u };
+  ///\brief Pool to which the node is returned.
+  pool_type& pool_;
+};
+
+
+} /* namespace cycle_ptr::detail */
+
+
+/**
+ * \brief Lock free multi-producer, multi-consumer queue of cycle_gptr.
+ * \details
+ * Implements the Michael-Scott queue.
+ * Nodes are protected by hazard pointers, and their memory is reused
+ * through a pool.
+ *
+ * Elements in the queue are held as \ref cycle_gptr, so they are
+ * considered reachable while in the queue.
+ * \tparam T The type of object pointed at by the elements.
+ */
+template<typename T>
+class concurrent_queue {
+ private:
+  using node = detail::lockfree_node<T>;
+  using node_ptr = detail::intrusive_ptr<node>;
+
+ public:
+  ///\brief Element type of the pointers in the queue.
+  using element_type = T;
+
+  ///\brief Create an empty queue.
+  ///\throws std::bad_alloc If there is not enough memory.
+  concurrent_queue()
+  : head_(node::create(pool_, nullptr))
+  {
+    tail_ = head_.load();
+  }
+
+  concurrent_queue(const concurrent_queue&) = delete;
+  auto operator=(const concurrent_queue&) -> concurrent_queue& = delete;
+
+  ///\brief Destructor.
+  ///\pre No other thread is accessing this queue.
+  ~concurrent_queue() noexcept {
+    // Pop iteratively, as releasing the head would release its successors recursively.
+    cycle_gptr<T> discard;
+    while (try_pop(discard)) discard.reset();
+
+    tail_.reset();
+    head_.reset();
+  }
+
+  ///\brief Test if the queue is empty.
+  ///\note Other threads may change the queue concurrently.
+  auto empty() const
+  noexcept
+  -> bool {
+    return head_.load()->next == nullptr;
+  }
+
+  /**
+   * \brief Append \p value to the queue.
+   * \throws std::bad_alloc If there is not enough memory.
+   */
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  auto push(cycle_gptr<U> value)
+  -> void {
+    const node_ptr n = node::create(pool_, cycle_gptr<T>(std::move(value)));
+
+    node_ptr t = tail_.load();
+    for (;;) {
+      node_ptr next = nullptr;
+      if (t->next.compare_exchange_weak(next, n)) break;
+
+      // Tail is lagging behind, help advance it.
+      if (next != nullptr && tail_.compare_exchange_weak(t, next)) t = std::move(next);
+    }
+
+    // Swing tail to the new node.
+    // If this fails, another thread already advanced it.
+    tail_.compare_exchange_strong(t, n);
+  }
+
+  /**
+   * \brief Remove the element at the front of the queue.
+   * \param[out] value Assigned the removed element.
+   * \returns True if an element was removed, false if the queue was empty.
+   */
+  auto try_pop(cycle_gptr<T>& value)
+  noexcept
+  -> bool {
+    node_ptr h = head_.load();
+    for (;;) {
+      node_ptr next = h->next.load();
+      if (next == nullptr) return false;
+
+      // Don't let head pass tail.
+      node_ptr t = h;
+      tail_.compare_exchange_strong(t, next);
+
+      if (head_.compare_exchange_weak(h, next)) {
+        // next is the new dummy node; we are the only thread to unlink it,
+        // so we are the only thread to access its value.
+        value = std::move(next->value);
+        return true;
+      }
+    }
+  }
+
+ private:
+  ///\brief Pool of node memory.
+  ///\details Declared first, so that it is destroyed last.
+  typename node::pool_type pool_;
+  ///\brief Dummy node, preceding the front of the queue.
+  detail::hazard_ptr<node> head_;
+  ///\brief Last node in the queue, or a node shortly before it.
+  detail::hazard_ptr<node> tail_;
+};
+
+
+/**
+ * \brief Lock free stack of cycle_gptr.
+ * \details
+ * Implements the Treiber stack.
+ * Nodes are protected by hazard pointers, and their memory is reused
+ * through a pool.
+ *
+ * Elements in the stack are held as \ref cycle_gptr, so they are
+ * considered reachable while in the stack.
+ * \tparam T The type of object pointed at by the elements.
+ */
+template<typename T>
+class concurrent_stack {
+ private:
+  using node = detail::lockfree_node<T>;
+  using node_ptr = detail::intrusive_ptr<node>;
+
+ public:
+  ///\brief Element type of the pointers in the stack.
+  using element_type = T;
+
+  ///\brief Create an empty stack.
+  concurrent_stack() noexcept = default;
+
+  concurrent_stack(const concurrent_stack&) = delete;
+  auto operator=(const concurrent_stack&) -> concurrent_stack& = delete;
+
+  ///\brief Destructor.
+  ///\pre No other thread is accessing this stack.
+  ~concurrent_stack() noexcept {
+    // Pop iteratively, as releasing the head would release its successors recursively.
+    cycle_gptr<T> discard;
+    while (try_pop(discard)) discard.reset();
+  }
+
+  ///\brief Test if the stack is empty.
+  ///\note Other threads may change the stack concurrently.
+  auto empty() const
+  noexcept
+  -> bool {
+    return head_ == nullptr;
+  }
+
+  /**
+   * \brief Push \p value on the stack.
+   * \throws std::bad_alloc If there is not enough memory.
+   */
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  auto push(cycle_gptr<U> value)
+  -> void {
+    const node_ptr n = node::create(pool_, cycle_gptr<T>(std::move(value)));
+
+    node_ptr h = head_.load();
+    do {
+      n->next = h;
+    } while (!head_.compare_exchange_weak(h, n));
+  }
+
+  /**
+   * \brief Remove the element at the top of the stack.
+   * \param[out] value Assigned the removed element.
+   * \returns True if an element was removed, false if the stack was empty.
+   */
+  auto try_pop(cycle_gptr<T>& value)
+  noexcept
+  -> bool {
+    // Since h holds a reference, its memory can't be reused
+    // while we look at it, which prevents the ABA problem.
+    node_ptr h = head_.load();
+    while (h != nullptr) {
+      if (head_.compare_exchange_weak(h, h->next.load())) {
+        value = std::move(h->value);
+        h->next.reset(); // Don't keep the rest of the stack alive.
+        return true;
+      }
+    }
+    return false;
+  }
+
+ private:
+  ///\brief Pool of node memory.
+  ///\details Declared first, so that it is destroyed last.
+  typename node::pool_type pool_;
+  ///\brief Top of the stack.
+  detail::hazard_ptr<node> head_;
+};
+
+
+} /* namespace cycle_ptr */
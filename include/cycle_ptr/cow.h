@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cycle_ptr.h>
+#include <cassert>
+#include <type_traits>
+#include <utility>
+
+namespace cycle_ptr {
+
+
+/**
+ * \brief Copy-on-write handle to an object.
+ * \details
+ * Copying the handle shares the object.
+ * Read access never copies.
+ * Write access copies the object, unless \ref cycle_gptr::is_unique reports
+ * that this handle holds the only pointer to it.
+ * So a sequence of writes through the same handle copies at most once.
+ *
+ * The object is copied by its copy constructor, so pointers held by the
+ * object are shared between the original and the copy.
+ *
+ * Like \ref cycle_gptr, a single handle may not be modified while
+ * other threads access it.
+ * Distinct handles sharing an object may be used concurrently.
+ *
+ * The handle holds a \ref cycle_gptr, so it is not meant to be a member
+ * of a cycle managed object.
+ *
+ * \code
+ * cow<Config> a = make_cow<Config>();
+ * cow<Config> b = a;       // Shares the object.
+ * b.write().verbose = true; // Copies, since a shares the object.
+ * b.write().level = 3;      // In place, b is now unique.
+ * \endcode
+ *
+ * \tparam T The type of object. Must be copy constructible.
+ */
+template<typename T>
+class cow {
+  static_assert(!std::is_const_v<T>, "cow requires a mutable type.");
+
+ public:
+  ///\brief Type of the object.
+  using element_type = T;
+
+  ///\brief Create a handle that holds no object.
+  ///\post get() == nullptr
+  cow() noexcept = default;
+
+  ///\brief Create a handle to \p ptr.
+  ///\details Writes copy the object, while \p ptr is shared.
+  explicit cow(cycle_gptr<T> ptr) noexcept
+  : ptr_(std::move(ptr))
+  {}
+
+  cow(const cow&) noexcept = default;
+  cow(cow&&) noexcept = default;
+  auto operator=(const cow&) noexcept -> cow& = default;
+  auto operator=(cow&&) noexcept -> cow& = default;
+
+  ///\brief Address of the object, for reading.
+  auto get() const
+  noexcept
+  -> const T* {
+    return ptr_.get();
+  }
+
+  /**
+   * \brief Read access to the object.
+   * \attention If ``get() == nullptr``, behaviour is undefined.
+   */
+  auto operator*() const
+  noexcept
+  -> const T& {
+    assert(get() != nullptr);
+    return *get();
+  }
+
+  /**
+   * \brief Read access to the object.
+   * \attention If ``get() == nullptr``, behaviour is undefined.
+   */
+  auto operator->() const
+  noexcept
+  -> const T* {
+    assert(get() != nullptr);
+    return get();
+  }
+
+  ///\brief Test if this holds an object.
+  explicit operator bool() const noexcept {
+    return get() != nullptr;
+  }
+
+  /**
+   * \brief Test if writes would modify the object in place.
+   * \details Conservative, see \ref cycle_gptr::is_unique.
+   */
+  auto unique() const
+  noexcept
+  -> bool {
+    return ptr_.is_unique();
+  }
+
+  /**
+   * \brief Share the object.
+   * \details
+   * While the returned pointer is alive, writes to this handle copy the object.
+   */
+  auto share() const
+  noexcept
+  -> cycle_gptr<const T> {
+    return ptr_;
+  }
+
+  /**
+   * \brief Write access to the object.
+   * \details
+   * Copies the object first, unless this is the only pointer to it.
+   * \attention If ``get() == nullptr``, behaviour is undefined.
+   * \returns Reference to the object, which is valid until this handle
+   * is modified or copied.
+   */
+  auto write()
+  -> T& {
+    assert(ptr_ != nullptr);
+    if (!ptr_.is_unique()) ptr_ = make_cycle<T>(std::as_const(*ptr_));
+    return *ptr_;
+  }
+
+  ///\brief Release the object.
+  ///\post get() == nullptr
+  auto reset()
+  noexcept
+  -> void {
+    ptr_.reset();
+  }
+
+  ///\brief Swap with \p other.
+  auto swap(cow& other)
+  noexcept
+  -> void {
+    ptr_.swap(other.ptr_);
+  }
+
+  ///\brief Test if \p x and \p y share the same object.
+  friend auto operator==(const cow& x, const cow& y)
+  noexcept
+  -> bool {
+    return x.ptr_ == y.ptr_;
+  }
+
+  ///\brief Test if \p x and \p y don't share the same object.
+  friend auto operator!=(const cow& x, const cow& y)
+  noexcept
+  -> bool {
+    return !(x == y);
+  }
+
+ private:
+  ///\brief Pointer to the object.
+  cycle_gptr<T> ptr_;
+};
+
+///\brief Swap \p x and \p y.
+///\relates cow
+template<typename T>
+auto swap(cow<T>& x, cow<T>& y)
+noexcept
+-> void {
+  x.swap(y);
+}
+
+/**
+ * \brief Create a copy-on-write handle to a new object.
+ * \relates cow
+ * \param args Arguments to the constructor of \p T.
+ */
+template<typename T, typename... Args>
+auto make_cow(Args&&... args)
+-> cow<T> {
+  return cow<T>(make_cycle<T>(std::forward<Args>(args)...));
+}
+
+
+} /* namespace cycle_ptr */
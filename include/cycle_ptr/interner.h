@@ -0,0 +1,255 @@
+#pragma once
+
+#include <cycle_ptr.h>
+#include <cycle_ptr/weak_cache.h>
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <iterator>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cycle_ptr {
+
+
+/**
+ * \brief Concurrent hash-consing table.
+ * \details
+ * Maps values to a canonical object holding that value:
+ * interning two equal values yields the same \ref cycle_gptr.
+ * This deduplicates structurally equal, immutable objects.
+ *
+ * The table holds weak pointers to its objects, and forgets an object
+ * once the GC collects it (see \ref weak_cache).
+ *
+ * Values passed to \ref intern are usually temporaries, so any
+ * \ref cycle_member_ptr inside them must be created with \ref unowned_cycle.
+ * The canonical object is a copy, owned by its own control block.
+ *
+ * \code
+ * interner<Expr, ExprHash> exprs;
+ * cycle_gptr<Expr> x = exprs.intern(Expr('+', a, b));
+ * \endcode
+ *
+ * \tparam T Type of the interned objects. Must be copy or move constructible.
+ * \tparam Hash Hash function for values.
+ * \tparam KeyEqual Equality comparison for values.
+ */
+template<typename T, typename Hash = std::hash<T>, typename KeyEqual = std::equal_to<T>>
+class interner {
+ public:
+  ///\brief Type of the interned objects.
+  using element_type = T;
+  ///\brief Size type of the table.
+  using size_type = std::size_t;
+  ///\brief Hash function.
+  using hasher = Hash;
+  ///\brief Value equality comparison.
+  using key_equal = KeyEqual;
+
+ private:
+  using entry = detail::weak_entry<T>;
+  using entry_ptr = detail::intrusive_ptr<entry>;
+
+  ///\brief Hash function for the precomputed hash codes.
+  struct identity_hash {
+    auto operator()(std::size_t hash) const
+    noexcept
+    -> std::size_t {
+      return hash;
+    }
+  };
+
+  ///\brief Shard of the table.
+  struct shard {
+    ///\brief Protects map.
+    std::mutex mtx;
+    ///\brief Entries in this shard, by hash code.
+    std::unordered_multimap<std::size_t, entry_ptr, identity_hash> map;
+  };
+
+ public:
+  ///\brief Create an empty table with \p shard_count shards.
+  explicit interner(size_type shard_count = 16u)
+  : shard_count_(std::max(shard_count, size_type(1))),
+    shards_(std::make_unique<shard[]>(shard_count_))
+  {}
+
+  interner(const interner&) = delete;
+  auto operator=(const interner&) -> interner& = delete;
+
+  ///\brief Destructor.
+  ///\pre No other thread is accessing this table.
+  ~interner() noexcept {
+    for (size_type i = 0; i < shard_count_; ++i) {
+      for (auto& [hash, e] : shards_[i].map) e->remove();
+      shards_[i].map.clear();
+    }
+    // Entries whose hook fired before they were removed.
+    prune();
+  }
+
+  ///\brief Number of objects in the table.
+  ///\note Includes objects that were collected, but which haven't been pruned yet.
+  ///\note Other threads may change the size concurrently.
+  auto size() const
+  noexcept
+  -> size_type {
+    return size_.load(std::memory_order_relaxed);
+  }
+
+  ///\brief Test if the table is empty.
+  ///\note Other threads may change the size concurrently.
+  auto empty() const
+  noexcept
+  -> bool {
+    return size() == 0u;
+  }
+
+  /**
+   * \brief Retrieve the canonical object equal to \p value.
+   * \details
+   * If there is no such object, one is created by copying \p value.
+   * The object is created without holding any locks, so that its
+   * constructor may use this table.
+   * \returns Pointer to the canonical object equal to \p value.
+   */
+  auto intern(const T& value)
+  -> cycle_gptr<T> {
+    return intern_(value, [&value]() { return make_cycle<T>(value); });
+  }
+
+  /**
+   * \brief Retrieve the canonical object equal to \p value.
+   * \details
+   * If there is no such object, one is created by moving \p value.
+   * The object is created without holding any locks, so that its
+   * constructor may use this table.
+   * \returns Pointer to the canonical object equal to \p value.
+   */
+  auto intern(T&& value)
+  -> cycle_gptr<T> {
+    return intern_(value, [&value]() { return make_cycle<T>(std::move(value)); });
+  }
+
+  /**
+   * \brief Retrieve the canonical object equal to \p *ptr.
+   * \details
+   * If there is no such object, \p ptr becomes the canonical object.
+   * \returns Pointer to the canonical object equal to \p *ptr.
+   */
+  auto intern(cycle_gptr<T> ptr)
+  -> cycle_gptr<T> {
+    if (ptr == nullptr) return nullptr;
+    const T& value = *ptr;
+    return intern_(value, [&ptr]() { return std::move(ptr); });
+  }
+
+  /**
+   * \brief Remove entries whose object was collected.
+   * \details
+   * Only visits the entries queued by the GC.
+   * Every other operation on the table does this implicitly.
+   */
+  auto prune()
+  noexcept
+  -> void {
+    entry* e = collected_.take();
+    while (e != nullptr) {
+      // Take over the reference held by the queue.
+      const entry_ptr ep = entry_ptr(e, false);
+      e = ep->next_collected;
+
+      shard& s = shard_(ep->hash);
+      std::lock_guard<std::mutex> lck{ s.mtx };
+      const auto [b, end] = s.map.equal_range(ep->hash);
+      const auto pos = std::find_if(b, end, [&ep](const auto& v) { return v.second == ep; });
+      if (pos != end) {
+        s.map.erase(pos);
+        size_.fetch_sub(1u, std::memory_order_relaxed);
+      }
+    }
+  }
+
+ private:
+  ///\brief Retrieve the shard for hash code \p hash.
+  auto shard_(std::size_t hash) const
+  noexcept
+  -> shard& {
+    return shards_[hash % shard_count_];
+  }
+
+  /**
+   * \brief Find a live object equal to \p value.
+   * \pre The caller holds the lock on \p s.
+   * \param[out] rejected Receives the live objects that compared unequal.
+   * The caller must release these after unlocking \p s, as dropping the
+   * last reference runs their destructor, which may use this table.
+   */
+  auto find_(shard& s, std::size_t hash, const T& value, std::vector<cycle_gptr<T>>& rejected) const
+  -> cycle_gptr<T> {
+    const auto [b, end] = s.map.equal_range(hash);
+    // Reserve up front, so no candidate is dropped if this throws.
+    rejected.reserve(rejected.size() + static_cast<std::size_t>(std::distance(b, end)));
+    for (auto i = b; i != end; ++i) {
+      cycle_gptr<T> candidate = i->second->value.lock();
+      if (candidate == nullptr) continue;
+      if (std::invoke(eq_fn_, std::as_const(*candidate), value)) return candidate;
+      rejected.push_back(std::move(candidate));
+    }
+    return nullptr;
+  }
+
+  /**
+   * \brief Intern implementation.
+   * \param value The value to look up.
+   * \param create Functor returning a new canonical object for \p value.
+   */
+  template<typename Fn>
+  auto intern_(const T& value, Fn&& create)
+  -> cycle_gptr<T> {
+    prune();
+
+    const std::size_t hash = std::invoke(hash_fn_, value);
+    shard& s = shard_(hash);
+    // Objects that compared unequal are released after unlocking.
+    std::vector<cycle_gptr<T>> rejected;
+    {
+      std::lock_guard<std::mutex> lck{ s.mtx };
+      if (cycle_gptr<T> existing = find_(s, hash, value, rejected))
+        return existing;
+    }
+    rejected.clear();
+
+    cycle_gptr<T> created = std::invoke(create);
+
+    std::lock_guard<std::mutex> lck{ s.mtx };
+    // Another thread may have interned an equal value, while we weren't looking.
+    // If so, the object we created is released after unlocking.
+    if (cycle_gptr<T> existing = find_(s, hash, *created, rejected))
+      return existing;
+
+    s.map.emplace(hash, entry_ptr(new entry(collected_, hash, created), false));
+    size_.fetch_add(1u, std::memory_order_relaxed);
+    return created;
+  }
+
+  ///\brief Hash function.
+  hasher hash_fn_;
+  ///\brief Value equality comparison.
+  key_equal eq_fn_;
+  ///\brief Number of shards.
+  const size_type shard_count_;
+  ///\brief Shards.
+  const std::unique_ptr<shard[]> shards_;
+  ///\brief Entries whose object was collected.
+  typename entry::queue collected_;
+  ///\brief Number of entries.
+  std::atomic<size_type> size_{ 0u };
+};
+
+
+} /* namespace cycle_ptr */
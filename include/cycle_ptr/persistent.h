@@ -0,0 +1,1022 @@
+#pragma once
+
+#include <cycle_ptr.h>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace cycle_ptr {
+namespace detail {
+
+
+/**
+ * \brief Reference counter for nodes in persistent containers.
+ * \details
+ * Counts the containers and parent nodes referencing a node.
+ * A node that is referenced once, through a path of nodes that are
+ * referenced once, is reachable from a single container only.
+ * Such a node can be modified in place instead of copied.
+ *
+ * The count is conservative: references from containers that are destroyed
+ * together with their owner are never removed.
+ * Such nodes are copied on modification, which is always correct.
+ *
+ * Note that the count is distinct from the reference counter of the control
+ * block, which only counts cycle_gptr instances.
+ */
+class persistent_shares {
+ public:
+  persistent_shares() noexcept = default;
+  persistent_shares(const persistent_shares&) = delete;
+
+  ///\brief Test if this node is referenced once.
+  auto unique() const
+  noexcept
+  -> bool {
+    return shares_.load(std::memory_order_acquire) == 1u;
+  }
+
+  ///\brief Add a reference.
+  auto share() const
+  noexcept
+  -> void {
+    shares_.fetch_add(1u, std::memory_order_relaxed);
+  }
+
+  ///\brief Remove a reference.
+  ///\returns True if this was the last reference.
+  auto unshare() const
+  noexcept
+  -> bool {
+    return shares_.fetch_sub(1u, std::memory_order_acq_rel) == 1u;
+  }
+
+ private:
+  ///\brief Number of references to this node.
+  mutable std::atomic<std::uintptr_t> shares_{ 1u };
+};
+
+
+} /* namespace cycle_ptr::detail */
+
+
+/**
+ * \brief Persistent vector of cycle pointers.
+ * \details
+ * A radix balanced tree, where each node has up to 32 children.
+ * The nodes are managed by cycle_ptr, and the elements are held as
+ * \ref cycle_member_ptr from the leaf nodes.
+ * So elements may point back at the object holding the vector.
+ *
+ * Copying the vector is O(1), as the copy shares all nodes with the
+ * original.
+ * Modifications are O(log n): they copy the path to the modified element.
+ * Nodes that are only reachable from this vector are modified in place,
+ * so repeated modifications of the same vector only copy a path once.
+ *
+ * Like standard containers, a single vector may not be modified while
+ * other threads access it.
+ * Distinct vectors sharing nodes may be used concurrently.
+ *
+ * \code
+ * class Document
+ * : public cycle_base
+ * {
+ *  public:
+ *   persistent_vector<Page> pages;
+ * };
+ *
+ * persistent_vector<Page> snapshot{ unowned_cycle, doc->pages };
+ * \endcode
+ *
+ * \tparam T The type of object pointed at by the elements.
+ */
+template<typename T>
+class persistent_vector {
+ public:
+  ///\brief Type of object the elements point at.
+  using element_type = T;
+  ///\brief Size type of the vector.
+  using size_type = std::size_t;
+
+ private:
+  ///\brief Number of bits of the index consumed per level.
+  static constexpr unsigned bits = 5u;
+  ///\brief Number of children of a node.
+  static constexpr size_type width = size_type(1) << bits;
+  ///\brief Mask for the index of a child.
+  static constexpr size_type mask = width - 1u;
+
+  ///\brief Node in the tree.
+  ///\details Leaves hold values, the other nodes hold children.
+  class node
+  : private cycle_base,
+    public detail::persistent_shares
+  {
+   public:
+    ///\brief Allocator for the edges of the node.
+    template<typename U>
+    using allocator_type = cycle_allocator<std::allocator<cycle_member_ptr<U>>>;
+
+    node()
+    : cycle_base(),
+      children(allocator_type<node>(static_cast<const cycle_base&>(*this))),
+      values(allocator_type<T>(static_cast<const cycle_base&>(*this)))
+    {}
+
+    ///\brief Copy a node, sharing its children.
+    node(const node& y)
+    : cycle_base(),
+      detail::persistent_shares(),
+      children(y.children.begin(), y.children.end(), allocator_type<node>(static_cast<const cycle_base&>(*this))),
+      values(y.values.begin(), y.values.end(), allocator_type<T>(static_cast<const cycle_base&>(*this)))
+    {
+      for (const auto& c : children) c->share();
+    }
+
+    ///\brief Remove a reference to this node.
+    ///\details If it was the last reference, the node no longer references its children.
+    auto release() const
+    noexcept
+    -> void {
+      if (unshare()) {
+        for (const auto& c : children) c->release();
+      }
+    }
+
+    ///\brief Replace the child at index \p k with \p c.
+    auto replace_child(size_type k, cycle_gptr<node>&& c)
+    -> void {
+      children[k]->release();
+      children[k] = std::move(c);
+    }
+
+    ///\brief Child nodes.
+    std::vector<cycle_member_ptr<node>, allocator_type<node>> children;
+    ///\brief Values in a leaf.
+    std::vector<cycle_member_ptr<T>, allocator_type<T>> values;
+  };
+
+ public:
+  /**
+   * \brief Default constructor acquires its owner from context.
+   * \details
+   * Uses the same publisher logic as \ref cycle_member_ptr.
+   * \throws std::runtime_error if no range was published.
+   */
+  persistent_vector()
+  : owner_(detail::base_control::publisher_lookup(this, sizeof(*this)))
+  {}
+
+  /**
+   * \brief Create an unowned vector.
+   * \details
+   * Makes the elements in this vector behave like cycle_gptr.
+   */
+  explicit persistent_vector(unowned_cycle_t unowned_tag)
+  : owner_(detail::base_control::unowned_control()),
+    root_(unowned_tag)
+  {}
+
+  /**
+   * \brief Copy constructor acquires its owner from context.
+   * \details
+   * The copy shares all nodes with \p y.
+   * \throws std::runtime_error if no range was published.
+   */
+  persistent_vector(const persistent_vector& y)
+  : owner_(detail::base_control::publisher_lookup(this, sizeof(*this))),
+    root_(y.root_),
+    size_(y.size_),
+    shift_(y.shift_)
+  {
+    if (root_ != nullptr) root_->share();
+  }
+
+  ///\brief Create an unowned copy of \p y.
+  ///\details The copy shares all nodes with \p y.
+  persistent_vector(unowned_cycle_t unowned_tag, const persistent_vector& y)
+  : owner_(detail::base_control::unowned_control()),
+    root_(unowned_tag, y.root_),
+    size_(y.size_),
+    shift_(y.shift_)
+  {
+    if (root_ != nullptr) root_->share();
+  }
+
+  ///\brief Destructor.
+  ~persistent_vector() noexcept {
+    // If the owner is expired, the nodes may already have been destroyed.
+    if (root_ != nullptr && !owner_->expired()) root_->release();
+  }
+
+  ///\brief Copy assignment.
+  ///\details After assignment, this shares all nodes with \p y.
+  auto operator=(const persistent_vector& y)
+  -> persistent_vector& {
+    if (y.root_ != nullptr) y.root_->share();
+    if (root_ != nullptr) root_->release();
+    root_ = y.root_;
+    size_ = y.size_;
+    shift_ = y.shift_;
+    return *this;
+  }
+
+  ///\brief Number of elements.
+  auto size() const
+  noexcept
+  -> size_type {
+    return size_;
+  }
+
+  ///\brief Test if the vector is empty.
+  auto empty() const
+  noexcept
+  -> bool {
+    return size_ == 0u;
+  }
+
+  /**
+   * \brief Retrieve the element at index \p i.
+   * \pre \p i < size()
+   */
+  auto get(size_type i) const
+  noexcept
+  -> cycle_gptr<T> {
+    assert(i < size_);
+    return cycle_gptr<T>(leaf_(i)->values[i & mask]);
+  }
+
+  ///\brief Retrieve the element at index \p i.
+  ///\throws std::out_of_range if \p i is not a valid index.
+  auto at(size_type i) const
+  -> cycle_gptr<T> {
+    if (i >= size_) throw std::out_of_range("cycle_ptr::persistent_vector: index out of range");
+    return get(i);
+  }
+
+  ///\brief Retrieve the element at index \p i.
+  auto operator[](size_type i) const
+  noexcept
+  -> cycle_gptr<T> {
+    return get(i);
+  }
+
+  /**
+   * \brief Assign \p value to the element at index \p i.
+   * \pre \p i < size()
+   * \throws std::bad_alloc If there is not enough memory.
+   */
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  auto set(size_type i, cycle_gptr<U> value)
+  -> void {
+    assert(i < size_);
+    replace_root_(set_(root_, shift_, i, cycle_gptr<T>(std::move(value)), true));
+  }
+
+  /**
+   * \brief Append \p value.
+   * \throws std::bad_alloc If there is not enough memory.
+   */
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  auto push_back(cycle_gptr<U> value)
+  -> void {
+    cycle_gptr<T> v = std::move(value);
+
+    if (root_ == nullptr) {
+      root_ = new_path_(0u, std::move(v));
+    } else if (size_ == (width << shift_)) {
+      // Tree is full, add a level.
+      // The old root is moved from this to the new root,
+      // so its reference count stays the same.
+      cycle_gptr<node> new_root = make_cycle<node>();
+      new_root->children.reserve(width);
+      new_root->children.emplace_back(root_);
+      new_root->children.emplace_back(new_path_(shift_, std::move(v)));
+      root_ = std::move(new_root);
+      shift_ += bits;
+    } else {
+      replace_root_(push_(root_, shift_, size_, std::move(v), true));
+    }
+    ++size_;
+  }
+
+  /**
+   * \brief Remove the last element.
+   * \pre !empty()
+   * \throws std::bad_alloc If there is not enough memory.
+   */
+  auto pop_back()
+  -> void {
+    assert(size_ > 0u);
+    if (size_ == 1u) {
+      clear();
+      return;
+    }
+
+    replace_root_(pop_(root_, shift_, size_ - 1u, true));
+    --size_;
+
+    // Remove a level, if the root has a single child.
+    if (shift_ > 0u && root_->children.size() == 1u) {
+      cycle_gptr<node> child = root_->children.front();
+      child->share();
+      root_->release();
+      root_ = std::move(child);
+      shift_ -= bits;
+    }
+  }
+
+  ///\brief Remove all elements.
+  auto clear()
+  noexcept
+  -> void {
+    if (root_ != nullptr) root_->release();
+    root_.reset();
+    size_ = 0;
+    shift_ = 0;
+  }
+
+ private:
+  ///\brief Find the leaf holding the element at index \p i.
+  auto leaf_(size_type i) const
+  noexcept
+  -> const node* {
+    // Raw pointers suffice: the nodes are reachable from root_,
+    // and can't change while we read them.
+    const node* n = root_.get();
+    for (unsigned shift = shift_; shift > 0u; shift -= bits)
+      n = n->children[(i >> shift) & mask].get();
+    return n;
+  }
+
+  ///\brief Replace the root with \p r.
+  auto replace_root_(cycle_gptr<node>&& r)
+  noexcept
+  -> void {
+    if (r == root_) return;
+    if (root_ != nullptr) root_->release();
+    root_ = std::move(r);
+  }
+
+  ///\brief Return \p n if it may be modified in place, or a copy of \p n otherwise.
+  static auto writable_(cycle_gptr<node> n, bool owned)
+  -> cycle_gptr<node> {
+    if (owned) return n;
+    return make_cycle<node>(*n);
+  }
+
+  ///\brief Create a path of nodes of height \p shift, ending in a leaf holding \p v.
+  static auto new_path_(unsigned shift, cycle_gptr<T>&& v)
+  -> cycle_gptr<node> {
+    cycle_gptr<node> n = make_cycle<node>();
+    if (shift == 0u) {
+      n->values.reserve(width);
+      n->values.emplace_back(std::move(v));
+    } else {
+      n->children.reserve(width);
+      n->children.emplace_back(new_path_(shift - bits, std::move(v)));
+    }
+    return n;
+  }
+
+  /**
+   * \brief Modify the element at index \p i in the subtree of \p n.
+   * \param n Subtree root.
+   * \param shift Height of the subtree.
+   * \param i Index of the element.
+   * \param v New value of the element.
+   * \param owned True if the parent of \p n may be modified in place.
+   * \returns Subtree root with the modification applied.
+   */
+  static auto set_(cycle_gptr<node> n, unsigned shift, size_type i, cycle_gptr<T>&& v, bool owned)
+  -> cycle_gptr<node> {
+    owned = owned && n->unique();
+    if (shift == 0u) {
+      n = writable_(std::move(n), owned);
+      n->values[i & mask] = std::move(v);
+      return n;
+    }
+
+    const size_type k = (i >> shift) & mask;
+    const cycle_gptr<node> c = n->children[k];
+    cycle_gptr<node> r = set_(c, shift - bits, i, std::move(v), owned);
+    if (r != c) {
+      n = writable_(std::move(n), owned);
+      n->replace_child(k, std::move(r));
+    }
+    return n;
+  }
+
+  ///\brief Append \p v at index \p i in the subtree of \p n.
+  ///\details Arguments and return value are the same as for set_().
+  static auto push_(cycle_gptr<node> n, unsigned shift, size_type i, cycle_gptr<T>&& v, bool owned)
+  -> cycle_gptr<node> {
+    owned = owned && n->unique();
+    if (shift == 0u) {
+      n = writable_(std::move(n), owned);
+      n->values.emplace_back(std::move(v));
+      return n;
+    }
+
+    const size_type k = (i >> shift) & mask;
+    if (k == n->children.size()) {
+      cycle_gptr<node> r = new_path_(shift - bits, std::move(v));
+      n = writable_(std::move(n), owned);
+      n->children.emplace_back(std::move(r));
+      return n;
+    }
+
+    const cycle_gptr<node> c = n->children[k];
+    cycle_gptr<node> r = push_(c, shift - bits, i, std::move(v), owned);
+    if (r != c) {
+      n = writable_(std::move(n), owned);
+      n->replace_child(k, std::move(r));
+    }
+    return n;
+  }
+
+  /**
+   * \brief Remove the element at index \p i, which is the last element in the subtree of \p n.
+   * \details Arguments are the same as for set_().
+   * \returns Subtree root with the element removed, or nullptr if the subtree is empty.
+   */
+  static auto pop_(cycle_gptr<node> n, unsigned shift, size_type i, bool owned)
+  -> cycle_gptr<node> {
+    // If i is the first element in this subtree, the subtree becomes empty.
+    if ((i & ((size_type(1) << (shift + bits)) - 1u)) == 0u) return nullptr;
+
+    owned = owned && n->unique();
+    if (shift == 0u) {
+      n = writable_(std::move(n), owned);
+      n->values.pop_back();
+      return n;
+    }
+
+    const size_type k = (i >> shift) & mask;
+    const cycle_gptr<node> c = n->children[k];
+    cycle_gptr<node> r = pop_(c, shift - bits, i, owned);
+    if (r == nullptr) {
+      n = writable_(std::move(n), owned);
+      n->children.back()->release();
+      n->children.pop_back();
+    } else if (r != c) {
+      n = writable_(std::move(n), owned);
+      n->replace_child(k, std::move(r));
+    }
+    return n;
+  }
+
+  ///\brief Control block of the owner of this vector.
+  ///\details Used to detect if the vector is destroyed during collection of its owner.
+  const detail::intrusive_ptr<detail::base_control> owner_;
+  ///\brief Root of the tree.
+  cycle_member_ptr<node> root_;
+  ///\brief Number of elements.
+  size_type size_ = 0;
+  ///\brief Height of the tree, in bits of the index.
+  unsigned shift_ = 0;
+};
+
+
+/**
+ * \brief Persistent hash map, whose values are cycle pointers.
+ * \details
+ * A hash array mapped trie, where each node has up to 32 entries and children.
+ * The nodes are managed by cycle_ptr, and the values are held as
+ * \ref cycle_member_ptr from the nodes.
+ * So values may point back at the object holding the map.
+ *
+ * Copying the map is O(1), as the copy shares all nodes with the original.
+ * Modifications are O(log n): they copy the path to the modified entry.
+ * Nodes that are only reachable from this map are modified in place,
+ * so repeated modifications of the same map only copy a path once.
+ *
+ * Like standard containers, a single map may not be modified while
+ * other threads access it.
+ * Distinct maps sharing nodes may be used concurrently.
+ *
+ * \tparam Key Key type of the map.
+ * \tparam T Type of object the values in the map point at.
+ * \tparam Hash Hash function for keys.
+ * \tparam KeyEqual Equality comparison for keys.
+ */
+template<typename Key, typename T, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
+class persistent_map {
+ public:
+  ///\brief Key type of the map.
+  using key_type = Key;
+  ///\brief Type of object the values point at.
+  using element_type = T;
+  ///\brief Size type of the map.
+  using size_type = std::size_t;
+  ///\brief Hash function.
+  using hasher = Hash;
+  ///\brief Key equality comparison.
+  using key_equal = KeyEqual;
+
+ private:
+  ///\brief Number of bits of the hash code consumed per level.
+  static constexpr unsigned bits = 5u;
+  ///\brief Mask for the position in a node.
+  static constexpr std::size_t mask = (std::size_t(1) << bits) - 1u;
+  ///\brief Nodes at this shift have consumed the whole hash code, and hold colliding entries.
+  static constexpr unsigned collision_shift = std::numeric_limits<std::size_t>::digits;
+
+  ///\brief A single key-value pair.
+  class entry {
+   public:
+    entry(std::size_t hash, const key_type& key, const cycle_gptr<T>& value)
+    : hash(hash),
+      key(key),
+      value(value)
+    {}
+
+    ///\brief Cached hash code of key.
+    std::size_t hash;
+    ///\brief Key of this entry.
+    key_type key;
+    ///\brief Value of this entry.
+    cycle_member_ptr<T> value;
+  };
+
+  /**
+   * \brief Node in the trie.
+   * \details
+   * The entries and children are ordered by their position in the node.
+   * Their positions are recorded in the datamap and nodemap bitmaps.
+   *
+   * Nodes at collision_shift don't use the bitmaps, and hold entries
+   * with equal hash codes.
+   */
+  class node
+  : private cycle_base,
+    public detail::persistent_shares
+  {
+   public:
+    ///\brief Allocator for the edges of the node.
+    template<typename U>
+    using allocator_type = cycle_allocator<std::allocator<U>>;
+
+    node()
+    : cycle_base(),
+      entries(allocator_type<entry>(static_cast<const cycle_base&>(*this))),
+      children(allocator_type<cycle_member_ptr<node>>(static_cast<const cycle_base&>(*this)))
+    {}
+
+    ///\brief Copy a node, sharing its children.
+    node(const node& y)
+    : cycle_base(),
+      detail::persistent_shares(),
+      datamap(y.datamap),
+      nodemap(y.nodemap),
+      entries(y.entries.begin(), y.entries.end(), allocator_type<entry>(static_cast<const cycle_base&>(*this))),
+      children(y.children.begin(), y.children.end(), allocator_type<cycle_member_ptr<node>>(static_cast<const cycle_base&>(*this)))
+    {
+      for (const auto& c : children) c->share();
+    }
+
+    ///\brief Remove a reference to this node.
+    ///\details If it was the last reference, the node no longer references its children.
+    auto release() const
+    noexcept
+    -> void {
+      if (unshare()) {
+        for (const auto& c : children) c->release();
+      }
+    }
+
+    ///\brief Replace the child at index \p k with \p c.
+    auto replace_child(size_type k, cycle_gptr<node>&& c)
+    -> void {
+      children[k]->release();
+      children[k] = std::move(c);
+    }
+
+    ///\brief Test if the node holds a single entry, which can move into its parent.
+    auto inlinable() const
+    noexcept
+    -> bool {
+      return entries.size() == 1u && children.empty();
+    }
+
+    ///\brief Positions of entries.
+    std::uint32_t datamap = 0;
+    ///\brief Positions of children.
+    std::uint32_t nodemap = 0;
+    ///\brief Entries in this node.
+    std::vector<entry, allocator_type<entry>> entries;
+    ///\brief Child nodes.
+    std::vector<cycle_member_ptr<node>, allocator_type<cycle_member_ptr<node>>> children;
+  };
+
+ public:
+  /**
+   * \brief Default constructor acquires its owner from context.
+   * \details
+   * Uses the same publisher logic as \ref cycle_member_ptr.
+   * \throws std::runtime_error if no range was published.
+   */
+  persistent_map()
+  : owner_(detail::base_control::publisher_lookup(this, sizeof(*this)))
+  {}
+
+  /**
+   * \brief Create an unowned map.
+   * \details
+   * Makes the values in this map behave like cycle_gptr.
+   */
+  explicit persistent_map(unowned_cycle_t unowned_tag)
+  : owner_(detail::base_control::unowned_control()),
+    root_(unowned_tag)
+  {}
+
+  /**
+   * \brief Copy constructor acquires its owner from context.
+   * \details
+   * The copy shares all nodes with \p y.
+   * \throws std::runtime_error if no range was published.
+   */
+  persistent_map(const persistent_map& y)
+  : owner_(detail::base_control::publisher_lookup(this, sizeof(*this))),
+    root_(y.root_),
+    size_(y.size_),
+    hash_fn_(y.hash_fn_),
+    eq_fn_(y.eq_fn_)
+  {
+    if (root_ != nullptr) root_->share();
+  }
+
+  ///\brief Create an unowned copy of \p y.
+  ///\details The copy shares all nodes with \p y.
+  persistent_map(unowned_cycle_t unowned_tag, const persistent_map& y)
+  : owner_(detail::base_control::unowned_control()),
+    root_(unowned_tag, y.root_),
+    size_(y.size_),
+    hash_fn_(y.hash_fn_),
+    eq_fn_(y.eq_fn_)
+  {
+    if (root_ != nullptr) root_->share();
+  }
+
+  ///\brief Destructor.
+  ~persistent_map() noexcept {
+    // If the owner is expired, the nodes may already have been destroyed.
+    if (root_ != nullptr && !owner_->expired()) root_->release();
+  }
+
+  ///\brief Copy assignment.
+  ///\details After assignment, this shares all nodes with \p y.
+  auto operator=(const persistent_map& y)
+  -> persistent_map& {
+    if (y.root_ != nullptr) y.root_->share();
+    if (root_ != nullptr) root_->release();
+    root_ = y.root_;
+    size_ = y.size_;
+    hash_fn_ = y.hash_fn_;
+    eq_fn_ = y.eq_fn_;
+    return *this;
+  }
+
+  ///\brief Number of entries in the map.
+  auto size() const
+  noexcept
+  -> size_type {
+    return size_;
+  }
+
+  ///\brief Test if the map is empty.
+  auto empty() const
+  noexcept
+  -> bool {
+    return size_ == 0u;
+  }
+
+  /**
+   * \brief Look up the value for \p key.
+   * \returns Pointer to the value of \p key, or nullptr if \p key is not present.
+   */
+  auto find(const key_type& key) const
+  -> cycle_gptr<T> {
+    const std::size_t hash = hash_(key);
+
+    // Raw pointers suffice: the nodes are reachable from root_,
+    // and can't change while we read them.
+    const node* n = root_.get();
+    for (unsigned shift = 0; n != nullptr; shift += bits) {
+      if (shift >= collision_shift) {
+        for (const entry& e : n->entries) {
+          if (e.hash == hash && eq_(e.key, key)) return cycle_gptr<T>(e.value);
+        }
+        return nullptr;
+      }
+
+      const std::uint32_t bit = bit_(hash, shift);
+      if (n->datamap & bit) {
+        const entry& e = n->entries[index_(n->datamap, bit)];
+        if (e.hash == hash && eq_(e.key, key)) return cycle_gptr<T>(e.value);
+        return nullptr;
+      }
+      if ((n->nodemap & bit) == 0u) return nullptr;
+      n = n->children[index_(n->nodemap, bit)].get();
+    }
+    return nullptr;
+  }
+
+  ///\brief Test if \p key is present.
+  auto contains(const key_type& key) const
+  -> bool {
+    return find(key) != nullptr;
+  }
+
+  /**
+   * \brief Insert \p value for \p key, if \p key is not present.
+   * \returns True if the value was inserted.
+   * \throws std::bad_alloc If there is not enough memory.
+   */
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  auto insert(const key_type& key, cycle_gptr<U> value)
+  -> bool {
+    return insert_(key, cycle_gptr<T>(std::move(value)), false);
+  }
+
+  /**
+   * \brief Assign \p value to \p key.
+   * \returns True if \p key was not present.
+   * \throws std::bad_alloc If there is not enough memory.
+   */
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  auto insert_or_assign(const key_type& key, cycle_gptr<U> value)
+  -> bool {
+    return insert_(key, cycle_gptr<T>(std::move(value)), true);
+  }
+
+  /**
+   * \brief Remove \p key.
+   * \returns True if \p key was present.
+   * \throws std::bad_alloc If there is not enough memory.
+   */
+  auto erase(const key_type& key)
+  -> bool {
+    if (root_ == nullptr) return false;
+
+    bool erased = false;
+    cycle_gptr<node> r = erase_(root_, 0, hash_(key), key, true, erased);
+    if (r->entries.empty() && r->children.empty()) r.reset();
+    replace_root_(std::move(r));
+    if (erased) --size_;
+    return erased;
+  }
+
+  ///\brief Remove all entries.
+  auto clear()
+  noexcept
+  -> void {
+    if (root_ != nullptr) root_->release();
+    root_.reset();
+    size_ = 0;
+  }
+
+ private:
+  ///\brief Compute hash code of \p key.
+  auto hash_(const key_type& key) const
+  -> std::size_t {
+    return std::invoke(hash_fn_, key);
+  }
+
+  ///\brief Compare keys.
+  auto eq_(const key_type& x, const key_type& y) const
+  -> bool {
+    return std::invoke(eq_fn_, x, y);
+  }
+
+  ///\brief Bit for the position of \p hash in a node at \p shift.
+  static auto bit_(std::size_t hash, unsigned shift)
+  noexcept
+  -> std::uint32_t {
+    return std::uint32_t(1) << ((hash >> shift) & mask);
+  }
+
+  ///\brief Index of \p bit in the entries or children described by \p map.
+  static auto index_(std::uint32_t map, std::uint32_t bit)
+  noexcept
+  -> size_type {
+    std::uint32_t x = map & (bit - 1u);
+    x = x - ((x >> 1) & 0x55555555u);
+    x = (x & 0x33333333u) + ((x >> 2) & 0x33333333u);
+    return (((x + (x >> 4)) & 0x0f0f0f0fu) * 0x01010101u) >> 24;
+  }
+
+  ///\brief Replace the root with \p r.
+  auto replace_root_(cycle_gptr<node>&& r)
+  noexcept
+  -> void {
+    if (r == root_) return;
+    if (root_ != nullptr) root_->release();
+    root_ = std::move(r);
+  }
+
+  ///\brief Return \p n if it may be modified in place, or a copy of \p n otherwise.
+  static auto writable_(cycle_gptr<node> n, bool owned)
+  -> cycle_gptr<node> {
+    if (owned) return n;
+    return make_cycle<node>(*n);
+  }
+
+  ///\brief Implementation of insert() and insert_or_assign().
+  auto insert_(const key_type& key, const cycle_gptr<T>& value, bool assign)
+  -> bool {
+    bool inserted = false;
+    cycle_gptr<node> root = root_;
+    if (root == nullptr) root = make_cycle<node>();
+    replace_root_(insert_(std::move(root), 0, hash_(key), key, value, assign, true, inserted));
+    if (inserted) ++size_;
+    return inserted;
+  }
+
+  /**
+   * \brief Insert or assign \p value for \p key in the subtree of \p n.
+   * \param n Subtree root.
+   * \param shift Depth of the subtree, in bits of the hash code.
+   * \param hash Hash code of \p key.
+   * \param key Key to insert.
+   * \param value Value to insert.
+   * \param assign If set, an existing entry for \p key is assigned \p value.
+   * \param owned True if the parent of \p n may be modified in place.
+   * \param[out] inserted Set to true if a new entry was inserted.
+   * \returns Subtree root with the modification applied.
+   */
+  auto insert_(cycle_gptr<node> n, unsigned shift, std::size_t hash, const key_type& key, const cycle_gptr<T>& value, bool assign, bool owned, bool& inserted)
+  -> cycle_gptr<node> {
+    owned = owned && n->unique();
+
+    if (shift >= collision_shift) {
+      const auto e_iter = std::find_if(
+          n->entries.begin(), n->entries.end(),
+          [&](const entry& e) { return eq_(e.key, key); });
+      const size_type i = e_iter - n->entries.begin();
+      if (e_iter == n->entries.end()) {
+        n = writable_(std::move(n), owned);
+        n->entries.emplace_back(hash, key, value);
+        inserted = true;
+      } else if (assign) {
+        n = writable_(std::move(n), owned);
+        n->entries[i].value = value;
+      }
+      return n;
+    }
+
+    const std::uint32_t bit = bit_(hash, shift);
+    if (n->datamap & bit) {
+      const size_type i = index_(n->datamap, bit);
+      const entry& e = n->entries[i];
+      if (e.hash == hash && eq_(e.key, key)) {
+        if (assign) {
+          n = writable_(std::move(n), owned);
+          n->entries[i].value = value;
+        }
+        return n;
+      }
+
+      // Move both entries into a new child.
+      cycle_gptr<node> child = make_pair_(shift + bits, e, hash, key, value);
+      n = writable_(std::move(n), owned);
+      n->entries.erase(n->entries.begin() + i);
+      n->datamap &= ~bit;
+      n->children.emplace(n->children.begin() + index_(n->nodemap, bit), std::move(child));
+      n->nodemap |= bit;
+      inserted = true;
+      return n;
+    }
+
+    if (n->nodemap & bit) {
+      const size_type k = index_(n->nodemap, bit);
+      const cycle_gptr<node> c = n->children[k];
+      cycle_gptr<node> r = insert_(c, shift + bits, hash, key, value, assign, owned, inserted);
+      if (r != c) {
+        n = writable_(std::move(n), owned);
+        n->replace_child(k, std::move(r));
+      }
+      return n;
+    }
+
+    n = writable_(std::move(n), owned);
+    n->entries.emplace(n->entries.begin() + index_(n->datamap, bit), hash, key, value);
+    n->datamap |= bit;
+    inserted = true;
+    return n;
+  }
+
+  ///\brief Create a subtree at \p shift, holding entry \p e and an entry for \p key.
+  static auto make_pair_(unsigned shift, const entry& e, std::size_t hash, const key_type& key, const cycle_gptr<T>& value)
+  -> cycle_gptr<node> {
+    cycle_gptr<node> n = make_cycle<node>();
+    if (shift >= collision_shift) {
+      n->entries.reserve(2);
+      n->entries.push_back(e);
+      n->entries.emplace_back(hash, key, value);
+      return n;
+    }
+
+    const std::uint32_t e_bit = bit_(e.hash, shift);
+    const std::uint32_t bit = bit_(hash, shift);
+    if (e_bit == bit) {
+      n->children.emplace_back(make_pair_(shift + bits, e, hash, key, value));
+      n->nodemap = bit;
+    } else {
+      n->entries.reserve(2);
+      if (e_bit < bit) {
+        n->entries.push_back(e);
+        n->entries.emplace_back(hash, key, value);
+      } else {
+        n->entries.emplace_back(hash, key, value);
+        n->entries.push_back(e);
+      }
+      n->datamap = e_bit | bit;
+    }
+    return n;
+  }
+
+  /**
+   * \brief Remove \p key from the subtree of \p n.
+   * \details Arguments are the same as for insert_().
+   * \param[out] erased Set to true if the entry was removed.
+   * \returns Subtree root with the entry removed.
+   * The root may have become empty, or hold a single entry.
+   */
+  auto erase_(cycle_gptr<node> n, unsigned shift, std::size_t hash, const key_type& key, bool owned, bool& erased)
+  -> cycle_gptr<node> {
+    owned = owned && n->unique();
+
+    if (shift >= collision_shift) {
+      const auto e_iter = std::find_if(
+          n->entries.begin(), n->entries.end(),
+          [&](const entry& e) { return eq_(e.key, key); });
+      if (e_iter == n->entries.end()) return n;
+      const size_type i = e_iter - n->entries.begin();
+
+      n = writable_(std::move(n), owned);
+      n->entries.erase(n->entries.begin() + i);
+      erased = true;
+      return n;
+    }
+
+    const std::uint32_t bit = bit_(hash, shift);
+    if (n->datamap & bit) {
+      const size_type i = index_(n->datamap, bit);
+      const entry& e = n->entries[i];
+      if (e.hash != hash || !eq_(e.key, key)) return n;
+
+      n = writable_(std::move(n), owned);
+      n->entries.erase(n->entries.begin() + i);
+      n->datamap &= ~bit;
+      erased = true;
+      return n;
+    }
+
+    if (n->nodemap & bit) {
+      const size_type k = index_(n->nodemap, bit);
+      const cycle_gptr<node> c = n->children[k];
+      cycle_gptr<node> r = erase_(c, shift + bits, hash, key, owned, erased);
+      if (r->inlinable()) {
+        // Move the remaining entry of the child into this node.
+        n = writable_(std::move(n), owned);
+        n->entries.emplace(n->entries.begin() + index_(n->datamap, bit), r->entries.front());
+        n->datamap |= bit;
+        n->children[k]->release();
+        n->children.erase(n->children.begin() + k);
+        n->nodemap &= ~bit;
+      } else if (r != c) {
+        n = writable_(std::move(n), owned);
+        n->replace_child(k, std::move(r));
+      }
+      return n;
+    }
+
+    return n;
+  }
+
+  ///\brief Control block of the owner of this map.
+  ///\details Used to detect if the map is destroyed during collection of its owner.
+  const detail::intrusive_ptr<detail::base_control> owner_;
+  ///\brief Root of the trie.
+  cycle_member_ptr<node> root_;
+  ///\brief Number of entries.
+  size_type size_ = 0;
+  ///\brief Hash function.
+  hasher hash_fn_;
+  ///\brief Key equality comparison.
+  key_equal eq_fn_;
+};
+
+
+} /* namespace cycle_ptr */
@@ -0,0 +1,312 @@
+#pragma once
+
+#include <cycle_ptr.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <iterator>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cycle_ptr {
+namespace detail {
+
+
+///\brief Magic bytes at the start of a serialized graph.
+inline constexpr char graph_magic[4] = { 'C', 'Y', 'P', 'G' };
+///\brief Version of the serialized graph format.
+inline constexpr std::uint64_t graph_version = 1u;
+
+
+} /* namespace cycle_ptr::detail */
+
+
+/**
+ * \brief Output of \ref serialize_graph, passed to the codec.
+ * \details
+ * The codec writes the fields of an object, and uses edge() for each
+ * edge that is to be followed.
+ * \tparam T The type of object in the graph.
+ */
+template<typename T>
+class graph_writer {
+  template<typename U, typename Codec>
+  friend auto serialize_graph(std::ostream& out, const cycle_gptr<U>& root, Codec&& codec) -> void;
+
+ public:
+  graph_writer(const graph_writer&) = delete;
+  auto operator=(const graph_writer&) -> graph_writer& = delete;
+
+  ///\brief Write \p n bytes at \p data.
+  auto write(const void* data, std::size_t n)
+  -> void {
+    out_.write(static_cast<const char*>(data), static_cast<std::streamsize>(n));
+  }
+
+  /**
+   * \brief Write \p v.
+   * \details
+   * The value is written in its in-memory representation,
+   * so it can only be read on a machine with the same byte order.
+   */
+  template<typename V>
+  auto write(const V& v)
+  -> void {
+    static_assert(std::is_trivially_copyable_v<V>,
+        "Only trivially copyable values can be written directly.");
+    write(&v, sizeof(v));
+  }
+
+  ///\brief Write \p v as a variable length integer.
+  auto write_size(std::uint64_t v)
+  -> void {
+    char buf[10];
+    std::size_t n = 0;
+    while (v >= 0x80u) {
+      buf[n++] = static_cast<char>((v & 0x7fu) | 0x80u);
+      v >>= 7;
+    }
+    buf[n++] = static_cast<char>(v);
+    write(buf, n);
+  }
+
+  /**
+   * \brief Write the edge \p ptr.
+   * \details
+   * Writes the number of the object pointed at.
+   * Objects are numbered in order of their first edge,
+   * and written in that order, so each object is written once.
+   */
+  template<typename Ptr>
+  auto edge(const Ptr& ptr)
+  -> void {
+    if (ptr == nullptr) {
+      write_size(0u);
+      return;
+    }
+
+    const T* obj = ptr.get();
+    const auto [pos, added] = ids_.emplace(obj, objects_.size());
+    if (added) objects_.push_back(obj);
+    write_size(pos->second + 1u);
+  }
+
+ private:
+  explicit graph_writer(std::ostream& out)
+  : out_(out)
+  {}
+
+  ///\brief Output stream.
+  std::ostream& out_;
+  ///\brief Number of each object.
+  std::unordered_map<const T*, std::uint64_t> ids_;
+  ///\brief Objects, by number.
+  std::vector<const T*> objects_;
+};
+
+
+/**
+ * \brief Input of \ref deserialize_graph, passed to the codec.
+ * \details
+ * The codec creates an object using make(), reading its fields
+ * in the order the codec wrote them, and uses edge() for each
+ * edge that was written.
+ * \tparam T The type of object in the graph.
+ */
+template<typename T>
+class graph_reader {
+  template<typename U, typename Codec>
+  friend auto deserialize_graph(std::istream& in, Codec&& codec) -> cycle_gptr<U>;
+
+ public:
+  graph_reader(const graph_reader&) = delete;
+  auto operator=(const graph_reader&) -> graph_reader& = delete;
+
+  /**
+   * \brief Read \p n bytes into \p data.
+   * \throws std::runtime_error if the input is truncated.
+   */
+  auto read(void* data, std::size_t n)
+  -> void {
+    in_.read(static_cast<char*>(data), static_cast<std::streamsize>(n));
+    if (static_cast<std::size_t>(in_.gcount()) != n)
+      throw std::runtime_error("cycle_ptr: truncated graph");
+  }
+
+  /**
+   * \brief Read a value written by \ref graph_writer::write.
+   * \throws std::runtime_error if the input is truncated.
+   */
+  template<typename V>
+  auto read()
+  -> V {
+    static_assert(std::is_trivially_copyable_v<V>,
+        "Only trivially copyable values can be read directly.");
+    V v;
+    read(&v, sizeof(v));
+    return v;
+  }
+
+  /**
+   * \brief Read a value written by \ref graph_writer::write_size.
+   * \throws std::runtime_error if the input is truncated or malformed.
+   */
+  auto read_size()
+  -> std::uint64_t {
+    std::uint64_t v = 0;
+    for (unsigned shift = 0; shift < 64u; shift += 7u) {
+      const auto c = static_cast<unsigned char>(read<char>());
+      v |= std::uint64_t(c & 0x7fu) << shift;
+      if ((c & 0x80u) == 0u) return v;
+    }
+    throw std::runtime_error("cycle_ptr: malformed graph");
+  }
+
+  /**
+   * \brief Allocate a new object in the generation of the graph.
+   * \param args The arguments passed to the constructor of type \p T.
+   * \returns A cycle_gptr to the new instance of \p T.
+   */
+  template<typename... Args>
+  auto make(Args&&... args)
+  -> cycle_gptr<T> {
+    return builder_.make(std::forward<Args>(args)...);
+  }
+
+  /**
+   * \brief Read an edge, and point \p dst at its object.
+   * \details
+   * The assignment is performed once all objects have been read.
+   * \throws std::runtime_error if the input is truncated or malformed.
+   */
+  auto edge(cycle_member_ptr<T>& dst)
+  -> void {
+    const std::uint64_t id = read_size();
+    if (id == 0u) {
+      dst = nullptr;
+      return;
+    }
+
+    // Objects are numbered in order of their first edge.
+    if (id > expected_ + 1u)
+      throw std::runtime_error("cycle_ptr: malformed graph");
+    if (id > expected_) expected_ = id;
+    builder_.link(dst, static_cast<std::size_t>(id - 1u));
+  }
+
+ private:
+  explicit graph_reader(std::istream& in)
+  : in_(in)
+  {}
+
+  ///\brief Input stream.
+  std::istream& in_;
+  ///\brief Builder for the objects.
+  detail::graph_builder<T> builder_;
+  ///\brief Number of objects referenced so far.
+  std::uint64_t expected_ = 0;
+};
+
+
+/**
+ * \brief Write the graph of objects reachable from \p root to \p out.
+ * \relates graph_writer
+ * \details
+ * The graph is written in a single pass.
+ * The codec is invoked once for each object reached, as
+ * ``codec.write(const T& obj, graph_writer<T>& w)``.
+ * Edges that the codec passes to ``w.edge()`` are followed.
+ *
+ * \code
+ * struct NodeCodec {
+ *   void write(const Node& n, graph_writer<Node>& w) const {
+ *     w.write(n.value);
+ *     w.edge(n.next);
+ *   }
+ *
+ *   cycle_gptr<Node> read(graph_reader<Node>& r) const {
+ *     cycle_gptr<Node> n = r.make(r.read<int>());
+ *     r.edge(n->next);
+ *     return n;
+ *   }
+ * };
+ *
+ * serialize_graph(out, root, NodeCodec());
+ * cycle_gptr<Node> copy = deserialize_graph<Node>(in, NodeCodec());
+ * \endcode
+ *
+ * \pre No other thread modifies the graph while it is written.
+ * \param out The stream to write to.
+ * \param root The root of the graph.
+ * \param codec Codec for objects in the graph.
+ * \throws std::runtime_error if writing to \p out fails.
+ */
+template<typename T, typename Codec>
+auto serialize_graph(std::ostream& out, const cycle_gptr<T>& root, Codec&& codec)
+-> void {
+  graph_writer<T> w{ out };
+  w.write(detail::graph_magic, sizeof(detail::graph_magic));
+  w.write_size(detail::graph_version);
+
+  w.edge(root);
+  for (std::size_t i = 0; i < w.objects_.size(); ++i)
+    codec.write(*w.objects_[i], w);
+
+  if (!out) throw std::runtime_error("cycle_ptr: failed to write graph");
+}
+
+/**
+ * \brief Read a graph written by \ref serialize_graph.
+ * \relates graph_reader
+ * \details
+ * The codec is invoked once for each object, as
+ * ``codec.read(graph_reader<T>& r)``, and returns a new object
+ * created with ``r.make(...)``.
+ *
+ * All objects are allocated in a single new generation.
+ * Edges are assigned after all objects exist, so they never
+ * have to merge generations, nor maintain reference counters.
+ * \param in The stream to read from.
+ * \param codec Codec for objects in the graph.
+ * \returns The root of the graph.
+ * \throws std::runtime_error if the input is truncated or malformed.
+ */
+template<typename T, typename Codec>
+auto deserialize_graph(std::istream& in, Codec&& codec)
+-> cycle_gptr<T> {
+  graph_reader<T> r{ in };
+
+  char magic[sizeof(detail::graph_magic)];
+  r.read(magic, sizeof(magic));
+  if (!std::equal(std::begin(magic), std::end(magic), std::begin(detail::graph_magic)))
+    throw std::runtime_error("cycle_ptr: not a serialized graph");
+  if (r.read_size() != detail::graph_version)
+    throw std::runtime_error("cycle_ptr: unsupported graph version");
+
+  switch (r.read_size()) {
+    case 0u:
+      return nullptr;
+    case 1u:
+      r.expected_ = 1u;
+      break;
+    default:
+      throw std::runtime_error("cycle_ptr: malformed graph");
+  }
+
+  // Each edge may reference the next unread object,
+  // so keep reading until all referenced objects are read.
+  while (r.builder_.size() < r.expected_) {
+    cycle_gptr<T> obj = codec.read(r);
+    if (obj == nullptr) throw std::runtime_error("cycle_ptr: codec returned no object");
+    r.builder_.add(std::move(obj));
+  }
+  return r.builder_.finish();
+}
+
+
+} /* namespace cycle_ptr */
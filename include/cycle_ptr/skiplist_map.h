@@ -0,0 +1,906 @@
+#pragma once
+
+#include <cycle_ptr.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace cycle_ptr {
+namespace detail {
+
+
+/**
+ * \brief Epoch based reclamation, shared by all skiplist maps.
+ * \details
+ * Each thread owns a record, in which it publishes the epoch it is
+ * reading in.
+ * So entering an epoch only writes to memory owned by the calling thread.
+ *
+ * The epoch advances once every reading thread has published the current
+ * epoch.
+ * Memory retired in epoch \e e can be released once the epoch reaches
+ * \e e + 2, since by then every thread that could have been reading it
+ * has left.
+ *
+ * Records are reused once their thread exits, and are never freed.
+ */
+class skiplist_epochs {
+ private:
+  ///\brief Per thread epoch record.
+  struct alignas(hardware_destructive_interference_size) record {
+    ///\brief Epoch in which the thread is reading, shifted left, with the low bit set.
+    ///\details Zero while the thread is not reading.
+    std::atomic<std::uintptr_t> state{ 0u };
+    ///\brief Set while a thread owns this record.
+    std::atomic<bool> owned{ true };
+    ///\brief Number of nested guards of the owning thread.
+    unsigned depth = 0;
+    ///\brief Next record; immutable once the record is published.
+    record* next = nullptr;
+  };
+
+  ///\brief Releases the record of a thread, when the thread exits.
+  struct record_owner {
+    record_owner() noexcept
+    : r(acquire_record_())
+    {}
+
+    record_owner(const record_owner&) = delete;
+
+    ~record_owner() noexcept {
+      r->owned.store(false, std::memory_order_release);
+    }
+
+    record*const r;
+  };
+
+ public:
+  ///\brief Marks the calling thread as reading.
+  class guard {
+   public:
+    guard() noexcept
+    : r_(local_record_())
+    {
+      if (r_.depth++ != 0u) return;
+
+      r_.state.store(
+          (epoch_.load(std::memory_order_relaxed) << 1) | 1u,
+          std::memory_order_relaxed);
+      // Order the publication before the reads that it protects.
+      // Pairs with the fence in try_advance().
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    guard(const guard&) = delete;
+
+    ~guard() noexcept {
+      if (--r_.depth == 0u) r_.state.store(0u, std::memory_order_release);
+    }
+
+   private:
+    record& r_;
+  };
+
+  /**
+   * \brief Epoch in which memory that was just unlinked is retired.
+   * \details
+   * Any thread that could have read the unlinked memory published
+   * this epoch or an earlier one.
+   */
+  static auto retire_epoch()
+  noexcept
+  -> std::uintptr_t {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return epoch_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * \brief Advance the epoch, if every reading thread published the current epoch.
+   * \returns The epoch after the attempt.
+   */
+  static auto try_advance()
+  noexcept
+  -> std::uintptr_t {
+    std::uintptr_t e = epoch_.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    for (const record* r = records_.load(std::memory_order_acquire); r != nullptr; r = r->next) {
+      const std::uintptr_t st = r->state.load(std::memory_order_acquire);
+      if ((st & 1u) != 0u && (st >> 1) != e) return e;
+    }
+
+    if (epoch_.compare_exchange_strong(e, e + 1u, std::memory_order_seq_cst, std::memory_order_relaxed))
+      ++e;
+    return e;
+  }
+
+ private:
+  ///\brief Record of the calling thread.
+  static auto local_record_()
+  noexcept
+  -> record& {
+    thread_local const record_owner owner;
+    return *owner.r;
+  }
+
+  ///\brief Claim a record that no thread owns, or create a new one.
+  static auto acquire_record_()
+  noexcept
+  -> record* {
+    for (record* r = records_.load(std::memory_order_acquire); r != nullptr; r = r->next) {
+      bool expect = false;
+      if (!r->owned.load(std::memory_order_relaxed)
+          && r->owned.compare_exchange_strong(expect, true, std::memory_order_acquire, std::memory_order_relaxed))
+        return r;
+    }
+
+    record*const r = new record();
+    r->next = records_.load(std::memory_order_relaxed);
+    while (!records_.compare_exchange_weak(r->next, r, std::memory_order_release, std::memory_order_relaxed)) {
+      // Retry with the updated r->next.
+    }
+    return r;
+  }
+
+  ///\brief Current epoch.
+  static inline std::atomic<std::uintptr_t> epoch_{ 0u };
+  ///\brief List of all records.
+  static inline std::atomic<record*> records_{ nullptr };
+};
+
+
+} /* namespace cycle_ptr::detail */
+
+
+/**
+ * \brief Concurrent ordered map, whose values are edges from the owner of the map.
+ * \details
+ * Each value in the map is a \ref cycle_member_ptr, owned by the object
+ * containing the map.
+ * Thus the GC sees the map contents, exactly as it would see a
+ * ``std::map`` with a \ref cycle_allocator.
+ * Values may point back at the owner of the map.
+ *
+ * The map is a lock free skiplist (Herlihy, Shavit, "The Art of
+ * Multiprocessor Programming", section 14.4).
+ * Lookups never write to shared memory, other than publishing the current
+ * epoch in a record owned by the calling thread.
+ * Inserts and erases link and unlink nodes using compare-and-swap.
+ *
+ * The forward links between nodes are not cycle edges:
+ * a cycle edge can't be updated with compare-and-swap,
+ * and since all nodes would end up in the same generation,
+ * every unlink would run the GC over the entire map.
+ * Instead, unlinked nodes are reclaimed once no thread can be reading them
+ * (epoch based reclamation), which releases their value edge to the GC.
+ *
+ * \code
+ * class Index
+ * : public cycle_base
+ * {
+ *  public:
+ *   skiplist_map<std::string, Item> items;
+ * };
+ * \endcode
+ *
+ * \tparam Key Key type of the map.
+ * \tparam T Type of object the values in the map point at.
+ * \tparam Compare Ordering of keys.
+ */
+template<typename Key, typename T, typename Compare = std::less<Key>>
+class skiplist_map {
+ public:
+  ///\brief Key type of the map.
+  using key_type = Key;
+  ///\brief Type of object the values point at.
+  using element_type = T;
+  ///\brief Size type of the map.
+  using size_type = std::size_t;
+  ///\brief Key ordering.
+  using key_compare = Compare;
+
+ private:
+  ///\brief Maximum number of levels of a node.
+  static constexpr unsigned max_height = 24u;
+
+  class entry;
+  class node;
+
+  /**
+   * \brief Record of an unlinked node or replaced entry, awaiting reclamation.
+   * \details
+   * Embedded in the node or entry, so retiring doesn't allocate.
+   */
+  struct retired {
+    node* n = nullptr;
+    entry* e = nullptr;
+    ///\brief Epoch in which it was retired.
+    std::uintptr_t epoch = 0u;
+    ///\brief Next record in the retired list.
+    retired* next = nullptr;
+
+    ///\brief Destroy the node or entry, which also destroys this record.
+    auto destroy()
+    noexcept
+    -> void {
+      // Copy, as *this is destroyed along with the node or entry.
+      node*const dead_node = n;
+      entry*const dead_entry = e;
+      delete dead_node;
+      detail::intrusive_ptr<entry>(dead_entry, false);
+    }
+  };
+
+  ///\brief Value of a node.
+  ///\details Immutable, so that lookups can read it without synchronization.
+  class entry {
+   public:
+    explicit entry(cycle_gptr<T>&& value)
+    : value(std::move(value))
+    {
+      retirement.e = this;
+    }
+
+    entry(const entry&) = delete;
+
+    ///\brief Value of this entry.
+    ///\details Edge from the owner of the map.
+    const cycle_member_ptr<T> value;
+    ///\brief Record used once this entry is replaced.
+    retired retirement;
+
+   private:
+    friend auto intrusive_ptr_add_ref(entry* e)
+    noexcept
+    -> void {
+      e->refs_.fetch_add(1u, std::memory_order_relaxed);
+    }
+
+    friend auto intrusive_ptr_release(entry* e)
+    noexcept
+    -> void {
+      if (e->refs_.fetch_sub(1u, std::memory_order_acq_rel) == 1u) {
+        using traits = std::allocator_traits<std::allocator<entry>>;
+        std::allocator<entry> alloc;
+        traits::destroy(alloc, e);
+        traits::deallocate(alloc, e, 1);
+      }
+    }
+
+    ///\brief Reference counter.
+    std::atomic<std::uintptr_t> refs_{ 1u };
+  };
+
+  /**
+   * \brief Forward link of a node, with a mark bit.
+   * \details
+   * The mark bit is set when the node owning the link is being erased,
+   * which prevents nodes from being linked after it.
+   */
+  class link {
+   public:
+    ///\brief Read the successor and mark bit.
+    auto load() const
+    noexcept
+    -> std::pair<node*, bool> {
+      const std::uintptr_t v = v_.load(std::memory_order_acquire);
+      return { reinterpret_cast<node*>(v & ~mark_bit), (v & mark_bit) != 0u };
+    }
+
+    ///\brief Read the successor, ignoring the mark bit.
+    auto ptr() const
+    noexcept
+    -> node* {
+      return load().first;
+    }
+
+    ///\brief Initialize the link.
+    ///\details Only valid while the owning node is not yet visible to other threads.
+    auto init(node* succ)
+    noexcept
+    -> void {
+      v_.store(reinterpret_cast<std::uintptr_t>(succ), std::memory_order_relaxed);
+    }
+
+    ///\brief Compare-and-swap the successor and mark bit.
+    auto compare_exchange(node* expected, bool expected_mark, node* desired, bool desired_mark)
+    noexcept
+    -> bool {
+      std::uintptr_t expect = encode_(expected, expected_mark);
+      return v_.compare_exchange_strong(
+          expect, encode_(desired, desired_mark),
+          std::memory_order_acq_rel,
+          std::memory_order_acquire);
+    }
+
+   private:
+    static constexpr std::uintptr_t mark_bit = 1u;
+
+    static auto encode_(node* n, bool mark)
+    noexcept
+    -> std::uintptr_t {
+      return reinterpret_cast<std::uintptr_t>(n) | (mark ? mark_bit : 0u);
+    }
+
+    std::atomic<std::uintptr_t> v_{ 0u };
+  };
+
+  ///\brief Node in the skiplist.
+  class node {
+   public:
+    ///\brief Create the head node.
+    node()
+    : height(max_height),
+      next(std::make_unique<link[]>(max_height))
+    {
+      retirement.n = this;
+    }
+
+    node(unsigned height, const key_type& key, detail::intrusive_ptr<entry>&& value)
+    : height(height),
+      key(key),
+      value(value.detach()),
+      next(std::make_unique<link[]>(height))
+    {
+      retirement.n = this;
+    }
+
+    node(const node&) = delete;
+
+    ~node() noexcept {
+      // Release the reference held by value.
+      detail::intrusive_ptr<entry>(value.load(std::memory_order_relaxed), false);
+    }
+
+    ///\brief Bit in state, set once the inserting thread is done with the node.
+    static constexpr unsigned inserted = 0x1u;
+    ///\brief Bit in state, set once the erasing thread is done with the node.
+    static constexpr unsigned erased = 0x2u;
+
+    ///\brief Number of levels in which this node is linked.
+    const unsigned height;
+    ///\brief Key of this node, absent for the head node.
+    const std::optional<key_type> key;
+    /**
+     * \brief Value of this node, holding a reference.
+     * \details
+     * A replaced value is retired like an unlinked node,
+     * so readers holding an epoch_guard can use it without acquiring it.
+     */
+    std::atomic<entry*> value{ nullptr };
+    ///\brief Forward links, one per level.
+    const std::unique_ptr<link[]> next;
+    /**
+     * \brief Handshake between the inserting and erasing thread.
+     * \details
+     * A node may be erased before its insert finished linking it,
+     * in which case the inserter unlinks it again.
+     * The node is retired by whichever of the two finishes last.
+     */
+    std::atomic<unsigned> state{ 0u };
+    ///\brief Record used once this node is unlinked.
+    retired retirement;
+  };
+
+  /**
+   * \brief Marks a thread as reading the skiplist.
+   * \details
+   * Nodes unlinked during an epoch are kept alive, until all threads that
+   * were reading during that epoch are done.
+   */
+  using epoch_guard = detail::skiplist_epochs::guard;
+
+  ///\brief Allocator for entries.
+  ///\details Publishes the owner of this map, when constructing an entry.
+  using entry_allocator = cycle_allocator<std::allocator<entry>>;
+
+  ///\brief Predecessors and successors of a key, per level.
+  using path = std::array<node*, max_height>;
+
+ public:
+  /**
+   * \brief Default constructor acquires its owner from context.
+   * \details
+   * Uses the same publisher logic as \ref cycle_member_ptr.
+   * \throws std::runtime_error if no range was published.
+   */
+  skiplist_map()
+  : skiplist_map(detail::base_control::publisher_lookup(this, sizeof(*this)))
+  {}
+
+  /**
+   * \brief Create an unowned map.
+   * \details
+   * Makes the values in this map behave like cycle_gptr.
+   * \param unowned_tag Tag to select ownerless construction.
+   */
+  explicit skiplist_map(unowned_cycle_t unowned_tag [[maybe_unused]])
+  : skiplist_map(detail::base_control::unowned_control())
+  {}
+
+  skiplist_map(const skiplist_map&) = delete;
+  auto operator=(const skiplist_map&) -> skiplist_map& = delete;
+
+  ///\brief Destructor.
+  ///\pre No other thread is accessing this map.
+  ~skiplist_map() noexcept {
+    node* n = head_.next[0].ptr();
+    while (n != nullptr) {
+      node*const succ = n->next[0].ptr();
+      delete n;
+      n = succ;
+    }
+
+    for (retired* list : { retired_.load(std::memory_order_acquire), pending_ }) {
+      while (list != nullptr) {
+        retired*const next = list->next;
+        list->destroy();
+        list = next;
+      }
+    }
+  }
+
+  ///\brief Number of entries in the map.
+  ///\note Other threads may change the size concurrently.
+  auto size() const
+  noexcept
+  -> size_type {
+    return size_.load(std::memory_order_relaxed);
+  }
+
+  ///\brief Test if the map is empty.
+  ///\note Other threads may change the size concurrently.
+  auto empty() const
+  noexcept
+  -> bool {
+    return size() == 0u;
+  }
+
+  /**
+   * \brief Look up the value for \p key.
+   * \details Lock free.
+   * \returns Pointer to the value of \p key, or nullptr if \p key is not present.
+   */
+  auto find(const key_type& key) const
+  -> cycle_gptr<T> {
+    epoch_guard guard;
+    const node*const n = lookup_(key);
+    if (n == nullptr) return nullptr;
+    return cycle_gptr<T>(n->value.load(std::memory_order_acquire)->value);
+  }
+
+  /**
+   * \brief Test if \p key is present.
+   * \details Lock free.
+   */
+  auto contains(const key_type& key) const
+  -> bool {
+    epoch_guard guard;
+    return lookup_(key) != nullptr;
+  }
+
+  /**
+   * \brief Find the first entry with a key not less than \p key.
+   * \details Lock free.
+   * \returns The key and value of the entry, or an empty optional if there is none.
+   */
+  auto lower_bound(const key_type& key) const
+  -> std::optional<std::pair<key_type, cycle_gptr<T>>> {
+    epoch_guard guard;
+    const node* pred = &head_;
+    const node* curr = nullptr;
+    for (unsigned level = max_height; level-- > 0u; )
+      std::tie(pred, curr) = scan_(pred, level, key);
+
+    if (curr == nullptr) return std::nullopt;
+    return std::make_pair(*curr->key, cycle_gptr<T>(curr->value.load(std::memory_order_acquire)->value));
+  }
+
+  /**
+   * \brief Invoke \p fn for each entry, in key order.
+   * \details
+   * Lock free.
+   * Entries inserted or erased concurrently may or may not be visited.
+   * \param fn Functor invoked with the key and a \ref cycle_gptr to the value.
+   */
+  template<typename Fn>
+  auto for_each(Fn&& fn) const
+  -> void {
+    epoch_guard guard;
+    for (const node* n = head_.next[0].ptr(); n != nullptr; ) {
+      const auto [succ, marked] = n->next[0].load();
+      if (!marked) std::invoke(fn, *n->key, cycle_gptr<T>(n->value.load(std::memory_order_acquire)->value));
+      n = succ;
+    }
+  }
+
+  /**
+   * \brief Insert \p value for \p key, if \p key is not present.
+   * \details Lock free.
+   * \returns True if the value was inserted.
+   */
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  auto insert(const key_type& key, cycle_gptr<U> value)
+  -> bool {
+    bool inserted;
+    {
+      epoch_guard guard;
+      inserted = insert_(key, make_entry_(std::move(value)), false);
+    }
+
+    reclaim_();
+    return inserted;
+  }
+
+  /**
+   * \brief Assign \p value to \p key.
+   * \details Lock free.
+   * \returns True if \p key was not present.
+   */
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  auto insert_or_assign(const key_type& key, cycle_gptr<U> value)
+  -> bool {
+    bool inserted;
+    {
+      epoch_guard guard;
+      inserted = insert_(key, make_entry_(std::move(value)), true);
+    }
+
+    reclaim_();
+    return inserted;
+  }
+
+  /**
+   * \brief Remove \p key.
+   * \details Lock free.
+   * \returns True if \p key was present.
+   */
+  auto erase(const key_type& key)
+  -> bool {
+    {
+      epoch_guard guard;
+      path preds, succs;
+      if (!find_(key, preds, succs)) return false;
+      node*const victim = succs[0];
+
+      // Mark the upper levels, so nothing gets linked after the victim.
+      for (unsigned level = victim->height; level-- > 1u; ) {
+        auto [succ, marked] = victim->next[level].load();
+        while (!marked) {
+          victim->next[level].compare_exchange(succ, false, succ, true);
+          std::tie(succ, marked) = victim->next[level].load();
+        }
+      }
+
+      // Marking the bottom level is what erases the node.
+      auto [succ, marked] = victim->next[0].load();
+      for (;;) {
+        if (marked) return false; // Another thread erased it.
+        if (victim->next[0].compare_exchange(succ, false, succ, true)) break;
+        std::tie(succ, marked) = victim->next[0].load();
+      }
+      size_.fetch_sub(1u, std::memory_order_relaxed);
+
+      find_(key, preds, succs); // Unlinks the victim.
+      if (victim->state.fetch_or(node::erased, std::memory_order_acq_rel) & node::inserted)
+        retire_(victim);
+    }
+
+    reclaim_();
+    return true;
+  }
+
+  /**
+   * \brief Remove all entries.
+   * \details
+   * Entries inserted concurrently may or may not be removed.
+   */
+  auto clear()
+  -> void {
+    for (;;) {
+      std::optional<key_type> key;
+      {
+        epoch_guard guard;
+        for (const node* n = head_.next[0].ptr(); n != nullptr; ) {
+          const auto [succ, marked] = n->next[0].load();
+          if (!marked) {
+            key = n->key;
+            break;
+          }
+          n = succ;
+        }
+      }
+      if (!key.has_value()) break;
+      erase(*key);
+    }
+
+    reclaim_();
+  }
+
+ private:
+  explicit skiplist_map(detail::intrusive_ptr<detail::base_control> owner)
+  : alloc_(std::move(owner))
+  {}
+
+  ///\brief Compare keys.
+  auto less_(const key_type& x, const key_type& y) const
+  -> bool {
+    return std::invoke(less_fn_, x, y);
+  }
+
+  ///\brief Create a new entry.
+  ///\details The entry is created with a member pointer owned by the owner of this map.
+  template<typename U>
+  auto make_entry_(cycle_gptr<U>&& value)
+  -> detail::intrusive_ptr<entry> {
+    using traits = std::allocator_traits<entry_allocator>;
+
+    entry_allocator alloc = alloc_;
+    entry*const e = traits::allocate(alloc, 1);
+    try {
+      traits::construct(alloc, e, cycle_gptr<T>(std::move(value)));
+    } catch (...) {
+      traits::deallocate(alloc, e, 1);
+      throw;
+    }
+    return detail::intrusive_ptr<entry>(e, false);
+  }
+
+  ///\brief Choose the height of a new node.
+  ///\details Each additional level has probability 1/4.
+  static auto random_height_()
+  noexcept
+  -> unsigned {
+    thread_local std::uint64_t state =
+        std::hash<std::thread::id>()(std::this_thread::get_id()) | 1u;
+
+    // xorshift64
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+
+    unsigned height = 1;
+    for (std::uint64_t bits = state; height < max_height && (bits & 0x3u) == 0u; bits >>= 2)
+      ++height;
+    return height;
+  }
+
+  /**
+   * \brief Walk \p level, starting at \p pred, until the first node not less than \p key.
+   * \details Skips marked nodes, without unlinking them.
+   * \returns The last node less than \p key, and its successor.
+   */
+  auto scan_(const node* pred, unsigned level, const key_type& key) const
+  -> std::pair<const node*, const node*> {
+    const node* curr = pred->next[level].ptr();
+    while (curr != nullptr) {
+      const auto [succ, marked] = curr->next[level].load();
+      if (marked) {
+        curr = succ;
+      } else if (less_(*curr->key, key)) {
+        pred = curr;
+        curr = succ;
+      } else {
+        break;
+      }
+    }
+    return { pred, curr };
+  }
+
+  ///\brief Find the node for \p key, without modifying the skiplist.
+  ///\pre The calling thread holds an epoch_guard.
+  auto lookup_(const key_type& key) const
+  -> const node* {
+    const node* pred = &head_;
+    const node* curr = nullptr;
+    for (unsigned level = max_height; level-- > 0u; )
+      std::tie(pred, curr) = scan_(pred, level, key);
+
+    if (curr == nullptr || less_(key, *curr->key)) return nullptr;
+    return curr;
+  }
+
+  /**
+   * \brief Find the predecessors and successors of \p key, on each level.
+   * \details Unlinks marked nodes encountered along the way.
+   * \pre The calling thread holds an epoch_guard.
+   * \returns True if succs[0] is an unmarked node with \p key.
+   */
+  auto find_(const key_type& key, path& preds, path& succs)
+  -> bool {
+  retry:
+    node* pred = &head_;
+    for (unsigned level = max_height; level-- > 0u; ) {
+      node* curr = pred->next[level].ptr();
+      while (curr != nullptr) {
+        auto [succ, marked] = curr->next[level].load();
+        if (marked) {
+          if (!pred->next[level].compare_exchange(curr, false, succ, false)) goto retry;
+          curr = succ;
+        } else if (less_(*curr->key, key)) {
+          pred = curr;
+          curr = succ;
+        } else {
+          break;
+        }
+      }
+      preds[level] = pred;
+      succs[level] = curr;
+    }
+    return succs[0] != nullptr && !less_(key, *succs[0]->key);
+  }
+
+  ///\brief Insert implementation.
+  ///\pre The calling thread holds an epoch_guard.
+  auto insert_(const key_type& key, detail::intrusive_ptr<entry>&& e, bool assign)
+  -> bool {
+    path preds, succs;
+    std::unique_ptr<node> owned_node;
+
+    for (;;) {
+      if (find_(key, preds, succs)) {
+        if (assign) {
+          if (owned_node != nullptr)
+            e = detail::intrusive_ptr<entry>(owned_node->value.exchange(nullptr, std::memory_order_relaxed), false);
+          retire_(succs[0]->value.exchange(e.detach(), std::memory_order_acq_rel));
+        }
+        return false;
+      }
+
+      if (owned_node == nullptr)
+        owned_node = std::make_unique<node>(random_height_(), key, std::move(e));
+      node*const n = owned_node.get();
+      for (unsigned level = 0; level < n->height; ++level)
+        n->next[level].init(succs[level]);
+
+      // Linking the bottom level is what inserts the node.
+      if (!preds[0]->next[0].compare_exchange(succs[0], false, n, false)) continue;
+      owned_node.release();
+      size_.fetch_add(1u, std::memory_order_relaxed);
+
+      link_upper_(key, n, preds, succs);
+      return true;
+    }
+  }
+
+  ///\brief Link the upper levels of a newly inserted node \p n.
+  auto link_upper_(const key_type& key, node* n, path& preds, path& succs)
+  -> void {
+    for (unsigned level = 1; level < n->height; ++level) {
+      for (;;) {
+        // Point our link at the current successor.
+        // Fails if the node is being erased.
+        const auto [succ, marked] = n->next[level].load();
+        if (marked) goto done;
+        if (succ != succs[level]
+            && !n->next[level].compare_exchange(succ, false, succs[level], false))
+          continue;
+
+        if (preds[level]->next[level].compare_exchange(succs[level], false, n, false)) break;
+        find_(key, preds, succs);
+        if (succs[0] != n) goto done; // Node was erased.
+      }
+    }
+
+  done:
+    // If the node was erased while we were linking it,
+    // we may have linked it after the erasing thread unlinked it.
+    if (n->next[0].load().second) find_(key, preds, succs);
+    if (n->state.fetch_or(node::inserted, std::memory_order_acq_rel) & node::erased)
+      retire_(n);
+  }
+
+  ///\brief Hand an unlinked node to epoch based reclamation.
+  auto retire_(node* n)
+  noexcept
+  -> void {
+    retire_(n->retirement);
+  }
+
+  ///\brief Hand a replaced entry to epoch based reclamation.
+  auto retire_(entry* old_value)
+  noexcept
+  -> void {
+    retire_(old_value->retirement);
+  }
+
+  ///\brief Push \p r on retired_, tagged with the current epoch.
+  auto retire_(retired& r)
+  noexcept
+  -> void {
+    r.epoch = detail::skiplist_epochs::retire_epoch();
+    r.next = retired_.load(std::memory_order_relaxed);
+    while (!retired_.compare_exchange_weak(r.next, &r, std::memory_order_release, std::memory_order_relaxed)) {
+      // Retry.
+    }
+    retired_size_.fetch_add(1u, std::memory_order_relaxed);
+  }
+
+  /**
+   * \brief Destroy retired nodes that no reader can access.
+   * \details
+   * Advances the epoch as far as readers allow, until every retired node
+   * can be destroyed, which releases their values.
+   *
+   * Only one thread at a time reclaims; other threads skip reclamation
+   * instead of waiting, so this never blocks.
+   */
+  auto reclaim_()
+  -> void {
+    if (retired_size_.load(std::memory_order_relaxed) == 0u) return;
+
+    // Another thread reclaiming is as good as us doing it.
+    if (reclaiming_.test_and_set(std::memory_order_acquire)) return;
+
+    // Move newly retired records to pending_.
+    std::uintptr_t max_epoch = 0u;
+    for (retired* r = retired_.exchange(nullptr, std::memory_order_acquire); r != nullptr; ) {
+      retired*const next = r->next;
+      r->next = pending_;
+      pending_ = r;
+      r = next;
+    }
+    for (const retired* r = pending_; r != nullptr; r = r->next)
+      max_epoch = std::max(max_epoch, r->epoch);
+
+    std::uintptr_t e = detail::skiplist_epochs::try_advance();
+    while (e < max_epoch + 2u) {
+      const std::uintptr_t next = detail::skiplist_epochs::try_advance();
+      if (next == e) break; // Blocked by a reader.
+      e = next;
+    }
+
+    retired* garbage = nullptr;
+    std::size_t garbage_size = 0;
+    for (retired** r = &pending_; *r != nullptr; ) {
+      if ((*r)->epoch + 2u <= e) {
+        retired*const expired = *r;
+        *r = expired->next;
+        expired->next = garbage;
+        garbage = expired;
+        ++garbage_size;
+      } else {
+        r = &(*r)->next;
+      }
+    }
+    retired_size_.fetch_sub(garbage_size, std::memory_order_relaxed);
+    reclaiming_.clear(std::memory_order_release);
+
+    // Destroyed after handing off reclamation, as their release may run the GC.
+    while (garbage != nullptr) {
+      retired*const next = garbage->next;
+      garbage->destroy();
+      garbage = next;
+    }
+  }
+
+  ///\brief Allocator for entries, which knows the owner of this map.
+  const entry_allocator alloc_;
+  ///\brief Key ordering.
+  key_compare less_fn_;
+  ///\brief Head of the skiplist.
+  node head_;
+  ///\brief Number of entries.
+  std::atomic<size_type> size_{ 0u };
+  ///\brief Unlinked nodes and replaced entries, pushed by retire_().
+  std::atomic<retired*> retired_{ nullptr };
+  ///\brief Set while a thread reclaims.
+  std::atomic_flag reclaiming_ = ATOMIC_FLAG_INIT;
+  ///\brief Retired records that were not yet reclaimable.
+  ///\details Only accessed by the thread that set reclaiming_.
+  retired* pending_ = nullptr;
+  ///\brief Number of retired records, in retired_ and pending_.
+  std::atomic<std::size_t> retired_size_{ 0u };
+};
+
+
+} /* namespace cycle_ptr */
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cycle_ptr.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace cycle_ptr {
+
+
+/**
+ * \brief Operation read from a trace file.
+ * \details
+ * Traces are recorded by \ref trace_start, which requires
+ * ``CYCLE_PTR_TRACE`` to be defined.
+ * Reading them does not.
+ */
+struct trace_event {
+  ///\brief The operation.
+  trace_op op = trace_op::make;
+  ///\brief Number of the thread that performed the operation.
+  std::uint64_t thread = 0;
+  ///\brief Position of the operation, across all threads.
+  std::uint64_t seq = 0;
+  ///\brief Number of the object operated on.
+  ///\details For edge operations, the object owning the edge.
+  std::uint64_t obj = 0;
+  /**
+   * \brief Offset of the edge, from the control block of \ref obj.
+   * \details
+   * Only meaningful for edge operations.
+   * Identifies the edge among the edges of the object, while the object lives.
+   */
+  std::ptrdiff_t slot = 0;
+  ///\brief Number of the destination object, for \ref trace_op::edge_set.
+  std::uint64_t dst = 0;
+};
+
+namespace detail {
+
+
+///\brief Read a varint from \p in.
+///\throws std::runtime_error if the file ends, or the value doesn't fit.
+inline auto trace_get_varint_(std::istream& in)
+-> std::uint64_t {
+  std::uint64_t v = 0;
+  for (unsigned shift = 0; shift < 64u; shift += 7u) {
+    const auto c = in.get();
+    if (c == std::istream::traits_type::eof())
+      throw std::runtime_error("cycle_ptr: truncated trace");
+    v |= static_cast<std::uint64_t>(c & 0x7f) << shift;
+    if ((c & 0x80) == 0) return v;
+  }
+  throw std::runtime_error("cycle_ptr: malformed varint in trace");
+}
+
+
+} /* namespace cycle_ptr::detail */
+
+/**
+ * \brief Read all operations in a trace file.
+ * \details
+ * The file must be opened in binary mode.
+ * \returns The operations, ordered by \ref trace_event::seq.
+ * \throws std::runtime_error if \p in does not hold a valid trace.
+ */
+inline auto read_trace(std::istream& in)
+-> std::vector<trace_event> {
+  char magic[std::size(detail::trace_magic)];
+  if (!in.read(magic, sizeof(magic)) || !std::equal(std::begin(magic), std::end(magic), std::begin(detail::trace_magic)))
+    throw std::runtime_error("cycle_ptr: not a trace file");
+  if (in.get() != detail::trace_version)
+    throw std::runtime_error("cycle_ptr: unsupported trace version");
+
+  std::vector<trace_event> events;
+  while (in.peek() != std::istream::traits_type::eof()) {
+    const std::uint64_t thread = detail::trace_get_varint_(in);
+    const std::uint64_t count = detail::trace_get_varint_(in);
+
+    std::uint64_t seq = 0;
+    for (std::uint64_t i = 0; i < count; ++i) {
+      trace_event& e = events.emplace_back();
+      const auto op = in.get();
+      if (op == std::istream::traits_type::eof())
+        throw std::runtime_error("cycle_ptr: truncated trace");
+      if (op > static_cast<int>(trace_op::weak_lock_failed))
+        throw std::runtime_error("cycle_ptr: unknown operation in trace");
+
+      e.op = static_cast<trace_op>(op);
+      e.thread = thread;
+      e.seq = seq += detail::trace_get_varint_(in);
+      e.obj = detail::trace_get_varint_(in);
+      if (e.op == trace_op::edge_set || e.op == trace_op::edge_reset) {
+        const std::uint64_t zigzag = detail::trace_get_varint_(in);
+        e.slot = static_cast<std::ptrdiff_t>(zigzag & 1u ? ~(zigzag >> 1) : zigzag >> 1);
+      }
+      if (e.op == trace_op::edge_set)
+        e.dst = detail::trace_get_varint_(in);
+    }
+  }
+
+  std::sort(events.begin(), events.end(),
+      [](const trace_event& x, const trace_event& y) {
+        return x.seq < y.seq;
+      });
+  return events;
+}
+
+
+} /* namespace cycle_ptr */
@@ -0,0 +1,405 @@
+#pragma once
+
+#include <cycle_ptr.h>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#ifdef CYCLE_PTR_NO_WEAK
+# error "cycle_ptr/weak_cache.h requires weak pointer support"
+#endif
+
+namespace cycle_ptr {
+namespace detail {
+
+
+/**
+ * \brief Weak pointer that queues itself, when its object is collected.
+ * \details
+ * Entries are reference counted, and the queue holds a reference
+ * to each queued entry.
+ * \tparam T The type of object pointed at.
+ */
+template<typename T>
+class weak_entry
+: public collect_hook
+{
+ public:
+  ///\brief Queue of entries whose object was collected.
+  class queue {
+    friend weak_entry;
+
+   public:
+    queue() noexcept = default;
+    queue(const queue&) = delete;
+
+    /**
+     * \brief Take all queued entries.
+     * \returns List of entries, linked through their next_collected member.
+     * The caller takes over the reference of the queue to each entry.
+     */
+    auto take()
+    noexcept
+    -> weak_entry* {
+      return head_.exchange(nullptr, std::memory_order_acquire);
+    }
+
+   private:
+    ///\brief Queue \p e.
+    auto push_(weak_entry* e)
+    noexcept
+    -> void {
+      intrusive_ptr_add_ref(e); // Reference held by the queue.
+      e->next_collected = head_.load(std::memory_order_relaxed);
+      while (!head_.compare_exchange_weak(e->next_collected, e, std::memory_order_release, std::memory_order_relaxed)) {
+        // Retry.
+      }
+    }
+
+    ///\brief Most recently queued entry.
+    std::atomic<weak_entry*> head_{ nullptr };
+  };
+
+  ///\brief Create an entry for \p value, which is queued on \p q once collected.
+  weak_entry(queue& q, std::size_t hash, const cycle_gptr<T>& value)
+  : hash(hash),
+    value(value),
+    queue_(q)
+  {
+    add_collect_hook(value, *this);
+  }
+
+  ~weak_entry() noexcept override {
+    remove();
+  }
+
+  ///\brief Cached hash code.
+  const std::size_t hash;
+  ///\brief Pointer to the object.
+  const cycle_weak_ptr<T> value;
+  ///\brief Next entry in the queue of collected entries.
+  weak_entry* next_collected = nullptr;
+
+ private:
+  auto on_collect()
+  noexcept
+  -> void override {
+    queue_.push_(this);
+  }
+
+  friend auto intrusive_ptr_add_ref(weak_entry* e)
+  noexcept
+  -> void {
+    e->refs_.fetch_add(1u, std::memory_order_relaxed);
+  }
+
+  friend auto intrusive_ptr_release(weak_entry* e)
+  noexcept
+  -> void {
+    if (e->refs_.fetch_sub(1u, std::memory_order_acq_rel) == 1u)
+      delete e;
+  }
+
+  ///\brief Queue to push this on, when the object is collected.
+  queue& queue_;
+  ///\brief Reference counter.
+  std::atomic<std::uintptr_t> refs_{ 1u };
+};
+
+
+} /* namespace cycle_ptr::detail */
+
+
+/**
+ * \brief Concurrent cache of weak pointers, that forgets collected objects.
+ * \details
+ * Maps keys to \ref cycle_weak_ptr, so the cache does not keep its objects
+ * alive.
+ * Each entry attaches a \ref collect_hook to its object.
+ * When the GC collects the object, the hook queues the entry for removal,
+ * and the next operation on the cache removes it.
+ * So the cache never needs to scan for expired entries.
+ *
+ * The cache is divided in shards, each protected by its own lock.
+ *
+ * \code
+ * weak_cache<std::string, Texture> textures;
+ *
+ * cycle_gptr<Texture> t = textures.get_or_create(
+ *     "grass.png",
+ *     []() { return make_cycle<Texture>("grass.png"); });
+ * \endcode
+ *
+ * \tparam Key Key type of the cache.
+ * \tparam T Type of object the values in the cache point at.
+ * \tparam Hash Hash function for keys.
+ * \tparam KeyEqual Equality comparison for keys.
+ */
+template<typename Key, typename T, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
+class weak_cache {
+ public:
+  ///\brief Key type of the cache.
+  using key_type = Key;
+  ///\brief Type of object the values point at.
+  using element_type = T;
+  ///\brief Size type of the cache.
+  using size_type = std::size_t;
+  ///\brief Hash function.
+  using hasher = Hash;
+  ///\brief Key equality comparison.
+  using key_equal = KeyEqual;
+
+ private:
+  ///\brief A single key-value pair.
+  class entry
+  : public detail::weak_entry<T>
+  {
+   public:
+    entry(typename detail::weak_entry<T>::queue& q, std::size_t hash, const key_type& key, const cycle_gptr<T>& value)
+    : detail::weak_entry<T>(q, hash, value),
+      key(key)
+    {}
+
+    ~entry() noexcept override {
+      this->remove();
+    }
+
+    ///\brief Key of this entry.
+    const key_type key;
+  };
+
+  using entry_ptr = detail::intrusive_ptr<entry>;
+
+  ///\brief Shard of the cache.
+  struct shard {
+    ///\brief Protects map.
+    std::mutex mtx;
+    ///\brief Entries in this shard.
+    std::unordered_map<key_type, entry_ptr, hasher, key_equal> map;
+  };
+
+ public:
+  ///\brief Create an empty cache with \p shard_count shards.
+  explicit weak_cache(size_type shard_count = 16u)
+  : shard_count_(std::max(shard_count, size_type(1))),
+    shards_(std::make_unique<shard[]>(shard_count_))
+  {}
+
+  weak_cache(const weak_cache&) = delete;
+  auto operator=(const weak_cache&) -> weak_cache& = delete;
+
+  ///\brief Destructor.
+  ///\pre No other thread is accessing this cache.
+  ~weak_cache() noexcept {
+    for (size_type i = 0; i < shard_count_; ++i) {
+      for (auto& [key, e] : shards_[i].map) e->remove();
+      shards_[i].map.clear();
+    }
+    // Entries whose hook fired before they were removed.
+    prune();
+  }
+
+  ///\brief Number of entries in the cache.
+  ///\note Includes entries whose object was collected, but which haven't been pruned yet.
+  ///\note Other threads may change the size concurrently.
+  auto size() const
+  noexcept
+  -> size_type {
+    return size_.load(std::memory_order_relaxed);
+  }
+
+  ///\brief Test if the cache is empty.
+  ///\note Other threads may change the size concurrently.
+  auto empty() const
+  noexcept
+  -> bool {
+    return size() == 0u;
+  }
+
+  /**
+   * \brief Look up the value for \p key.
+   * \returns Pointer to the value of \p key, or nullptr if \p key is not
+   * present or its object was collected.
+   */
+  auto get(const key_type& key)
+  -> cycle_gptr<T> {
+    prune();
+
+    const std::size_t hash = hash_(key);
+    cycle_weak_ptr<T> value;
+    {
+      shard& s = shard_(hash);
+      std::lock_guard<std::mutex> lck{ s.mtx };
+      const auto pos = s.map.find(key);
+      if (pos == s.map.end()) return nullptr;
+      value = pos->second->value;
+    }
+    return value.lock();
+  }
+
+  /**
+   * \brief Look up the value for \p key, creating it if it is absent.
+   * \details
+   * If \p key is not present, or its object was collected,
+   * \p fn is invoked to create a new object, which is stored in the cache.
+   *
+   * \p fn is invoked with the shard of \p key locked,
+   * so that concurrent calls for the same key create only one object.
+   * Consequently, \p fn must not access the cache.
+   * \param key The key to look up.
+   * \param fn Functor returning a cycle_gptr to a new object.
+   * \returns Pointer to the value of \p key.
+   */
+  template<typename Fn>
+  auto get_or_create(const key_type& key, Fn&& fn)
+  -> cycle_gptr<T> {
+    prune();
+
+    const std::size_t hash = hash_(key);
+    cycle_gptr<T> result;
+    entry_ptr old;
+    {
+      shard& s = shard_(hash);
+      std::lock_guard<std::mutex> lck{ s.mtx };
+      auto pos = s.map.find(key);
+      if (pos != s.map.end()) {
+        result = pos->second->value.lock();
+        if (result != nullptr) return result;
+      }
+
+      result = std::invoke(fn);
+      assign_(s, pos, hash, key, result, old);
+    }
+    // Replaced entry is released after unlocking.
+    old.reset();
+    return result;
+  }
+
+  /**
+   * \brief Assign \p value to \p key.
+   * \returns True if \p key was not present.
+   */
+  template<typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+  auto insert_or_assign(const key_type& key, const cycle_gptr<U>& value)
+  -> bool {
+    prune();
+
+    const std::size_t hash = hash_(key);
+    entry_ptr old;
+    {
+      shard& s = shard_(hash);
+      std::lock_guard<std::mutex> lck{ s.mtx };
+      assign_(s, s.map.find(key), hash, key, cycle_gptr<T>(value), old);
+    }
+    return old == nullptr;
+  }
+
+  /**
+   * \brief Remove \p key.
+   * \returns True if \p key was present.
+   */
+  auto erase(const key_type& key)
+  -> bool {
+    prune();
+
+    const std::size_t hash = hash_(key);
+    entry_ptr old;
+    {
+      shard& s = shard_(hash);
+      std::lock_guard<std::mutex> lck{ s.mtx };
+      const auto pos = s.map.find(key);
+      if (pos == s.map.end()) return false;
+
+      // Detach the hook before we release our reference,
+      // so the GC won't invoke it on a destroyed entry.
+      pos->second->remove();
+      old = std::move(pos->second);
+      s.map.erase(pos);
+      size_.fetch_sub(1u, std::memory_order_relaxed);
+    }
+    return true;
+  }
+
+  /**
+   * \brief Remove entries whose object was collected.
+   * \details
+   * Only visits the entries queued by the GC.
+   * Every other operation on the cache does this implicitly.
+   */
+  auto prune()
+  noexcept
+  -> void {
+    detail::weak_entry<T>* e = collected_.take();
+    while (e != nullptr) {
+      // Take over the reference held by the queue.
+      const entry_ptr ep = entry_ptr(static_cast<entry*>(e), false);
+      e = ep->next_collected;
+
+      shard& s = shard_(ep->hash);
+      std::lock_guard<std::mutex> lck{ s.mtx };
+      const auto pos = s.map.find(ep->key);
+      if (pos != s.map.end() && pos->second == ep) {
+        s.map.erase(pos);
+        size_.fetch_sub(1u, std::memory_order_relaxed);
+      }
+    }
+  }
+
+ private:
+  ///\brief Compute hash code of \p key.
+  auto hash_(const key_type& key) const
+  -> std::size_t {
+    return std::invoke(hash_fn_, key);
+  }
+
+  ///\brief Retrieve the shard for hash code \p hash.
+  auto shard_(std::size_t hash) const
+  noexcept
+  -> shard& {
+    return shards_[hash % shard_count_];
+  }
+
+  /**
+   * \brief Store \p value for \p key in shard \p s.
+   * \pre The caller holds the lock on \p s.
+   * \param pos Position of \p key in \p s, or end if \p key is absent.
+   * \param[out] old Receives the replaced entry, which the caller must
+   * release after unlocking.
+   */
+  auto assign_(shard& s, typename std::unordered_map<key_type, entry_ptr, hasher, key_equal>::iterator pos,
+      std::size_t hash, const key_type& key, const cycle_gptr<T>& value, entry_ptr& old)
+  -> void {
+    auto e = entry_ptr(new entry(collected_, hash, key, value), false);
+    if (pos != s.map.end()) {
+      // Detach the hook before we release our reference,
+      // so the GC won't invoke it on a destroyed entry.
+      pos->second->remove();
+      old = std::exchange(pos->second, std::move(e));
+    } else {
+      s.map.emplace(key, std::move(e));
+      size_.fetch_add(1u, std::memory_order_relaxed);
+    }
+  }
+
+  ///\brief Hash function.
+  hasher hash_fn_;
+  ///\brief Number of shards.
+  const size_type shard_count_;
+  ///\brief Shards.
+  const std::unique_ptr<shard[]> shards_;
+  ///\brief Entries whose object was collected.
+  typename detail::weak_entry<T>::queue collected_;
+  ///\brief Number of entries.
+  std::atomic<size_type> size_{ 0u };
+};
+
+
+} /* namespace cycle_ptr */
@@ -0,0 +1,114 @@
+#include <cycle_ptr.h>
+#include "UnitTest++/UnitTest++.h"
+#include <vector>
+
+using namespace cycle_ptr;
+
+namespace {
+
+class node {
+ public:
+  node(int value, int* destroyed) noexcept
+  : value(value),
+    destroyed(destroyed)
+  {}
+
+  ~node() noexcept {
+    if (destroyed != nullptr) ++*destroyed;
+  }
+
+  int value;
+  int* destroyed;
+  cycle_member_ptr<node> next, skip;
+};
+
+// Copies value and both edges.
+auto clone_node(const node& original, clone_context<node>& ctx)
+-> cycle_gptr<node> {
+  cycle_gptr<node> copy = ctx.make(original.value, original.destroyed);
+  ctx.link(copy->next, original.next);
+  ctx.link(copy->skip, original.skip);
+  return copy;
+}
+
+} /* namespace <unnamed> */
+
+TEST(clone_graph_null) {
+  CHECK(clone_graph(cycle_gptr<node>(), clone_node) == nullptr);
+}
+
+TEST(clone_graph_cycle) {
+  int destroyed = 0;
+  int copies_destroyed = 0;
+
+  // Ring of 5 nodes, with skip edges and a self loop.
+  std::vector<cycle_gptr<node>> ring;
+  for (int i = 0; i < 5; ++i) ring.push_back(make_cycle<node>(i, &destroyed));
+  for (int i = 0; i < 5; ++i) ring[i]->next = ring[(i + 1) % 5];
+  ring[0]->skip = ring[2];
+  ring[3]->skip = ring[3];
+  cycle_gptr<node> root = ring[0];
+  ring.clear();
+
+  cycle_gptr<node> copy = clone_graph(
+      root,
+      [&copies_destroyed](const node& original, clone_context<node>& ctx) {
+        cycle_gptr<node> c = ctx.make(original.value, &copies_destroyed);
+        ctx.link(c->next, original.next);
+        ctx.link(c->skip, original.skip);
+        return c;
+      });
+  REQUIRE CHECK(copy != nullptr);
+  CHECK(copy != root);
+  CHECK_EQUAL(0, copies_destroyed);
+
+  // Same shape.
+  cycle_gptr<node> x = copy, y = root;
+  for (int i = 0; i < 5; ++i) {
+    CHECK(x != y);
+    CHECK_EQUAL(y->value, x->value);
+    CHECK_EQUAL(y->skip == nullptr, x->skip == nullptr);
+    x = x->next;
+    y = y->next;
+  }
+  CHECK(x == copy);
+  CHECK(copy->skip == copy->next->next);
+  CHECK(copy->next->next->next->skip == copy->next->next->next);
+  x = y = nullptr;
+
+  // Copy and original are independent.
+  root = nullptr;
+  CHECK_EQUAL(5, destroyed);
+  CHECK_EQUAL(0, copies_destroyed);
+  CHECK_EQUAL(1, copy->next->value);
+  copy = nullptr;
+  CHECK_EQUAL(5, copies_destroyed);
+}
+
+TEST(clone_graph_unlinked_edges_are_shared) {
+  cycle_gptr<node> shared = make_cycle<node>(42, nullptr);
+  cycle_gptr<node> root = make_cycle<node>(1, nullptr);
+  root->next = make_cycle<node>(2, nullptr);
+  root->next->skip = shared;
+
+  cycle_gptr<node> copy = clone_graph(
+      root,
+      [](const node& original, clone_context<node>& ctx) {
+        cycle_gptr<node> c = ctx.make(original.value, nullptr);
+        ctx.link(c->next, original.next);
+        c->skip = original.skip; // Not followed.
+        return c;
+      });
+  CHECK(copy->next != root->next);
+  CHECK(copy->next->skip == shared);
+}
+
+TEST(clone_graph_function) {
+  cycle_gptr<node> root = make_cycle<node>(7, nullptr);
+  root->next = root;
+
+  cycle_gptr<node> copy = clone_graph(root, clone_node);
+  CHECK(copy != root);
+  CHECK(copy->next == copy);
+  CHECK(copy.is_unique());
+}
@@ -0,0 +1,208 @@
+#include <cycle_ptr/concurrent_map.h>
+#include "UnitTest++/UnitTest++.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace cycle_ptr;
+
+namespace {
+
+class map_value {
+ public:
+  explicit map_value(bool* destroyed = nullptr, int value = 0) noexcept
+  : value(value),
+    destroyed(destroyed)
+  {}
+
+  ~map_value() {
+    if (destroyed != nullptr) {
+      CHECK(!*destroyed); // Check that we're only destroyed once.
+      *destroyed = true;
+    }
+  }
+
+  int value;
+  cycle_member_ptr<class map_owner> back;
+
+ private:
+  bool* destroyed = nullptr;
+};
+
+class map_owner {
+ public:
+  explicit map_owner(bool* destroyed = nullptr) noexcept
+  : destroyed(destroyed)
+  {}
+
+  ~map_owner() {
+    if (destroyed != nullptr) {
+      CHECK(!*destroyed); // Check that we're only destroyed once.
+      *destroyed = true;
+    }
+  }
+
+  concurrent_map<int, map_value> items;
+
+ private:
+  bool* destroyed = nullptr;
+};
+
+// Set on threads that only perform lookups.
+thread_local bool lookup_thread = false;
+// Number of map entries destroyed on a lookup thread.
+std::atomic<int> destroyed_by_lookup{ 0 };
+
+// Key that records if a copy is destroyed on a lookup thread.
+// The map stores a copy of the key in each entry.
+class tracked_key {
+ public:
+  explicit tracked_key(int value) noexcept
+  : value(value)
+  {}
+
+  tracked_key(const tracked_key& other) noexcept
+  : value(other.value),
+    copied(true)
+  {}
+
+  ~tracked_key() {
+    if (copied && lookup_thread) destroyed_by_lookup.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  auto operator==(const tracked_key& other) const
+  noexcept
+  -> bool {
+    return value == other.value;
+  }
+
+  int value;
+
+ private:
+  bool copied = false;
+};
+
+struct tracked_key_hash {
+  auto operator()(const tracked_key& key) const
+  noexcept
+  -> std::size_t {
+    return std::hash<int>()(key.value);
+  }
+};
+
+class tracked_map_owner {
+ public:
+  concurrent_map<tracked_key, map_value, tracked_key_hash> items;
+};
+
+} /* namespace <unnamed> */
+
+TEST(concurrent_map_insert_find_erase) {
+  bool destroyed = false;
+  cycle_gptr<map_owner> owner = make_cycle<map_owner>();
+
+  CHECK(owner->items.insert(1, make_cycle<map_value>(&destroyed, 17)));
+  CHECK(!owner->items.insert(1, make_cycle<map_value>(nullptr, 18)));
+  CHECK_EQUAL(1u, owner->items.size());
+
+  REQUIRE CHECK(owner->items.find(1) != nullptr);
+  CHECK_EQUAL(17, owner->items.find(1)->value);
+  CHECK(owner->items.find(2) == nullptr);
+  CHECK(!destroyed);
+
+  CHECK(owner->items.erase(1));
+  CHECK(!owner->items.erase(1));
+  CHECK(destroyed);
+  CHECK(owner->items.empty());
+}
+
+TEST(concurrent_map_insert_or_assign) {
+  bool destroyed = false;
+  cycle_gptr<map_owner> owner = make_cycle<map_owner>();
+
+  CHECK(owner->items.insert_or_assign(1, make_cycle<map_value>(&destroyed, 17)));
+  CHECK(!owner->items.insert_or_assign(1, make_cycle<map_value>(nullptr, 18)));
+  CHECK(destroyed);
+  CHECK_EQUAL(18, owner->items.find(1)->value);
+}
+
+TEST(concurrent_map_grows) {
+  cycle_gptr<map_owner> owner = make_cycle<map_owner>();
+  const auto initial_buckets = owner->items.bucket_count();
+
+  for (int i = 0; i < 1000; ++i)
+    owner->items.insert(i, make_cycle<map_value>(nullptr, i));
+
+  CHECK_EQUAL(1000u, owner->items.size());
+  CHECK(owner->items.bucket_count() > initial_buckets);
+  for (int i = 0; i < 1000; ++i) {
+    REQUIRE CHECK(owner->items.find(i) != nullptr);
+    CHECK_EQUAL(i, owner->items.find(i)->value);
+  }
+}
+
+TEST(concurrent_map_cycle) {
+  bool owner_destroyed = false;
+  bool value_destroyed = false;
+  cycle_gptr<map_owner> owner = make_cycle<map_owner>(&owner_destroyed);
+  cycle_gptr<map_value> value = make_cycle<map_value>(&value_destroyed);
+  value->back = owner;
+  owner->items.insert(1, value);
+
+  value = nullptr;
+  CHECK(!owner_destroyed);
+  CHECK(!value_destroyed);
+
+  owner = nullptr;
+  CHECK(owner_destroyed);
+  CHECK(value_destroyed);
+}
+
+TEST(concurrent_map_threads) {
+  cycle_gptr<map_owner> owner = make_cycle<map_owner>();
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back(
+        [&owner, t]() {
+          for (int i = 0; i < 500; ++i) {
+            const int key = t * 1000 + i;
+            owner->items.insert(key, make_cycle<map_value>(nullptr, key));
+            cycle_gptr<map_value> found = owner->items.find(key);
+            CHECK(found != nullptr && found->value == key);
+            if (i % 2 == 0) owner->items.erase(key);
+          }
+        });
+  }
+  for (auto& thr : threads) thr.join();
+
+  CHECK_EQUAL(1000u, owner->items.size());
+}
+
+// Lookups may hold the last reference to bucket data that a writer replaced.
+// Destroying that would release the replaced entries on the lookup thread.
+TEST(concurrent_map_lookup_does_not_release) {
+  constexpr int keys = 4, rounds = 20000, readers = 2;
+  cycle_gptr<tracked_map_owner> owner = make_cycle<tracked_map_owner>();
+  for (int key = 0; key < keys; ++key)
+    owner->items.insert(tracked_key(key), make_cycle<map_value>(nullptr, key));
+
+  std::atomic<bool> stop{ false };
+  std::vector<std::thread> threads;
+  for (int t = 0; t < readers; ++t) {
+    threads.emplace_back(
+        [&owner, &stop]() {
+          lookup_thread = true;
+          for (int i = 0; !stop.load(std::memory_order_relaxed); i = (i + 1) % keys) {
+            cycle_gptr<map_value> found = owner->items.find(tracked_key(i));
+            CHECK(found != nullptr && found->value == i);
+          }
+        });
+  }
+  for (int i = 0; i < rounds; ++i)
+    owner->items.insert_or_assign(tracked_key(i % keys), make_cycle<map_value>(nullptr, i % keys));
+  stop.store(true, std::memory_order_relaxed);
+  for (auto& thr : threads) thr.join();
+
+  CHECK_EQUAL(0, destroyed_by_lookup.load());
+}
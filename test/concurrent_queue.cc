@@ -0,0 +1,151 @@
+#include <cycle_ptr/concurrent_queue.h>
+#include "UnitTest++/UnitTest++.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace cycle_ptr;
+
+namespace {
+
+struct queue_item {
+  explicit queue_item(int value = 0) noexcept
+  : value(value)
+  {}
+
+  int value;
+};
+
+} /* namespace <unnamed> */
+
+TEST(concurrent_queue_fifo) {
+  concurrent_queue<queue_item> q;
+  CHECK(q.empty());
+
+  for (int i = 0; i < 4; ++i) q.push(make_cycle<queue_item>(i));
+  CHECK(!q.empty());
+
+  cycle_gptr<queue_item> item;
+  for (int i = 0; i < 4; ++i) {
+    REQUIRE CHECK(q.try_pop(item));
+    CHECK_EQUAL(i, item->value);
+  }
+  CHECK(!q.try_pop(item));
+  CHECK(q.empty());
+}
+
+TEST(concurrent_queue_holds_reference) {
+  concurrent_queue<queue_item> q;
+  cycle_weak_ptr<queue_item> weak;
+  {
+    cycle_gptr<queue_item> item = make_cycle<queue_item>(7);
+    weak = item;
+    q.push(std::move(item));
+  }
+  CHECK(!weak.expired());
+
+  cycle_gptr<queue_item> item;
+  REQUIRE CHECK(q.try_pop(item));
+  CHECK_EQUAL(7, item->value);
+  item.reset();
+  CHECK(weak.expired());
+}
+
+TEST(concurrent_stack_lifo) {
+  concurrent_stack<queue_item> s;
+  CHECK(s.empty());
+
+  for (int i = 0; i < 4; ++i) s.push(make_cycle<queue_item>(i));
+  CHECK(!s.empty());
+
+  cycle_gptr<queue_item> item;
+  for (int i = 3; i >= 0; --i) {
+    REQUIRE CHECK(s.try_pop(item));
+    CHECK_EQUAL(i, item->value);
+  }
+  CHECK(!s.try_pop(item));
+  CHECK(s.empty());
+}
+
+// A thread that loaded the head of a queue, holds on to that node while
+// other threads pop many elements.
+// Popped nodes keep their next link, so dropping the stale node releases
+// the chain of popped nodes, which must not recurse.
+TEST(concurrent_queue_stale_node) {
+  using node = detail::lockfree_node<queue_item>;
+  constexpr int count = 1000000;
+
+  node::pool_type pool;
+  detail::intrusive_ptr<node> head = node::create(pool, nullptr);
+  detail::intrusive_ptr<node> tail = head;
+  for (int i = 0; i < count; ++i) {
+    detail::intrusive_ptr<node> n = node::create(pool, nullptr);
+    tail->next = n;
+    tail = std::move(n);
+  }
+
+  detail::intrusive_ptr<node> stale = head;
+  for (int i = 0; i < count; ++i) head = head->next.load();
+  CHECK(head == tail);
+
+  stale.reset();
+  CHECK(head->next.load() == nullptr);
+}
+
+TEST(concurrent_queue_threads) {
+  constexpr int producers = 2, consumers = 2, count = 2000;
+  concurrent_queue<queue_item> q;
+  std::atomic<int> consumed{ 0 };
+  std::vector<std::vector<int>> seen(consumers);
+
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back(
+        [&q, p]() {
+          for (int i = 0; i < count; ++i) q.push(make_cycle<queue_item>(p * count + i));
+        });
+  }
+  for (int c = 0; c < consumers; ++c) {
+    threads.emplace_back(
+        [&q, &consumed, &seen, c]() {
+          cycle_gptr<queue_item> item;
+          while (consumed.load() < producers * count) {
+            if (q.try_pop(item)) {
+              seen[c].push_back(item->value);
+              ++consumed;
+            }
+          }
+        });
+  }
+  for (auto& thr : threads) thr.join();
+
+  std::vector<int> all;
+  for (const auto& v : seen) all.insert(all.end(), v.begin(), v.end());
+  std::sort(all.begin(), all.end());
+  REQUIRE CHECK_EQUAL(std::size_t(producers * count), all.size());
+  for (int i = 0; i < producers * count; ++i) CHECK_EQUAL(i, all[i]);
+}
+
+TEST(concurrent_stack_threads) {
+  constexpr int threads_count = 4, count = 2000;
+  concurrent_stack<queue_item> s;
+  std::atomic<int> popped{ 0 };
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threads_count; ++t) {
+    threads.emplace_back(
+        [&s, &popped]() {
+          cycle_gptr<queue_item> item;
+          for (int i = 0; i < count; ++i) {
+            s.push(make_cycle<queue_item>(i));
+            if (s.try_pop(item)) ++popped;
+          }
+        });
+  }
+  for (auto& thr : threads) thr.join();
+
+  cycle_gptr<queue_item> item;
+  while (s.try_pop(item)) ++popped;
+  CHECK_EQUAL(threads_count * count, popped.load());
+}
@@ -0,0 +1,138 @@
+#include <cycle_ptr/cow.h>
+#include "UnitTest++/UnitTest++.h"
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cycle_ptr;
+
+namespace {
+
+class node {
+ public:
+  explicit node(int value = 0) noexcept
+  : value(value)
+  {}
+
+  int value;
+  cycle_member_ptr<node> next;
+};
+
+struct document {
+  std::string title;
+  std::vector<int> pages;
+};
+
+} /* namespace <unnamed> */
+
+TEST(is_unique) {
+  cycle_gptr<node> x = make_cycle<node>();
+  CHECK(x.is_unique());
+
+  cycle_gptr<node> copy = x;
+  CHECK(!x.is_unique());
+  copy = nullptr;
+  CHECK(x.is_unique());
+
+  auto alias = cycle_gptr<int>(x, &x->value);
+  CHECK(!x.is_unique());
+  CHECK(!alias.is_unique());
+  alias = nullptr;
+
+  CHECK(!cycle_gptr<node>().is_unique());
+  CHECK(!make_cycle_immortal<node>().is_unique());
+}
+
+TEST(is_unique_with_edges) {
+  cycle_gptr<node> x = make_cycle<node>();
+  cycle_gptr<node> y = make_cycle<node>();
+  x->next = y;
+  CHECK(x.is_unique());
+  CHECK(!y.is_unique());
+
+  // Pointing at itself doesn't share the object.
+  x->next = x;
+  CHECK(x.is_unique());
+  CHECK(y.is_unique());
+
+  // A cycle: y is only held by x, but x can still reach it.
+  x->next = y;
+  y->next = x;
+  x = nullptr;
+  CHECK(!y.is_unique());
+
+  y->next = nullptr;
+  CHECK(y.is_unique());
+}
+
+// Another thread moves the only edge to x between objects in the
+// generation of x, so the scan may pass each object at the wrong moment.
+TEST(is_unique_with_concurrent_edge_moves) {
+  cycle_gptr<node> x = make_cycle<node>();
+
+  // Merge the holders into the generation of x.
+  std::vector<cycle_gptr<node>> holders;
+  for (int i = 0; i < 1000; ++i) {
+    const cycle_gptr<node>& h = holders.emplace_back(make_cycle<node>());
+    x->next = h;
+    h->next = x;
+    h->next = nullptr;
+  }
+  x->next = nullptr;
+  holders.front()->next = x;
+
+  std::atomic<bool> stop{ false };
+  std::thread mover(
+      [&]() {
+        std::minstd_rand rng;
+        std::uniform_int_distribution<std::size_t> pick(0, holders.size() - 1u);
+        std::size_t current = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+          const std::size_t next = pick(rng);
+          if (next == current) continue;
+          holders[next]->next = holders[current]->next;
+          holders[current]->next = nullptr;
+          current = next;
+        }
+      });
+
+  int unique = 0;
+  for (int i = 0; i < 20000; ++i)
+    if (x.is_unique()) ++unique;
+  stop.store(true, std::memory_order_relaxed);
+  mover.join();
+
+  CHECK_EQUAL(0, unique);
+}
+
+TEST(cow_write_copies_shared) {
+  cow<document> a = make_cow<document>(document{ "draft", { 1, 2 } });
+  CHECK(a.unique());
+
+  cow<document> b = a;
+  CHECK(a == b);
+  CHECK(!a.unique());
+
+  b.write().title = "final";
+  CHECK(a != b);
+  CHECK_EQUAL("draft", a->title);
+  CHECK_EQUAL("final", b->title);
+  CHECK_EQUAL(2u, b->pages.size());
+}
+
+TEST(cow_write_in_place_when_unique) {
+  cow<document> a = make_cow<document>();
+  const document* address = a.get();
+
+  a.write().title = "x";
+  a.write().pages.push_back(1);
+  CHECK_EQUAL(address, a.get());
+
+  cycle_gptr<const document> snapshot = a.share();
+  a.write().title = "y";
+  CHECK(address != a.get());
+  CHECK_EQUAL("x", snapshot->title);
+  CHECK_EQUAL("y", a->title);
+}
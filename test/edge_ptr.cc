@@ -0,0 +1,138 @@
+#include <cycle_ptr.h>
+#include "UnitTest++/UnitTest++.h"
+
+using namespace cycle_ptr;
+
+struct edge_node {
+  explicit edge_node(bool* destroyed = nullptr) noexcept
+  : destroyed(destroyed)
+  {}
+
+  ~edge_node() {
+    if (destroyed != nullptr) {
+      CHECK(!*destroyed); // Check that we're only destroyed once.
+      *destroyed = true;
+    }
+  }
+
+  cycle_edge_ptr<edge_node> left, right;
+  bool* destroyed = nullptr;
+};
+
+CYCLE_PTR_EDGES(edge_node, &edge_node::left, &edge_node::right)
+
+// Uses the edges declared for edge_node.
+struct derived_edge_node
+: edge_node
+{
+  using edge_node::edge_node;
+};
+
+// Declares its own edges, in addition to those of edge_node.
+struct extended_edge_node
+: edge_node
+{
+  using edge_node::edge_node;
+
+  cycle_edge_ptr<edge_node> extra;
+};
+
+CYCLE_PTR_EDGES(extended_edge_node, &edge_node::left, &edge_node::right, &extended_edge_node::extra)
+
+TEST(edge_ptr_destructor) {
+  bool destroyed = false;
+  cycle_gptr<edge_node> ptr = make_cycle<edge_node>(&destroyed);
+  REQUIRE CHECK(ptr != nullptr);
+
+  ptr = nullptr;
+  CHECK(destroyed);
+}
+
+TEST(edge_ptr_keeps_target_alive) {
+  bool first_destroyed = false;
+  bool second_destroyed = false;
+  cycle_gptr<edge_node> ptr_1 = make_cycle<edge_node>(&first_destroyed);
+  ptr_1->left = make_cycle<edge_node>(&second_destroyed);
+
+  CHECK(!second_destroyed);
+  ptr_1->left = nullptr;
+  CHECK(second_destroyed);
+  CHECK(!first_destroyed);
+}
+
+TEST(edge_ptr_cycle) {
+  bool first_destroyed = false;
+  bool second_destroyed = false;
+  cycle_gptr<edge_node> ptr_1 = make_cycle<edge_node>(&first_destroyed);
+  cycle_gptr<edge_node> ptr_2 = make_cycle<edge_node>(&second_destroyed);
+  ptr_1->left = ptr_2;
+  ptr_2->right = ptr_1;
+
+  REQUIRE CHECK(ptr_1->left == ptr_2);
+  REQUIRE CHECK(ptr_2->right == ptr_1);
+
+  ptr_1 = nullptr;
+  CHECK(!first_destroyed);
+  CHECK(!second_destroyed);
+
+  ptr_2 = nullptr;
+  CHECK(first_destroyed);
+  CHECK(second_destroyed);
+}
+
+TEST(edge_ptr_self_cycle) {
+  bool destroyed = false;
+  cycle_gptr<edge_node> ptr = make_cycle<edge_node>(&destroyed);
+  ptr->left = ptr;
+  ptr->right = ptr;
+
+  ptr = nullptr;
+  CHECK(destroyed);
+}
+
+TEST(edge_ptr_unowned_is_strong) {
+  bool destroyed = false;
+  cycle_edge_ptr<edge_node> edge = make_cycle<edge_node>(&destroyed);
+  CHECK(!destroyed);
+
+  cycle_gptr<edge_node> ptr = edge;
+  CHECK(ptr == edge);
+  edge = nullptr;
+  CHECK(!destroyed);
+  ptr = nullptr;
+  CHECK(destroyed);
+}
+
+TEST(edge_ptr_derived_cycle) {
+  bool first_destroyed = false;
+  bool second_destroyed = false;
+  cycle_gptr<derived_edge_node> ptr_1 = make_cycle<derived_edge_node>(&first_destroyed);
+  cycle_gptr<derived_edge_node> ptr_2 = make_cycle_split<derived_edge_node>(&second_destroyed);
+  ptr_1->left = ptr_2;
+  ptr_2->right = ptr_1;
+
+  ptr_1 = nullptr;
+  CHECK(!first_destroyed);
+  CHECK(!second_destroyed);
+
+  ptr_2 = nullptr;
+  CHECK(first_destroyed);
+  CHECK(second_destroyed);
+}
+
+TEST(edge_ptr_derived_declares_own) {
+  bool first_destroyed = false;
+  bool second_destroyed = false;
+  cycle_gptr<extended_edge_node> ptr_1 = make_cycle<extended_edge_node>(&first_destroyed);
+  cycle_gptr<extended_edge_node> ptr_2 = make_cycle<extended_edge_node>(&second_destroyed);
+  ptr_1->extra = ptr_2;
+  ptr_2->left = ptr_1;
+
+  ptr_1 = nullptr;
+  CHECK(!first_destroyed);
+  CHECK(!second_destroyed);
+
+  ptr_2 = nullptr;
+  CHECK(first_destroyed);
+  CHECK(second_destroyed);
+}
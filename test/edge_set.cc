@@ -0,0 +1,115 @@
+#include <cycle_ptr.h>
+#include <vector>
+#include "UnitTest++/UnitTest++.h"
+
+using namespace cycle_ptr;
+
+class set_node {
+ public:
+  explicit set_node(bool* destroyed = nullptr, int value = 0) noexcept
+  : value(value),
+    destroyed(destroyed)
+  {}
+
+  ~set_node() {
+    if (destroyed != nullptr) {
+      CHECK(!*destroyed); // Check that we're only destroyed once.
+      *destroyed = true;
+    }
+  }
+
+  cycle_edge_set<set_node> neighbours;
+  int value;
+
+ private:
+  bool* destroyed = nullptr;
+};
+
+TEST(edge_set_push_back) {
+  bool destroyed[3] = { false, false, false };
+  cycle_gptr<set_node> owner = make_cycle<set_node>(&destroyed[0]);
+  owner->neighbours.push_back(make_cycle<set_node>(&destroyed[1], 1));
+  owner->neighbours.push_back(make_cycle<set_node>(&destroyed[2], 2));
+
+  REQUIRE CHECK_EQUAL(2u, owner->neighbours.size());
+  CHECK_EQUAL(1, owner->neighbours.get(0)->value);
+  CHECK_EQUAL(2, owner->neighbours.at(1)->value);
+  CHECK(!destroyed[1]);
+  CHECK(!destroyed[2]);
+
+  owner = nullptr;
+  CHECK(destroyed[0]);
+  CHECK(destroyed[1]);
+  CHECK(destroyed[2]);
+}
+
+TEST(edge_set_insert_and_erase) {
+  bool destroyed[4] = { false, false, false, false };
+  std::vector<cycle_gptr<set_node>> nodes;
+  for (int i = 0; i < 4; ++i)
+    nodes.push_back(make_cycle<set_node>(&destroyed[i], i));
+
+  cycle_gptr<set_node> owner = make_cycle<set_node>();
+  owner->neighbours.insert(nodes.begin(), nodes.end());
+  nodes.clear();
+  REQUIRE CHECK_EQUAL(4u, owner->neighbours.size());
+
+  owner->neighbours.erase(1);
+  CHECK(destroyed[1]);
+  REQUIRE CHECK_EQUAL(3u, owner->neighbours.size());
+  CHECK_EQUAL(0, owner->neighbours.get(0)->value);
+  CHECK_EQUAL(2, owner->neighbours.get(1)->value);
+  CHECK_EQUAL(3, owner->neighbours.get(2)->value);
+
+  CHECK_EQUAL(1u, owner->neighbours.erase_if([](set_node* n) { return n->value == 2; }));
+  CHECK(destroyed[2]);
+  REQUIRE CHECK_EQUAL(2u, owner->neighbours.size());
+  CHECK_EQUAL(0, owner->neighbours.get(0)->value);
+  CHECK_EQUAL(3, owner->neighbours.get(1)->value);
+
+  owner->neighbours.clear();
+  CHECK(owner->neighbours.empty());
+  CHECK(destroyed[0]);
+  CHECK(destroyed[3]);
+}
+
+TEST(edge_set_cycle) {
+  bool destroyed[3] = { false, false, false };
+  cycle_gptr<set_node> nodes[3];
+  for (int i = 0; i < 3; ++i) nodes[i] = make_cycle<set_node>(&destroyed[i], i);
+
+  // Fully connected graph, including self edges.
+  for (auto& src : nodes) src->neighbours.insert(std::begin(nodes), std::end(nodes));
+
+  nodes[0] = nullptr;
+  nodes[1] = nullptr;
+  CHECK(!destroyed[0]);
+  CHECK(!destroyed[1]);
+  CHECK(!destroyed[2]);
+
+  nodes[2] = nullptr;
+  CHECK(destroyed[0]);
+  CHECK(destroyed[1]);
+  CHECK(destroyed[2]);
+}
+
+TEST(edge_set_assign) {
+  bool destroyed[2] = { false, false };
+  cycle_gptr<set_node> owner = make_cycle<set_node>();
+  owner->neighbours.push_back(make_cycle<set_node>(&destroyed[0], 0));
+  owner->neighbours.assign(0, make_cycle<set_node>(&destroyed[1], 1));
+
+  CHECK(destroyed[0]);
+  CHECK(!destroyed[1]);
+  CHECK_EQUAL(1, owner->neighbours.get(0)->value);
+}
+
+TEST(edge_set_unowned) {
+  bool destroyed = false;
+  cycle_edge_set<set_node> set{ unowned_cycle };
+  set.push_back(make_cycle<set_node>(&destroyed));
+  CHECK(!destroyed);
+
+  set.clear();
+  CHECK(destroyed);
+}
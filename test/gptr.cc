@@ -1,5 +1,7 @@
 #include <cycle_ptr.h>
 #include "UnitTest++/UnitTest++.h"
+#include <iterator>
+#include <vector>
 
 using namespace cycle_ptr;
 
@@ -77,3 +79,126 @@ TEST(alias) {
   alias = nullptr;
   CHECK(destroyed);
 }
+
+TEST(split_destructor) {
+  bool destroyed = false;
+  cycle_gptr<create_destroy_check> ptr =
+      make_cycle_split<create_destroy_check>(&destroyed);
+  REQUIRE CHECK(ptr != nullptr);
+  cycle_weak_ptr<create_destroy_check> weak = ptr;
+
+  CHECK(!destroyed);
+  CHECK(!weak.expired());
+  ptr = nullptr;
+  CHECK(destroyed);
+  CHECK(weak.expired());
+  CHECK(weak.lock() == nullptr);
+}
+
+TEST(split_alias) {
+  bool destroyed = false;
+  cycle_gptr<csc_container> ptr_1 =
+      make_cycle_split<csc_container>(&destroyed);
+  REQUIRE CHECK(ptr_1 != nullptr);
+  auto alias = cycle_gptr<int>(ptr_1, &ptr_1->foo);
+  REQUIRE CHECK(alias != nullptr);
+
+  ptr_1 = nullptr;
+  CHECK_EQUAL(4, *alias);
+  CHECK(!destroyed);
+
+  alias = nullptr;
+  CHECK(destroyed);
+}
+
+struct isolated_type {
+  int value = 17;
+};
+
+template<>
+struct cycle_ptr::cache_isolated<isolated_type>
+: std::true_type
+{};
+
+TEST(cache_isolated_layout) {
+  cycle_gptr<isolated_type> ptr = make_cycle<isolated_type>();
+  REQUIRE CHECK(ptr != nullptr);
+
+  CHECK_EQUAL(17, ptr->value);
+  CHECK_EQUAL(
+      std::uintptr_t(0),
+      reinterpret_cast<std::uintptr_t>(ptr.get()) % detail::hardware_destructive_interference_size);
+}
+
+TEST(immortal) {
+  static bool destroyed = false;
+  cycle_gptr<create_destroy_check> ptr =
+      make_cycle_immortal<create_destroy_check>(&destroyed);
+  REQUIRE CHECK(ptr != nullptr);
+  cycle_weak_ptr<create_destroy_check> weak = ptr;
+
+  cycle_gptr<create_destroy_check> copy = ptr;
+  ptr = nullptr;
+  copy = nullptr;
+  CHECK(!destroyed);
+  CHECK(!weak.expired());
+  CHECK(weak.lock() != nullptr);
+}
+
+TEST(lock_all) {
+  bool first_destroyed = false;
+  bool second_destroyed = false;
+  cycle_gptr<create_destroy_check> first =
+      make_cycle<create_destroy_check>(&first_destroyed);
+  cycle_gptr<create_destroy_check> second =
+      make_cycle<create_destroy_check>(&second_destroyed);
+
+  std::vector<cycle_weak_ptr<create_destroy_check>> weak{ first, second, first, {} };
+  second = nullptr;
+  REQUIRE CHECK(second_destroyed);
+
+  std::vector<cycle_gptr<create_destroy_check>> locked;
+  lock_all(weak.begin(), weak.end(), std::back_inserter(locked));
+  REQUIRE CHECK_EQUAL(4u, locked.size());
+  CHECK_EQUAL(first, locked[0]);
+  CHECK(locked[1] == nullptr);
+  CHECK_EQUAL(first, locked[2]);
+  CHECK(locked[3] == nullptr);
+
+  first = nullptr;
+  CHECK(!first_destroyed);
+  locked.clear();
+  CHECK(first_destroyed);
+}
+
+namespace {
+
+std::vector<gc_phase> recorded_phases;
+
+void record_phase(gc_phase p) noexcept {
+  recorded_phases.push_back(p);
+}
+
+} /* namespace <unnamed> */
+
+TEST(gc_phase_hook) {
+  bool destroyed = false;
+  cycle_gptr<create_destroy_check> ptr =
+      make_cycle<create_destroy_check>(&destroyed);
+
+  recorded_phases.clear();
+  CHECK(set_gc_phase_hook(&record_phase) == nullptr);
+  ptr = nullptr;
+  CHECK(set_gc_phase_hook(nullptr) == &record_phase);
+  REQUIRE CHECK(destroyed);
+
+  const std::vector<gc_phase> expect{
+    gc_phase::start,
+    gc_phase::phase1,
+    gc_phase::phase2,
+    gc_phase::phase3,
+    gc_phase::destroy,
+    gc_phase::done
+  };
+  CHECK(recorded_phases == expect);
+}
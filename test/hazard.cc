@@ -0,0 +1,121 @@
+#include <cycle_ptr.h>
+#include "UnitTest++/UnitTest++.h"
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using cycle_ptr::detail::hazard_ptr;
+using cycle_ptr::detail::intrusive_ptr;
+
+namespace {
+
+// Reference counted object, that records whether it is still alive.
+struct counted {
+  static constexpr std::uint32_t alive_magic = 0x600dc0deu;
+  static constexpr std::uint32_t dead_magic = 0xdeadbeefu;
+  static inline std::atomic<int> live{ 0 };
+
+  counted() noexcept {
+    live.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  ~counted() noexcept {
+    magic.store(dead_magic, std::memory_order_relaxed);
+    live.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  friend auto intrusive_ptr_add_ref(counted* p)
+  noexcept
+  -> void {
+    p->refs.fetch_add(1u, std::memory_order_relaxed);
+  }
+
+  friend auto intrusive_ptr_release(counted* p)
+  noexcept
+  -> void {
+    if (p->refs.fetch_sub(1u, std::memory_order_acq_rel) == 1u) delete p;
+  }
+
+  std::atomic<std::uintptr_t> refs{ 1u };
+  std::atomic<std::uint32_t> magic{ alive_magic };
+};
+
+auto make_counted()
+-> intrusive_ptr<counted> {
+  return intrusive_ptr<counted>(new counted(), false);
+}
+
+} /* namespace <unnamed> */
+
+TEST(hazard_ptr_compare_exchange) {
+  hazard_ptr<counted> hp{ make_counted() };
+
+  intrusive_ptr<counted> expected = hp.load();
+  intrusive_ptr<counted> other = make_counted();
+  CHECK(!hp.compare_exchange_strong(other, make_counted()));
+  CHECK(other == expected);
+
+  const intrusive_ptr<counted> desired = make_counted();
+  CHECK(hp.compare_exchange_strong(expected, desired));
+  CHECK(hp.load() == desired);
+
+  hp.reset();
+  expected.reset();
+  other.reset();
+  CHECK_EQUAL(1, counted::live.load());
+}
+
+// Readers acquire the pointer while writers replace it.
+// A reader that acquires a released object would see it dead,
+// or crash under a sanitizer.
+TEST(hazard_ptr_stress) {
+  constexpr int writers = 2, readers = 4, rounds = 20000;
+
+  hazard_ptr<counted> hp{ make_counted() };
+  std::atomic<bool> stop{ false };
+  std::atomic<int> bad{ 0 };
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < readers; ++i) {
+    threads.emplace_back(
+        [&]() {
+          while (!stop.load(std::memory_order_relaxed)) {
+            const intrusive_ptr<counted> p = hp.load();
+            if (p == nullptr) continue;
+            if (p->magic.load(std::memory_order_relaxed) != counted::alive_magic
+                || p->refs.load(std::memory_order_relaxed) == 0u)
+              bad.fetch_add(1, std::memory_order_relaxed);
+          }
+        });
+  }
+  for (int i = 0; i < writers; ++i) {
+    threads.emplace_back(
+        [&, i]() {
+          for (int r = 0; r < rounds; ++r) {
+            switch ((r + i) % 3) {
+              case 0:
+                hp.store(make_counted());
+                break;
+              case 1:
+                hp.reset();
+                break;
+              case 2:
+                {
+                  intrusive_ptr<counted> expected = hp.load();
+                  hp.compare_exchange_strong(expected, make_counted());
+                }
+                break;
+            }
+          }
+        });
+  }
+
+  for (int i = 0; i < writers; ++i) threads[readers + i].join();
+  stop.store(true, std::memory_order_relaxed);
+  for (int i = 0; i < readers; ++i) threads[i].join();
+
+  CHECK_EQUAL(0, bad.load());
+  hp.reset();
+  CHECK_EQUAL(0, counted::live.load());
+}
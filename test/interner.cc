@@ -0,0 +1,198 @@
+#include <cycle_ptr/interner.h>
+#include "UnitTest++/UnitTest++.h"
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cycle_ptr;
+
+namespace {
+
+///\brief Expression node, as used with hash-consing.
+class expr {
+ public:
+  // Probe values live on the stack, so their members are unowned.
+  expr(char op, int value) noexcept
+  : op(op),
+    value(value),
+    lhs(unowned_cycle),
+    rhs(unowned_cycle)
+  {}
+
+  expr(char op, cycle_gptr<expr> lhs, cycle_gptr<expr> rhs)
+  : op(op),
+    lhs(unowned_cycle, std::move(lhs)),
+    rhs(unowned_cycle, std::move(rhs))
+  {}
+
+  expr(const expr& other)
+  : op(other.op),
+    value(other.value),
+    lhs(other.lhs),
+    rhs(other.rhs)
+  {}
+
+  char op;
+  int value = 0;
+  cycle_member_ptr<expr> lhs, rhs;
+};
+
+///\brief Structural equality, assuming children are interned.
+struct expr_equal {
+  auto operator()(const expr& x, const expr& y) const noexcept -> bool {
+    return x.op == y.op && x.value == y.value && x.lhs == y.lhs && x.rhs == y.rhs;
+  }
+};
+
+///\brief Structural hash, assuming children are interned.
+struct expr_hash {
+  auto operator()(const expr& x) const noexcept -> std::size_t {
+    return std::hash<int>()(x.op * 31 + x.value)
+        ^ std::hash<const expr*>()(x.lhs.get()) * 7u
+        ^ std::hash<const expr*>()(x.rhs.get()) * 13u;
+  }
+};
+
+///\brief Value, which records how many comparisons preceded its destruction.
+struct compared_value {
+  compared_value(int value, bool tracked) noexcept
+  : value(value),
+    tracked(tracked)
+  {}
+
+  compared_value(const compared_value& other) = default;
+  ~compared_value() noexcept;
+
+  int value;
+  bool tracked;
+};
+
+int compare_calls = 0;
+std::vector<int> compare_calls_at_destruction;
+std::vector<cycle_gptr<compared_value>> compared_holders;
+bool drop_compared = false;
+
+compared_value::~compared_value() noexcept {
+  if (tracked) compare_calls_at_destruction.push_back(compare_calls);
+}
+
+///\brief Every value collides, so a lookup compares against all of them.
+struct colliding_hash {
+  auto operator()(const compared_value&) const noexcept -> std::size_t {
+    return 0u;
+  }
+};
+
+///\brief Equality that drops the outside reference to the compared object.
+struct dropping_equal {
+  auto operator()(const compared_value& x, const compared_value& y) const noexcept -> bool {
+    ++compare_calls;
+    if (drop_compared) {
+      for (cycle_gptr<compared_value>& holder : compared_holders)
+        if (holder.get() == &x) holder = nullptr;
+    }
+    return x.value == y.value;
+  }
+};
+
+} /* namespace <unnamed> */
+
+TEST(interner_strings) {
+  interner<std::string> strings;
+
+  cycle_gptr<std::string> x = strings.intern(std::string("hello"));
+  cycle_gptr<std::string> y = strings.intern(std::string("hel") + "lo");
+  cycle_gptr<std::string> z = strings.intern(std::string("world"));
+  CHECK(x == y);
+  CHECK(x != z);
+  CHECK_EQUAL(2u, strings.size());
+
+  // An existing object becomes canonical, if there is none yet.
+  cycle_gptr<std::string> w = make_cycle<std::string>("!");
+  CHECK(strings.intern(w) == w);
+  CHECK(strings.intern(make_cycle<std::string>("!")) == w);
+}
+
+TEST(interner_forgets_collected) {
+  interner<std::string> strings;
+  cycle_gptr<std::string> x = strings.intern(std::string("hello"));
+  strings.intern(std::string("temporary"));
+
+  strings.prune();
+  CHECK_EQUAL(1u, strings.size());
+
+  x = nullptr;
+  strings.prune();
+  CHECK(strings.empty());
+
+  // Interning a collected value creates a new object.
+  x = strings.intern(std::string("hello"));
+  CHECK_EQUAL(std::string("hello"), *x);
+  CHECK_EQUAL(1u, strings.size());
+}
+
+TEST(interner_expressions) {
+  interner<expr, expr_hash, expr_equal> exprs;
+
+  const auto build =
+      [&exprs]() {
+        cycle_gptr<expr> one = exprs.intern(expr('c', 1));
+        cycle_gptr<expr> two = exprs.intern(expr('c', 2));
+        cycle_gptr<expr> sum = exprs.intern(expr('+', one, two));
+        return exprs.intern(expr('*', sum, sum));
+      };
+
+  cycle_gptr<expr> x = build();
+  cycle_gptr<expr> y = build();
+  CHECK(x == y);
+  CHECK(x->lhs == x->rhs);
+  CHECK_EQUAL(4u, exprs.size());
+
+  x = nullptr;
+  y = nullptr;
+  exprs.prune();
+  CHECK(exprs.empty());
+}
+
+TEST(interner_threads) {
+  interner<std::string> strings{ 4 };
+  std::vector<std::vector<cycle_gptr<std::string>>> results(4);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back(
+        [&strings, &result = results[t]]() {
+          for (int i = 0; i < 200; ++i)
+            result.push_back(strings.intern(std::to_string(i)));
+        });
+  }
+  for (auto& thr : threads) thr.join();
+
+  for (int t = 1; t < 4; ++t) {
+    for (int i = 0; i < 200; ++i)
+      CHECK(results[0][i] == results[t][i]);
+  }
+  CHECK_EQUAL(200u, strings.size());
+}
+
+TEST(interner_releases_unequal_after_unlock) {
+  interner<compared_value, colliding_hash, dropping_equal> values{ 1 };
+  compared_holders.push_back(values.intern(make_cycle<compared_value>(0, true)));
+  compared_holders.push_back(values.intern(make_cycle<compared_value>(1, true)));
+  compare_calls = 0;
+  compare_calls_at_destruction.clear();
+  drop_compared = true;
+
+  // The lookup holds the last reference to the objects it compared.
+  // They must be released after the lookup, not while the shard is locked.
+  cycle_gptr<compared_value> x = values.intern(compared_value(2, false));
+  CHECK_EQUAL(2, x->value);
+  CHECK_EQUAL(2, compare_calls);
+  REQUIRE CHECK_EQUAL(2u, compare_calls_at_destruction.size());
+  CHECK_EQUAL(2, compare_calls_at_destruction[0]);
+  CHECK_EQUAL(2, compare_calls_at_destruction[1]);
+
+  drop_compared = false;
+  compared_holders.clear();
+}
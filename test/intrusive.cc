@@ -0,0 +1,103 @@
+#include <cycle_ptr.h>
+#include "UnitTest++/UnitTest++.h"
+
+using namespace cycle_ptr;
+
+class intrusive_node
+: public cycle_intrusive_base
+{
+ public:
+  explicit intrusive_node(bool* destroyed = nullptr) noexcept
+  : destroyed(destroyed)
+  {}
+
+  ~intrusive_node() {
+    if (destroyed != nullptr) {
+      CHECK(!*destroyed); // Check that we're only destroyed once.
+      *destroyed = true;
+    }
+  }
+
+  cycle_intrusive_member_ptr<intrusive_node> next;
+
+ private:
+  bool* destroyed = nullptr;
+};
+
+TEST(intrusive_single_word) {
+  CHECK_EQUAL(sizeof(void*), sizeof(cycle_intrusive_gptr<intrusive_node>));
+  CHECK_EQUAL(sizeof(void*), sizeof(cycle_intrusive_weak_ptr<intrusive_node>));
+}
+
+TEST(intrusive_destructor) {
+  bool destroyed = false;
+  cycle_intrusive_gptr<intrusive_node> ptr = make_cycle<intrusive_node>(&destroyed);
+  REQUIRE CHECK(ptr != nullptr);
+
+  cycle_intrusive_gptr<intrusive_node> copy = ptr;
+  ptr = nullptr;
+  CHECK(!destroyed);
+  copy.reset();
+  CHECK(destroyed);
+}
+
+TEST(intrusive_from_raw_pointer) {
+  bool destroyed = false;
+  cycle_intrusive_gptr<intrusive_node> ptr = make_cycle<intrusive_node>(&destroyed);
+  cycle_intrusive_gptr<intrusive_node> copy = cycle_intrusive_gptr<intrusive_node>(ptr.get());
+
+  CHECK_EQUAL(ptr.get(), copy.get());
+  ptr = nullptr;
+  CHECK(!destroyed);
+  copy = nullptr;
+  CHECK(destroyed);
+}
+
+TEST(intrusive_cycle) {
+  bool first_destroyed = false;
+  bool second_destroyed = false;
+  cycle_intrusive_gptr<intrusive_node> ptr_1 = make_cycle<intrusive_node>(&first_destroyed);
+  cycle_intrusive_gptr<intrusive_node> ptr_2 = make_cycle<intrusive_node>(&second_destroyed);
+  ptr_1->next = ptr_2;
+  ptr_2->next = ptr_1;
+
+  REQUIRE CHECK(ptr_1->next == ptr_2);
+  REQUIRE CHECK(ptr_2->next == ptr_1);
+
+  ptr_1 = nullptr;
+  CHECK(!first_destroyed);
+  CHECK(!second_destroyed);
+
+  ptr_2 = nullptr;
+  CHECK(first_destroyed);
+  CHECK(second_destroyed);
+}
+
+TEST(intrusive_weak) {
+  bool destroyed = false;
+  cycle_intrusive_gptr<intrusive_node> ptr = make_cycle<intrusive_node>(&destroyed);
+  cycle_intrusive_weak_ptr<intrusive_node> weak = ptr;
+
+  CHECK(!weak.expired());
+  CHECK(weak.lock() == ptr);
+
+  ptr = nullptr;
+  CHECK(destroyed);
+  CHECK(weak.expired());
+  CHECK(weak.lock() == nullptr);
+}
+
+TEST(intrusive_gptr_conversion) {
+  bool destroyed = false;
+  cycle_gptr<intrusive_node> ptr = make_cycle<intrusive_node>(&destroyed);
+  cycle_intrusive_gptr<intrusive_node> intrusive = ptr;
+
+  cycle_gptr<intrusive_node> back = intrusive;
+  CHECK_EQUAL(ptr, back);
+
+  ptr = nullptr;
+  back = nullptr;
+  CHECK(!destroyed);
+  intrusive = nullptr;
+  CHECK(destroyed);
+}
@@ -1,5 +1,13 @@
 #include <cycle_ptr.h>
 #include "UnitTest++/UnitTest++.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <random>
+#include <thread>
 #include <vector>
 
 using namespace cycle_ptr;
@@ -159,6 +167,80 @@ TEST(move_seq) {
   auto ooc = make_cycle<owner_of_collection>(pointers.cbegin(), pointers.cend());
 }
 
+class two_edges
+: public create_destroy_check
+{
+ public:
+  using create_destroy_check::create_destroy_check;
+
+  cycle_member_ptr<two_edges> p, q;
+};
+
+TEST(move_seq_collision) {
+  bool d_destroyed = false, a_destroyed = false, b_destroyed = false, c_destroyed = false;
+  {
+    // Created in order, so each has a higher sequence number than the last.
+    auto d = make_cycle<two_edges>(&d_destroyed);
+    auto a = make_cycle<two_edges>(&a_destroyed);
+    auto b = make_cycle<two_edges>(&b_destroyed);
+    auto c = make_cycle<two_edges>(&c_destroyed);
+
+    // a and b are both moved down, to just below d.
+    a->p = d;
+    b->p = d;
+    // Their sequence numbers stop being moveable, and are now equal.
+    c->p = a;
+    c->q = b;
+    // Edges between generations with equal sequence numbers:
+    // one direction is allowed by the address tie-break,
+    // the other requires a merge.
+    a->q = b;
+    b->q = a;
+    CHECK(a->q == b && b->q == a && c->p == a && c->q == b);
+
+    d = nullptr;
+    a = nullptr;
+    b = nullptr;
+    CHECK(!d_destroyed && !a_destroyed && !b_destroyed && !c_destroyed);
+
+    c->p = nullptr;
+    c->q = nullptr;
+    CHECK(!c_destroyed);
+    CHECK(d_destroyed && a_destroyed && b_destroyed);
+  }
+  CHECK(c_destroyed);
+}
+
+TEST(move_seq_collision_threads) {
+  // Repeat the colliding pattern from several threads,
+  // so merges of equal sequence numbers race with each other.
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back(
+        []() {
+          for (int i = 0; i < 500; ++i) {
+            auto d = make_cycle<two_edges>();
+            auto a = make_cycle<two_edges>();
+            auto b = make_cycle<two_edges>();
+            auto c = make_cycle<two_edges>();
+            a->p = d;
+            b->p = d;
+            c->p = a;
+            c->q = b;
+            // Alternate the direction that needs the merge.
+            if (i % 2 == 0) {
+              a->q = b;
+              b->q = a;
+            } else {
+              b->q = a;
+              a->q = b;
+            }
+          }
+        });
+  }
+  for (auto& thr : threads) thr.join();
+}
+
 TEST(expired_can_assign) {
   struct testclass {
     bool* td_ptr;
@@ -223,3 +305,412 @@ TEST(expired_can_create_gptr_but_wont_resurrect) {
   REQUIRE CHECK(tc == nullptr);
   CHECK_EQUAL(nullptr, gptr);
 }
+
+TEST(split_cycle) {
+  bool first_destroyed = false;
+  bool second_destroyed = false;
+  cycle_gptr<owner> ptr_1 = make_cycle_split<owner>(&first_destroyed);
+  cycle_gptr<owner> ptr_2 = make_cycle<owner>(&second_destroyed);
+  ptr_1->target = ptr_2;
+  ptr_2->target = ptr_1;
+
+  ptr_1 = nullptr;
+  CHECK(!first_destroyed);
+  CHECK(!second_destroyed);
+
+  ptr_2 = nullptr;
+  CHECK(first_destroyed);
+  CHECK(second_destroyed);
+}
+
+TEST(immortal_target) {
+  static bool target_destroyed = false;
+  bool owner_destroyed = false;
+  cycle_gptr<create_destroy_check> target =
+      make_cycle_immortal<create_destroy_check>(&target_destroyed);
+  cycle_gptr<owner> ptr = make_cycle<owner>(&owner_destroyed);
+  ptr->target = target;
+  target = nullptr;
+
+  REQUIRE CHECK(ptr->target != nullptr);
+  ptr = nullptr;
+  CHECK(owner_destroyed);
+  CHECK(!target_destroyed);
+}
+
+TEST(immortal_owner) {
+  static bool owner_destroyed = false;
+  bool target_destroyed = false;
+  cycle_gptr<owner> ptr = make_cycle_immortal<owner>(&owner_destroyed);
+  ptr->target = make_cycle<create_destroy_check>(&target_destroyed);
+  cycle_weak_ptr<owner> weak = ptr;
+  ptr = nullptr;
+  CHECK(!owner_destroyed);
+  CHECK(!target_destroyed);
+
+  weak.lock()->target = nullptr;
+  CHECK(!owner_destroyed);
+  CHECK(target_destroyed);
+}
+
+TEST(lock_all_members) {
+  bool owner_destroyed = false;
+  bool first_destroyed = false;
+  bool second_destroyed = false;
+  cycle_gptr<owner_of_collection> ptr = make_cycle<owner_of_collection>();
+  ptr->data.emplace_back(make_cycle<create_destroy_check>(&first_destroyed));
+  ptr->data.emplace_back(make_cycle<create_destroy_check>(&second_destroyed));
+  cycle_gptr<owner> other = make_cycle<owner>(&owner_destroyed);
+  other->target = ptr->data[0];
+
+  // Only reachable through members, which may require red promotion.
+  std::vector<cycle_weak_ptr<create_destroy_check>> weak{
+    ptr->data[0], ptr->data[1], other->target };
+  cycle_gptr<owner> cycle_1 = make_cycle<owner>(nullptr);
+  cycle_gptr<owner> cycle_2 = make_cycle<owner>(nullptr);
+  cycle_1->target = cycle_2;
+  cycle_2->target = cycle_1;
+  weak.push_back(cycle_2);
+  cycle_2 = nullptr;
+  std::vector<cycle_gptr<create_destroy_check>> locked;
+  lock_all(weak.begin(), weak.end(), std::back_inserter(locked));
+  REQUIRE CHECK_EQUAL(4u, locked.size());
+  CHECK(locked[0] == ptr->data[0]);
+  CHECK(locked[1] == ptr->data[1]);
+  CHECK(locked[2] == ptr->data[0]);
+  CHECK(locked[3] == cycle_1->target);
+
+  ptr = nullptr;
+  other = nullptr;
+  cycle_1 = nullptr;
+  CHECK(owner_destroyed);
+  CHECK(!first_destroyed);
+  CHECK(!second_destroyed);
+  locked.clear();
+  CHECK(first_destroyed);
+  CHECK(second_destroyed);
+
+  lock_all(weak.begin(), weak.end(), std::back_inserter(locked));
+  REQUIRE CHECK_EQUAL(4u, locked.size());
+  CHECK(locked[0] == nullptr && locked[1] == nullptr && locked[2] == nullptr);
+  CHECK(locked[3] == nullptr);
+}
+
+class chain_node
+: public cycle_base
+{
+ public:
+  static constexpr std::uint32_t alive_magic = 0x600dc0deu;
+  static constexpr std::uint32_t dead_magic = 0xdeadbeefu;
+  static inline std::atomic<int> live{ 0 };
+
+  chain_node() noexcept {
+    live.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  ~chain_node() noexcept {
+    magic.store(dead_magic, std::memory_order_relaxed);
+    live.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  std::atomic<std::uint32_t> magic{ alive_magic };
+  cycle_member_ptr<chain_node> next;
+};
+
+// Other threads promote weak pointers into a chain, while its generation
+// is being collected.
+// Whatever they promote, and everything after it in the chain,
+// must survive the collection.
+//
+// The promoters hold on to the first few objects they promote:
+// dropping the last reference requests a GC, which waits for the
+// running one.
+TEST(weak_promotion_during_gc) {
+  constexpr std::size_t chain_length = 4096, max_held = 8;
+  constexpr int rounds = 20, promoters = 2;
+
+  // Let the promoters run once the collection holds the generation lock.
+  const gc_phase_hook old_hook = set_gc_phase_hook(
+      [](gc_phase p) noexcept {
+        if (p == gc_phase::phase1) std::this_thread::yield();
+      });
+
+  std::atomic<int> bad{ 0 };
+  for (int round = 0; round < rounds; ++round) {
+    std::vector<cycle_weak_ptr<chain_node>> weak;
+    cycle_gptr<chain_node> root;
+    {
+      detail::graph_builder<chain_node> b;
+      for (std::size_t i = 0; i < chain_length; ++i) {
+        const cycle_gptr<chain_node> n = b.make();
+        weak.emplace_back(n);
+        if (i + 1u < chain_length) b.link(n->next, i + 1u);
+        b.add(n);
+      }
+      root = b.finish();
+    }
+
+    std::atomic<bool> collecting{ false }, stop{ false };
+    std::vector<std::thread> threads;
+    for (int t = 0; t < promoters; ++t) {
+      threads.emplace_back(
+          [&, t]() {
+            std::minstd_rand rng(static_cast<std::minstd_rand::result_type>(round * promoters + t + 1));
+            std::uniform_int_distribution<std::size_t> pick(0, chain_length - 1u);
+            std::vector<cycle_gptr<chain_node>> held;
+            while (!collecting.load(std::memory_order_relaxed)) std::this_thread::yield();
+
+            while (!stop.load(std::memory_order_relaxed)) {
+              // Promoting the head makes everything reachable.
+              const std::size_t i = (rng() % 64u == 0u ? 0u : pick(rng));
+              cycle_gptr<chain_node> p = weak[i].lock();
+              if (p == nullptr) continue;
+
+              // Everything after p is reachable through p.
+              std::size_t count = 0;
+              for (const chain_node* q = p.get(); q != nullptr && count < 64u; q = q->next.get(), ++count) {
+                if (q->magic.load(std::memory_order_relaxed) != chain_node::alive_magic)
+                  bad.fetch_add(1, std::memory_order_relaxed);
+              }
+              if (held.size() < max_held) held.push_back(std::move(p));
+            }
+          });
+    }
+    collecting.store(true, std::memory_order_relaxed);
+    root = nullptr; // Collects the chain, except what the promoters hold.
+    stop.store(true, std::memory_order_relaxed);
+    for (auto& thr : threads) thr.join();
+  }
+  set_gc_phase_hook(old_hook);
+
+  CHECK_EQUAL(0, bad.load());
+  CHECK_EQUAL(0, chain_node::live.load());
+}
+
+namespace {
+
+// Collections of the rings in lock_all_of_red_targets, in phase 3.
+std::atomic<int> red_rings_collecting{ 0 };
+// Set when the locker returned from lock_all.
+std::atomic<bool> red_rings_locked{ false };
+
+} /* namespace <unnamed> */
+
+// Two garbage rings, in distinct generations, are collected on two threads.
+// Once both collections are in phase 3, their objects are red and their
+// promotion is sealed: lock_all has to group them by generation,
+// and fail fast instead of waiting for the collections to complete.
+TEST(lock_all_of_red_targets) {
+  constexpr std::size_t rings = 2, ring_length = 64;
+
+  std::vector<cycle_weak_ptr<chain_node>> weak;
+  std::vector<cycle_gptr<chain_node>> roots;
+  for (std::size_t r = 0; r < rings; ++r) {
+    detail::graph_builder<chain_node> b;
+    for (std::size_t i = 0; i < ring_length; ++i) {
+      const cycle_gptr<chain_node> n = b.make();
+      weak.emplace_back(n);
+      b.link(n->next, (i + 1u) % ring_length);
+      b.add(n);
+    }
+    roots.push_back(b.finish());
+  }
+
+  // Hold both collections in phase 3, until the locker returned.
+  // Gives up after a while, so a blocking lock_all fails the test instead
+  // of hanging it.
+  const gc_phase_hook old_hook = set_gc_phase_hook(
+      [](gc_phase p) noexcept {
+        if (p != gc_phase::phase3) return;
+        red_rings_collecting.fetch_add(1, std::memory_order_relaxed);
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (!red_rings_locked.load(std::memory_order_relaxed)
+            && std::chrono::steady_clock::now() < deadline)
+          std::this_thread::yield();
+      });
+
+  std::vector<cycle_gptr<chain_node>> locked;
+  bool locked_while_collecting = false;
+  std::thread locker(
+      [&]() {
+        while (red_rings_collecting.load(std::memory_order_relaxed) < static_cast<int>(rings))
+          std::this_thread::yield();
+        lock_all(weak.begin(), weak.end(), std::back_inserter(locked));
+        locked_while_collecting = (chain_node::live.load() != 0);
+        red_rings_locked.store(true, std::memory_order_relaxed);
+      });
+  std::vector<std::thread> collectors;
+  for (cycle_gptr<chain_node>& root : roots)
+    collectors.emplace_back([&root]() { root = nullptr; });
+  for (auto& thr : collectors) thr.join();
+  locker.join();
+  set_gc_phase_hook(old_hook);
+
+  CHECK(locked_while_collecting);
+  REQUIRE CHECK_EQUAL(weak.size(), locked.size());
+  for (const cycle_gptr<chain_node>& p : locked) CHECK(p == nullptr);
+  CHECK_EQUAL(0, chain_node::live.load());
+}
+
+// Other threads lock weak pointers into several chains using lock_all,
+// while the chains are collected and linked into each other.
+// Linking the chains merges their generations, so objects that lock_all
+// found red may have moved to another generation by the time it announces
+// the promotion.
+//
+// Each locker holds an object in one of the chains, which keeps everything
+// after it in that chain reachable: lock_all must acquire those.
+TEST(lock_all_during_gc_and_merge) {
+  constexpr std::size_t chains = 4, chain_length = 256, max_held = 8;
+  constexpr int rounds = 10, lockers = 2;
+
+  // Let the lockers and the linker run once the collection holds the
+  // generation lock.
+  const gc_phase_hook old_hook = set_gc_phase_hook(
+      [](gc_phase p) noexcept {
+        if (p == gc_phase::phase1) std::this_thread::yield();
+      });
+
+  std::atomic<int> bad{ 0 }, missed{ 0 };
+  for (int round = 0; round < rounds; ++round) {
+    // Chain c holds weak[c * chain_length] up to weak[(c + 1) * chain_length].
+    std::vector<cycle_weak_ptr<chain_node>> weak;
+    std::vector<cycle_gptr<chain_node>> roots;
+    for (std::size_t c = 0; c < chains; ++c) {
+      detail::graph_builder<chain_node> b;
+      for (std::size_t i = 0; i < chain_length; ++i) {
+        const cycle_gptr<chain_node> n = b.make();
+        weak.emplace_back(n);
+        if (i + 1u < chain_length) b.link(n->next, i + 1u);
+        b.add(n);
+      }
+      roots.push_back(b.finish());
+    }
+
+    std::atomic<bool> collecting{ false }, stop{ false };
+    std::vector<std::thread> threads;
+    for (int t = 0; t < lockers; ++t) {
+      threads.emplace_back(
+          [&, t]() {
+            std::minstd_rand rng(static_cast<std::minstd_rand::result_type>(round * lockers + t + 1));
+            const std::size_t anchor_idx = (t % chains) * chain_length + chain_length / 2u;
+            const std::size_t anchor_end = (t % chains + 1u) * chain_length;
+            const cycle_gptr<chain_node> anchor = weak[anchor_idx].lock();
+            std::vector<cycle_gptr<chain_node>> held;
+            while (!collecting.load(std::memory_order_relaxed)) std::this_thread::yield();
+
+            std::vector<cycle_gptr<chain_node>> locked;
+            while (!stop.load(std::memory_order_relaxed)) {
+              locked.clear();
+              lock_all(weak.begin(), weak.end(), std::back_inserter(locked));
+
+              for (std::size_t i = 0; i < locked.size(); ++i) {
+                if (locked[i] == nullptr) {
+                  if (i >= anchor_idx && i < anchor_end)
+                    missed.fetch_add(1, std::memory_order_relaxed);
+                } else if (locked[i]->magic.load(std::memory_order_relaxed) != chain_node::alive_magic) {
+                  bad.fetch_add(1, std::memory_order_relaxed);
+                }
+              }
+
+              if (held.size() < max_held) {
+                const cycle_gptr<chain_node>& p = locked[rng() % locked.size()];
+                if (p != nullptr) held.push_back(p);
+              }
+            }
+          });
+    }
+
+    // Link the end of each chain to the start of the next,
+    // merging their generations.
+    threads.emplace_back(
+        [&]() {
+          while (!collecting.load(std::memory_order_relaxed)) std::this_thread::yield();
+
+          for (std::size_t c = 0; c < chains && !stop.load(std::memory_order_relaxed); ++c) {
+            const cycle_gptr<chain_node> last = weak[(c + 1u) * chain_length - 1u].lock();
+            const cycle_gptr<chain_node> next = weak[(c + 1u) % chains * chain_length].lock();
+            if (last != nullptr && next != nullptr) last->next = next;
+          }
+        });
+
+    collecting.store(true, std::memory_order_relaxed);
+    while (!roots.empty()) roots.pop_back(); // Collect each chain in turn.
+    stop.store(true, std::memory_order_relaxed);
+    for (auto& thr : threads) thr.join();
+  }
+  set_gc_phase_hook(old_hook);
+
+  CHECK_EQUAL(0, bad.load());
+  CHECK_EQUAL(0, missed.load());
+  CHECK_EQUAL(0, chain_node::live.load());
+}
+
+class owner_of_map
+: public cycle_base
+{
+ public:
+  using map_type = std::map<
+      cycle_member_ptr<create_destroy_check>, int,
+      ptr_less<>,
+      cycle_allocator<std::allocator<std::pair<const cycle_member_ptr<create_destroy_check>, int>>>>;
+
+  owner_of_map()
+  : data(map_type::allocator_type(*this))
+  {}
+
+  map_type data;
+};
+
+TEST(transparent_lookup) {
+  cycle_gptr<owner_of_map> ptr = make_cycle<owner_of_map>();
+  cycle_gptr<create_destroy_check> key = make_cycle<create_destroy_check>();
+  cycle_gptr<create_destroy_check> other = make_cycle<create_destroy_check>();
+  ptr->data.emplace(key, 17);
+
+  REQUIRE CHECK(ptr->data.find(key) != ptr->data.end());
+  CHECK_EQUAL(17, ptr->data.find(key)->second);
+  CHECK(ptr->data.find(key.get()) != ptr->data.end());
+  CHECK(ptr->data.find(other) == ptr->data.end());
+  CHECK(ptr->data.find(nullptr) == ptr->data.end());
+
+  CHECK(ptr_equal<>()(ptr->data.begin()->first, key.get()));
+  CHECK_EQUAL(ptr_hash<>()(key), ptr_hash<>()(ptr->data.begin()->first));
+  CHECK_EQUAL(ptr_hash<>()(key), ptr_hash<>()(key.get()));
+}
+
+TEST(transparent_owner_less) {
+  cycle_gptr<owner> ptr = make_cycle<owner>(nullptr);
+  ptr->target = make_cycle<create_destroy_check>();
+  auto alias = cycle_gptr<cycle_member_ptr<create_destroy_check>>(ptr, &ptr->target);
+
+  CHECK(!owner_less<>()(ptr, alias));
+  CHECK(!owner_less<>()(alias, ptr));
+  CHECK(owner_less<>()(ptr, ptr->target) || owner_less<>()(ptr->target, ptr));
+}
+
+class owner_constructed_on_other_thread
+: public create_destroy_check
+{
+ public:
+  explicit owner_constructed_on_other_thread(bool* destroyed)
+  : create_destroy_check(destroyed)
+  {
+    // Simulate a constructor that jumps threads.
+    std::thread([this]() { self.emplace(); }).join();
+  }
+
+  std::optional<cycle_member_ptr<owner_constructed_on_other_thread>> self;
+};
+
+TEST(publisher_lookup_from_other_thread) {
+  bool destroyed = false;
+  cycle_gptr<owner_constructed_on_other_thread> ptr =
+      make_cycle<owner_constructed_on_other_thread>(&destroyed);
+  REQUIRE CHECK(ptr->self.has_value());
+
+  // Self cycle is only collected if the member pointer found its owner.
+  *ptr->self = ptr;
+  ptr = nullptr;
+  CHECK(destroyed);
+}
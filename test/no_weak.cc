@@ -0,0 +1,107 @@
+#include <cycle_ptr.h>
+#include "UnitTest++/UnitTest++.h"
+#include <memory>
+
+// Tests of the library built without weak pointers.
+// Compiled into its own test executable, as the other tests use weak pointers.
+
+#ifndef CYCLE_PTR_NO_WEAK
+# error "no_weak.cc requires CYCLE_PTR_NO_WEAK to be defined"
+#endif
+
+using namespace cycle_ptr;
+
+namespace {
+
+// Records the outcome of shared_from_this() during construction and destruction.
+class self_sharing
+: public cycle_base
+{
+ public:
+  explicit self_sharing(bool* destroyed, bool* threw_on_destroy = nullptr)
+  : destroyed(destroyed),
+    threw_on_destroy(threw_on_destroy)
+  {
+    try {
+      shared_from_this(this);
+    } catch (const std::bad_weak_ptr&) {
+      threw_on_construct = true;
+    }
+  }
+
+  ~self_sharing() {
+    if (threw_on_destroy != nullptr) {
+      try {
+        shared_from_this(this);
+      } catch (const std::bad_weak_ptr&) {
+        *threw_on_destroy = true;
+      }
+    }
+
+    CHECK(!*destroyed); // Check that we're only destroyed once.
+    *destroyed = true;
+  }
+
+  auto self()
+  -> cycle_gptr<self_sharing> {
+    return shared_from_this(this);
+  }
+
+  bool threw_on_construct = false;
+  cycle_member_ptr<self_sharing> next;
+
+ private:
+  bool* destroyed;
+  bool* threw_on_destroy;
+};
+
+} /* namespace <unnamed> */
+
+TEST(no_weak_shared_from_this) {
+  bool destroyed = false;
+  cycle_gptr<self_sharing> ptr = make_cycle<self_sharing>(&destroyed);
+  CHECK(ptr->threw_on_construct);
+
+  cycle_gptr<self_sharing> self = ptr->self();
+  CHECK(self == ptr);
+  ptr = nullptr;
+  CHECK(!destroyed);
+  self = nullptr;
+  CHECK(destroyed);
+}
+
+TEST(no_weak_shared_from_this_reachable_through_member) {
+  bool first_destroyed = false, second_destroyed = false;
+  cycle_gptr<self_sharing> first = make_cycle<self_sharing>(&first_destroyed);
+  first->next = make_cycle<self_sharing>(&second_destroyed);
+
+  // The second object is only reachable through the edge.
+  cycle_gptr<self_sharing> second = first->next->self();
+  CHECK(second == first->next);
+  first = nullptr;
+  CHECK(first_destroyed);
+  CHECK(!second_destroyed);
+  second = nullptr;
+  CHECK(second_destroyed);
+}
+
+TEST(no_weak_shared_from_this_when_expired) {
+  bool destroyed = false, threw_on_destroy = false;
+  make_cycle<self_sharing>(&destroyed, &threw_on_destroy) = nullptr;
+  CHECK(destroyed);
+  CHECK(threw_on_destroy);
+}
+
+TEST(no_weak_shared_from_this_when_collected) {
+  bool first_destroyed = false, first_threw = false;
+  bool second_destroyed = false, second_threw = false;
+  cycle_gptr<self_sharing> first = make_cycle<self_sharing>(&first_destroyed, &first_threw);
+  first->next = make_cycle<self_sharing>(&second_destroyed, &second_threw);
+  first->next->next = first;
+
+  first = nullptr;
+  CHECK(first_destroyed);
+  CHECK(second_destroyed);
+  CHECK(first_threw);
+  CHECK(second_threw);
+}
@@ -0,0 +1,239 @@
+#include <cycle_ptr/persistent.h>
+#include "UnitTest++/UnitTest++.h"
+#include <thread>
+#include <vector>
+
+using namespace cycle_ptr;
+
+namespace {
+
+class item {
+ public:
+  explicit item(int value = 0, bool* destroyed = nullptr) noexcept
+  : value(value),
+    destroyed(destroyed)
+  {}
+
+  ~item() {
+    if (destroyed != nullptr) {
+      CHECK(!*destroyed); // Check that we're only destroyed once.
+      *destroyed = true;
+    }
+  }
+
+  int value;
+  cycle_member_ptr<class item_owner> back;
+
+ private:
+  bool* destroyed = nullptr;
+};
+
+class item_owner {
+ public:
+  explicit item_owner(bool* destroyed = nullptr) noexcept
+  : destroyed(destroyed)
+  {}
+
+  ~item_owner() {
+    if (destroyed != nullptr) {
+      CHECK(!*destroyed); // Check that we're only destroyed once.
+      *destroyed = true;
+    }
+  }
+
+  persistent_vector<item> list;
+  persistent_map<int, item> map;
+
+ private:
+  bool* destroyed = nullptr;
+};
+
+///\brief Hash that makes all keys collide.
+struct colliding_hash {
+  auto operator()(int x [[maybe_unused]]) const noexcept -> std::size_t {
+    return 7u;
+  }
+};
+
+} /* namespace <unnamed> */
+
+TEST(persistent_vector_push_pop) {
+  persistent_vector<item> v{ unowned_cycle };
+  CHECK(v.empty());
+
+  for (int i = 0; i < 2000; ++i)
+    v.push_back(make_cycle<item>(i));
+  REQUIRE CHECK_EQUAL(2000u, v.size());
+  for (int i = 0; i < 2000; ++i)
+    CHECK_EQUAL(i, v[i]->value);
+
+  for (int i = 2000; i > 10; --i) v.pop_back();
+  REQUIRE CHECK_EQUAL(10u, v.size());
+  for (int i = 0; i < 10; ++i)
+    CHECK_EQUAL(i, v[i]->value);
+
+  CHECK_THROW(v.at(10), std::out_of_range);
+  v.clear();
+  CHECK(v.empty());
+}
+
+TEST(persistent_vector_snapshot) {
+  persistent_vector<item> v{ unowned_cycle };
+  for (int i = 0; i < 100; ++i)
+    v.push_back(make_cycle<item>(i));
+
+  persistent_vector<item> snapshot{ unowned_cycle, v };
+  v.set(50, make_cycle<item>(-1));
+  v.push_back(make_cycle<item>(100));
+  v.pop_back();
+  v.pop_back();
+
+  CHECK_EQUAL(99u, v.size());
+  CHECK_EQUAL(-1, v[50]->value);
+  REQUIRE CHECK_EQUAL(100u, snapshot.size());
+  for (int i = 0; i < 100; ++i)
+    CHECK_EQUAL(i, snapshot[i]->value);
+
+  // Modifying the snapshot doesn't affect v.
+  snapshot.set(0, make_cycle<item>(-2));
+  CHECK_EQUAL(0, v[0]->value);
+  CHECK_EQUAL(-2, snapshot[0]->value);
+}
+
+TEST(persistent_vector_releases_elements) {
+  bool destroyed = false;
+  persistent_vector<item> v{ unowned_cycle };
+  v.push_back(make_cycle<item>(1, &destroyed));
+  v.push_back(make_cycle<item>(2));
+
+  persistent_vector<item> snapshot{ unowned_cycle, v };
+  v.set(0, make_cycle<item>(3));
+  CHECK(!destroyed);
+
+  snapshot.clear();
+  CHECK(destroyed);
+}
+
+TEST(persistent_vector_cycle) {
+  bool owner_destroyed = false;
+  bool item_destroyed = false;
+  cycle_gptr<item_owner> owner = make_cycle<item_owner>(&owner_destroyed);
+  cycle_gptr<item> value = make_cycle<item>(0, &item_destroyed);
+  value->back = owner;
+  owner->list.push_back(value);
+
+  value = nullptr;
+  CHECK(!owner_destroyed);
+  CHECK(!item_destroyed);
+
+  owner = nullptr;
+  CHECK(owner_destroyed);
+  CHECK(item_destroyed);
+}
+
+TEST(persistent_map_insert_find_erase) {
+  persistent_map<int, item> m{ unowned_cycle };
+
+  for (int i = 0; i < 2000; ++i)
+    CHECK(m.insert(i, make_cycle<item>(i)));
+  CHECK(!m.insert(0, make_cycle<item>(-1)));
+  REQUIRE CHECK_EQUAL(2000u, m.size());
+  for (int i = 0; i < 2000; ++i) {
+    REQUIRE CHECK(m.find(i) != nullptr);
+    CHECK_EQUAL(i, m.find(i)->value);
+  }
+  CHECK(m.find(2000) == nullptr);
+
+  CHECK(!m.insert_or_assign(0, make_cycle<item>(-1)));
+  CHECK_EQUAL(-1, m.find(0)->value);
+
+  for (int i = 0; i < 2000; i += 2)
+    CHECK(m.erase(i));
+  CHECK(!m.erase(0));
+  CHECK_EQUAL(1000u, m.size());
+  for (int i = 0; i < 2000; ++i)
+    CHECK_EQUAL(i % 2 != 0, m.contains(i));
+
+  for (int i = 1; i < 2000; i += 2)
+    CHECK(m.erase(i));
+  CHECK(m.empty());
+}
+
+TEST(persistent_map_collisions) {
+  persistent_map<int, item, colliding_hash> m{ unowned_cycle };
+
+  for (int i = 0; i < 10; ++i)
+    CHECK(m.insert(i, make_cycle<item>(i)));
+  for (int i = 0; i < 10; ++i) {
+    REQUIRE CHECK(m.find(i) != nullptr);
+    CHECK_EQUAL(i, m.find(i)->value);
+  }
+
+  for (int i = 0; i < 9; ++i)
+    CHECK(m.erase(i));
+  CHECK_EQUAL(1u, m.size());
+  REQUIRE CHECK(m.find(9) != nullptr);
+  CHECK_EQUAL(9, m.find(9)->value);
+}
+
+TEST(persistent_map_snapshot) {
+  persistent_map<int, item> m{ unowned_cycle };
+  for (int i = 0; i < 100; ++i)
+    m.insert(i, make_cycle<item>(i));
+
+  persistent_map<int, item> snapshot{ unowned_cycle, m };
+  for (int i = 0; i < 100; i += 2) m.erase(i);
+  m.insert_or_assign(1, make_cycle<item>(-1));
+  m.insert(100, make_cycle<item>(100));
+
+  CHECK_EQUAL(51u, m.size());
+  CHECK_EQUAL(-1, m.find(1)->value);
+  REQUIRE CHECK_EQUAL(100u, snapshot.size());
+  for (int i = 0; i < 100; ++i) {
+    REQUIRE CHECK(snapshot.find(i) != nullptr);
+    CHECK_EQUAL(i, snapshot.find(i)->value);
+  }
+  CHECK(!snapshot.contains(100));
+}
+
+TEST(persistent_map_cycle) {
+  bool owner_destroyed = false;
+  bool item_destroyed = false;
+  cycle_gptr<item_owner> owner = make_cycle<item_owner>(&owner_destroyed);
+  cycle_gptr<item> value = make_cycle<item>(0, &item_destroyed);
+  value->back = owner;
+  owner->map.insert(1, value);
+
+  value = nullptr;
+  CHECK(!owner_destroyed);
+  CHECK(!item_destroyed);
+
+  owner = nullptr;
+  CHECK(owner_destroyed);
+  CHECK(item_destroyed);
+}
+
+TEST(persistent_map_snapshots_across_threads) {
+  persistent_map<int, item> m{ unowned_cycle };
+  for (int i = 0; i < 1000; ++i)
+    m.insert(i, make_cycle<item>(i));
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back(
+        [&m, t]() {
+          persistent_map<int, item> local{ unowned_cycle, m };
+          for (int i = 0; i < 1000; ++i) {
+            if (i % 4 == t) local.insert_or_assign(i, make_cycle<item>(-i));
+          }
+          for (int i = 0; i < 1000; ++i) {
+            REQUIRE CHECK(local.find(i) != nullptr);
+            CHECK_EQUAL(i % 4 == t ? -i : i, local.find(i)->value);
+          }
+        });
+  }
+  for (auto& thr : threads) thr.join();
+
+  for (int i = 0; i < 1000; ++i)
+    CHECK_EQUAL(i, m.find(i)->value);
+}
@@ -0,0 +1,95 @@
+#include <cycle_ptr/serialize.h>
+#include "UnitTest++/UnitTest++.h"
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace cycle_ptr;
+
+namespace {
+
+class node {
+ public:
+  node(int value, std::string name) noexcept
+  : value(value),
+    name(std::move(name))
+  {}
+
+  int value;
+  std::string name;
+  cycle_member_ptr<node> next, skip;
+};
+
+struct node_codec {
+  void write(const node& n, graph_writer<node>& w) const {
+    w.write(n.value);
+    w.write_size(n.name.size());
+    w.write(n.name.data(), n.name.size());
+    w.edge(n.next);
+    w.edge(n.skip);
+  }
+
+  cycle_gptr<node> read(graph_reader<node>& r) const {
+    const int value = r.read<int>();
+    std::string name(r.read_size(), '\0');
+    r.read(name.data(), name.size());
+
+    cycle_gptr<node> n = r.make(value, std::move(name));
+    r.edge(n->next);
+    r.edge(n->skip);
+    return n;
+  }
+};
+
+auto make_ring(int n)
+-> cycle_gptr<node> {
+  std::vector<cycle_gptr<node>> ring;
+  for (int i = 0; i < n; ++i) ring.push_back(make_cycle<node>(i, "node " + std::to_string(i)));
+  for (int i = 0; i < n; ++i) ring[i]->next = ring[(i + 1) % n];
+  ring[0]->skip = ring[n / 2];
+  ring[n - 1]->skip = ring[n - 1];
+  return ring[0];
+}
+
+} /* namespace <unnamed> */
+
+TEST(serialize_round_trip) {
+  cycle_gptr<node> root = make_ring(7);
+  std::stringstream buf;
+  serialize_graph(buf, root, node_codec());
+
+  cycle_gptr<node> copy = deserialize_graph<node>(buf, node_codec());
+  REQUIRE CHECK(copy != nullptr);
+
+  cycle_gptr<node> x = copy, y = root;
+  for (int i = 0; i < 7; ++i) {
+    CHECK(x != y);
+    CHECK_EQUAL(y->value, x->value);
+    CHECK_EQUAL(y->name, x->name);
+    x = x->next;
+    y = y->next;
+  }
+  CHECK(x == copy);
+  CHECK_EQUAL(3, copy->skip->value);
+  CHECK(copy->next->next->next->next->next->next->skip == copy->next->next->next->next->next->next);
+  CHECK(copy->next->skip == nullptr);
+}
+
+TEST(serialize_null) {
+  std::stringstream buf;
+  serialize_graph(buf, cycle_gptr<node>(), node_codec());
+  CHECK(deserialize_graph<node>(buf, node_codec()) == nullptr);
+}
+
+TEST(deserialize_truncated) {
+  std::stringstream buf;
+  serialize_graph(buf, make_ring(4), node_codec());
+  const std::string data = buf.str();
+
+  std::stringstream truncated(data.substr(0, data.size() - 1u));
+  CHECK_THROW(deserialize_graph<node>(truncated, node_codec()), std::runtime_error);
+
+  std::stringstream garbage("not a graph");
+  CHECK_THROW(deserialize_graph<node>(garbage, node_codec()), std::runtime_error);
+}
@@ -0,0 +1,194 @@
+#include <cycle_ptr/skiplist_map.h>
+#include "UnitTest++/UnitTest++.h"
+#include <functional>
+#include <thread>
+#include <vector>
+
+using namespace cycle_ptr;
+
+namespace {
+
+class item {
+ public:
+  explicit item(int value = 0, bool* destroyed = nullptr) noexcept
+  : value(value),
+    destroyed(destroyed)
+  {}
+
+  ~item() {
+    if (destroyed != nullptr) {
+      CHECK(!*destroyed); // Check that we're only destroyed once.
+      *destroyed = true;
+    }
+  }
+
+  int value;
+  cycle_member_ptr<class item_owner> back;
+
+ private:
+  bool* destroyed = nullptr;
+};
+
+class item_owner {
+ public:
+  explicit item_owner(bool* destroyed = nullptr) noexcept
+  : destroyed(destroyed)
+  {}
+
+  ~item_owner() {
+    if (destroyed != nullptr) {
+      CHECK(!*destroyed); // Check that we're only destroyed once.
+      *destroyed = true;
+    }
+  }
+
+  skiplist_map<int, item> items;
+
+ private:
+  bool* destroyed = nullptr;
+};
+
+} /* namespace <unnamed> */
+
+TEST(skiplist_map_insert_find_erase) {
+  skiplist_map<int, item> m{ unowned_cycle };
+  CHECK(m.empty());
+
+  for (int i = 0; i < 1000; ++i)
+    CHECK(m.insert(i, make_cycle<item>(i)));
+  CHECK(!m.insert(0, make_cycle<item>(-1)));
+  REQUIRE CHECK_EQUAL(1000u, m.size());
+  for (int i = 0; i < 1000; ++i) {
+    REQUIRE CHECK(m.find(i) != nullptr);
+    CHECK_EQUAL(i, m.find(i)->value);
+  }
+  CHECK(m.find(1000) == nullptr);
+
+  CHECK(!m.insert_or_assign(0, make_cycle<item>(-1)));
+  CHECK_EQUAL(-1, m.find(0)->value);
+  CHECK(m.insert_or_assign(-1, make_cycle<item>(-1)));
+
+  for (int i = -1; i < 1000; i += 2)
+    CHECK(m.erase(i));
+  CHECK(!m.erase(1));
+  CHECK_EQUAL(500u, m.size());
+  for (int i = 0; i < 1000; ++i)
+    CHECK_EQUAL(i % 2 == 0, m.contains(i));
+
+  m.clear();
+  CHECK(m.empty());
+  CHECK(!m.contains(0));
+}
+
+TEST(skiplist_map_ordering) {
+  skiplist_map<int, item, std::greater<int>> m{ unowned_cycle };
+  for (int i = 0; i < 100; ++i)
+    m.insert((i * 37) % 100, make_cycle<item>((i * 37) % 100));
+
+  int expect = 99;
+  m.for_each(
+      [&expect](int key, const cycle_gptr<item>& value) {
+        CHECK_EQUAL(expect, key);
+        CHECK_EQUAL(expect, value->value);
+        --expect;
+      });
+  CHECK_EQUAL(-1, expect);
+
+  m.erase(50);
+  auto lb = m.lower_bound(50);
+  REQUIRE CHECK(lb.has_value());
+  CHECK_EQUAL(49, lb->first);
+  CHECK_EQUAL(49, lb->second->value);
+  CHECK(!m.lower_bound(-1).has_value());
+}
+
+TEST(skiplist_map_releases_erased_values) {
+  bool destroyed = false;
+  skiplist_map<int, item> m{ unowned_cycle };
+  m.insert(1, make_cycle<item>(1, &destroyed));
+
+  // Without readers, erase reclaims the node right away.
+  m.erase(1);
+  CHECK(destroyed);
+}
+
+TEST(skiplist_map_releases_replaced_values) {
+  bool destroyed = false;
+  skiplist_map<int, item> m{ unowned_cycle };
+  m.insert(1, make_cycle<item>(1, &destroyed));
+
+  m.insert_or_assign(1, make_cycle<item>(2));
+  CHECK(destroyed);
+  CHECK_EQUAL(2, m.find(1)->value);
+}
+
+// A reader holds back reclamation, until it is done.
+TEST(skiplist_map_reclaims_after_reader) {
+  bool destroyed = false;
+  skiplist_map<int, item> m{ unowned_cycle };
+  m.insert(1, make_cycle<item>(1, &destroyed));
+  m.insert(2, make_cycle<item>(2));
+
+  m.for_each(
+      [&m, &destroyed](int key, const cycle_gptr<item>& value [[maybe_unused]]) {
+        if (key == 2) {
+          CHECK(m.erase(1));
+          CHECK(!destroyed);
+        }
+      });
+  CHECK(!destroyed);
+
+  m.erase(2);
+  CHECK(destroyed);
+}
+
+TEST(skiplist_map_cycle) {
+  bool owner_destroyed = false;
+  bool item_destroyed = false;
+  cycle_gptr<item_owner> owner = make_cycle<item_owner>(&owner_destroyed);
+  cycle_gptr<item> value = make_cycle<item>(0, &item_destroyed);
+  value->back = owner;
+  owner->items.insert(1, value);
+
+  value = nullptr;
+  CHECK(!owner_destroyed);
+  CHECK(!item_destroyed);
+
+  owner = nullptr;
+  CHECK(owner_destroyed);
+  CHECK(item_destroyed);
+}
+
+TEST(skiplist_map_threads) {
+  skiplist_map<int, item> m{ unowned_cycle };
+  for (int i = 0; i < 1000; i += 2)
+    m.insert(i, make_cycle<item>(i));
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back(
+        [&m, t]() {
+          for (int round = 0; round < 20; ++round) {
+            for (int i = 1 + 2 * t; i < 1000; i += 8) {
+              m.insert(i, make_cycle<item>(i));
+              CHECK(m.contains(i - 1));
+            }
+            for (int i = 1 + 2 * t; i < 1000; i += 8) {
+              CHECK(m.erase(i));
+              REQUIRE CHECK(m.find(i - 1) != nullptr);
+              CHECK_EQUAL(i - 1, m.find(i - 1)->value);
+            }
+          }
+        });
+  }
+  for (auto& thr : threads) thr.join();
+
+  CHECK_EQUAL(500u, m.size());
+  int expect = 0;
+  m.for_each(
+      [&expect](int key, const cycle_gptr<item>& value [[maybe_unused]]) {
+        CHECK_EQUAL(expect, key);
+        expect += 2;
+      });
+  CHECK_EQUAL(1000, expect);
+}
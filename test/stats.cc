@@ -0,0 +1,137 @@
+#include <cycle_ptr.h>
+#include "UnitTest++/UnitTest++.h"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// Tests of the statistics counters.
+// Compiled into its own test executable, as the counters change the
+// generation constructors.
+
+#ifndef CYCLE_PTR_STATS
+# error "stats.cc requires CYCLE_PTR_STATS to be defined"
+#endif
+
+using namespace cycle_ptr;
+
+// Hand out dirty memory, so members that are left uninitialized
+// don't happen to start out zeroed.
+// Fills with 0x01, as that is also how a set atomic_flag is represented.
+auto operator new(std::size_t sz)
+-> void* {
+  void*const p = std::malloc(sz == 0u ? 1u : sz);
+  if (p == nullptr) throw std::bad_alloc();
+  std::memset(p, 0x01, sz);
+  return p;
+}
+
+auto operator delete(void* p)
+noexcept
+-> void {
+  std::free(p);
+}
+
+auto operator delete(void* p, [[maybe_unused]] std::size_t sz)
+noexcept
+-> void {
+  ::operator delete(p);
+}
+
+namespace {
+
+class counted_node
+: public cycle_base
+{
+ public:
+  explicit counted_node(bool* destroyed)
+  : destroyed(destroyed)
+  {}
+
+  ~counted_node() {
+    *destroyed = true;
+  }
+
+  cycle_member_ptr<counted_node> next;
+
+ private:
+  bool* destroyed;
+};
+
+// Difference between two snapshots of the counters.
+auto delta(const statistics& after, const statistics& before)
+noexcept
+-> statistics {
+  statistics d;
+  d.generations = after.generations - before.generations;
+  d.merges = after.merges - before.merges;
+  d.merged_objects = after.merged_objects - before.merged_objects;
+  d.collections = after.collections - before.collections;
+  d.collected_objects = after.collected_objects - before.collected_objects;
+  return d;
+}
+
+} /* namespace <unnamed> */
+
+TEST(statistics_merge_and_collect) {
+  bool a_destroyed = false, b_destroyed = false;
+  const statistics before = get_statistics();
+
+  cycle_gptr<counted_node> a = make_cycle<counted_node>(&a_destroyed);
+  cycle_gptr<counted_node> b = make_cycle<counted_node>(&b_destroyed);
+  statistics d = delta(get_statistics(), before);
+  CHECK_EQUAL(2u, d.generations);
+  CHECK_EQUAL(0u, d.merges);
+  CHECK_EQUAL(0u, d.collections);
+
+  // An edge from the older generation to the newer one keeps them apart.
+  a->next = b;
+  d = delta(get_statistics(), before);
+  CHECK_EQUAL(0u, d.merges);
+
+  // The edge back requires a merge, moving one object,
+  // after which the drained generation is collected.
+  b->next = a;
+  d = delta(get_statistics(), before);
+  CHECK_EQUAL(2u, d.generations);
+  CHECK_EQUAL(1u, d.merges);
+  CHECK_EQUAL(1u, d.merged_objects);
+  CHECK_EQUAL(1u, d.collections);
+  CHECK_EQUAL(0u, d.collected_objects);
+
+  // Dropping a collects, but b keeps a reachable.
+  a = nullptr;
+  d = delta(get_statistics(), before);
+  CHECK_EQUAL(2u, d.collections);
+  CHECK_EQUAL(0u, d.collected_objects);
+  CHECK(!a_destroyed);
+
+  // Dropping b collects the cycle.
+  b = nullptr;
+  d = delta(get_statistics(), before);
+  CHECK_EQUAL(2u, d.generations);
+  CHECK_EQUAL(1u, d.merges);
+  CHECK_EQUAL(1u, d.merged_objects);
+  CHECK_EQUAL(3u, d.collections);
+  CHECK_EQUAL(2u, d.collected_objects);
+  CHECK(a_destroyed);
+  CHECK(b_destroyed);
+}
+
+// With CYCLE_PTR_STATS, generations have a user provided constructor,
+// so their GC flag isn't zero initialized.
+// A flag that started out set would make every GC request appear
+// pending, and nothing would be collected.
+TEST(statistics_gc_flag_starts_clear) {
+  bool a_destroyed = false, b_destroyed = false;
+  const statistics before = get_statistics();
+  {
+    cycle_gptr<counted_node> a = make_cycle<counted_node>(&a_destroyed);
+    a->next = make_cycle<counted_node>(&b_destroyed);
+    a->next->next = a;
+  }
+
+  const statistics d = delta(get_statistics(), before);
+  CHECK_EQUAL(2u, d.collected_objects);
+  CHECK(a_destroyed);
+  CHECK(b_destroyed);
+}
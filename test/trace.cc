@@ -0,0 +1,160 @@
+#include <cycle_ptr.h>
+#include <cycle_ptr/trace.h>
+#include "UnitTest++/UnitTest++.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Tests of recording and reading traces.
+// Compiled into its own test executable, as tracing changes the control blocks.
+
+#ifndef CYCLE_PTR_TRACE
+# error "trace.cc requires CYCLE_PTR_TRACE to be defined"
+#endif
+
+using namespace cycle_ptr;
+
+namespace {
+
+struct traced_node
+: public cycle_base
+{
+  cycle_member_ptr<traced_node> next;
+  cycle_member_ptr<traced_node> other;
+};
+
+// Arena, from which traced_node is allocated below everything else.
+// So the edges of a split allocated node are at a negative offset
+// from its control block.
+struct arena {
+  static constexpr std::size_t half = 4096;
+
+  alignas(64) unsigned char low[half];
+  alignas(64) unsigned char high[half];
+  std::size_t low_used = 0, high_used = 0;
+
+  static auto get()
+  noexcept
+  -> arena& {
+    static arena impl;
+    return impl;
+  }
+};
+
+template<typename T>
+class arena_allocator {
+ public:
+  using value_type = T;
+
+  arena_allocator() noexcept = default;
+
+  template<typename U>
+  arena_allocator(const arena_allocator<U>&) noexcept {}
+
+  auto allocate(std::size_t n)
+  -> T* {
+    arena& a = arena::get();
+    const std::size_t bytes = (n * sizeof(T) + 63u) & ~std::size_t(63);
+    if constexpr (std::is_same_v<T, traced_node>) {
+      if (a.low_used + bytes > arena::half) throw std::bad_alloc();
+      void*const p = a.low + a.low_used;
+      a.low_used += bytes;
+      return static_cast<T*>(p);
+    } else {
+      if (a.high_used + bytes > arena::half) throw std::bad_alloc();
+      void*const p = a.high + a.high_used;
+      a.high_used += bytes;
+      return static_cast<T*>(p);
+    }
+  }
+
+  auto deallocate(T*, std::size_t) noexcept -> void {}
+
+  template<typename U>
+  auto operator==(const arena_allocator<U>&) const noexcept -> bool { return true; }
+  template<typename U>
+  auto operator!=(const arena_allocator<U>&) const noexcept -> bool { return false; }
+};
+
+} /* namespace <unnamed> */
+
+TEST(trace_round_trip) {
+  const char path[] = "cycle_ptr_test.trace";
+  std::ptrdiff_t edge_distance;
+
+  trace_start(path);
+  {
+    cycle_gptr<traced_node> a = allocate_cycle<traced_node>(arena_allocator<traced_node>());
+    cycle_gptr<traced_node> b = allocate_cycle_split<traced_node>(arena_allocator<traced_node>());
+    edge_distance = reinterpret_cast<const char*>(&b->other) - reinterpret_cast<const char*>(&b->next);
+
+    a->next = b;
+    b->next = a;
+    b->other = a;
+    b->next.reset();
+
+    cycle_weak_ptr<traced_node> weak = a;
+    cycle_gptr<traced_node> locked = weak.lock();
+    CHECK(locked == a);
+    locked = nullptr;
+
+    a = nullptr;
+    b = nullptr;
+    CHECK(weak.lock() == nullptr);
+  }
+  trace_stop();
+
+  std::vector<trace_event> events;
+  {
+    std::ifstream in(path, std::ios_base::in | std::ios_base::binary);
+    REQUIRE CHECK(in.is_open());
+    events = read_trace(in);
+  }
+  std::remove(path);
+
+  REQUIRE CHECK_EQUAL(11u, events.size());
+  for (std::size_t i = 0; i < events.size(); ++i) {
+    CHECK_EQUAL(events[0].seq + i, events[i].seq);
+    CHECK_EQUAL(events[0].thread, events[i].thread);
+  }
+
+  const std::uint64_t a = events[0].obj, b = events[1].obj;
+  CHECK(a != 0u);
+  CHECK(b != 0u);
+  CHECK(a != b);
+
+  // The node is allocated after its control block, unless split allocated.
+  const std::ptrdiff_t a_next = events[2].slot, b_next = events[3].slot;
+  CHECK(a_next > 0);
+  CHECK(b_next < 0);
+
+  struct expected {
+    trace_op op;
+    std::uint64_t obj;
+    std::ptrdiff_t slot;
+    std::uint64_t dst;
+  };
+  const expected expect[] = {
+    { trace_op::make, a, 0, 0u },
+    { trace_op::make, b, 0, 0u },
+    { trace_op::edge_set, a, a_next, b },
+    { trace_op::edge_set, b, b_next, a },
+    { trace_op::edge_set, b, b_next + edge_distance, a },
+    { trace_op::edge_reset, b, b_next, 0u },
+    { trace_op::weak_lock, a, 0, 0u },
+    { trace_op::drop, a, 0, 0u },
+    { trace_op::drop, a, 0, 0u },
+    { trace_op::drop, b, 0, 0u },
+    { trace_op::weak_lock_failed, a, 0, 0u },
+  };
+  for (std::size_t i = 0; i < events.size(); ++i) {
+    CHECK(expect[i].op == events[i].op);
+    CHECK_EQUAL(expect[i].obj, events[i].obj);
+    CHECK_EQUAL(expect[i].slot, events[i].slot);
+    CHECK_EQUAL(expect[i].dst, events[i].dst);
+  }
+}
@@ -0,0 +1,142 @@
+#include <cycle_ptr/weak_cache.h>
+#include "UnitTest++/UnitTest++.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace cycle_ptr;
+
+namespace {
+
+class item {
+ public:
+  explicit item(int value = 0) noexcept
+  : value(value)
+  {}
+
+  int value;
+  cycle_member_ptr<item> next;
+};
+
+class counting_hook
+: public collect_hook
+{
+ public:
+  ~counting_hook() noexcept override {
+    remove();
+  }
+
+  int count = 0;
+
+ private:
+  auto on_collect()
+  noexcept
+  -> void override {
+    ++count;
+  }
+};
+
+} /* namespace <unnamed> */
+
+TEST(collect_hook_fires_on_collection) {
+  counting_hook hook;
+  cycle_gptr<item> x = make_cycle<item>();
+  x->next = make_cycle<item>();
+  x->next->next = x; // Cycle.
+  add_collect_hook(x, hook);
+
+  CHECK_EQUAL(0, hook.count);
+  x = nullptr;
+  CHECK_EQUAL(1, hook.count);
+}
+
+TEST(collect_hook_removed) {
+  counting_hook hook;
+  cycle_gptr<item> x = make_cycle<item>();
+  add_collect_hook(x, hook);
+  hook.remove();
+
+  x = nullptr;
+  CHECK_EQUAL(0, hook.count);
+}
+
+TEST(weak_cache_get_or_create) {
+  weak_cache<int, item> cache;
+  int created = 0;
+  const auto create =
+      [&created]() {
+        ++created;
+        return make_cycle<item>(created);
+      };
+
+  cycle_gptr<item> x = cache.get_or_create(1, create);
+  cycle_gptr<item> y = cache.get_or_create(1, create);
+  CHECK_EQUAL(1, created);
+  CHECK(x == y);
+  CHECK(cache.get(1) == x);
+  CHECK(cache.get(2) == nullptr);
+  CHECK_EQUAL(1u, cache.size());
+}
+
+TEST(weak_cache_prunes_collected) {
+  weak_cache<int, item> cache;
+  cycle_gptr<item> keep = make_cycle<item>(1);
+  cache.insert_or_assign(1, keep);
+  cache.insert_or_assign(2, make_cycle<item>(2));
+  CHECK_EQUAL(2u, cache.size());
+
+  // Item 2 was collected, when the temporary went away.
+  CHECK(cache.get(2) == nullptr);
+  CHECK_EQUAL(1u, cache.size());
+  CHECK(cache.get(1) == keep);
+
+  // Recreating a collected entry.
+  cycle_gptr<item> x = cache.get_or_create(2, []() { return make_cycle<item>(3); });
+  CHECK_EQUAL(3, x->value);
+  x = nullptr;
+  cache.prune();
+  CHECK_EQUAL(1u, cache.size());
+}
+
+TEST(weak_cache_erase) {
+  weak_cache<int, item> cache;
+  cycle_gptr<item> x = make_cycle<item>(1);
+  CHECK(cache.insert_or_assign(1, x));
+  CHECK(!cache.insert_or_assign(1, x));
+  CHECK(cache.erase(1));
+  CHECK(!cache.erase(1));
+  CHECK(cache.empty());
+
+  x = nullptr; // Hook was removed, so this doesn't touch the cache.
+  CHECK(cache.empty());
+}
+
+TEST(weak_cache_threads) {
+  weak_cache<int, item> cache{ 4 };
+  std::atomic<int> created{ 0 };
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back(
+        [&cache, &created]() {
+          for (int round = 0; round < 50; ++round) {
+            std::vector<cycle_gptr<item>> held;
+            for (int i = 0; i < 100; ++i) {
+              held.push_back(cache.get_or_create(
+                      i,
+                      [&created, i]() {
+                        created.fetch_add(1, std::memory_order_relaxed);
+                        return make_cycle<item>(i);
+                      }));
+              CHECK_EQUAL(i, held.back()->value);
+            }
+          }
+        });
+  }
+  for (auto& thr : threads) thr.join();
+
+  // Everything was collected.
+  cache.prune();
+  CHECK(cache.empty());
+  CHECK(created.load() >= 100);
+}